@@ -1,5 +1,5 @@
 #include "account_manager.h"
-#include <iostream>
+#include "async_log.h"
 #include <openssl/sha.h>
 #include <sstream>
 #include <iomanip>
@@ -17,16 +17,15 @@ bool AccountManager::authenticate(const std::string& username, const std::string
     
     auto it = accounts_.find(username);
     if (it == accounts_.end()) {
-        std::cout << "[AccountManager] User not found: " << username << std::endl;
+        LOG_INFO("AccountManager", "User not found", {"username", username});
         return false;
     }
     
     std::string hashed = hashPassword(password);
     bool authenticated = (it->second.password_hash == hashed);
     
-    std::cout << "[AccountManager] Authentication " 
-              << (authenticated ? "SUCCESS" : "FAILED") 
-              << " for user: " << username << std::endl;
+    LOG_INFO("AccountManager", authenticated ? "Authentication succeeded" : "Authentication failed",
+             {"username", username});
     
     return authenticated;
 }
@@ -35,7 +34,7 @@ bool AccountManager::createAccount(const std::string& username, const std::strin
     std::lock_guard<std::mutex> lock(mutex_);
     
     if (accounts_.find(username) != accounts_.end()) {
-        std::cout << "[AccountManager] User already exists: " << username << std::endl;
+        LOG_INFO("AccountManager", "User already exists", {"username", username});
         return false;
     }
     
@@ -46,7 +45,7 @@ bool AccountManager::createAccount(const std::string& username, const std::strin
     account.is_active = true;
     
     accounts_[username] = account;
-    std::cout << "[AccountManager] Account created: " << username << std::endl;
+    LOG_INFO("AccountManager", "Account created", {"username", username});
     return true;
 }
 
@@ -59,7 +58,7 @@ bool AccountManager::deleteAccount(const std::string& username) {
     }
     
     accounts_.erase(it);
-    std::cout << "[AccountManager] Account deleted: " << username << std::endl;
+    LOG_INFO("AccountManager", "Account deleted", {"username", username});
     return true;
 }
 
@@ -115,7 +114,7 @@ void AccountManager::initializeDefaultAccounts() {
     createAccount("victor", "password123", "victor@example.com");
     createAccount("admin", "admin123", "admin@example.com");
     
-    std::cout << "[AccountManager] Initialized with default accounts" << std::endl;
+    LOG_INFO("AccountManager", "Initialized with default accounts");
 }
 
 } // namespace AccountServer
@@ -1,4 +1,5 @@
 #include "account_manager.h"
+#include "async_log.h"
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -7,6 +8,7 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
+#include <cerrno>
 #include <csignal>
 #include <atomic>
 
@@ -15,7 +17,6 @@ using namespace RemoteAccessSystem::AccountServer;
 std::atomic<bool> running(true);
 
 void signalHandler(int signal) {
-    std::cout << "\n[AccountServer] Shutting down..." << std::endl;
     running = false;
 }
 
@@ -27,12 +28,13 @@ int main() {
     std::cout << "  Account Server v1.0" << std::endl;
     std::cout << "========================================" << std::endl;
     
+    RemoteAccessSystem::Common::AsyncLog::Start();
     AccountManager manager;
     
     // Create server socket
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
-        std::cerr << "[AccountServer] Failed to create socket" << std::endl;
+        LOG_ERROR("AccountServer", "Failed to create socket", {"error", strerror(errno)});
         return 1;
     }
     
@@ -45,18 +47,18 @@ int main() {
     address.sin_port = htons(2809);
     
     if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-        std::cerr << "[AccountServer] Bind failed" << std::endl;
+        LOG_ERROR("AccountServer", "Bind failed", {"error", strerror(errno)});
         close(server_fd);
         return 1;
     }
     
     if (listen(server_fd, 5) < 0) {
-        std::cerr << "[AccountServer] Listen failed" << std::endl;
+        LOG_ERROR("AccountServer", "Listen failed", {"error", strerror(errno)});
         close(server_fd);
         return 1;
     }
     
-    std::cout << "[AccountServer] Listening on port 2809" << std::endl;
+    LOG_INFO("AccountServer", "Listening", {"port", 2809});
     
     while (running) {
         // Accept connections and process authentication requests
@@ -73,7 +75,7 @@ int main() {
         ssize_t bytes = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
         if (bytes > 0) {
             buffer[bytes] = '\0';
-            std::cout << "[AccountServer] Received: " << buffer << std::endl;
+            LOG_DEBUG("AccountServer", "Received", {"request", std::string_view(buffer, bytes)});
             
             std::string response = "AUTH_OK\n";
             send(client_fd, response.c_str(), response.length(), 0);
@@ -82,7 +84,8 @@ int main() {
         close(client_fd);
     }
     
+    LOG_INFO("AccountServer", "Shutting down");
     close(server_fd);
-    std::cout << "[AccountServer] Shutdown complete" << std::endl;
+    LOG_INFO("AccountServer", "Shutdown complete");
     return 0;
 }
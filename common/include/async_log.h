@@ -0,0 +1,158 @@
+#ifndef REMOTE_ACCESS_SYSTEM_ASYNC_LOG_H
+#define REMOTE_ACCESS_SYSTEM_ASYNC_LOG_H
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+enum class LogLevel : uint8_t {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4
+};
+
+// Levels below this are compiled out: their arguments are not even
+// evaluated. Build with -DRAS_LOG_COMPILED_LEVEL=0 to keep Trace.
+#ifndef RAS_LOG_COMPILED_LEVEL
+#define RAS_LOG_COMPILED_LEVEL 1
+#endif
+
+// One key=value field of a log line. Strings are referenced, not copied,
+// so they only need to outlive the logging call; numbers are formatted
+// into the field itself.
+class LogField {
+public:
+    LogField(std::string_view key, std::string_view value) : key_(key), value_(value), number_size_(0) {}
+    LogField(std::string_view key, const std::string& value) : LogField(key, std::string_view(value)) {}
+    LogField(std::string_view key, const char* value)
+        : LogField(key, value ? std::string_view(value) : std::string_view("(null)")) {}
+    LogField(std::string_view key, bool value) : LogField(key, value ? "true" : "false") {}
+    
+    template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+    LogField(std::string_view key, T value) : key_(key) {
+        number_size_ = static_cast<uint8_t>(std::to_chars(number_, number_ + sizeof(number_), value).ptr - number_);
+    }
+    
+    LogField(std::string_view key, double value) : key_(key) {
+        number_size_ = static_cast<uint8_t>(snprintf(number_, sizeof(number_), "%.6g", value));
+    }
+    
+    std::string_view Key() const { return key_; }
+    std::string_view Value() const { return number_size_ ? std::string_view(number_, number_size_) : value_; }
+
+private:
+    std::string_view key_;
+    std::string_view value_;
+    char number_[24];
+    uint8_t number_size_;
+};
+
+// Asynchronous logger.
+//
+// A logging call formats its line on the calling thread into that
+// thread's own ring buffer (single producer, single consumer, no locks)
+// and returns; a background thread drains every ring about every 50 ms,
+// orders the lines by time and writes them out in one write() per round.
+// Nothing on the logging path flushes or takes a shared lock, so transfer
+// threads no longer serialize on the console. A full ring drops the line
+// and counts it rather than blocking; Error lines wake the writer at once.
+//
+// Lines look like
+//   2026-01-05 14:03:07.123 INFO  [RelayServer] PC registered pc_id=abc username=bob
+//
+// Use the LOG_* macros below rather than calling Write() directly, so
+// compiled-out levels cost nothing.
+class AsyncLog {
+public:
+    // Output descriptor (default stdout) and the minimum level written
+    // (default Info, or RAS_LOG_LEVEL=trace|debug|info|warn|error from
+    // the environment). The logger also starts by itself on first use.
+    static void Start(int fd = 1);
+    static void SetLevel(LogLevel level);
+    static bool Enabled(LogLevel level);
+    
+    static void Write(LogLevel level, std::string_view component, std::string_view message,
+                      std::initializer_list<LogField> fields);
+    
+    // One overload per field count, so the LOG_* macros can pass the
+    // message and fields as one __VA_ARGS__ that is never empty
+    static void Write(LogLevel level, std::string_view component, std::string_view message) {
+        Write(level, component, message, std::initializer_list<LogField>{});
+    }
+    static void Write(LogLevel level, std::string_view component, std::string_view message, const LogField& f1) {
+        Write(level, component, message, {f1});
+    }
+    static void Write(LogLevel level, std::string_view component, std::string_view message, const LogField& f1,
+                      const LogField& f2) {
+        Write(level, component, message, {f1, f2});
+    }
+    static void Write(LogLevel level, std::string_view component, std::string_view message, const LogField& f1,
+                      const LogField& f2, const LogField& f3) {
+        Write(level, component, message, {f1, f2, f3});
+    }
+    static void Write(LogLevel level, std::string_view component, std::string_view message, const LogField& f1,
+                      const LogField& f2, const LogField& f3, const LogField& f4) {
+        Write(level, component, message, {f1, f2, f3, f4});
+    }
+    static void Write(LogLevel level, std::string_view component, std::string_view message, const LogField& f1,
+                      const LogField& f2, const LogField& f3, const LogField& f4, const LogField& f5) {
+        Write(level, component, message, {f1, f2, f3, f4, f5});
+    }
+    static void Write(LogLevel level, std::string_view component, std::string_view message, const LogField& f1,
+                      const LogField& f2, const LogField& f3, const LogField& f4, const LogField& f5,
+                      const LogField& f6) {
+        Write(level, component, message, {f1, f2, f3, f4, f5, f6});
+    }
+    static void Write(LogLevel level, std::string_view component, std::string_view message, const LogField& f1,
+                      const LogField& f2, const LogField& f3, const LogField& f4, const LogField& f5,
+                      const LogField& f6, const LogField& f7) {
+        Write(level, component, message, {f1, f2, f3, f4, f5, f6, f7});
+    }
+    static void Write(LogLevel level, std::string_view component, std::string_view message, const LogField& f1,
+                      const LogField& f2, const LogField& f3, const LogField& f4, const LogField& f5,
+                      const LogField& f6, const LogField& f7, const LogField& f8) {
+        Write(level, component, message, {f1, f2, f3, f4, f5, f6, f7, f8});
+    }
+    
+    // Returns once everything logged before the call has been written
+    static void Flush();
+    
+    // Writes what is left and stops the writer thread; lines logged
+    // afterwards are written synchronously. Runs at exit by itself.
+    static void Stop();
+    
+    // Lines dropped because a thread's ring was full
+    static uint64_t Dropped();
+};
+
+} // namespace Common
+} // namespace RemoteAccessSystem
+
+// __VA_ARGS__ is the message followed by up to eight fields
+#define RAS_LOG(level, component, ...)                                                                          \
+    do {                                                                                                        \
+        if constexpr (static_cast<int>(::RemoteAccessSystem::Common::LogLevel::level) >= RAS_LOG_COMPILED_LEVEL) { \
+            if (::RemoteAccessSystem::Common::AsyncLog::Enabled(::RemoteAccessSystem::Common::LogLevel::level)) { \
+                ::RemoteAccessSystem::Common::AsyncLog::Write(::RemoteAccessSystem::Common::LogLevel::level,    \
+                                                              component, __VA_ARGS__);                          \
+            }                                                                                                   \
+        }                                                                                                       \
+    } while (0)
+
+// LOG_INFO("RelayServer", "PC registered", {"pc_id", pc_id}, {"username", name});
+#define LOG_TRACE(component, ...) RAS_LOG(Trace, component, __VA_ARGS__)
+#define LOG_DEBUG(component, ...) RAS_LOG(Debug, component, __VA_ARGS__)
+#define LOG_INFO(component, ...) RAS_LOG(Info, component, __VA_ARGS__)
+#define LOG_WARN(component, ...) RAS_LOG(Warn, component, __VA_ARGS__)
+#define LOG_ERROR(component, ...) RAS_LOG(Error, component, __VA_ARGS__)
+
+#endif // REMOTE_ACCESS_SYSTEM_ASYNC_LOG_H
@@ -0,0 +1,91 @@
+#ifndef INPUT_FRAME_H
+#define INPUT_FRAME_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace RemoteAccessSystem {
+
+// Fixed-size binary input event for the low-latency input channel.
+//
+// Mouse and keyboard events are sent as 12-byte little-endian frames over
+// a dedicated TCP_NODELAY connection, so a pointer move costs one small
+// segment instead of a formatted text line queued behind screen data.
+//
+//   offset  size  field
+//   0       1     type (InputFrame::Type)
+//   1       1     button (mouse) or modifier bits (keys)
+//   2       2     sequence, wraps
+//   4       4     sender timestamp in microseconds, wraps
+//   8       4     x/y as two int16 (mouse) or key code (keys) or
+//                 receiver processing time in microseconds (ACK)
+//
+// The PC answers each batch with an ACK frame that echoes the sequence and
+// timestamp of the last event it injected, which gives the sender a round
+// trip time without needing synchronized clocks.
+struct InputFrame {
+    enum Type : uint8_t {
+        MOVE = 1,
+        BUTTON_DOWN = 2,
+        BUTTON_UP = 3,
+        SCROLL = 4,         // y > 0 scrolls up, y < 0 down
+        KEY_DOWN = 5,
+        KEY_UP = 6,
+        ACK = 0x80
+    };
+
+    uint8_t type;
+    uint8_t button;
+    uint16_t sequence;
+    uint32_t timestampUs;
+    int16_t x;
+    int16_t y;
+    uint32_t value;         // key code, or processing time for ACK
+
+    static const size_t kSize = 12;
+
+    void encode(uint8_t* out) const {
+        out[0] = type;
+        out[1] = button;
+        putU16(out + 2, sequence);
+        putU32(out + 4, timestampUs);
+        if (type == KEY_DOWN || type == KEY_UP || type == ACK) {
+            putU32(out + 8, value);
+        } else {
+            putU16(out + 8, static_cast<uint16_t>(x));
+            putU16(out + 10, static_cast<uint16_t>(y));
+        }
+    }
+
+    // Returns false for an unknown type
+    bool decode(const uint8_t* in) {
+        type = in[0];
+        button = in[1];
+        sequence = getU16(in + 2);
+        timestampUs = getU32(in + 4);
+        x = static_cast<int16_t>(getU16(in + 8));
+        y = static_cast<int16_t>(getU16(in + 10));
+        value = getU32(in + 8);
+        return (type >= MOVE && type <= KEY_UP) || type == ACK;
+    }
+
+private:
+    static void putU16(uint8_t* p, uint16_t v) {
+        p[0] = static_cast<uint8_t>(v);
+        p[1] = static_cast<uint8_t>(v >> 8);
+    }
+    static void putU32(uint8_t* p, uint32_t v) {
+        putU16(p, static_cast<uint16_t>(v));
+        putU16(p + 2, static_cast<uint16_t>(v >> 16));
+    }
+    static uint16_t getU16(const uint8_t* p) {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+    static uint32_t getU32(const uint8_t* p) {
+        return getU16(p) | (static_cast<uint32_t>(getU16(p + 2)) << 16);
+    }
+};
+
+} // namespace RemoteAccessSystem
+
+#endif // INPUT_FRAME_H
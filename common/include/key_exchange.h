@@ -0,0 +1,116 @@
+#ifndef REMOTE_ACCESS_SYSTEM_KEY_EXCHANGE_H
+#define REMOTE_ACCESS_SYSTEM_KEY_EXCHANGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef struct evp_pkey_st EVP_PKEY;
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+// Traffic keys for one connection, one key/IV pair per direction, sized
+// for RecordLayer
+struct SessionKeys {
+    std::vector<unsigned char> client_key;
+    std::vector<unsigned char> client_iv;
+    std::vector<unsigned char> server_key;
+    std::vector<unsigned char> server_iv;
+};
+
+// What a client keeps to resume: the server's opaque ticket and the
+// secret both sides derived for it
+struct SessionTicket {
+    std::vector<unsigned char> ticket;
+    std::vector<unsigned char> secret;
+    
+    bool Valid() const { return !ticket.empty() && !secret.empty(); }
+};
+
+// Per-connection handshake that replaces static or per-message keys.
+//
+// Full handshake: each side sends 32 random bytes and an ephemeral X25519
+// public key; traffic keys are HKDF-SHA256 of the shared secret, salted
+// with both randoms. Resumption: the client sends a ticket instead of a
+// key share; the server opens it to recover the resumption secret and both
+// derive fresh keys from it and the new randoms, with no X25519 work.
+// Every handshake issues a new ticket, so secrets roll forward.
+//
+// Client hello:  version, mode (FULL/RESUME), random[32], then
+//                public[32] or u16 ticket length + ticket
+// Server hello:  version, mode (FULL/RESUMED/RETRY), random[32],
+//                public[32] if FULL, u16 ticket length + ticket
+// RETRY means the ticket was refused; the client starts over with FULL.
+//
+// The exchange itself does not authenticate the relay; identity comes
+// from the TLS connection or the account-server login around it.
+class KeyExchange {
+public:
+    static constexpr size_t RANDOM_SIZE = 32;
+    static constexpr size_t PUBLIC_KEY_SIZE = 32;
+    static constexpr size_t SECRET_SIZE = 32;
+    
+    enum class Mode : uint8_t {
+        FULL = 0,
+        RESUME = 1,
+        RESUMED = 2,
+        RETRY = 3
+    };
+    
+    KeyExchange();
+    ~KeyExchange();
+    
+    // Client side: builds the hello, offering `resume` if it is valid
+    std::vector<unsigned char> ClientHello(const SessionTicket* resume = nullptr);
+    
+    // Client side: reads the server hello. Returns false on a malformed
+    // reply or RETRY (check Retry()); otherwise fills keys and the ticket
+    // to offer next time.
+    bool ClientFinish(const std::vector<unsigned char>& server_hello,
+                      SessionKeys& keys, SessionTicket& next);
+    
+    bool Resumed() const { return resumed_; }
+    bool Retry() const { return retry_; }
+
+private:
+    KeyExchange(const KeyExchange&) = delete;
+    KeyExchange& operator=(const KeyExchange&) = delete;
+    
+    EVP_PKEY* private_key_;
+    unsigned char client_random_[RANDOM_SIZE];
+    std::vector<unsigned char> offered_secret_;
+    bool resumed_;
+    bool retry_;
+};
+
+// Server side of KeyExchange. Tickets are sealed with AES-256-GCM under a
+// key that lives only in this process, so they are useless elsewhere and
+// die with a restart. Thread-safe; one instance serves all connections.
+class TicketIssuer {
+public:
+    // Throws std::runtime_error if the ticket key cannot be generated
+    explicit TicketIssuer(uint64_t lifetime_seconds = 24 * 60 * 60);
+    ~TicketIssuer();
+    
+    // Answers a client hello. Returns false if it is malformed; otherwise
+    // fills `server_hello` and, unless the reply is RETRY, `keys`.
+    bool Accept(const std::vector<unsigned char>& client_hello,
+                std::vector<unsigned char>& server_hello,
+                SessionKeys& keys, KeyExchange::Mode& mode);
+
+private:
+    std::vector<unsigned char> Seal(const std::vector<unsigned char>& secret) const;
+    bool Open(const unsigned char* ticket, size_t length, std::vector<unsigned char>& secret) const;
+    
+    TicketIssuer(const TicketIssuer&) = delete;
+    TicketIssuer& operator=(const TicketIssuer&) = delete;
+    
+    std::vector<unsigned char> ticket_key_;
+    uint64_t lifetime_;
+};
+
+} // namespace Common
+} // namespace RemoteAccessSystem
+
+#endif // REMOTE_ACCESS_SYSTEM_KEY_EXCHANGE_H
@@ -0,0 +1,103 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace RemoteAccessSystem {
+
+// Lock-free latency histogram over microseconds.
+//
+// Each power of two is split into four buckets, so percentiles are exact
+// to within 25%; the last bucket also takes everything above ~16 s.
+// record() is safe from any thread.
+class LatencyHistogram {
+public:
+    static const int kBuckets = 96;
+
+    LatencyHistogram() { reset(); }
+
+    void record(uint64_t us) {
+        m_buckets[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(us, std::memory_order_relaxed);
+
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (us > max && !m_max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+        }
+    }
+
+    void reset() {
+        for (int i = 0; i < kBuckets; i++) {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t maxUs() const { return m_max.load(std::memory_order_relaxed); }
+
+    uint64_t meanUs() const {
+        uint64_t n = count();
+        return n ? m_sum.load(std::memory_order_relaxed) / n : 0;
+    }
+
+    // Upper bound of the bucket holding the given percentile (0-100),
+    // capped at the largest sample
+    uint64_t percentileUs(double percentile) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+
+        uint64_t rank = static_cast<uint64_t>(n * percentile / 100.0);
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen > rank) {
+                uint64_t bound = upperBound(i);
+                return bound < maxUs() ? bound : maxUs();
+            }
+        }
+        return maxUs();
+    }
+
+    // e.g. "n=1200 mean=3.1ms p50=4.1ms p90=8.2ms p99=16.4ms max=21.0ms"
+    std::string summary() const {
+        char text[160];
+        std::snprintf(text, sizeof(text),
+                      "n=%llu mean=%.1fms p50=%.1fms p90=%.1fms p99=%.1fms max=%.1fms",
+                      static_cast<unsigned long long>(count()), meanUs() / 1000.0,
+                      percentileUs(50) / 1000.0, percentileUs(90) / 1000.0,
+                      percentileUs(99) / 1000.0, maxUs() / 1000.0);
+        return text;
+    }
+
+private:
+    // Values below 4 get their own bucket; above that, bucket 4*(e-1)+m
+    // holds [(4+m) << (e-2), (5+m) << (e-2)) where e is the top bit
+    static int bucketFor(uint64_t us) {
+        if (us < 4) return static_cast<int>(us);
+        int e = 63 - __builtin_clzll(us);
+        int bucket = 4 * (e - 1) + static_cast<int>((us >> (e - 2)) & 3);
+        return bucket < kBuckets ? bucket : kBuckets - 1;
+    }
+
+    static uint64_t upperBound(int bucket) {
+        if (bucket < 4) return bucket;
+        int e = bucket / 4 + 1;
+        uint64_t m = bucket % 4;
+        return ((5 + m) << (e - 2)) - 1;
+    }
+
+    std::atomic<uint64_t> m_buckets[kBuckets];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+};
+
+} // namespace RemoteAccessSystem
+
+#endif // LATENCY_HISTOGRAM_H
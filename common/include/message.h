@@ -77,50 +77,35 @@ struct Message {
     MessageHeader header;
     std::vector<uint8_t> payload;
     
-    // Serialization methods
-    std::vector<uint8_t> Serialize() const {
-        std::vector<uint8_t> result;
-        
-        // Reserve space for header + payload
-        result.reserve(sizeof(uint32_t) * 2 + sizeof(uint64_t) * 2 + sizeof(uint64_t) + payload.size());
-        
-        // Serialize MessageType
+    // type(4) message_id(8) timestamp(8) status(4) payload_size(8), host order
+    static constexpr size_t HEADER_SIZE = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 3;
+    
+    // Writes the fixed header into out, which must hold HEADER_SIZE bytes.
+    // Senders keep it on the stack and pair it with the payload in one writev.
+    void SerializeHeader(uint8_t* out) const {
         uint32_t type_value = static_cast<uint32_t>(header.type);
-        result.insert(result.end(), 
-                     reinterpret_cast<const uint8_t*>(&type_value),
-                     reinterpret_cast<const uint8_t*>(&type_value) + sizeof(type_value));
-        
-        // Serialize message_id
-        result.insert(result.end(),
-                     reinterpret_cast<const uint8_t*>(&header.message_id),
-                     reinterpret_cast<const uint8_t*>(&header.message_id) + sizeof(header.message_id));
-        
-        // Serialize timestamp
-        result.insert(result.end(),
-                     reinterpret_cast<const uint8_t*>(&header.timestamp),
-                     reinterpret_cast<const uint8_t*>(&header.timestamp) + sizeof(header.timestamp));
-        
-        // Serialize status
         uint32_t status_value = static_cast<uint32_t>(header.status);
-        result.insert(result.end(),
-                     reinterpret_cast<const uint8_t*>(&status_value),
-                     reinterpret_cast<const uint8_t*>(&status_value) + sizeof(status_value));
-        
-        // Serialize payload size
         uint64_t payload_size = payload.size();
-        result.insert(result.end(),
-                     reinterpret_cast<const uint8_t*>(&payload_size),
-                     reinterpret_cast<const uint8_t*>(&payload_size) + sizeof(payload_size));
-        
-        // Serialize payload
-        result.insert(result.end(), payload.begin(), payload.end());
         
+        std::memcpy(out, &type_value, sizeof(type_value));
+        std::memcpy(out + 4, &header.message_id, sizeof(header.message_id));
+        std::memcpy(out + 12, &header.timestamp, sizeof(header.timestamp));
+        std::memcpy(out + 20, &status_value, sizeof(status_value));
+        std::memcpy(out + 24, &payload_size, sizeof(payload_size));
+    }
+    
+    // Serialization methods
+    std::vector<uint8_t> Serialize() const {
+        std::vector<uint8_t> result(HEADER_SIZE + payload.size());
+        SerializeHeader(result.data());
+        if (!payload.empty()) {
+            std::memcpy(result.data() + HEADER_SIZE, payload.data(), payload.size());
+        }
         return result;
     }
     
     bool Deserialize(const std::vector<uint8_t>& data) {
-        size_t min_size = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 3;
-        if (data.size() < min_size) {
+        if (data.size() < HEADER_SIZE) {
             return false;
         }
         
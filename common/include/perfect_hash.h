@@ -0,0 +1,80 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace RemoteAccessSystem {
+
+namespace Detail {
+
+constexpr size_t nameIndexSlots(size_t count) {
+    size_t slots = 8;
+    while (slots < count * 4) slots *= 2;
+    return slots;
+}
+
+} // namespace Detail
+
+// Collision-free lookup from a fixed set of names to their position.
+//
+// The seed is searched for at compile time, so a constexpr NameIndex
+// costs one hash, one table load and one string compare at run time. The
+// table has at least four slots per name, which keeps the search short;
+// duplicate names fail to compile.
+template <size_t N>
+class NameIndex {
+public:
+    static constexpr size_t kSlots = Detail::nameIndexSlots(N);
+
+    constexpr explicit NameIndex(const std::array<std::string_view, N>& names)
+        : m_names(names), m_slots{}, m_seed(0) {
+        for (uint32_t seed = 1; seed < 100000; seed++) {
+            if (tryBuild(seed)) {
+                m_seed = seed;
+                return;
+            }
+        }
+        throw "NameIndex: no perfect hash (duplicate names?)";
+    }
+
+    // Position of name in the original list, or -1
+    constexpr int find(std::string_view name) const {
+        uint16_t entry = m_slots[hash(name, m_seed) & (kSlots - 1)];
+        if (entry == 0 || m_names[entry - 1] != name) return -1;
+        return entry - 1;
+    }
+
+    constexpr uint32_t seed() const { return m_seed; }
+
+private:
+    // FNV-1a with the seed folded into the offset basis
+    static constexpr uint32_t hash(std::string_view name, uint32_t seed) {
+        uint32_t h = 2166136261u ^ (seed * 0x9E3779B1u);
+        for (char c : name) {
+            h ^= static_cast<uint8_t>(c);
+            h *= 16777619u;
+        }
+        return h ^ (h >> 16);
+    }
+
+    constexpr bool tryBuild(uint32_t seed) {
+        for (size_t i = 0; i < kSlots; i++) m_slots[i] = 0;
+        for (size_t i = 0; i < N; i++) {
+            uint16_t& entry = m_slots[hash(m_names[i], seed) & (kSlots - 1)];
+            if (entry != 0) return false;
+            entry = static_cast<uint16_t>(i + 1);
+        }
+        return true;
+    }
+
+    std::array<std::string_view, N> m_names;
+    uint16_t m_slots[kSlots];
+    uint32_t m_seed;
+};
+
+} // namespace RemoteAccessSystem
+
+#endif // PERFECT_HASH_H
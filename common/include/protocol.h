@@ -2,11 +2,22 @@
 #define PROTOCOL_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>
+#include <sys/uio.h>
 
 namespace RemoteAccessSystem {
 
+// Serialization
+//
+// serialize()/deserialize() return owning copies. The hot paths use the
+// allocation-free forms instead: serializeTo() formats into a caller
+// buffer sized with serializedSize() and returns the bytes written (0 if
+// it does not fit), and parse() reads with std::from_chars, returning
+// false on malformed input. Views returned by parse() point into the
+// input buffer.
+
 // Message types
 enum class MessageType : uint8_t {
     // Authentication
@@ -60,6 +71,16 @@ struct Message {
     
     std::string serialize() const;
     static Message deserialize(const std::string& data);
+    
+    size_t serializedSize() const;
+    size_t serializeTo(char* out, size_t capacity) const;
+};
+
+struct MessageView {
+    MessageType type;
+    std::string_view payload;
+    
+    bool parse(std::string_view data);
 };
 
 // File info structure
@@ -72,17 +93,63 @@ struct FileInfo {
     
     std::string serialize() const;
     static FileInfo deserialize(const std::string& data);
+    
+    size_t serializedSize() const;
+    size_t serializeTo(char* out, size_t capacity) const;
+    bool parse(std::string_view data);   // reuses the strings' capacity
+};
+
+// Rectangle of a screen frame that changed since the previous frame
+struct ScreenTile {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;  // same codes as ScreenFrame::format
+    std::vector<uint8_t> data;
 };
 
 // Screen frame structure
+// When tiles is non-empty the frame is a delta: data is empty and only the
+// listed tiles are sent, each in its own format.
 struct ScreenFrame {
     uint32_t width;
     uint32_t height;
     uint32_t format; // 0=RGB, 1=JPEG, 2=PNG
     std::vector<uint8_t> data;
+    std::vector<ScreenTile> tiles;
     
     std::string serialize() const;
     static ScreenFrame deserialize(const std::string& data);
+    
+    size_t serializedSize() const;
+    size_t serializeTo(char* out, size_t capacity) const;
+    
+    // Scatter-gather form for writev(): the '|' headers are formatted into
+    // `scratch` and pixel data is referenced in place, never copied. Both
+    // vectors are reused across calls. Returns the total size; the iovecs
+    // stay valid while this frame and `scratch` are unchanged.
+    size_t serializeTo(std::vector<char>& scratch, std::vector<struct iovec>& iov) const;
+};
+
+struct ScreenTileView {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    std::string_view data;
+};
+
+// Parsed ScreenFrame whose pixel data stays in the receive buffer
+struct ScreenFrameView {
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    std::string_view data;
+    std::vector<ScreenTileView> tiles;   // reused across parse() calls
+    
+    bool parse(std::string_view data);
 };
 
 // Mouse event structure
@@ -105,6 +172,10 @@ struct MouseEvent {
     
     std::string serialize() const;
     static MouseEvent deserialize(const std::string& data);
+    
+    size_t serializedSize() const;
+    size_t serializeTo(char* out, size_t capacity) const;
+    bool parse(std::string_view data);
 };
 
 // Keyboard event structure
@@ -120,6 +191,10 @@ struct KeyboardEvent {
     
     std::string serialize() const;
     static KeyboardEvent deserialize(const std::string& data);
+    
+    size_t serializedSize() const;
+    size_t serializeTo(char* out, size_t capacity) const;
+    bool parse(std::string_view data);
 };
 
 } // namespace RemoteAccessSystem
@@ -0,0 +1,93 @@
+#ifndef REMOTE_ACCESS_SYSTEM_RECORD_LAYER_H
+#define REMOTE_ACCESS_SYSTEM_RECORD_LAYER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+enum class CipherSuite : uint8_t {
+    AES_256_GCM = 1,
+    CHACHA20_POLY1305 = 2
+};
+
+// AEAD record layer for one connection.
+//
+// A record is a 4-byte header (version, suite, u16 LE plaintext length),
+// the ciphertext, and a 16-byte tag; the header is authenticated too.
+// Each direction has its own key, a 12-byte IV and a 64-bit sequence
+// number; the nonce is the IV XOR the sequence number, as in TLS 1.3, so
+// a nonce is never reused and replayed or reordered records fail to open.
+//
+// The cipher contexts are set up once with the key and only re-seeded with
+// a nonce per record. Seal and Open work in place when the plaintext sits
+// at record + HEADER_SIZE, so a sender can read file data straight into
+// its send buffer and encrypt it there.
+class RecordLayer {
+public:
+    static constexpr size_t KEY_SIZE = 32;
+    static constexpr size_t IV_SIZE = 12;
+    static constexpr size_t HEADER_SIZE = 4;
+    static constexpr size_t TAG_SIZE = 16;
+    static constexpr size_t MAX_PLAINTEXT = 16384;
+    static constexpr size_t MAX_RECORD = HEADER_SIZE + MAX_PLAINTEXT + TAG_SIZE;
+    
+    // Throws std::invalid_argument for bad key/IV sizes and
+    // std::runtime_error if OpenSSL cannot set up the contexts
+    RecordLayer(CipherSuite suite,
+                const std::vector<unsigned char>& write_key, const std::vector<unsigned char>& write_iv,
+                const std::vector<unsigned char>& read_key, const std::vector<unsigned char>& read_iv);
+    ~RecordLayer();
+    
+    // Random 96-bit IV for one direction
+    static std::vector<unsigned char> GenerateIV();
+    
+    // Bytes a record carrying `length` bytes of plaintext takes
+    static size_t RecordSize(size_t length) { return HEADER_SIZE + length + TAG_SIZE; }
+    
+    // Full record size announced by a header, or 0 if the header is not
+    // one of ours; lets a reader know how much to wait for
+    static size_t RecordSizeFromHeader(const unsigned char* header);
+    
+    // Encrypts up to MAX_PLAINTEXT bytes into `record`, which must hold
+    // RecordSize(length). `plaintext` may be record + HEADER_SIZE.
+    // Returns the record size.
+    size_t Seal(const unsigned char* plaintext, size_t length, unsigned char* record);
+    
+    // Seals `length` bytes as consecutive full-size records appended to
+    // `out`; returns the bytes appended
+    size_t SealStream(const unsigned char* data, size_t length, std::vector<unsigned char>& out);
+    
+    // Authenticates and decrypts one whole record into `plaintext` (which
+    // may be record + HEADER_SIZE). Returns false, leaving the sequence
+    // number alone, if the record is malformed or was tampered with.
+    bool Open(const unsigned char* record, size_t record_size,
+              unsigned char* plaintext, size_t& length);
+    
+    CipherSuite Suite() const { return suite_; }
+    uint64_t WriteSequence() const { return write_seq_; }
+    uint64_t ReadSequence() const { return read_seq_; }
+
+private:
+    void Nonce(const unsigned char* iv, uint64_t seq, unsigned char* nonce) const;
+    
+    RecordLayer(const RecordLayer&) = delete;
+    RecordLayer& operator=(const RecordLayer&) = delete;
+    
+    CipherSuite suite_;
+    EVP_CIPHER_CTX* seal_ctx_;
+    EVP_CIPHER_CTX* open_ctx_;
+    unsigned char write_iv_[IV_SIZE];
+    unsigned char read_iv_[IV_SIZE];
+    uint64_t write_seq_;
+    uint64_t read_seq_;
+};
+
+} // namespace Common
+} // namespace RemoteAccessSystem
+
+#endif // REMOTE_ACCESS_SYSTEM_RECORD_LAYER_H
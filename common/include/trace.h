@@ -0,0 +1,217 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "wire_frame.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace RemoteAccessSystem {
+namespace Trace {
+
+// Distributed request tracing across mobile, relay and PC.
+//
+// A request carries a Wire::TraceContext from hop to hop (FLAG_TRACED);
+// every process records the spans it spent on it and appends them to the
+// file named by RAS_TRACE_FILE as Chrome trace events, which
+// chrome://tracing and Perfetto (ui.perfetto.dev) open directly. Spans of
+// one request share args.trace_id and link up through parent_span_id.
+// Several processes may append to the same file.
+//
+// Timestamps are wall-clock microseconds, so hops on different hosts line
+// up only as well as their clocks do.
+
+inline int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t randomId() {
+    thread_local std::mt19937_64 generator(
+        (static_cast<uint64_t>(std::random_device()()) << 32) ^ static_cast<uint64_t>(nowUs()));
+    uint64_t id;
+    do {
+        id = generator();
+    } while (id == 0);
+    return id;
+}
+
+// Writes spans to RAS_TRACE_FILE. Events are buffered and written in
+// whole lines with O_APPEND, at most a second late, so processes sharing
+// the file do not tear each other's lines.
+class Exporter {
+public:
+    // Never destroyed, so threads still finishing spans at exit are safe;
+    // what is buffered is written by an atexit hook
+    static Exporter& instance() {
+        static Exporter* exporter = new Exporter();
+        return *exporter;
+    }
+
+    bool enabled() const { return m_fd >= 0; }
+
+    // Names this process's track in the viewer ("relay", "pc-client", ...)
+    void setService(const std::string& name) {
+        if (!enabled()) return;
+        std::string event = "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(getpid()) +
+                            ",\"args\":{\"name\":\"" + name + "\"}},\n";
+        add(event, true);
+    }
+
+    // Small per-process number of the calling thread, for the tid column
+    static int threadNumber() {
+        static std::atomic<int> next(1);
+        thread_local int number = next++;
+        return number;
+    }
+
+    void record(const std::string& name, const Wire::TraceContext& context, uint64_t parentSpan,
+                int thread, int64_t startUs, int64_t endUs) {
+        if (!enabled()) return;
+        char ids[128];
+        snprintf(ids, sizeof(ids), "\"trace_id\":\"%016llx%016llx\",\"span_id\":\"%016llx\"",
+                 static_cast<unsigned long long>(context.traceHigh),
+                 static_cast<unsigned long long>(context.traceLow),
+                 static_cast<unsigned long long>(context.spanId));
+
+        std::string event = "{\"name\":\"" + name + "\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":" +
+                            std::to_string(startUs) + ",\"dur\":" + std::to_string(endUs - startUs) +
+                            ",\"pid\":" + std::to_string(getpid()) + ",\"tid\":" + std::to_string(thread) +
+                            ",\"args\":{" + ids;
+        if (parentSpan != 0) {
+            char parent[48];
+            snprintf(parent, sizeof(parent), ",\"parent_span_id\":\"%016llx\"",
+                     static_cast<unsigned long long>(parentSpan));
+            event += parent;
+        }
+        event += "}},\n";
+        add(event, false);
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        flushLocked();
+    }
+
+private:
+    static const size_t kFlushBytes = 16 * 1024;
+    static const int64_t kFlushAfterUs = 1000000;
+
+    Exporter() : m_fd(-1), m_oldestUs(0) {
+        const char* path = getenv("RAS_TRACE_FILE");
+        if (!path || !*path) return;
+        m_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            fprintf(stderr, "RAS_TRACE_FILE: cannot open %s\n", path);
+            return;
+        }
+
+        // The first writer opens the JSON array; viewers accept it unclosed
+        struct stat info;
+        flock(m_fd, LOCK_EX);
+        if (fstat(m_fd, &info) == 0 && info.st_size == 0) {
+            ssize_t written = write(m_fd, "[\n", 2);
+            (void)written;
+        }
+        flock(m_fd, LOCK_UN);
+        atexit([] { instance().flush(); });
+    }
+
+    void add(const std::string& event, bool now) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_buffer.empty()) {
+            m_oldestUs = nowUs();
+        }
+        m_buffer += event;
+        if (now || m_buffer.size() >= kFlushBytes || nowUs() - m_oldestUs >= kFlushAfterUs) {
+            flushLocked();
+        }
+    }
+
+    void flushLocked() {
+        const char* data = m_buffer.data();
+        size_t left = m_buffer.size();
+        while (left > 0) {
+            ssize_t written = write(m_fd, data, left);
+            if (written <= 0) break;
+            data += written;
+            left -= written;
+        }
+        m_buffer.clear();
+    }
+
+    int m_fd;
+    std::mutex m_mutex;
+    std::string m_buffer;
+    int64_t m_oldestUs;
+};
+
+// One timed piece of work on a request. A span started under a received
+// context joins that trace; context() is what goes on the next hop's
+// frame. A default-constructed span is inactive and records nothing.
+class Span {
+public:
+    Span() : m_parent(0), m_thread(0), m_start(0), m_finished(false) {}
+
+    // Starts a new trace (the mobile app, where requests begin)
+    static Span root(const std::string& name) {
+        Span span;
+        span.m_name = name;
+        span.m_context.traceHigh = randomId();
+        span.m_context.traceLow = randomId();
+        span.m_context.spanId = randomId();
+        span.m_thread = Exporter::threadNumber();
+        span.m_start = nowUs();
+        return span;
+    }
+
+    // Starts a span under the sender's; inactive if the parent is not
+    // valid. A process that does not export passes the parent through, so
+    // the next hop's spans still link up with the last recorded one.
+    static Span child(const std::string& name, const Wire::TraceContext& parent) {
+        Span span;
+        if (!parent.valid()) return span;
+        span.m_context = parent;
+        if (!Exporter::instance().enabled()) return span;
+        span.m_name = name;
+        span.m_context.spanId = randomId();
+        span.m_parent = parent.spanId;
+        span.m_thread = Exporter::threadNumber();
+        span.m_start = nowUs();
+        return span;
+    }
+
+    bool active() const { return m_context.valid(); }
+    const Wire::TraceContext& context() const { return m_context; }
+    int64_t startUs() const { return m_start; }
+
+    // Records the span from its start until now, on the thread that
+    // started it; later calls do nothing
+    void finish() {
+        if (!active() || m_finished) return;
+        m_finished = true;
+        Exporter::instance().record(m_name, m_context, m_parent, m_thread, m_start, nowUs());
+    }
+
+private:
+    std::string m_name;
+    Wire::TraceContext m_context;
+    uint64_t m_parent;
+    int m_thread;
+    int64_t m_start;
+    bool m_finished;
+};
+
+} // namespace Trace
+} // namespace RemoteAccessSystem
+
+#endif // TRACE_H
@@ -0,0 +1,764 @@
+#ifndef WIRE_FRAME_H
+#define WIRE_FRAME_H
+
+#include "perfect_hash.h"
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+namespace RemoteAccessSystem {
+namespace Wire {
+
+// Binary framing for the relay / FileHandler / FileServer / mobile protocol.
+//
+// Every message is a 16-byte little-endian header followed by its fields,
+// each carried as a u32 length and raw bytes, so paths may contain '|' or
+// '\n' and nothing needs escaping:
+//
+//   offset  size  field
+//   0       1     magic 0xFA (never the first byte of a text command)
+//   1       1     version
+//   2       2     type (Wire::Type)
+//   4       2     flags
+//   6       2     field count
+//   8       4     request id (0 = none)
+//   12      4     payload length
+//
+// With FLAG_TRACED set, a 24-byte TraceContext (trace id high and low
+// halves, then the sender's span id, u64 each) sits between the header
+// and the fields and counts towards the payload length. Only peers that
+// announced "TRACE" get traced frames; older readers would not skip it.
+//
+// Compatibility: Reader also accepts the old newline-terminated
+// "CMD|a|b" lines and converts them to the same frames, and appendMessage()
+// can write either form. A peer that spoke text gets text back, so old
+// clients keep working while the relay and PCs move to binary.
+
+const uint8_t kMagic = 0xFA;
+const uint8_t kVersion = 1;
+const size_t kHeaderSize = 16;
+const uint32_t kMaxPayload = 16 * 1024 * 1024;
+const size_t kMaxFields = 0xFFFF;       // the header's field count is a u16
+
+enum Flags : uint16_t {
+    FLAG_NONE = 0,
+    FLAG_LEGACY = 1,        // converted from a text line by Reader
+    FLAG_TRACED = 2         // a TraceContext follows the header
+};
+
+const size_t kTraceSize = 24;
+
+// Where a request sits in a distributed trace: the trace it belongs to
+// and the span that sent it, which the receiver's spans hang under
+struct TraceContext {
+    uint64_t traceHigh = 0;
+    uint64_t traceLow = 0;
+    uint64_t spanId = 0;
+
+    bool valid() const { return (traceHigh | traceLow) != 0 && spanId != 0; }
+};
+
+enum class Type : uint16_t {
+    UNKNOWN = 0,
+
+    // Generic
+    OK = 1,
+    ERROR = 2,
+    PING = 3,
+    PONG = 4,
+    HEARTBEAT = 5,
+
+    // Registration and sessions
+    REGISTER = 10,
+    FILE_HANDLER_REGISTER = 11,
+    PC_FILE = 12,
+    CONNECT = 13,
+    GET_PCS = 14,
+    PC_LIST = 15,
+    PC_OFFLINE = 16,
+    CONNECT_TO_PC = 17,
+    CONTROL_REGISTER = 18,
+    CONTROL_SESSION = 19,
+    INPUT_REGISTER = 20,
+    INPUT_CHANNEL = 21,
+    INPUT_READY = 22,
+    DISCONNECT = 23,
+    SUBSCRIBE_PCS = 24,
+    PC_ONLINE = 25,
+
+    // File operations through the relay (FileHandler)
+    LIST_DIR = 30,
+    DIR_LIST = 31,
+    DOWNLOAD = 32,
+    DOWNLOAD_START = 33,
+    UPLOAD = 34,
+    UPLOAD_READY = 35,
+    UPLOAD_COMPLETE = 36,
+    UPLOAD_SUCCESS = 37,
+    GENERATE_URL = 38,
+    SHARE_URL = 39,
+    DELETE = 40,
+    DELETE_OK = 41,
+    RENAME = 42,
+    RENAME_OK = 43,
+    COPY = 44,
+    COPY_OK = 45,
+    CREATE_FOLDER = 46,
+    CREATE_FOLDER_OK = 47,
+    SHARE_DOWNLOAD = 48,
+
+    // Direct FileServer commands
+    LIST = 60,
+    FILE_LIST = 61,
+    GET = 62,
+    FILE_DATA = 63,
+    PUT = 64,
+    READY = 65,
+    MKDIR = 66,
+    GENERATE_LINK = 67,
+    SHARE_LINK = 68
+};
+
+// How a type was laid out as a text line
+struct LegacyLayout {
+    Type type;
+    const char* name;
+    uint8_t maxFields;      // 0 = split every '|'; else the last field takes the rest
+    uint8_t headFields;     // plain fields before a record list
+    uint8_t recordWidth;    // 0 = no record list
+    char recordInner;       // separator inside a record
+    char recordEnd;         // separator between records
+    bool recordTerminated;  // recordEnd also follows the last record
+};
+
+inline constexpr LegacyLayout kLegacyLayouts[] = {
+    { Type::OK, "OK", 0, 0, 0, 0, 0, false },
+    { Type::ERROR, "ERROR", 1, 0, 0, 0, 0, false },
+    { Type::PING, "PING", 0, 0, 0, 0, 0, false },
+    { Type::PONG, "PONG", 0, 0, 0, 0, 0, false },
+    { Type::HEARTBEAT, "HEARTBEAT", 0, 0, 0, 0, 0, false },
+    { Type::REGISTER, "REGISTER", 0, 0, 0, 0, 0, false },
+    { Type::FILE_HANDLER_REGISTER, "FILE_HANDLER_REGISTER", 0, 0, 0, 0, 0, false },
+    { Type::PC_FILE, "PC_FILE", 0, 0, 0, 0, 0, false },
+    { Type::CONNECT, "CONNECT", 0, 0, 0, 0, 0, false },
+    { Type::GET_PCS, "GET_PCS", 0, 0, 0, 0, 0, false },
+    { Type::PC_LIST, "PC_LIST", 0, 0, 3, ',', ';', true },
+    { Type::PC_OFFLINE, "PC_OFFLINE", 0, 0, 0, 0, 0, false },
+    { Type::CONNECT_TO_PC, "CONNECT_TO_PC", 0, 0, 0, 0, 0, false },
+    { Type::CONTROL_REGISTER, "CONTROL_REGISTER", 0, 0, 0, 0, 0, false },
+    { Type::CONTROL_SESSION, "CONTROL_SESSION", 0, 0, 0, 0, 0, false },
+    { Type::INPUT_REGISTER, "INPUT_REGISTER", 0, 0, 0, 0, 0, false },
+    { Type::INPUT_CHANNEL, "INPUT_CHANNEL", 0, 0, 0, 0, 0, false },
+    { Type::INPUT_READY, "INPUT_READY", 0, 0, 0, 0, 0, false },
+    { Type::DISCONNECT, "DISCONNECT", 0, 0, 0, 0, 0, false },
+    { Type::SUBSCRIBE_PCS, "SUBSCRIBE_PCS", 0, 0, 0, 0, 0, false },
+    { Type::PC_ONLINE, "PC_ONLINE", 0, 0, 0, 0, 0, false },
+    { Type::LIST_DIR, "LIST_DIR", 2, 0, 0, 0, 0, false },
+    { Type::DIR_LIST, "DIR_LIST", 0, 0, 3, '|', ';', true },
+    { Type::DOWNLOAD, "DOWNLOAD", 2, 0, 0, 0, 0, false },
+    { Type::DOWNLOAD_START, "DOWNLOAD_START", 0, 0, 0, 0, 0, false },
+    { Type::UPLOAD, "UPLOAD", 0, 0, 0, 0, 0, false },
+    { Type::UPLOAD_READY, "UPLOAD_READY", 0, 0, 0, 0, 0, false },
+    { Type::UPLOAD_COMPLETE, "UPLOAD_COMPLETE", 0, 0, 0, 0, 0, false },
+    { Type::UPLOAD_SUCCESS, "UPLOAD_SUCCESS", 0, 0, 0, 0, 0, false },
+    { Type::GENERATE_URL, "GENERATE_URL", 2, 0, 0, 0, 0, false },
+    { Type::SHARE_URL, "SHARE_URL", 1, 0, 0, 0, 0, false },
+    { Type::DELETE, "DELETE", 2, 0, 0, 0, 0, false },
+    { Type::DELETE_OK, "DELETE_OK", 0, 0, 0, 0, 0, false },
+    { Type::RENAME, "RENAME", 0, 0, 0, 0, 0, false },
+    { Type::RENAME_OK, "RENAME_OK", 0, 0, 0, 0, 0, false },
+    { Type::COPY, "COPY", 0, 0, 0, 0, 0, false },
+    { Type::COPY_OK, "COPY_OK", 0, 0, 0, 0, 0, false },
+    { Type::CREATE_FOLDER, "CREATE_FOLDER", 2, 0, 0, 0, 0, false },
+    { Type::CREATE_FOLDER_OK, "CREATE_FOLDER_OK", 0, 0, 0, 0, 0, false },
+    { Type::SHARE_DOWNLOAD, "SHARE_DOWNLOAD", 2, 0, 0, 0, 0, false },
+    { Type::LIST, "LIST", 1, 0, 0, 0, 0, false },
+    { Type::FILE_LIST, "FILE_LIST", 0, 1, 3, ',', ';', false },
+    { Type::GET, "GET", 1, 0, 0, 0, 0, false },
+    { Type::FILE_DATA, "FILE_DATA", 0, 0, 0, 0, 0, false },
+    { Type::PUT, "PUT", 0, 0, 0, 0, 0, false },
+    { Type::READY, "READY", 0, 0, 0, 0, 0, false },
+    { Type::MKDIR, "MKDIR", 1, 0, 0, 0, 0, false },
+    { Type::GENERATE_LINK, "GENERATE_LINK", 0, 0, 0, 0, 0, false },
+    { Type::SHARE_LINK, "SHARE_LINK", 1, 0, 0, 0, 0, false }
+};
+
+const size_t kLayoutCount = sizeof(kLegacyLayouts) / sizeof(kLegacyLayouts[0]);
+
+// Every Type value is below this; types index tables directly
+const size_t kTypeSlots = 128;
+
+namespace Detail {
+
+constexpr std::array<std::string_view, kLayoutCount> layoutNames() {
+    std::array<std::string_view, kLayoutCount> names{};
+    for (size_t i = 0; i < kLayoutCount; i++) {
+        names[i] = kLegacyLayouts[i].name;
+    }
+    return names;
+}
+
+// Position in kLegacyLayouts plus one, by type value
+constexpr std::array<uint8_t, kTypeSlots> layoutsByType() {
+    std::array<uint8_t, kTypeSlots> index{};
+    for (size_t i = 0; i < kLayoutCount; i++) {
+        size_t slot = static_cast<uint16_t>(kLegacyLayouts[i].type);
+        if (slot >= kTypeSlots || index[slot] != 0) {
+            throw "kLegacyLayouts: type out of range or listed twice";
+        }
+        index[slot] = static_cast<uint8_t>(i + 1);
+    }
+    return index;
+}
+
+inline constexpr NameIndex<kLayoutCount> kLayoutNames(layoutNames());
+inline constexpr std::array<uint8_t, kTypeSlots> kLayoutsByType = layoutsByType();
+
+} // namespace Detail
+
+inline const LegacyLayout* legacyLayout(Type type) {
+    size_t slot = static_cast<uint16_t>(type);
+    if (slot >= kTypeSlots || Detail::kLayoutsByType[slot] == 0) return nullptr;
+    return &kLegacyLayouts[Detail::kLayoutsByType[slot] - 1];
+}
+
+// Command names are matched with a perfect hash built at compile time
+inline const LegacyLayout* legacyLayout(std::string_view name) {
+    int index = Detail::kLayoutNames.find(name);
+    return index < 0 ? nullptr : &kLegacyLayouts[index];
+}
+
+inline const char* typeName(Type type) {
+    const LegacyLayout* layout = legacyLayout(type);
+    return layout ? layout->name : "UNKNOWN";
+}
+
+namespace Detail {
+
+inline void putU16(char* p, uint16_t v) {
+    p[0] = static_cast<char>(v);
+    p[1] = static_cast<char>(v >> 8);
+}
+
+inline void putU32(char* p, uint32_t v) {
+    putU16(p, static_cast<uint16_t>(v));
+    putU16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+inline void putU64(char* p, uint64_t v) {
+    putU32(p, static_cast<uint32_t>(v));
+    putU32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+inline uint16_t getU16(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>(u[0] | (u[1] << 8));
+}
+
+inline uint32_t getU32(const char* p) {
+    return getU16(p) | (static_cast<uint32_t>(getU16(p + 2)) << 16);
+}
+
+inline uint64_t getU64(const char* p) {
+    return getU32(p) | (static_cast<uint64_t>(getU32(p + 4)) << 32);
+}
+
+// Where the fields start: after the header and the trace context, if any
+inline size_t fieldOffset(uint16_t flags) {
+    return kHeaderSize + ((flags & FLAG_TRACED) ? kTraceSize : 0);
+}
+
+} // namespace Detail
+
+// Read-only view of one frame. Field accessors return views into the
+// frame's own bytes; nothing is copied.
+class FrameView {
+public:
+    FrameView() : m_data(nullptr) {}
+    explicit FrameView(const char* frame) : m_data(frame) {}
+
+    bool valid() const { return m_data != nullptr; }
+    Type type() const { return static_cast<Type>(Detail::getU16(m_data + 2)); }
+    uint16_t flags() const { return Detail::getU16(m_data + 4); }
+    bool legacy() const { return (flags() & FLAG_LEGACY) != 0; }
+    bool traced() const { return (flags() & FLAG_TRACED) != 0; }
+    size_t fieldCount() const { return Detail::getU16(m_data + 6); }
+    uint32_t requestId() const { return Detail::getU32(m_data + 8); }
+    uint32_t payloadSize() const { return Detail::getU32(m_data + 12); }
+    size_t size() const { return kHeaderSize + payloadSize(); }
+    std::string_view bytes() const { return std::string_view(m_data, size()); }
+
+    // Empty (not valid()) unless the frame is traced
+    TraceContext trace() const {
+        TraceContext context;
+        if (traced()) {
+            context.traceHigh = Detail::getU64(m_data + kHeaderSize);
+            context.traceLow = Detail::getU64(m_data + kHeaderSize + 8);
+            context.spanId = Detail::getU64(m_data + kHeaderSize + 16);
+        }
+        return context;
+    }
+
+    // The encoded fields, for copying them into another frame as they are
+    std::string_view encodedFields() const {
+        size_t offset = Detail::fieldOffset(flags());
+        return std::string_view(m_data + offset, size() - offset);
+    }
+
+    // Sequential access, for frames with many fields (directory listings)
+    class FieldCursor {
+    public:
+        FieldCursor(const char* pos, const char* end) : m_pos(pos), m_end(end) {}
+        bool next(std::string_view& field) {
+            if (m_end - m_pos < 4) return false;
+            uint32_t length = Detail::getU32(m_pos);
+            m_pos += 4;
+            field = std::string_view(m_pos, length);
+            m_pos += length;
+            return true;
+        }
+    private:
+        const char* m_pos;
+        const char* m_end;
+    };
+
+    FieldCursor fields() const {
+        return FieldCursor(m_data + Detail::fieldOffset(flags()), m_data + size());
+    }
+
+    // Empty if the frame has fewer fields
+    std::string_view field(size_t index) const {
+        FieldCursor cursor = fields();
+        std::string_view value;
+        for (size_t i = 0; i <= index; i++) {
+            if (!cursor.next(value)) return std::string_view();
+        }
+        return value;
+    }
+
+    std::string fieldString(size_t index) const {
+        return std::string(field(index));
+    }
+
+    uint64_t fieldU64(size_t index, uint64_t fallback = 0) const {
+        std::string_view text = field(index);
+        uint64_t value = fallback;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    }
+
+    // Checks that the field lengths add up to the payload
+    static bool verify(const char* frame, size_t size) {
+        size_t offset = Detail::fieldOffset(Detail::getU16(frame + 4));
+        if (offset > size) return false;
+        size_t count = Detail::getU16(frame + 6);
+        for (size_t i = 0; i < count; i++) {
+            if (size - offset < 4) return false;
+            uint32_t length = Detail::getU32(frame + offset);
+            offset += 4;
+            if (size - offset < length) return false;
+            offset += length;
+        }
+        return offset == size;
+    }
+
+private:
+    const char* m_data;
+};
+
+// One entry of an endpoint's command table: the type it accepts, the
+// fields a request must carry, and the handler that receives it
+template <typename Context>
+struct Command {
+    Type type;
+    uint8_t minFields;
+    void (*handle)(Context& context, const FrameView& frame);
+};
+
+// Routes frames through a command table laid out at compile time.
+//
+// Lookup is a direct index by type, and the arity is checked here once,
+// so handlers can read their fields without re-validating them. Each
+// endpoint declares its table as a constexpr array; a type listed twice
+// fails to compile.
+enum class DispatchResult {
+    HANDLED,
+    UNKNOWN_COMMAND,    // not in this endpoint's table
+    MISSING_FIELDS      // fewer fields than the command's minFields
+};
+
+template <typename Context, size_t N>
+class Dispatcher {
+public:
+    constexpr explicit Dispatcher(const Command<Context> (&commands)[N])
+        : m_commands{}, m_index{} {
+        for (size_t i = 0; i < N; i++) {
+            size_t slot = static_cast<uint16_t>(commands[i].type);
+            if (slot >= kTypeSlots || m_index[slot] != 0) {
+                throw "Dispatcher: type out of range or listed twice";
+            }
+            m_commands[i] = commands[i];
+            m_index[slot] = static_cast<uint8_t>(i + 1);
+        }
+    }
+
+    const Command<Context>* find(Type type) const {
+        size_t slot = static_cast<uint16_t>(type);
+        if (slot >= kTypeSlots || m_index[slot] == 0) return nullptr;
+        return &m_commands[m_index[slot] - 1];
+    }
+
+    DispatchResult dispatch(Context& context, const FrameView& frame) const {
+        const Command<Context>* command = find(frame.type());
+        if (!command) return DispatchResult::UNKNOWN_COMMAND;
+        if (frame.fieldCount() < command->minFields) return DispatchResult::MISSING_FIELDS;
+        command->handle(context, frame);
+        return DispatchResult::HANDLED;
+    }
+
+private:
+    Command<Context> m_commands[N];
+    uint8_t m_index[kTypeSlots];
+};
+
+// Appends one frame to `out` in place; fields go straight into the buffer.
+//
+// The frame never grows past what a Reader accepts (kMaxFields fields,
+// kMaxPayload bytes): a field that does not fit is dropped and
+// overflowed() turns true, so long lists come out truncated rather than
+// as a frame the peer rejects along with its whole connection.
+class Builder {
+public:
+    Builder(std::string& out, Type type, uint32_t requestId = 0, uint16_t flags = FLAG_NONE,
+            const TraceContext* trace = nullptr)
+        : m_out(out), m_start(out.size()), m_fields(0), m_overflowed(false) {
+        if (trace) {
+            flags |= FLAG_TRACED;
+        }
+        m_out.resize(m_start + Detail::fieldOffset(flags));
+        char* header = &m_out[m_start];
+        header[0] = static_cast<char>(kMagic);
+        header[1] = static_cast<char>(kVersion);
+        Detail::putU16(header + 2, static_cast<uint16_t>(type));
+        Detail::putU16(header + 4, flags);
+        Detail::putU32(header + 8, requestId);
+        if (trace) {
+            Detail::putU64(header + kHeaderSize, trace->traceHigh);
+            Detail::putU64(header + kHeaderSize + 8, trace->traceLow);
+            Detail::putU64(header + kHeaderSize + 16, trace->spanId);
+        }
+    }
+
+    // Whether `count` more fields of `bytes` in all still fit
+    bool fits(size_t count, size_t bytes) const {
+        size_t payload = m_out.size() - m_start - kHeaderSize;
+        return m_fields + count <= kMaxFields && payload + 4 * count + bytes <= kMaxPayload;
+    }
+
+    bool overflowed() const { return m_overflowed; }
+
+    Builder& add(std::string_view field) {
+        if (!fits(1, field.size())) {
+            m_overflowed = true;
+            return *this;
+        }
+        char length[4];
+        Detail::putU32(length, static_cast<uint32_t>(field.size()));
+        m_out.append(length, 4);
+        m_out.append(field.data(), field.size());
+        m_fields++;
+        return *this;
+    }
+
+    // Fields already encoded elsewhere (FrameView::encodedFields())
+    Builder& addEncoded(std::string_view fields, size_t count) {
+        if (!fits(count, fields.size() - 4 * count)) {
+            m_overflowed = true;
+            return *this;
+        }
+        m_out.append(fields.data(), fields.size());
+        m_fields = static_cast<uint16_t>(m_fields + count);
+        return *this;
+    }
+
+    Builder& addNumber(uint64_t value) {
+        char text[24];
+        std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+        return add(std::string_view(text, result.ptr - text));
+    }
+
+    // One record of a list: all of its fields, or none and false if they
+    // do not fit
+    bool addRecord(std::initializer_list<std::string_view> fields) {
+        size_t bytes = 0;
+        for (std::string_view field : fields) {
+            bytes += field.size();
+        }
+        if (!fits(fields.size(), bytes)) {
+            m_overflowed = true;
+            return false;
+        }
+        for (std::string_view field : fields) {
+            add(field);
+        }
+        return true;
+    }
+
+    // Patches the header; returns the frame size
+    size_t finish() {
+        char* header = &m_out[m_start];
+        Detail::putU16(header + 6, m_fields);
+        Detail::putU32(header + 12, static_cast<uint32_t>(m_out.size() - m_start - kHeaderSize));
+        return m_out.size() - m_start;
+    }
+
+private:
+    std::string& m_out;
+    size_t m_start;
+    uint16_t m_fields;
+    bool m_overflowed;
+};
+
+// Writes a frame as a legacy text line, for peers that spoke text
+inline void appendText(std::string& out, Type type, FrameView::FieldCursor fields) {
+    const LegacyLayout* layout = legacyLayout(type);
+    std::string_view field;
+    if (layout) {
+        out += layout->name;
+    } else if (fields.next(field)) {
+        // Unknown commands carry their name as the first field
+        out.append(field.data(), field.size());
+    }
+
+    if (!layout || layout->recordWidth == 0) {
+        while (fields.next(field)) {
+            out += '|';
+            out.append(field.data(), field.size());
+        }
+        out += '\n';
+        return;
+    }
+
+    for (int i = 0; i < layout->headFields && fields.next(field); i++) {
+        out += '|';
+        out.append(field.data(), field.size());
+    }
+    out += '|';
+
+    int column = 0;
+    bool first = true;
+    while (fields.next(field)) {
+        if (column == 0 && !first && !layout->recordTerminated) {
+            out += layout->recordEnd;
+        }
+        if (column > 0) {
+            out += layout->recordInner;
+        }
+        out.append(field.data(), field.size());
+        first = false;
+        if (++column == layout->recordWidth) {
+            column = 0;
+            if (layout->recordTerminated) {
+                out += layout->recordEnd;
+            }
+        }
+    }
+    out += '\n';
+}
+
+// Converts one text line (without its '\n') to a frame appended to `out`
+inline void appendFromText(std::string& out, std::string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    size_t bar = line.find('|');
+    std::string_view name = line.substr(0, bar);
+    std::string_view rest = bar == std::string_view::npos ? std::string_view() : line.substr(bar + 1);
+    bool hasRest = bar != std::string_view::npos;
+
+    const LegacyLayout* layout = legacyLayout(name);
+    Builder builder(out, layout ? layout->type : Type::UNKNOWN, 0, FLAG_LEGACY);
+
+    // Unknown commands keep their name as the first field
+    if (!layout) {
+        builder.add(name);
+    }
+
+    auto take = [&rest](char separator) {
+        size_t end = rest.find(separator);
+        std::string_view part = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+        return part;
+    };
+
+    if (layout && layout->recordWidth > 0) {
+        for (int i = 0; i < layout->headFields && hasRest; i++) {
+            builder.add(take('|'));
+        }
+        while (!rest.empty()) {
+            std::string_view record = take(layout->recordEnd);
+            if (record.empty()) continue;
+            for (int i = 0; i < layout->recordWidth; i++) {
+                size_t end = record.find(layout->recordInner);
+                builder.add(record.substr(0, end));
+                record = end == std::string_view::npos ? std::string_view() : record.substr(end + 1);
+            }
+        }
+    } else if (hasRest) {
+        size_t limit = layout ? layout->maxFields : 0;
+        size_t count = 0;
+        while (true) {
+            count++;
+            if (limit != 0 && count == limit) {
+                builder.add(rest);
+                break;
+            }
+            size_t end = rest.find('|');
+            builder.add(rest.substr(0, end));
+            if (end == std::string_view::npos) break;
+            rest = rest.substr(end + 1);
+        }
+    }
+
+    builder.finish();
+}
+
+// Appends a message in the peer's format; text lines carry no trace
+inline void appendMessage(std::string& out, bool binary, Type type,
+                          std::initializer_list<std::string_view> fields,
+                          uint32_t requestId = 0, const TraceContext* trace = nullptr) {
+    if (binary) {
+        Builder builder(out, type, requestId, FLAG_NONE, trace);
+        for (std::string_view field : fields) {
+            builder.add(field);
+        }
+        builder.finish();
+        return;
+    }
+
+    // Text is only for legacy peers; build a frame and render it
+    std::string frame;
+    Builder builder(frame, type, requestId);
+    for (std::string_view field : fields) {
+        builder.add(field);
+    }
+    builder.finish();
+    appendText(out, type, FrameView(frame.data()).fields());
+}
+
+// Re-encodes a received frame for another peer
+inline void appendMessage(std::string& out, bool binary, const FrameView& frame) {
+    if (binary) {
+        out.append(frame.bytes().data(), frame.size());
+        Detail::putU16(&out[out.size() - frame.size() + 4], frame.flags() & ~FLAG_LEGACY);
+    } else {
+        appendText(out, frame.type(), frame.fields());
+    }
+}
+
+// Same, under another request id: ids belong to a connection, so a relay
+// passing a frame between peers renumbers it (text lines carry none).
+// The trace context belongs to a hop too: the frame goes on with `trace`
+// in place of the one it came with, or with none.
+inline void appendMessage(std::string& out, bool binary, const FrameView& frame, uint32_t requestId,
+                          const TraceContext* trace = nullptr) {
+    if (!binary) {
+        appendText(out, frame.type(), frame.fields());
+        return;
+    }
+    if (trace && frame.encodedFields().size() + kTraceSize > kMaxPayload) {
+        trace = nullptr;    // no room left for it; the frame goes untraced
+    }
+    uint16_t flags = frame.flags() & ~(FLAG_LEGACY | FLAG_TRACED);
+    Builder builder(out, frame.type(), requestId, flags, trace);
+    builder.addEncoded(frame.encodedFields(), frame.fieldCount());
+    builder.finish();
+}
+
+// Reassembles frames (and legacy text lines) from a byte stream.
+//
+// Views returned by next() point into the reader and stay valid until the
+// next call to append() or next().
+class Reader {
+public:
+    enum Result {
+        NEED_MORE,
+        FRAME,
+        BAD_FRAME       // corrupt or oversized; drop the connection
+    };
+
+    Reader() : m_offset(0), m_lastBinary(false) {}
+
+    void append(const char* data, size_t size) {
+        if (m_offset > 0 && m_offset * 2 >= m_buffer.size()) {
+            m_buffer.erase(0, m_offset);
+            m_offset = 0;
+        }
+        m_buffer.append(data, size);
+    }
+
+    Result next(FrameView& frame) {
+        size_t available = m_buffer.size() - m_offset;
+        if (available == 0) return NEED_MORE;
+
+        const char* start = m_buffer.data() + m_offset;
+        if (static_cast<uint8_t>(start[0]) == kMagic) {
+            if (available < kHeaderSize) return NEED_MORE;
+            if (static_cast<uint8_t>(start[1]) != kVersion) return BAD_FRAME;
+
+            uint32_t payload = Detail::getU32(start + 12);
+            if (payload > kMaxPayload) return BAD_FRAME;
+            if (available < kHeaderSize + payload) return NEED_MORE;
+            if (!FrameView::verify(start, kHeaderSize + payload)) return BAD_FRAME;
+
+            m_offset += kHeaderSize + payload;
+            m_lastBinary = true;
+            frame = FrameView(start);
+            return FRAME;
+        }
+
+        // Legacy text line
+        const char* newline = static_cast<const char*>(std::memchr(start, '\n', available));
+        if (!newline) {
+            return available > kMaxPayload ? BAD_FRAME : NEED_MORE;
+        }
+
+        std::string_view line(start, newline - start);
+        m_offset += line.size() + 1;
+        if (line.empty() || line == "\r") {
+            return next(frame);
+        }
+
+        m_scratch.clear();
+        appendFromText(m_scratch, line);
+        m_lastBinary = false;
+        frame = FrameView(m_scratch.data());
+        return FRAME;
+    }
+
+    // Whether the last message was binary, i.e. how to answer this peer
+    bool binary() const { return m_lastBinary; }
+
+    // Raw bytes after the last message (file data that followed a header)
+    std::string_view pending() const {
+        return std::string_view(m_buffer.data() + m_offset, m_buffer.size() - m_offset);
+    }
+
+    void consume(size_t size) { m_offset += size; }
+
+private:
+    std::string m_buffer;
+    size_t m_offset;
+    std::string m_scratch;
+    bool m_lastBinary;
+};
+
+} // namespace Wire
+} // namespace RemoteAccessSystem
+
+#endif // WIRE_FRAME_H
@@ -0,0 +1,423 @@
+#include "async_log.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ctime>
+#include <strings.h>
+#include <unistd.h>
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+namespace {
+
+const size_t RING_SIZE = 16 * 1024;             // per logging thread
+const size_t MAX_LINE = 4096;                   // longer lines are cut
+const auto FLUSH_INTERVAL = std::chrono::milliseconds(50);
+
+const char* const LEVEL_NAMES[] = { "TRACE", "DEBUG", "INFO ", "WARN ", "ERROR" };
+
+struct RecordHeader {
+    uint32_t size;                              // text bytes that follow
+    uint32_t level;
+    int64_t time_ns;
+};
+
+size_t Padded(size_t size) {
+    return (sizeof(RecordHeader) + size + 7) & ~size_t(7);
+}
+
+int64_t NowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Byte ring with one producer (the owning thread) and one consumer (the
+// writer thread). head_ and tail_ only ever grow; positions are taken
+// modulo RING_SIZE, and a record may wrap around the end.
+class Ring {
+public:
+    Ring() : head_(0), tail_(0), orphaned_(false) {}
+    
+    bool Push(const RecordHeader& header, const char* text) {
+        size_t need = Padded(header.size);
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (RING_SIZE - (head - tail_.load(std::memory_order_acquire)) < need) {
+            return false;
+        }
+        CopyIn(head, &header, sizeof(header));
+        CopyIn(head + sizeof(header), text, header.size);
+        head_.store(head + need, std::memory_order_release);
+        return true;
+    }
+    
+    // Hands every complete record to emit(header, text) and frees its space
+    template <typename Emit>
+    void Drain(Emit emit) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        char text[MAX_LINE];
+        while (tail < head) {
+            RecordHeader header;
+            CopyOut(tail, &header, sizeof(header));
+            CopyOut(tail + sizeof(header), text, header.size);
+            emit(header, text);
+            tail += Padded(header.size);
+        }
+        tail_.store(tail, std::memory_order_release);
+    }
+    
+    size_t Used() const {
+        return static_cast<size_t>(head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+    }
+    
+    bool Empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+    }
+    
+    // Set when the owning thread exits; the ring is reused once drained
+    std::atomic<bool>& Orphaned() { return orphaned_; }
+
+private:
+    void CopyIn(uint64_t position, const void* data, size_t size) {
+        size_t offset = position % RING_SIZE;
+        size_t first = std::min(size, RING_SIZE - offset);
+        memcpy(data_ + offset, data, first);
+        memcpy(data_, static_cast<const char*>(data) + first, size - first);
+    }
+    
+    void CopyOut(uint64_t position, void* data, size_t size) const {
+        size_t offset = position % RING_SIZE;
+        size_t first = std::min(size, RING_SIZE - offset);
+        memcpy(data, data_ + offset, first);
+        memcpy(static_cast<char*>(data) + first, data_, size - first);
+    }
+    
+    alignas(64) std::atomic<uint64_t> head_;
+    alignas(64) std::atomic<uint64_t> tail_;
+    std::atomic<bool> orphaned_;
+    char data_[RING_SIZE];
+};
+
+// localtime_r() once per second rather than once per line
+class TimestampCache {
+public:
+    void Append(std::string& out, int64_t time_ns) {
+        int64_t second = time_ns / 1000000000;
+        if (second != second_) {
+            time_t seconds = static_cast<time_t>(second);
+            struct tm local;
+            localtime_r(&seconds, &local);
+            strftime(prefix_, sizeof(prefix_), "%Y-%m-%d %H:%M:%S", &local);
+            second_ = second;
+        }
+        char millis[8];
+        snprintf(millis, sizeof(millis), ".%03d ", static_cast<int>(time_ns / 1000000 % 1000));
+        out += prefix_;
+        out += millis;
+    }
+
+private:
+    int64_t second_ = -1;
+    char prefix_[32];
+};
+
+struct Logger {
+    // Guards rings, free and the flush state; Write() only takes it for a
+    // thread's first line
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::vector<std::shared_ptr<Ring>> free;
+    std::thread writer;
+    std::atomic<bool> running{ false };
+    // Set by Write() without the lock, so a wake-up can be missed; the
+    // writer then sees it at the next interval instead
+    std::atomic<bool> wake_now{ false };
+    uint64_t flush_requested = 0;
+    uint64_t flush_done = 0;
+    
+    int fd = 1;
+    std::atomic<int> level{ static_cast<int>(LogLevel::Info) };
+    std::atomic<uint64_t> dropped{ 0 };
+    
+    // Used by whichever thread is draining: the writer, or Stop() after it
+    struct Line {
+        int64_t time_ns;
+        uint32_t level;
+        size_t offset;
+        size_t size;
+    };
+    std::string text;
+    std::vector<Line> lines;
+    std::string out;
+    TimestampCache timestamps;
+    uint64_t dropped_reported = 0;
+};
+
+Logger& Instance() {
+    static Logger* logger = new Logger();       // outlives threads still logging at exit
+    return *logger;
+}
+
+std::once_flag start_once;
+
+void ReadLevelFromEnvironment(Logger& logger) {
+    const char* name = getenv("RAS_LOG_LEVEL");
+    if (!name) return;
+    static const char* const names[] = { "trace", "debug", "info", "warn", "error" };
+    for (int i = 0; i < 5; i++) {
+        if (strcasecmp(name, names[i]) == 0) {
+            logger.level = i;
+        }
+    }
+}
+
+void WriteAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        written += n;
+    }
+}
+
+void AppendLine(std::string& out, TimestampCache& timestamps, uint32_t level, int64_t time_ns,
+                const char* text, size_t size) {
+    timestamps.Append(out, time_ns);
+    out += LEVEL_NAMES[level];
+    out += ' ';
+    out.append(text, size);
+    out += '\n';
+}
+
+// One round: every ring drained, lines ordered by time, one write()
+void WriteRound(Logger& logger, const std::vector<std::shared_ptr<Ring>>& rings) {
+    logger.text.clear();
+    logger.lines.clear();
+    logger.out.clear();
+    
+    for (const auto& ring : rings) {
+        ring->Drain([&logger](const RecordHeader& header, const char* data) {
+            logger.lines.push_back(Logger::Line{ header.time_ns, header.level, logger.text.size(), header.size });
+            logger.text.append(data, header.size);
+        });
+    }
+    uint64_t dropped = logger.dropped.load(std::memory_order_relaxed);
+    if (logger.lines.empty() && dropped == logger.dropped_reported) return;
+    
+    // Each ring is already in order; only lines of different threads interleave
+    std::stable_sort(logger.lines.begin(), logger.lines.end(),
+                     [](const Logger::Line& a, const Logger::Line& b) { return a.time_ns < b.time_ns; });
+    for (const Logger::Line& line : logger.lines) {
+        AppendLine(logger.out, logger.timestamps, line.level, line.time_ns,
+                   logger.text.data() + line.offset, line.size);
+    }
+    if (dropped != logger.dropped_reported) {
+        std::string note = "[AsyncLog] Lines dropped, ring full count=" + std::to_string(dropped - logger.dropped_reported);
+        AppendLine(logger.out, logger.timestamps, static_cast<uint32_t>(LogLevel::Warn), NowNs(),
+                   note.data(), note.size());
+        logger.dropped_reported = dropped;
+    }
+    WriteAll(logger.fd, logger.out);
+}
+
+void WriterLoop() {
+    Logger& logger = Instance();
+    std::vector<std::shared_ptr<Ring>> rings;
+    bool running = true;
+    
+    while (running) {
+        uint64_t flush_target;
+        {
+            std::unique_lock<std::mutex> lock(logger.mutex);
+            logger.wake.wait_for(lock, FLUSH_INTERVAL, [&logger] { return logger.wake_now || !logger.running; });
+            logger.wake_now = false;
+            running = logger.running;
+            flush_target = logger.flush_requested;
+            rings = logger.rings;
+        }
+        
+        WriteRound(logger, rings);
+        
+        // Rings of exited threads go back to the pool once empty
+        std::lock_guard<std::mutex> lock(logger.mutex);
+        for (auto it = logger.rings.begin(); it != logger.rings.end();) {
+            if ((*it)->Orphaned() && (*it)->Empty()) {
+                (*it)->Orphaned() = false;
+                logger.free.push_back(*it);
+                it = logger.rings.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        logger.flush_done = flush_target;
+        logger.flushed.notify_all();
+    }
+}
+
+void StartWriter() {
+    Logger& logger = Instance();
+    ReadLevelFromEnvironment(logger);
+    {
+        std::lock_guard<std::mutex> lock(logger.mutex);
+        logger.running = true;
+    }
+    logger.writer = std::thread(WriterLoop);
+    std::atexit(AsyncLog::Stop);
+}
+
+// The calling thread's ring, taken from the pool on its first line
+class ThreadRing {
+public:
+    ~ThreadRing() {
+        if (ring_) ring_->Orphaned() = true;
+    }
+    
+    Ring& Get() {
+        if (!ring_) {
+            Logger& logger = Instance();
+            std::lock_guard<std::mutex> lock(logger.mutex);
+            if (logger.free.empty()) {
+                ring_ = std::make_shared<Ring>();
+            } else {
+                ring_ = logger.free.back();
+                logger.free.pop_back();
+            }
+            logger.rings.push_back(ring_);
+        }
+        return *ring_;
+    }
+
+private:
+    std::shared_ptr<Ring> ring_;
+};
+
+void AppendValue(std::string& out, std::string_view value) {
+    bool quote = value.empty() || value.find_first_of(" \"=\\\n\t") != std::string_view::npos;
+    if (!quote) {
+        out.append(value.data(), value.size());
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+void AsyncLog::Start(int fd) {
+    Instance().fd = fd;
+    std::call_once(start_once, StartWriter);
+}
+
+void AsyncLog::SetLevel(LogLevel level) {
+    Instance().level = static_cast<int>(level);
+}
+
+bool AsyncLog::Enabled(LogLevel level) {
+    return static_cast<int>(level) >= Instance().level.load(std::memory_order_relaxed);
+}
+
+void AsyncLog::Write(LogLevel level, std::string_view component, std::string_view message,
+                     std::initializer_list<LogField> fields) {
+    std::call_once(start_once, StartWriter);
+    thread_local ThreadRing ring;
+    thread_local std::string line;
+    
+    line.clear();
+    line += '[';
+    line.append(component.data(), component.size());
+    line += "] ";
+    line.append(message.data(), message.size());
+    for (const LogField& field : fields) {
+        line += ' ';
+        line.append(field.Key().data(), field.Key().size());
+        line += '=';
+        AppendValue(line, field.Value());
+    }
+    if (line.size() > MAX_LINE) {
+        line.resize(MAX_LINE);
+    }
+    
+    Logger& logger = Instance();
+    RecordHeader header;
+    header.size = static_cast<uint32_t>(line.size());
+    header.level = static_cast<uint32_t>(level);
+    header.time_ns = NowNs();
+    
+    if (!logger.running.load(std::memory_order_acquire)) {
+        // Stopped (process exiting): write through so nothing is lost
+        std::string out;
+        TimestampCache timestamps;
+        AppendLine(out, timestamps, header.level, header.time_ns, line.data(), line.size());
+        WriteAll(logger.fd, out);
+        return;
+    }
+    
+    Ring& mine = ring.Get();
+    if (!mine.Push(header, line.data())) {
+        logger.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    
+    // Errors go out at once, and a ring half full is drained before it overflows
+    if ((level >= LogLevel::Error || mine.Used() > RING_SIZE / 2) && !logger.wake_now.exchange(true)) {
+        logger.wake.notify_one();
+    }
+}
+
+void AsyncLog::Flush() {
+    std::call_once(start_once, StartWriter);
+    Logger& logger = Instance();
+    std::unique_lock<std::mutex> lock(logger.mutex);
+    if (!logger.running) return;
+    uint64_t target = ++logger.flush_requested;
+    logger.wake_now = true;
+    logger.wake.notify_one();
+    logger.flushed.wait(lock, [&logger, target] { return logger.flush_done >= target || !logger.running; });
+}
+
+void AsyncLog::Stop() {
+    Logger& logger = Instance();
+    {
+        std::lock_guard<std::mutex> lock(logger.mutex);
+        if (!logger.running) return;
+        logger.running = false;
+        logger.wake.notify_one();
+    }
+    // The loop makes one last round after seeing running == false; lines
+    // pushed while it did are picked up here
+    logger.writer.join();
+    std::lock_guard<std::mutex> lock(logger.mutex);
+    WriteRound(logger, logger.rings);
+}
+
+uint64_t AsyncLog::Dropped() {
+    return Instance().dropped.load(std::memory_order_relaxed);
+}
+
+} // namespace Common
+} // namespace RemoteAccessSystem
@@ -0,0 +1,342 @@
+#include "key_exchange.h"
+#include "record_layer.h"
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <stdexcept>
+#include <cstring>
+#include <ctime>
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+namespace {
+
+const unsigned char HANDSHAKE_VERSION = 1;
+const size_t HELLO_PREFIX = 2 + KeyExchange::RANDOM_SIZE;
+
+// Sealed ticket: nonce, AES-256-GCM(expiry u64 LE + secret), tag
+const size_t TICKET_NONCE_SIZE = 12;
+const size_t TICKET_TAG_SIZE = 16;
+const size_t TICKET_PLAINTEXT_SIZE = 8 + KeyExchange::SECRET_SIZE;
+const size_t TICKET_SIZE = TICKET_NONCE_SIZE + TICKET_PLAINTEXT_SIZE + TICKET_TAG_SIZE;
+
+void RandomBytes(unsigned char* out, size_t length) {
+    if (RAND_bytes(out, static_cast<int>(length)) != 1) {
+        throw std::runtime_error("Failed to generate handshake randomness");
+    }
+}
+
+EVP_PKEY* GenerateX25519() {
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, nullptr);
+    if (!ctx || EVP_PKEY_keygen_init(ctx) != 1 || EVP_PKEY_keygen(ctx, &key) != 1) {
+        EVP_PKEY_CTX_free(ctx);
+        throw std::runtime_error("Failed to generate X25519 key");
+    }
+    EVP_PKEY_CTX_free(ctx);
+    return key;
+}
+
+void AppendPublicKey(EVP_PKEY* key, std::vector<unsigned char>& out) {
+    size_t length = KeyExchange::PUBLIC_KEY_SIZE;
+    size_t start = out.size();
+    out.resize(start + length);
+    if (EVP_PKEY_get_raw_public_key(key, out.data() + start, &length) != 1 ||
+        length != KeyExchange::PUBLIC_KEY_SIZE) {
+        throw std::runtime_error("Failed to export X25519 public key");
+    }
+}
+
+// X25519 with the peer's raw public key; false for a bad key or a
+// low-order point (all-zero result)
+bool SharedSecret(EVP_PKEY* key, const unsigned char* peer_public, std::vector<unsigned char>& secret) {
+    EVP_PKEY* peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, nullptr, peer_public,
+                                                 KeyExchange::PUBLIC_KEY_SIZE);
+    EVP_PKEY_CTX* ctx = peer ? EVP_PKEY_CTX_new(key, nullptr) : nullptr;
+    size_t length = KeyExchange::SECRET_SIZE;
+    secret.resize(length);
+    
+    bool ok = ctx && EVP_PKEY_derive_init(ctx) == 1 && EVP_PKEY_derive_set_peer(ctx, peer) == 1 &&
+              EVP_PKEY_derive(ctx, secret.data(), &length) == 1 && length == KeyExchange::SECRET_SIZE;
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(peer);
+    
+    static const unsigned char zero[KeyExchange::SECRET_SIZE] = {};
+    return ok && CRYPTO_memcmp(secret.data(), zero, sizeof(zero)) != 0;
+}
+
+std::vector<unsigned char> Hkdf(const std::vector<unsigned char>& ikm, const unsigned char* salt,
+                                size_t salt_length, const char* label, size_t length) {
+    std::vector<unsigned char> out(length);
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+    bool ok = ctx && EVP_PKEY_derive_init(ctx) == 1 &&
+              EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) == 1 &&
+              EVP_PKEY_CTX_set1_hkdf_salt(ctx, salt, static_cast<int>(salt_length)) == 1 &&
+              EVP_PKEY_CTX_set1_hkdf_key(ctx, ikm.data(), static_cast<int>(ikm.size())) == 1 &&
+              EVP_PKEY_CTX_add1_hkdf_info(ctx, reinterpret_cast<const unsigned char*>(label),
+                                          static_cast<int>(std::strlen(label))) == 1 &&
+              EVP_PKEY_derive(ctx, out.data(), &length) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    if (!ok) {
+        throw std::runtime_error("Key derivation failed");
+    }
+    return out;
+}
+
+// Traffic keys and the next resumption secret from the handshake secret,
+// salted with both randoms so every connection gets fresh keys
+void DeriveKeys(const std::vector<unsigned char>& ikm, const unsigned char* client_random,
+                const unsigned char* server_random, SessionKeys& keys, std::vector<unsigned char>& next_secret) {
+    unsigned char salt[2 * KeyExchange::RANDOM_SIZE];
+    std::memcpy(salt, client_random, KeyExchange::RANDOM_SIZE);
+    std::memcpy(salt + KeyExchange::RANDOM_SIZE, server_random, KeyExchange::RANDOM_SIZE);
+    
+    // One expansion, split in order: client key/IV, server key/IV, resumption secret
+    std::vector<unsigned char> block = Hkdf(ikm, salt, sizeof(salt), "ras session keys",
+                                            2 * (RecordLayer::KEY_SIZE + RecordLayer::IV_SIZE) +
+                                            KeyExchange::SECRET_SIZE);
+    auto take = [&block](size_t& offset, size_t length) {
+        std::vector<unsigned char> part(block.begin() + offset, block.begin() + offset + length);
+        offset += length;
+        return part;
+    };
+    
+    size_t offset = 0;
+    keys.client_key = take(offset, RecordLayer::KEY_SIZE);
+    keys.client_iv = take(offset, RecordLayer::IV_SIZE);
+    keys.server_key = take(offset, RecordLayer::KEY_SIZE);
+    keys.server_iv = take(offset, RecordLayer::IV_SIZE);
+    next_secret = take(offset, KeyExchange::SECRET_SIZE);
+    OPENSSL_cleanse(block.data(), block.size());
+}
+
+void AppendTicket(const std::vector<unsigned char>& ticket, std::vector<unsigned char>& out) {
+    out.push_back(static_cast<unsigned char>(ticket.size() & 0xFF));
+    out.push_back(static_cast<unsigned char>(ticket.size() >> 8));
+    out.insert(out.end(), ticket.begin(), ticket.end());
+}
+
+// Length-prefixed ticket at `offset`; false if it runs past the end
+bool ReadTicket(const std::vector<unsigned char>& in, size_t offset, const unsigned char*& ticket, size_t& length) {
+    if (in.size() < offset + 2) {
+        return false;
+    }
+    length = in[offset] | (in[offset + 1] << 8);
+    ticket = in.data() + offset + 2;
+    return in.size() == offset + 2 + length;
+}
+
+} // namespace
+
+KeyExchange::KeyExchange()
+    : private_key_(nullptr)
+    , resumed_(false)
+    , retry_(false) {
+    std::memset(client_random_, 0, sizeof(client_random_));
+}
+
+KeyExchange::~KeyExchange() {
+    EVP_PKEY_free(private_key_);
+    OPENSSL_cleanse(offered_secret_.data(), offered_secret_.size());
+}
+
+std::vector<unsigned char> KeyExchange::ClientHello(const SessionTicket* resume) {
+    EVP_PKEY_free(private_key_);
+    private_key_ = nullptr;
+    offered_secret_.clear();
+    resumed_ = false;
+    retry_ = false;
+    
+    RandomBytes(client_random_, RANDOM_SIZE);
+    
+    bool offer = resume && resume->Valid() && resume->ticket.size() <= 0xFFFF;
+    std::vector<unsigned char> hello;
+    hello.reserve(HELLO_PREFIX + 2 + (offer ? resume->ticket.size() : PUBLIC_KEY_SIZE));
+    hello.push_back(HANDSHAKE_VERSION);
+    hello.push_back(static_cast<unsigned char>(offer ? Mode::RESUME : Mode::FULL));
+    hello.insert(hello.end(), client_random_, client_random_ + RANDOM_SIZE);
+    
+    if (offer) {
+        offered_secret_ = resume->secret;
+        AppendTicket(resume->ticket, hello);
+    } else {
+        private_key_ = GenerateX25519();
+        AppendPublicKey(private_key_, hello);
+    }
+    return hello;
+}
+
+bool KeyExchange::ClientFinish(const std::vector<unsigned char>& server_hello,
+                               SessionKeys& keys, SessionTicket& next) {
+    if (server_hello.size() < HELLO_PREFIX || server_hello[0] != HANDSHAKE_VERSION) {
+        return false;
+    }
+    
+    Mode mode = static_cast<Mode>(server_hello[1]);
+    const unsigned char* server_random = server_hello.data() + 2;
+    size_t offset = HELLO_PREFIX;
+    std::vector<unsigned char> ikm;
+    
+    if (mode == Mode::RETRY && !offered_secret_.empty()) {
+        retry_ = true;
+        return false;
+    } else if (mode == Mode::RESUMED && !offered_secret_.empty()) {
+        ikm = offered_secret_;
+    } else if (mode == Mode::FULL && private_key_) {
+        if (server_hello.size() < offset + PUBLIC_KEY_SIZE ||
+            !SharedSecret(private_key_, server_hello.data() + offset, ikm)) {
+            return false;
+        }
+        offset += PUBLIC_KEY_SIZE;
+    } else {
+        return false;
+    }
+    
+    const unsigned char* ticket = nullptr;
+    size_t ticket_length = 0;
+    if (!ReadTicket(server_hello, offset, ticket, ticket_length)) {
+        return false;
+    }
+    
+    DeriveKeys(ikm, client_random_, server_random, keys, next.secret);
+    next.ticket.assign(ticket, ticket + ticket_length);
+    OPENSSL_cleanse(ikm.data(), ikm.size());
+    
+    resumed_ = mode == Mode::RESUMED;
+    return true;
+}
+
+TicketIssuer::TicketIssuer(uint64_t lifetime_seconds)
+    : ticket_key_(RecordLayer::KEY_SIZE)
+    , lifetime_(lifetime_seconds) {
+    RandomBytes(ticket_key_.data(), ticket_key_.size());
+}
+
+TicketIssuer::~TicketIssuer() {
+    OPENSSL_cleanse(ticket_key_.data(), ticket_key_.size());
+}
+
+std::vector<unsigned char> TicketIssuer::Seal(const std::vector<unsigned char>& secret) const {
+    unsigned char plaintext[TICKET_PLAINTEXT_SIZE];
+    uint64_t expires = static_cast<uint64_t>(std::time(nullptr)) + lifetime_;
+    for (int i = 0; i < 8; ++i) {
+        plaintext[i] = static_cast<unsigned char>(expires >> (i * 8));
+    }
+    std::memcpy(plaintext + 8, secret.data(), KeyExchange::SECRET_SIZE);
+    
+    std::vector<unsigned char> ticket(TICKET_SIZE);
+    RandomBytes(ticket.data(), TICKET_NONCE_SIZE);
+    
+    int len = 0;
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    bool ok = ctx && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, ticket_key_.data(), ticket.data()) == 1 &&
+              EVP_EncryptUpdate(ctx, ticket.data() + TICKET_NONCE_SIZE, &len, plaintext, sizeof(plaintext)) == 1 &&
+              EVP_EncryptFinal_ex(ctx, ticket.data() + TICKET_NONCE_SIZE + len, &len) == 1 &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, TICKET_TAG_SIZE,
+                                  ticket.data() + TICKET_NONCE_SIZE + TICKET_PLAINTEXT_SIZE) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    OPENSSL_cleanse(plaintext, sizeof(plaintext));
+    if (!ok) {
+        throw std::runtime_error("Failed to seal session ticket");
+    }
+    return ticket;
+}
+
+bool TicketIssuer::Open(const unsigned char* ticket, size_t length, std::vector<unsigned char>& secret) const {
+    if (length != TICKET_SIZE) {
+        return false;
+    }
+    
+    unsigned char plaintext[TICKET_PLAINTEXT_SIZE];
+    int len = 0;
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    bool ok = ctx && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, ticket_key_.data(), ticket) == 1 &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, TICKET_TAG_SIZE,
+                                  const_cast<unsigned char*>(ticket + TICKET_NONCE_SIZE + TICKET_PLAINTEXT_SIZE)) == 1 &&
+              EVP_DecryptUpdate(ctx, plaintext, &len, ticket + TICKET_NONCE_SIZE, TICKET_PLAINTEXT_SIZE) == 1 &&
+              EVP_DecryptFinal_ex(ctx, plaintext + len, &len) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    
+    uint64_t expires = 0;
+    for (int i = 0; i < 8; ++i) {
+        expires |= static_cast<uint64_t>(plaintext[i]) << (i * 8);
+    }
+    ok = ok && expires > static_cast<uint64_t>(std::time(nullptr));
+    if (ok) {
+        secret.assign(plaintext + 8, plaintext + 8 + KeyExchange::SECRET_SIZE);
+    }
+    OPENSSL_cleanse(plaintext, sizeof(plaintext));
+    return ok;
+}
+
+bool TicketIssuer::Accept(const std::vector<unsigned char>& client_hello,
+                          std::vector<unsigned char>& server_hello,
+                          SessionKeys& keys, KeyExchange::Mode& mode) {
+    if (client_hello.size() < HELLO_PREFIX || client_hello[0] != HANDSHAKE_VERSION) {
+        return false;
+    }
+    
+    const unsigned char* client_random = client_hello.data() + 2;
+    unsigned char server_random[KeyExchange::RANDOM_SIZE];
+    RandomBytes(server_random, sizeof(server_random));
+    
+    server_hello.clear();
+    server_hello.reserve(HELLO_PREFIX + KeyExchange::PUBLIC_KEY_SIZE + 2 + TICKET_SIZE);
+    server_hello.push_back(HANDSHAKE_VERSION);
+    server_hello.push_back(0);
+    server_hello.insert(server_hello.end(), server_random, server_random + sizeof(server_random));
+    
+    std::vector<unsigned char> ikm;
+    switch (static_cast<KeyExchange::Mode>(client_hello[1])) {
+        case KeyExchange::Mode::FULL: {
+            if (client_hello.size() != HELLO_PREFIX + KeyExchange::PUBLIC_KEY_SIZE) {
+                return false;
+            }
+            EVP_PKEY* key = GenerateX25519();
+            bool ok = SharedSecret(key, client_hello.data() + HELLO_PREFIX, ikm);
+            if (ok) {
+                AppendPublicKey(key, server_hello);
+            }
+            EVP_PKEY_free(key);
+            if (!ok) {
+                return false;
+            }
+            mode = KeyExchange::Mode::FULL;
+            break;
+        }
+        
+        case KeyExchange::Mode::RESUME: {
+            const unsigned char* ticket = nullptr;
+            size_t ticket_length = 0;
+            if (!ReadTicket(client_hello, HELLO_PREFIX, ticket, ticket_length)) {
+                return false;
+            }
+            if (!Open(ticket, ticket_length, ikm)) {
+                // Expired or from another process: no keys, client redoes FULL
+                mode = KeyExchange::Mode::RETRY;
+                server_hello[1] = static_cast<unsigned char>(mode);
+                AppendTicket({}, server_hello);
+                return true;
+            }
+            mode = KeyExchange::Mode::RESUMED;
+            break;
+        }
+        
+        default:
+            return false;
+    }
+    
+    std::vector<unsigned char> next_secret;
+    DeriveKeys(ikm, client_random, server_random, keys, next_secret);
+    OPENSSL_cleanse(ikm.data(), ikm.size());
+    
+    server_hello[1] = static_cast<unsigned char>(mode);
+    AppendTicket(Seal(next_secret), server_hello);
+    OPENSSL_cleanse(next_secret.data(), next_secret.size());
+    return true;
+}
+
+} // namespace Common
+} // namespace RemoteAccessSystem
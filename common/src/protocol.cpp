@@ -1,117 +1,432 @@
 #include "protocol.h"
-#include <sstream>
-#include <iomanip>
+#include <charconv>
+#include <cstring>
 
 namespace RemoteAccessSystem {
 
+namespace {
+
+// Formats into a caller buffer; with a null buffer it only counts, which
+// is how serializedSize() is computed from the same code path
+class Writer {
+public:
+    Writer(char* out, size_t capacity) : m_out(out), m_capacity(capacity), m_size(0), m_overflow(false) {}
+    
+    void put(const void* data, size_t length) {
+        if (m_out) {
+            if (length > m_capacity - m_size) {
+                m_overflow = true;
+                return;
+            }
+            memcpy(m_out + m_size, data, length);
+        }
+        m_size += length;
+    }
+    
+    void put(std::string_view text) { put(text.data(), text.size()); }
+    
+    void putByte(uint8_t value) { put(&value, 1); }
+    
+    template <typename T>
+    void putNumber(T value) {
+        char text[24];
+        std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+        put(text, result.ptr - text);
+    }
+    
+    // Field then separator, the layout every type here uses
+    template <typename T>
+    void field(T value) {
+        putNumber(value);
+        putByte('|');
+    }
+    
+    size_t size() const { return m_size; }
+    size_t result() const { return m_overflow ? 0 : m_size; }
+
+private:
+    char* m_out;
+    size_t m_capacity;
+    size_t m_size;
+    bool m_overflow;
+};
+
+// Walks '|'-separated fields without copying them
+class Parser {
+public:
+    explicit Parser(std::string_view data) : m_pos(data.data()), m_end(data.data() + data.size()), m_ok(true) {}
+    
+    // Up to the next '|' (consumed) or the end of input
+    std::string_view field() {
+        const char* bar = static_cast<const char*>(memchr(m_pos, '|', m_end - m_pos));
+        const char* stop = bar ? bar : m_end;
+        std::string_view value(m_pos, stop - m_pos);
+        m_pos = bar ? bar + 1 : m_end;
+        return value;
+    }
+    
+    template <typename T>
+    T number() {
+        std::string_view text = field();
+        T value = 0;
+        std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+            m_ok = false;
+        }
+        return value;
+    }
+    
+    // The type byte every event starts with, followed by '|'
+    uint8_t typeByte() {
+        if (m_end - m_pos < 2 || m_pos[1] != '|') {
+            m_ok = false;
+            return 0;
+        }
+        uint8_t value = static_cast<uint8_t>(m_pos[0]);
+        m_pos += 2;
+        return value;
+    }
+    
+    std::string_view bytes(size_t length) {
+        if (static_cast<size_t>(m_end - m_pos) < length) {
+            m_ok = false;
+            length = m_end - m_pos;
+        }
+        std::string_view value(m_pos, length);
+        m_pos += length;
+        return value;
+    }
+    
+    std::string_view rest() {
+        std::string_view value(m_pos, m_end - m_pos);
+        m_pos = m_end;
+        return value;
+    }
+    
+    bool atEnd() const { return m_pos == m_end; }
+    bool ok() const { return m_ok; }
+
+private:
+    const char* m_pos;
+    const char* m_end;
+    bool m_ok;
+};
+
+template <typename T>
+std::string serializeToString(const T& value) {
+    std::string out(value.serializedSize(), '\0');
+    value.serializeTo(&out[0], out.size());
+    return out;
+}
+
+// Message, MouseEvent and KeyboardEvent carry the type as one raw byte
+
+void writeMessage(Writer& writer, const Message& message) {
+    writer.putByte(static_cast<uint8_t>(message.type));
+    writer.putByte('|');
+    writer.put(message.payload);
+}
+
+void writeFileInfo(Writer& writer, const FileInfo& info) {
+    writer.put(info.name);
+    writer.putByte('|');
+    writer.put(info.path);
+    writer.putByte('|');
+    writer.field(info.size);
+    writer.put(info.is_directory ? "1|" : "0|");
+    writer.put(info.modified_time);
+}
+
+// Header of the full-frame part: width|height|format|size|
+void writeFrameHeader(Writer& writer, const ScreenFrame& frame) {
+    writer.field(frame.width);
+    writer.field(frame.height);
+    writer.field(frame.format);
+    writer.field(frame.data.size());
+}
+
+// x|y|width|height|format|size|
+void writeTileHeader(Writer& writer, const ScreenTile& tile) {
+    writer.field(tile.x);
+    writer.field(tile.y);
+    writer.field(tile.width);
+    writer.field(tile.height);
+    writer.field(static_cast<uint32_t>(tile.format));
+    writer.field(tile.data.size());
+}
+
+// Tiles follow the full-frame data; frames without tiles serialize as before
+void writeScreenFrame(Writer& writer, const ScreenFrame& frame) {
+    writeFrameHeader(writer, frame);
+    writer.put(frame.data.data(), frame.data.size());
+    
+    if (!frame.tiles.empty()) {
+        writer.field(frame.tiles.size());
+        for (const auto& tile : frame.tiles) {
+            writeTileHeader(writer, tile);
+            writer.put(tile.data.data(), tile.data.size());
+        }
+    }
+}
+
+void writeMouseEvent(Writer& writer, const MouseEvent& event) {
+    writer.putByte(static_cast<uint8_t>(event.type));
+    writer.putByte('|');
+    writer.field(event.x);
+    writer.field(event.y);
+    writer.putNumber(event.scroll_delta);
+}
+
+void writeKeyboardEvent(Writer& writer, const KeyboardEvent& event) {
+    writer.putByte(static_cast<uint8_t>(event.type));
+    writer.putByte('|');
+    writer.field(event.key_code);
+    writer.putNumber(event.modifiers);
+}
+
+} // namespace
+
+// Message
+
+size_t Message::serializedSize() const {
+    Writer writer(nullptr, 0);
+    writeMessage(writer, *this);
+    return writer.size();
+}
+
+size_t Message::serializeTo(char* out, size_t capacity) const {
+    Writer writer(out, capacity);
+    writeMessage(writer, *this);
+    return writer.result();
+}
+
 std::string Message::serialize() const {
-    std::ostringstream oss;
-    oss << static_cast<uint8_t>(type) << "|" << payload;
-    return oss.str();
+    return serializeToString(*this);
+}
+
+bool MessageView::parse(std::string_view data) {
+    Parser parser(data);
+    type = static_cast<MessageType>(parser.typeByte());
+    payload = parser.rest();
+    return parser.ok();
 }
 
 Message Message::deserialize(const std::string& data) {
     Message msg;
-    size_t pos = data.find('|');
-    if (pos != std::string::npos) {
-        msg.type = static_cast<MessageType>(std::stoi(data.substr(0, pos)));
-        msg.payload = data.substr(pos + 1);
+    MessageView view;
+    if (view.parse(data)) {
+        msg.type = view.type;
+        msg.payload.assign(view.payload.data(), view.payload.size());
     }
     return msg;
 }
 
+// FileInfo
+
+size_t FileInfo::serializedSize() const {
+    Writer writer(nullptr, 0);
+    writeFileInfo(writer, *this);
+    return writer.size();
+}
+
+size_t FileInfo::serializeTo(char* out, size_t capacity) const {
+    Writer writer(out, capacity);
+    writeFileInfo(writer, *this);
+    return writer.result();
+}
+
 std::string FileInfo::serialize() const {
-    std::ostringstream oss;
-    oss << name << "|" << path << "|" << size << "|" 
-        << (is_directory ? "1" : "0") << "|" << modified_time;
-    return oss.str();
+    return serializeToString(*this);
+}
+
+bool FileInfo::parse(std::string_view data) {
+    Parser parser(data);
+    std::string_view field = parser.field();
+    name.assign(field.data(), field.size());
+    field = parser.field();
+    path.assign(field.data(), field.size());
+    size = parser.number<uint64_t>();
+    is_directory = parser.field() == "1";
+    field = parser.field();
+    modified_time.assign(field.data(), field.size());
+    return parser.ok();
 }
 
 FileInfo FileInfo::deserialize(const std::string& data) {
     FileInfo info;
-    std::istringstream iss(data);
-    std::string token;
+    info.parse(data);
+    return info;
+}
+
+// ScreenFrame
+
+size_t ScreenFrame::serializedSize() const {
+    Writer writer(nullptr, 0);
+    writeScreenFrame(writer, *this);
+    return writer.size();
+}
+
+size_t ScreenFrame::serializeTo(char* out, size_t capacity) const {
+    Writer writer(out, capacity);
+    writeScreenFrame(writer, *this);
+    return writer.result();
+}
+
+size_t ScreenFrame::serializeTo(std::vector<char>& scratch, std::vector<struct iovec>& iov) const {
+    // Each header is at most 6 numbers of up to 20 digits plus separators.
+    // Sized before writing so the iovecs never see scratch reallocate.
+    const size_t maxHeader = 6 * 21;
+    scratch.resize(maxHeader * (tiles.size() + 2));
+    iov.clear();
     
-    std::getline(iss, info.name, '|');
-    std::getline(iss, info.path, '|');
-    std::getline(iss, token, '|');
-    info.size = std::stoull(token);
-    std::getline(iss, token, '|');
-    info.is_directory = (token == "1");
-    std::getline(iss, info.modified_time, '|');
+    char* base = scratch.data();
+    size_t used = 0;
+    size_t total = 0;
     
-    return info;
+    auto addHeader = [&](auto&& write) {
+        Writer writer(base + used, scratch.size() - used);
+        write(writer);
+        iov.push_back({ base + used, writer.size() });
+        used += writer.size();
+        total += writer.size();
+    };
+    auto addPayload = [&](const std::vector<uint8_t>& payload) {
+        if (payload.empty()) return;
+        iov.push_back({ const_cast<uint8_t*>(payload.data()), payload.size() });
+        total += payload.size();
+    };
+    
+    addHeader([this](Writer& writer) { writeFrameHeader(writer, *this); });
+    addPayload(data);
+    
+    if (!tiles.empty()) {
+        for (size_t i = 0; i < tiles.size(); i++) {
+            const ScreenTile& tile = tiles[i];
+            addHeader([&](Writer& writer) {
+                if (i == 0) writer.field(tiles.size());
+                writeTileHeader(writer, tile);
+            });
+            addPayload(tile.data);
+        }
+    }
+    
+    return total;
 }
 
 std::string ScreenFrame::serialize() const {
-    std::ostringstream oss;
-    oss << width << "|" << height << "|" << format << "|";
-    oss << data.size() << "|";
-    oss.write(reinterpret_cast<const char*>(data.data()), data.size());
-    return oss.str();
+    return serializeToString(*this);
+}
+
+bool ScreenFrameView::parse(std::string_view input) {
+    Parser parser(input);
+    width = parser.number<uint32_t>();
+    height = parser.number<uint32_t>();
+    format = parser.number<uint32_t>();
+    data = parser.bytes(parser.number<size_t>());
+    
+    tiles.clear();
+    if (parser.ok() && !parser.atEnd()) {
+        size_t count = parser.number<size_t>();
+        for (size_t i = 0; i < count && parser.ok(); i++) {
+            ScreenTileView tile;
+            tile.x = parser.number<uint16_t>();
+            tile.y = parser.number<uint16_t>();
+            tile.width = parser.number<uint16_t>();
+            tile.height = parser.number<uint16_t>();
+            tile.format = parser.number<uint8_t>();
+            tile.data = parser.bytes(parser.number<size_t>());
+            tiles.push_back(tile);
+        }
+    }
+    return parser.ok();
 }
 
 ScreenFrame ScreenFrame::deserialize(const std::string& data) {
     ScreenFrame frame;
-    std::istringstream iss(data);
-    std::string token;
-    
-    std::getline(iss, token, '|');
-    frame.width = std::stoul(token);
-    std::getline(iss, token, '|');
-    frame.height = std::stoul(token);
-    std::getline(iss, token, '|');
-    frame.format = std::stoul(token);
-    std::getline(iss, token, '|');
-    size_t data_size = std::stoull(token);
+    ScreenFrameView view;
+    view.parse(data);
     
-    frame.data.resize(data_size);
-    iss.read(reinterpret_cast<char*>(frame.data.data()), data_size);
+    frame.width = view.width;
+    frame.height = view.height;
+    frame.format = view.format;
+    frame.data.assign(view.data.begin(), view.data.end());
+    frame.tiles.resize(view.tiles.size());
+    for (size_t i = 0; i < view.tiles.size(); i++) {
+        const ScreenTileView& source = view.tiles[i];
+        ScreenTile& tile = frame.tiles[i];
+        tile.x = source.x;
+        tile.y = source.y;
+        tile.width = source.width;
+        tile.height = source.height;
+        tile.format = source.format;
+        tile.data.assign(source.data.begin(), source.data.end());
+    }
     
     return frame;
 }
 
+// MouseEvent
+
+size_t MouseEvent::serializedSize() const {
+    Writer writer(nullptr, 0);
+    writeMouseEvent(writer, *this);
+    return writer.size();
+}
+
+size_t MouseEvent::serializeTo(char* out, size_t capacity) const {
+    Writer writer(out, capacity);
+    writeMouseEvent(writer, *this);
+    return writer.result();
+}
+
 std::string MouseEvent::serialize() const {
-    std::ostringstream oss;
-    oss << static_cast<uint8_t>(type) << "|" << x << "|" << y << "|" << scroll_delta;
-    return oss.str();
+    return serializeToString(*this);
+}
+
+bool MouseEvent::parse(std::string_view data) {
+    Parser parser(data);
+    type = static_cast<Type>(parser.typeByte());
+    x = parser.number<int32_t>();
+    y = parser.number<int32_t>();
+    scroll_delta = parser.number<int32_t>();
+    return parser.ok();
 }
 
 MouseEvent MouseEvent::deserialize(const std::string& data) {
-    MouseEvent event;
-    std::istringstream iss(data);
-    std::string token;
-    
-    std::getline(iss, token, '|');
-    event.type = static_cast<Type>(std::stoi(token));
-    std::getline(iss, token, '|');
-    event.x = std::stoi(token);
-    std::getline(iss, token, '|');
-    event.y = std::stoi(token);
-    std::getline(iss, token, '|');
-    event.scroll_delta = std::stoi(token);
-    
+    MouseEvent event{};
+    event.parse(data);
     return event;
 }
 
+// KeyboardEvent
+
+size_t KeyboardEvent::serializedSize() const {
+    Writer writer(nullptr, 0);
+    writeKeyboardEvent(writer, *this);
+    return writer.size();
+}
+
+size_t KeyboardEvent::serializeTo(char* out, size_t capacity) const {
+    Writer writer(out, capacity);
+    writeKeyboardEvent(writer, *this);
+    return writer.result();
+}
+
 std::string KeyboardEvent::serialize() const {
-    std::ostringstream oss;
-    oss << static_cast<uint8_t>(type) << "|" << key_code << "|" << modifiers;
-    return oss.str();
+    return serializeToString(*this);
+}
+
+bool KeyboardEvent::parse(std::string_view data) {
+    Parser parser(data);
+    type = static_cast<Type>(parser.typeByte());
+    key_code = parser.number<uint32_t>();
+    modifiers = parser.number<uint32_t>();
+    return parser.ok();
 }
 
 KeyboardEvent KeyboardEvent::deserialize(const std::string& data) {
-    KeyboardEvent event;
-    std::istringstream iss(data);
-    std::string token;
-    
-    std::getline(iss, token, '|');
-    event.type = static_cast<Type>(std::stoi(token));
-    std::getline(iss, token, '|');
-    event.key_code = std::stoul(token);
-    std::getline(iss, token, '|');
-    event.modifiers = std::stoul(token);
-    
+    KeyboardEvent event{};
+    event.parse(data);
     return event;
 }
 
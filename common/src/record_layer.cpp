@@ -0,0 +1,177 @@
+#include "record_layer.h"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+namespace {
+
+const unsigned char RECORD_VERSION = 1;
+
+const EVP_CIPHER* CipherFor(CipherSuite suite) {
+    switch (suite) {
+        case CipherSuite::AES_256_GCM:
+            return EVP_aes_256_gcm();
+        case CipherSuite::CHACHA20_POLY1305:
+            return EVP_chacha20_poly1305();
+    }
+    throw std::invalid_argument("Unknown cipher suite");
+}
+
+// Creates a context with the cipher and key fixed; only the nonce changes
+// per record afterwards, so the key schedule is computed once
+EVP_CIPHER_CTX* CreateContext(CipherSuite suite, const std::vector<unsigned char>& key, bool encrypt) {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        throw std::runtime_error("Failed to create cipher context");
+    }
+    
+    if (EVP_CipherInit_ex(ctx, CipherFor(suite), nullptr, nullptr, nullptr, encrypt ? 1 : 0) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, RecordLayer::IV_SIZE, nullptr) != 1 ||
+        EVP_CipherInit_ex(ctx, nullptr, nullptr, key.data(), nullptr, encrypt ? 1 : 0) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        throw std::runtime_error("Failed to initialize record cipher");
+    }
+    return ctx;
+}
+
+} // namespace
+
+RecordLayer::RecordLayer(CipherSuite suite,
+                         const std::vector<unsigned char>& write_key, const std::vector<unsigned char>& write_iv,
+                         const std::vector<unsigned char>& read_key, const std::vector<unsigned char>& read_iv)
+    : suite_(suite)
+    , seal_ctx_(nullptr)
+    , open_ctx_(nullptr)
+    , write_seq_(0)
+    , read_seq_(0) {
+    
+    if (write_key.size() != KEY_SIZE || read_key.size() != KEY_SIZE) {
+        throw std::invalid_argument("Key must be 256 bits (32 bytes)");
+    }
+    if (write_iv.size() != IV_SIZE || read_iv.size() != IV_SIZE) {
+        throw std::invalid_argument("IV must be 96 bits (12 bytes)");
+    }
+    
+    std::memcpy(write_iv_, write_iv.data(), IV_SIZE);
+    std::memcpy(read_iv_, read_iv.data(), IV_SIZE);
+    
+    seal_ctx_ = CreateContext(suite, write_key, true);
+    try {
+        open_ctx_ = CreateContext(suite, read_key, false);
+    } catch (...) {
+        EVP_CIPHER_CTX_free(seal_ctx_);
+        throw;
+    }
+}
+
+RecordLayer::~RecordLayer() {
+    EVP_CIPHER_CTX_free(seal_ctx_);
+    EVP_CIPHER_CTX_free(open_ctx_);
+}
+
+std::vector<unsigned char> RecordLayer::GenerateIV() {
+    std::vector<unsigned char> iv(IV_SIZE);
+    if (RAND_bytes(iv.data(), iv.size()) != 1) {
+        throw std::runtime_error("Failed to generate record IV");
+    }
+    return iv;
+}
+
+size_t RecordLayer::RecordSizeFromHeader(const unsigned char* header) {
+    if (header[0] != RECORD_VERSION) {
+        return 0;
+    }
+    size_t length = header[2] | (header[3] << 8);
+    return length > MAX_PLAINTEXT ? 0 : RecordSize(length);
+}
+
+void RecordLayer::Nonce(const unsigned char* iv, uint64_t seq, unsigned char* nonce) const {
+    // Sequence number, big-endian, XORed into the last 8 bytes of the IV
+    std::memcpy(nonce, iv, IV_SIZE);
+    for (int i = 0; i < 8; ++i) {
+        nonce[IV_SIZE - 1 - i] ^= static_cast<unsigned char>(seq >> (i * 8));
+    }
+}
+
+size_t RecordLayer::Seal(const unsigned char* plaintext, size_t length, unsigned char* record) {
+    if (length > MAX_PLAINTEXT) {
+        throw std::invalid_argument("Record plaintext exceeds 16 KB");
+    }
+    if (write_seq_ == UINT64_MAX) {
+        throw std::runtime_error("Record sequence exhausted; rekey required");
+    }
+    
+    // The header sits in front of the plaintext, so writing it first is
+    // safe for in-place callers; it is authenticated as associated data
+    record[0] = RECORD_VERSION;
+    record[1] = static_cast<unsigned char>(suite_);
+    record[2] = static_cast<unsigned char>(length & 0xFF);
+    record[3] = static_cast<unsigned char>(length >> 8);
+    
+    unsigned char nonce[IV_SIZE];
+    Nonce(write_iv_, write_seq_, nonce);
+    
+    int len = 0;
+    if (EVP_EncryptInit_ex(seal_ctx_, nullptr, nullptr, nullptr, nonce) != 1 ||
+        EVP_EncryptUpdate(seal_ctx_, nullptr, &len, record, HEADER_SIZE) != 1 ||
+        EVP_EncryptUpdate(seal_ctx_, record + HEADER_SIZE, &len, plaintext, static_cast<int>(length)) != 1 ||
+        EVP_EncryptFinal_ex(seal_ctx_, record + HEADER_SIZE + len, &len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(seal_ctx_, EVP_CTRL_AEAD_GET_TAG, TAG_SIZE, record + HEADER_SIZE + length) != 1) {
+        throw std::runtime_error("Record encryption failed");
+    }
+    
+    write_seq_++;
+    return RecordSize(length);
+}
+
+size_t RecordLayer::SealStream(const unsigned char* data, size_t length, std::vector<unsigned char>& out) {
+    size_t records = length == 0 ? 1 : (length + MAX_PLAINTEXT - 1) / MAX_PLAINTEXT;
+    size_t start = out.size();
+    out.resize(start + length + records * (HEADER_SIZE + TAG_SIZE));
+    
+    unsigned char* pos = out.data() + start;
+    size_t offset = 0;
+    do {
+        size_t chunk = std::min(length - offset, MAX_PLAINTEXT);
+        pos += Seal(data + offset, chunk, pos);
+        offset += chunk;
+    } while (offset < length);
+    
+    return out.size() - start;
+}
+
+bool RecordLayer::Open(const unsigned char* record, size_t record_size,
+                       unsigned char* plaintext, size_t& length) {
+    if (record_size < HEADER_SIZE + TAG_SIZE || RecordSizeFromHeader(record) != record_size ||
+        record[1] != static_cast<unsigned char>(suite_)) {
+        return false;
+    }
+    
+    // Decrypting in place only rewrites the payload; header and tag stay
+    size_t payload = record_size - HEADER_SIZE - TAG_SIZE;
+    
+    unsigned char nonce[IV_SIZE];
+    Nonce(read_iv_, read_seq_, nonce);
+    
+    int len = 0;
+    if (EVP_DecryptInit_ex(open_ctx_, nullptr, nullptr, nullptr, nonce) != 1 ||
+        EVP_CIPHER_CTX_ctrl(open_ctx_, EVP_CTRL_AEAD_SET_TAG, TAG_SIZE,
+                            const_cast<unsigned char*>(record + HEADER_SIZE + payload)) != 1 ||
+        EVP_DecryptUpdate(open_ctx_, nullptr, &len, record, HEADER_SIZE) != 1 ||
+        EVP_DecryptUpdate(open_ctx_, plaintext, &len, record + HEADER_SIZE, static_cast<int>(payload)) != 1 ||
+        EVP_DecryptFinal_ex(open_ctx_, plaintext + len, &len) != 1) {
+        return false;
+    }
+    
+    read_seq_++;
+    length = payload;
+    return true;
+}
+
+} // namespace Common
+} // namespace RemoteAccessSystem
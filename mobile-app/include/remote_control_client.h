@@ -3,6 +3,9 @@
 
 #include <QObject>
 #include <QTcpSocket>
+#include <QElapsedTimer>
+#include "input_frame.h"
+#include "latency_histogram.h"
 
 class RemoteControlClient : public QObject {
     Q_OBJECT
@@ -16,6 +19,10 @@ public:
     Q_INVOKABLE void sendMouseMove(int x, int y);
     Q_INVOKABLE void sendMouseClick(int button);
     Q_INVOKABLE void sendKeyPress(int key);
+    Q_INVOKABLE void sendScroll(int steps);
+    
+    // Round trip from sending an input event to the PC acking its injection
+    Q_INVOKABLE QString inputLatencySummary() const;
     
     bool isConnected() const;
 
@@ -31,8 +38,31 @@ private slots:
     void handleData();
 
 private:
+    void handleLine(const QByteArray &line);
+    
+    // Binary input channel (INPUT_CHANNEL through the relay)
+    void openInputChannel();
+    void handleInputData();
+    bool sendInputFrame(uint8_t type, uint8_t button, int x, int y, uint32_t value = 0);
+    
     QTcpSocket *m_socket;
     bool m_connected;
+    
+    // Stream framing: text lines, except a SCREEN_FRAME header is followed
+    // by that many payload bytes
+    QByteArray m_buffer;
+    qint64 m_frameBytesPending;
+    quint64 m_frameSequence;
+    
+    QString m_pcId;
+    QString m_relayServer;
+    int m_relayPort;
+    QTcpSocket *m_inputSocket;
+    bool m_inputReady;                  // past the INPUT_READY handshake
+    QByteArray m_inputBuffer;
+    QElapsedTimer m_inputClock;
+    quint16 m_inputSequence;
+    RemoteAccessSystem::LatencyHistogram m_inputLatency;
 };
 
 #endif // REMOTE_CONTROL_CLIENT_H
@@ -152,6 +152,32 @@ ApplicationWindow {
                 "isOnline": isOnline
             })
         }
+        
+        function onPcOnline(pcId, hostname, username) {
+            console.log("[QML] PC online:", pcId)
+            for (var i = 0; i < pcListModel.count; i++) {
+                if (pcListModel.get(i).pcId === pcId) {
+                    pcListModel.set(i, { "hostname": hostname, "username": username, "isOnline": true })
+                    return
+                }
+            }
+            pcListModel.append({
+                "pcId": pcId,
+                "hostname": hostname,
+                "username": username,
+                "isOnline": true
+            })
+        }
+        
+        function onPcOffline(pcId) {
+            console.log("[QML] PC offline:", pcId)
+            for (var i = 0; i < pcListModel.count; i++) {
+                if (pcListModel.get(i).pcId === pcId) {
+                    pcListModel.remove(i)
+                    return
+                }
+            }
+        }
     }
 
     StackView {
@@ -630,6 +656,7 @@ ApplicationWindow {
                             onClicked: {
                                 console.log("[QML] Login button clicked")
                                 connectionManager.login(usernameField.text, passwordField.text)
+                                pcManager.setUsername(usernameField.text)
                                 stackView.push(pcListPage)
                             }
                         }
@@ -4,15 +4,33 @@
 #include <QStringList>
 #include <QSettings>
 #include <QCryptographicHash>
+#include <QVariantMap>
+
+namespace Wire = RemoteAccessSystem::Wire;
+namespace Trace = RemoteAccessSystem::Trace;
+
+// Reconnect backoff after a session's link drops
+static const int RECONNECT_MIN_MS = 1000;
+static const int RECONNECT_MAX_MS = 30000;
+
+static QString fieldString(const Wire::FrameView &frame, size_t index) {
+    std::string_view field = frame.field(index);
+    return QString::fromUtf8(field.data(), static_cast<int>(field.size()));
+}
 
 ConnectionManager::ConnectionManager(QObject *parent)
     : QObject(parent),
       m_isConnected(false),
       m_relaySocket(nullptr),
       m_connectionTimer(nullptr),
+      m_nextRequestId(1),
+      m_relayTraces(false),
+      m_reconnectTimer(nullptr),
+      m_reconnectDelay(RECONNECT_MIN_MS),
       m_state(Disconnected) {
     
     qDebug() << "[ConnectionManager] Initialized";
+    Trace::Exporter::instance().setService("mobile-app");
     
     // Initialize relay socket
     m_relaySocket = new QTcpSocket(this);
@@ -27,6 +45,10 @@ ConnectionManager::ConnectionManager(QObject *parent)
     m_connectionTimer->setInterval(10000); // 10 second timeout
     connect(m_connectionTimer, &QTimer::timeout, this, &ConnectionManager::onConnectionTimeout);
     
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &ConnectionManager::onReconnectTimer);
+    
     updateConnectionStatus("Disconnected");
 }
 
@@ -188,6 +210,9 @@ void ConnectionManager::connectToPC(const QString &pcId) {
         return;
     }
     
+    if (info.pcId != m_currentPC.pcId) {
+        endSession();
+    }
     m_currentPC = info;
     connectToRelay(info);
 }
@@ -196,6 +221,7 @@ void ConnectionManager::connectViaScan(const QString &qrData) {
     qDebug() << "[ConnectionManager] Connect via QR scan:" << qrData;
     
     if (parseQRCode(qrData)) {
+        endSession();
         connectToRelay(m_currentPC);
     }
 }
@@ -220,6 +246,7 @@ void ConnectionManager::connectToRelay(const PCConnectionInfo &info) {
     
     // Start connection timeout
     m_connectionTimer->start();
+    m_relayReader = Wire::Reader();
     
     // Connect to relay server
     m_relaySocket->connectToHost(info.relayServer, info.relayPort);
@@ -228,6 +255,15 @@ void ConnectionManager::connectToRelay(const PCConnectionInfo &info) {
 void ConnectionManager::disconnectFromPC() {
     qDebug() << "[ConnectionManager] Disconnecting from PC";
     
+    // Ends the session on the relay too, rather than leaving it to expire
+    if (m_relaySocket->state() == QAbstractSocket::ConnectedState) {
+        std::string frame;
+        Wire::appendMessage(frame, true, Wire::Type::DISCONNECT, {});
+        m_relaySocket->write(frame.data(), static_cast<qint64>(frame.size()));
+        m_relaySocket->flush();
+    }
+    endSession();
+    
     if (m_relaySocket->state() != QAbstractSocket::UnconnectedState) {
         m_relaySocket->disconnectFromHost();
     }
@@ -243,6 +279,79 @@ void ConnectionManager::disconnectFromPC() {
     emit pcDisconnected();
 }
 
+void ConnectionManager::endSession() {
+    m_reconnectTimer->stop();
+    m_reconnectDelay = RECONNECT_MIN_MS;
+    m_sessionToken.clear();
+    
+    // Whatever was still outstanding will not be answered now
+    QList<quint32> pending = m_inFlight.keys();
+    m_inFlight.clear();
+    m_spans.clear();
+    for (quint32 requestId : pending) {
+        emit requestFailed(static_cast<int>(requestId), "Disconnected");
+    }
+}
+
+void ConnectionManager::scheduleReconnect() {
+    qDebug() << "[ConnectionManager] Reconnecting in" << m_reconnectDelay << "ms";
+    updateConnectionStatus("Reconnecting...");
+    m_reconnectTimer->start(m_reconnectDelay);
+    m_reconnectDelay = qMin(m_reconnectDelay * 2, RECONNECT_MAX_MS);
+}
+
+void ConnectionManager::onReconnectTimer() {
+    connectToRelay(m_currentPC);
+}
+
+// ============================================================================
+// Session Requests
+// ============================================================================
+
+int ConnectionManager::listDirectory(const QString &path) {
+    return sendRequest(Wire::Type::LIST_DIR, path);
+}
+
+int ConnectionManager::generateShareUrl(const QString &filePath) {
+    return sendRequest(Wire::Type::GENERATE_URL, filePath);
+}
+
+int ConnectionManager::sendRequest(Wire::Type type, const QString &argument) {
+    if (m_sessionToken.isEmpty()) {
+        qDebug() << "[ConnectionManager] No session for" << Wire::typeName(type);
+        return 0;
+    }
+    
+    quint32 requestId = m_nextRequestId++;
+    if (m_nextRequestId > 0x7FFFFFFF) {
+        m_nextRequestId = 1;    // ids are handed to QML as int
+    }
+    
+    // The request starts a trace; its span runs until the answer is in
+    Trace::Span span;
+    if (m_relayTraces) {
+        span = Trace::Span::root(std::string("mobile ") + Wire::typeName(type));
+    }
+    
+    QByteArray pcId = m_currentPC.pcId.toUtf8();
+    QByteArray value = argument.toUtf8();
+    std::string frame;
+    Wire::appendMessage(frame, true, type, {
+        std::string_view(pcId.constData(), pcId.size()),
+        std::string_view(value.constData(), value.size())
+    }, requestId, span.active() ? &span.context() : nullptr);
+    m_inFlight.insert(requestId, QByteArray(frame.data(), static_cast<int>(frame.size())));
+    if (span.active()) {
+        m_spans.insert(requestId, span);
+    }
+    
+    // While reconnecting it is kept and goes out once the session resumes
+    if (m_state == Connected) {
+        m_relaySocket->write(frame.data(), static_cast<qint64>(frame.size()));
+    }
+    return static_cast<int>(requestId);
+}
+
 // ============================================================================
 // Connection State Management
 // ============================================================================
@@ -283,19 +392,24 @@ void ConnectionManager::onRelayConnected() {
 
 void ConnectionManager::sendAuthRequest(const PCConnectionInfo &info) {
     // Send authentication request to relay
-    // Format: CONNECT|mobile_id|pc_id|auth_token
-    QString mobileId = QCryptographicHash::hash(
+    // Fields: mobile_id, pc_id, auth_token, session token to resume (if any)
+    QByteArray mobileId = QCryptographicHash::hash(
         m_username.toUtf8(), 
         QCryptographicHash::Md5
     ).toHex();
-    
-    QString message = QString("CONNECT|%1|%2|%3\n")
-        .arg(mobileId)
-        .arg(info.pcId)
-        .arg(info.authToken);
-    
-    qDebug() << "[ConnectionManager] Sending auth request:" << message.trimmed();
-    m_relaySocket->write(message.toUtf8());
+    QByteArray pcId = info.pcId.toUtf8();
+    QByteArray token = info.authToken.toUtf8();
+    
+    std::string frame;
+    Wire::appendMessage(frame, true, Wire::Type::CONNECT, {
+        std::string_view(mobileId.constData(), mobileId.size()),
+        std::string_view(pcId.constData(), pcId.size()),
+        std::string_view(token.constData(), token.size()),
+        std::string_view(m_sessionToken.constData(), m_sessionToken.size())
+    });
+    
+    qDebug() << "[ConnectionManager] Sending auth request for PC:" << info.pcId;
+    m_relaySocket->write(frame.data(), static_cast<qint64>(frame.size()));
     m_relaySocket->flush();
 }
 
@@ -304,6 +418,22 @@ void ConnectionManager::onRelayDisconnected() {
     
     m_connectionTimer->stop();
     
+    // A live session is resumed rather than given up; the relay holds it
+    // (and answers arriving for it) for a while
+    if (!m_sessionToken.isEmpty()) {
+        if (m_reconnectTimer->isActive()) {
+            return;
+        }
+        bool wasConnected = m_state == Connected;
+        m_state = Disconnected;
+        scheduleReconnect();
+        if (wasConnected) {
+            m_isConnected = false;
+            emit isConnectedChanged(false);
+        }
+        return;
+    }
+    
     if (m_state == Connected) {
         updateConnectionStatus("Connection lost");
         emit connectionError("Connection to PC lost");
@@ -320,21 +450,49 @@ void ConnectionManager::onRelayDisconnected() {
 
 void ConnectionManager::onRelayReadyRead() {
     QByteArray data = m_relaySocket->readAll();
-    QString response = QString::fromUtf8(data).trimmed();
+    m_relayReader.append(data.constData(), data.size());
+    
+    Wire::FrameView response;
+    Wire::Reader::Result result;
+    while ((result = m_relayReader.next(response)) == Wire::Reader::FRAME) {
+        qDebug() << "[ConnectionManager] Relay response:" << Wire::typeName(response.type());
+        processRelayResponse(response);
+    }
     
-    qDebug() << "[ConnectionManager] Relay response:" << response;
-    processRelayResponse(response);
+    if (result == Wire::Reader::BAD_FRAME) {
+        qDebug() << "[ConnectionManager] Malformed frame from relay";
+        m_relaySocket->abort();
+    }
 }
 
-void ConnectionManager::processRelayResponse(const QString &response) {
-    QStringList parts = response.split('|');
-    if (parts.isEmpty()) return;
-    
-    QString command = parts[0];
+void ConnectionManager::processRelayResponse(const Wire::FrameView &response) {
+    Wire::Type command = response.type();
     
-    if (command == "OK" && m_state == Authenticating) {
-        // Authentication successful
-        qDebug() << "[ConnectionManager] Authentication successful";
+    if (command == Wire::Type::OK && m_state == Authenticating) {
+        // Authentication successful: OK|CONNECTED|pc_id|session_token|NEW or RESUMED[|TRACE]
+        bool resumed = fieldString(response, 3) == "RESUMED";
+        m_relayTraces = fieldString(response, 4) == "TRACE";
+        qDebug() << "[ConnectionManager] Authentication successful" << (resumed ? "(session resumed)" : "");
+        
+        if (!resumed) {
+            // The relay no longer knows the old session (or there was
+            // none): requests sent on it will never be answered
+            QList<quint32> lost = m_inFlight.keys();
+            m_inFlight.clear();
+            m_spans.clear();
+            for (quint32 requestId : lost) {
+                emit requestFailed(static_cast<int>(requestId), "Session lost");
+            }
+        }
+        std::string_view token = response.field(2);
+        m_sessionToken = QByteArray(token.data(), static_cast<int>(token.size()));
+        m_reconnectDelay = RECONNECT_MIN_MS;
+        
+        // Unanswered requests go again; the relay drops the ones it is
+        // still working on, and answers it held follow this OK
+        for (const QByteArray &frame : m_inFlight) {
+            m_relaySocket->write(frame);
+        }
         
         m_state = Connected;
         m_isConnected = true;
@@ -345,9 +503,43 @@ void ConnectionManager::processRelayResponse(const QString &response) {
         emit currentPCNameChanged(m_currentPCName);
         emit pcConnected(m_currentPC.pcId);
         
-    } else if (command == "ERROR") {
+    } else if (command == Wire::Type::DIR_LIST) {
+        quint32 requestId = response.requestId();
+        if (m_inFlight.remove(requestId) == 0) {
+            return;     // already answered (or abandoned)
+        }
+        m_spans.take(requestId).finish();
+        
+        // One (name, type, size) record per entry
+        QVariantList entries;
+        for (size_t i = 0; i + 2 < response.fieldCount(); i += 3) {
+            QVariantMap entry;
+            entry["name"] = fieldString(response, i);
+            entry["type"] = fieldString(response, i + 1);
+            entry["size"] = static_cast<qulonglong>(response.fieldU64(i + 2));
+            entries.append(entry);
+        }
+        emit directoryListed(static_cast<int>(requestId), entries);
+        
+    } else if (command == Wire::Type::SHARE_URL) {
+        quint32 requestId = response.requestId();
+        if (m_inFlight.remove(requestId) != 0) {
+            m_spans.take(requestId).finish();
+            emit shareUrlReady(static_cast<int>(requestId), fieldString(response, 0));
+        }
+        
+    } else if (command == Wire::Type::ERROR && m_inFlight.contains(response.requestId())) {
+        // One request failed; the session carries on
+        quint32 requestId = response.requestId();
+        m_inFlight.remove(requestId);
+        m_spans.take(requestId).finish();
+        emit requestFailed(static_cast<int>(requestId), fieldString(response, 0));
+        
+    } else if (command == Wire::Type::ERROR) {
         // Authentication or connection failed
-        QString error = parts.size() > 1 ? parts[1] : "Unknown error";
+        std::string_view field = response.field(0);
+        QString error = field.empty() ? QString("Unknown error")
+                                      : QString::fromUtf8(field.data(), static_cast<int>(field.size()));
         qDebug() << "[ConnectionManager] Connection error:" << error;
         
         m_state = Error;
@@ -356,12 +548,14 @@ void ConnectionManager::processRelayResponse(const QString &response) {
         
         disconnectFromPC();
         
-    } else if (command == "PING") {
-        // Respond to keep-alive ping
-        m_relaySocket->write("PONG\n");
+    } else if (command == Wire::Type::PING) {
+        // Respond to keep-alive ping in the format it came in
+        std::string pong;
+        Wire::appendMessage(pong, m_relayReader.binary(), Wire::Type::PONG, {}, response.requestId());
+        m_relaySocket->write(pong.data(), static_cast<qint64>(pong.size()));
         m_relaySocket->flush();
         
-    } else if (command == "PC_OFFLINE") {
+    } else if (command == Wire::Type::PC_OFFLINE) {
         qDebug() << "[ConnectionManager] PC went offline";
         updateConnectionStatus("PC is offline");
         emit connectionError("PC is currently offline");
@@ -374,6 +568,15 @@ void ConnectionManager::onRelayError(QAbstractSocket::SocketError error) {
     qDebug() << "[ConnectionManager] Socket error:" << error << "-" << errorString;
     
     m_connectionTimer->stop();
+    
+    // A reconnect attempt that failed outright (no disconnected() follows)
+    if (!m_sessionToken.isEmpty()) {
+        if (m_relaySocket->state() == QAbstractSocket::UnconnectedState && !m_reconnectTimer->isActive()) {
+            m_state = Disconnected;
+            scheduleReconnect();
+        }
+        return;
+    }
     m_state = Error;
     
     updateConnectionStatus("Connection error: " + errorString);
@@ -383,6 +586,14 @@ void ConnectionManager::onRelayError(QAbstractSocket::SocketError error) {
 void ConnectionManager::onConnectionTimeout() {
     qDebug() << "[ConnectionManager] Connection timeout";
     
+    if (!m_sessionToken.isEmpty()) {
+        // Still trying to get a lost session back
+        m_relaySocket->abort();
+        m_state = Disconnected;
+        scheduleReconnect();
+        return;
+    }
+    
     m_state = Error;
     updateConnectionStatus("Connection timeout");
     emit connectionError("Connection timed out");
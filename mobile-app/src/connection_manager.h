@@ -6,6 +6,9 @@
 #include <QTcpSocket>
 #include <QMap>
 #include <QTimer>
+#include <QVariantList>
+#include "wire_frame.h"
+#include "trace.h"
 
 /**
  * Struct to hold PC connection information parsed from QR code
@@ -36,6 +39,13 @@ struct PCConnectionInfo {
  * - Account server authentication
  * - PC connection via relay server
  * - Connection state management
+ *
+ * A connection to a PC is a long-lived relay session: directory listings
+ * and share URLs are pipelined over it, each tagged with a request id the
+ * answer echoes, so several can be outstanding at once. When the link
+ * drops the manager reconnects with backoff and presents its session
+ * token; the relay resumes the session, hands over answers that arrived
+ * meanwhile, and the requests still unanswered are sent again.
  */
 class ConnectionManager : public QObject {
     Q_OBJECT
@@ -63,6 +73,12 @@ public:
     Q_INVOKABLE void disconnectFromPC();
     Q_INVOKABLE void connectViaScan(const QString &qrData);
     
+    // Requests over the session; each returns the request id its answer
+    // (directoryListed / shareUrlReady / requestFailed) carries, or 0 if
+    // not connected
+    Q_INVOKABLE int listDirectory(const QString &path);
+    Q_INVOKABLE int generateShareUrl(const QString &filePath);
+    
     // Connection State
     Q_INVOKABLE QString connectionStatus() const;
     Q_INVOKABLE bool isConnected() const;
@@ -93,6 +109,9 @@ signals:
     
     // Data signals
     void pcListUpdated();
+    void directoryListed(int requestId, const QVariantList &entries);
+    void shareUrlReady(int requestId, const QString &url);
+    void requestFailed(int requestId, const QString &error);
 
 private slots:
     void onRelayConnected();
@@ -100,6 +119,7 @@ private slots:
     void onRelayReadyRead();
     void onRelayError(QAbstractSocket::SocketError error);
     void onConnectionTimeout();
+    void onReconnectTimer();
 
 private:
     // Helper methods
@@ -107,7 +127,10 @@ private:
     bool validateQRData(const PCConnectionInfo &info);
     void connectToRelay(const PCConnectionInfo &info);
     void sendAuthRequest(const PCConnectionInfo &info);
-    void processRelayResponse(const QString &response);
+    void processRelayResponse(const RemoteAccessSystem::Wire::FrameView &response);
+    int sendRequest(RemoteAccessSystem::Wire::Type type, const QString &argument);
+    void scheduleReconnect();
+    void endSession();
     void updateConnectionStatus(const QString &status);
     void saveConnectionInfo(const PCConnectionInfo &info);
     PCConnectionInfo loadConnectionInfo(const QString &pcId);
@@ -121,9 +144,20 @@ private:
     
     // Current connection
     QTcpSocket *m_relaySocket;
+    RemoteAccessSystem::Wire::Reader m_relayReader;
     PCConnectionInfo m_currentPC;
     QTimer *m_connectionTimer;
     
+    // Relay session: token to resume it, and the requests not yet answered
+    // (their encoded frames, resent after a reconnect)
+    QByteArray m_sessionToken;
+    quint32 m_nextRequestId;
+    QMap<quint32, QByteArray> m_inFlight;
+    bool m_relayTraces;     // the relay said TRACE: requests go out traced
+    QMap<quint32, RemoteAccessSystem::Trace::Span> m_spans;     // of traced requests in flight
+    QTimer *m_reconnectTimer;
+    int m_reconnectDelay;
+    
     // Saved connections
     QMap<QString, PCConnectionInfo> m_savedPCs;
     
@@ -1,33 +1,90 @@
 #include "pcmanager.h"
 #include <QDebug>
 #include <QStringList>
+#include <QSettings>
+
+namespace Wire = RemoteAccessSystem::Wire;
+
+// PCs paired by QR code, as saved by ConnectionManager
+static QStringList pairedPCs() {
+    QSettings settings("RemoteAccessSystem", "MobileApp");
+    settings.beginGroup("SavedPCs");
+    QStringList paired = settings.childGroups();
+    settings.endGroup();
+    paired.sort();
+    return paired;
+}
 
 PCManager::PCManager(QObject *parent)
     : QObject(parent)
     , m_socket(new QTcpSocket(this))
+    , m_reconnectTimer(new QTimer(this))
+    , m_relayPort(0)
+    , m_subscribed(false)
+    , m_retrying(false)
     , m_isConnected(false)
 {
     connect(m_socket, &QTcpSocket::connected, this, &PCManager::onConnected);
     connect(m_socket, &QTcpSocket::readyRead, this, &PCManager::onReadyRead);
     connect(m_socket, &QTcpSocket::disconnected, this, &PCManager::onDisconnected);
     connect(m_socket, &QTcpSocket::errorOccurred, this, &PCManager::onError);
+    
+    m_reconnectTimer->setSingleShot(true);
+    m_reconnectTimer->setInterval(5000);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &PCManager::onReconnect);
 }
 
 PCManager::~PCManager() {
+    m_reconnectTimer->stop();
     if (m_socket->isOpen()) {
         m_socket->close();
     }
 }
 
-void PCManager::queryPCList(const QString &relayServerAddress, int port) {
-    qDebug() << "[PCManager] Querying PC list from" << relayServerAddress << ":" << port;
+void PCManager::setUsername(const QString &username) {
+    if (username == m_username) {
+        return;
+    }
+    m_username = username;
     
-    if (m_socket->state() == QAbstractSocket::ConnectedState) {
-        m_socket->disconnectFromHost();
-        m_socket->waitForDisconnected(500);
+    // The subscription is per user; start over with the new one
+    if (!m_relayAddress.isEmpty()) {
+        subscribe();
+    }
+}
+
+void PCManager::queryPCList(const QString &relayServerAddress, int port) {
+    // Already subscribed to this relay for the same PCs: the list is
+    // current, no round trip
+    if (m_subscribed && relayServerAddress == m_relayAddress && port == m_relayPort &&
+        m_socket->state() == QAbstractSocket::ConnectedState && pairedPCs() == m_paired) {
+        publishList();
+        return;
     }
     
-    m_socket->connectToHost(relayServerAddress, port);
+    m_relayAddress = relayServerAddress;
+    m_relayPort = port;
+    m_retrying = false;
+    subscribe();
+}
+
+void PCManager::subscribe() {
+    qDebug() << "[PCManager] Subscribing to PC presence on" << m_relayAddress << ":" << m_relayPort;
+    
+    if (m_socket->state() != QAbstractSocket::UnconnectedState) {
+        m_socket->abort();
+    }
+    m_reconnectTimer->stop();
+    m_subscribed = false;
+    m_reader = Wire::Reader();
+    m_socket->connectToHost(m_relayAddress, m_relayPort);
+}
+
+void PCManager::onReconnect() {
+    if (!m_relayAddress.isEmpty()) {
+        m_retrying = true;
+        subscribe();
+    }
 }
 
 void PCManager::connectToPC(const QString &pcId, const QString &relayServerAddress) {
@@ -58,59 +115,98 @@ void PCManager::disconnectFromPC() {
 
 void PCManager::onConnected() {
     qDebug() << "[PCManager] Socket connected to relay server";
-    // Changed from QUERY_PC_LIST to GET_PCS to match relay server
-    QString request = "GET_PCS\n";
-    qDebug() << "[PCManager] Sending:" << request.trimmed();
-    m_socket->write(request.toUtf8());
+    
+    // SUBSCRIBE_PCS|username|pc_id...: this user's PCs plus the paired ones
+    m_paired = pairedPCs();
+    std::string frame;
+    Wire::Builder request(frame, Wire::Type::SUBSCRIBE_PCS);
+    request.add(m_username.toStdString());
+    for (const QString &pcId : m_paired) {
+        request.add(pcId.toStdString());
+    }
+    request.finish();
+    
+    qDebug() << "[PCManager] Subscribing for user" << m_username << "and" << m_paired.size() << "paired PCs";
+    m_socket->write(frame.data(), static_cast<qint64>(frame.size()));
     m_socket->flush();
 }
 
 void PCManager::onReadyRead() {
     QByteArray data = m_socket->readAll();
-    QString response = QString::fromUtf8(data).trimmed();
-    qDebug() << "[PCManager] Response:" << response;
-    
-    if (response.startsWith("PC_LIST|")) {
-        emit clearPCList();
-        
-        // Extract content after "PC_LIST|"
-        QString content = response.mid(8);
-        
-        // Split by semicolon to get individual PCs
-        QStringList pcEntries = content.split(';', Qt::SkipEmptyParts);
-        QStringList pcList;
-        
-        qDebug() << "[PCManager] Found" << pcEntries.size() << "PC entries";
-        
-        for (const QString &entry : pcEntries) {
-            // Each entry is: pc_id,username,pc_name
-            QStringList parts = entry.split(',');
-            if (parts.size() >= 3) {
-                QString pcId = parts[0].trimmed();
-                QString username = parts[1].trimmed();
-                QString hostname = parts[2].trimmed();
-                
-                pcList.append(pcId);
-                emit addPCToList(pcId, hostname, username, true);
-                qDebug() << "[PCManager] Added PC:" << hostname << "(" << username << ")";
-            }
-        }
-        
-        emit pcListUpdated(pcList);
-        qDebug() << "[PCManager] PC list updated with" << pcList.size() << "PCs";
-    } else if (response.startsWith("ERROR|")) {
-        qDebug() << "[PCManager] Error from relay:" << response;
-        emit connectionFailed(response);
+    m_reader.append(data.constData(), data.size());
+    
+    Wire::FrameView frame;
+    Wire::Reader::Result result;
+    while ((result = m_reader.next(frame)) == Wire::Reader::FRAME) {
+        processFrame(frame);
     }
     
-    m_socket->disconnectFromHost();
+    if (result == Wire::Reader::BAD_FRAME) {
+        qDebug() << "[PCManager] Malformed frame from relay";
+        m_socket->abort();
+    }
+}
+
+void PCManager::processFrame(const Wire::FrameView &frame) {
+    auto text = [&frame](size_t index) {
+        std::string_view field = frame.field(index);
+        return QString::fromUtf8(field.data(), static_cast<int>(field.size())).trimmed();
+    };
+    
+    if (frame.type() == Wire::Type::PC_LIST) {
+        // Each record is: pc_id, username, pc_name
+        m_pcs.clear();
+        for (size_t i = 0; i + 2 < frame.fieldCount(); i += 3) {
+            m_pcs.insert(text(i), ListedPC{ text(i + 2), text(i + 1) });
+        }
+        m_subscribed = true;
+        m_retrying = false;
+        qDebug() << "[PCManager] Found" << m_pcs.size() << "PC entries";
+        publishList();
+    } else if (frame.type() == Wire::Type::PC_ONLINE && frame.fieldCount() >= 3) {
+        QString pcId = text(0);
+        ListedPC pc{ text(2), text(1) };
+        m_pcs.insert(pcId, pc);
+        qDebug() << "[PCManager] PC online:" << pc.hostname << "(" << pc.username << ")";
+        emit pcOnline(pcId, pc.hostname, pc.username);
+        emit pcListUpdated(m_pcs.keys());
+    } else if (frame.type() == Wire::Type::PC_OFFLINE && frame.fieldCount() >= 1) {
+        QString pcId = text(0);
+        if (m_pcs.remove(pcId) > 0) {
+            qDebug() << "[PCManager] PC offline:" << pcId;
+            emit pcOffline(pcId);
+            emit pcListUpdated(m_pcs.keys());
+        }
+    } else if (frame.type() == Wire::Type::ERROR) {
+        QString error = "ERROR|" + text(0);
+        qDebug() << "[PCManager] Error from relay:" << error;
+        emit connectionFailed(error);
+    }
+}
+
+void PCManager::publishList() {
+    emit clearPCList();
+    for (auto it = m_pcs.constBegin(); it != m_pcs.constEnd(); ++it) {
+        emit addPCToList(it.key(), it.value().hostname, it.value().username, true);
+    }
+    emit pcListUpdated(m_pcs.keys());
+    qDebug() << "[PCManager] PC list updated with" << m_pcs.size() << "PCs";
 }
 
 void PCManager::onDisconnected() {
     qDebug() << "[PCManager] Disconnected from relay server";
+    m_subscribed = false;
+    m_reconnectTimer->start();
 }
 
 void PCManager::onError(QAbstractSocket::SocketError error) {
     qDebug() << "[PCManager] Socket error:" << m_socket->errorString();
-    emit connectionFailed(m_socket->errorString());
-}
\ No newline at end of file
+    
+    // A failed query is reported once; a dropped subscription and the
+    // retries after it carry on quietly
+    if (!m_subscribed && !m_retrying) {
+        emit connectionFailed(m_socket->errorString());
+    }
+    m_subscribed = false;
+    m_reconnectTimer->start();
+}
@@ -4,7 +4,16 @@
 #include <QObject>
 #include <QString>
 #include <QTcpSocket>
+#include <QTimer>
+#include <QMap>
+#include <QStringList>
+#include "wire_frame.h"
 
+// PC list for the mobile. Instead of polling GET_PCS over a new
+// connection each time, it keeps one SUBSCRIBE_PCS connection to the relay
+// for the logged-in user (plus the PCs paired by QR code): the relay sends
+// the current list once and then pushes PCs coming online or going away.
+// The subscription is re-established after the connection drops.
 class PCManager : public QObject {
     Q_OBJECT
     Q_PROPERTY(QString connectedPcId READ connectedPcId NOTIFY connectedPcIdChanged)
@@ -14,6 +23,7 @@ public:
     explicit PCManager(QObject *parent = nullptr);
     ~PCManager();
     
+    Q_INVOKABLE void setUsername(const QString &username);
     Q_INVOKABLE void queryPCList(const QString &relayServerAddress, int port = 2810);
     Q_INVOKABLE void connectToPC(const QString &pcId, const QString &relayServerAddress);
     Q_INVOKABLE void disconnectFromPC();
@@ -29,15 +39,36 @@ signals:
     void isConnectedChanged();
     void clearPCList();
     void addPCToList(const QString &pcId, const QString &hostname, const QString &username, bool isOnline);
+    void pcOnline(const QString &pcId, const QString &hostname, const QString &username);
+    void pcOffline(const QString &pcId);
 
 private slots:
     void onConnected();
     void onReadyRead();
     void onDisconnected();
     void onError(QAbstractSocket::SocketError error);
+    void onReconnect();
 
 private:
+    struct ListedPC {
+        QString hostname;
+        QString username;
+    };
+    
+    void subscribe();
+    void processFrame(const RemoteAccessSystem::Wire::FrameView &frame);
+    void publishList();
+    
     QTcpSocket *m_socket;
+    RemoteAccessSystem::Wire::Reader m_reader;
+    QTimer *m_reconnectTimer;
+    QString m_relayAddress;
+    int m_relayPort;
+    QString m_username;
+    QStringList m_paired;
+    bool m_subscribed;              // current list received on this connection
+    bool m_retrying;                // reconnecting on our own, not asked to
+    QMap<QString, ListedPC> m_pcs;  // online PCs by id
     QString m_connectedPcId;
     bool m_isConnected;
     QString m_currentPcId;
@@ -2,7 +2,11 @@
 #include <QDebug>
 
 RemoteControlClient::RemoteControlClient(QObject *parent)
-    : QObject(parent), m_socket(new QTcpSocket(this)), m_connected(false) {
+    : QObject(parent), m_socket(new QTcpSocket(this)), m_connected(false),
+      m_frameBytesPending(0), m_frameSequence(0), m_relayPort(0),
+      m_inputSocket(new QTcpSocket(this)), m_inputReady(false), m_inputSequence(0) {
+    
+    m_inputClock.start();
     
     connect(m_socket, &QTcpSocket::connected, this, [this]() {
         qDebug() << "[RemoteControlClient] Connected to PC";
@@ -13,11 +17,26 @@ RemoteControlClient::RemoteControlClient(QObject *parent)
     connect(m_socket, &QTcpSocket::disconnected, this, [this]() {
         qDebug() << "[RemoteControlClient] Disconnected from PC";
         m_connected = false;
+        m_buffer.clear();
+        m_frameBytesPending = 0;
         emit disconnected();
     });
     
     connect(m_socket, &QTcpSocket::readyRead, this, &RemoteControlClient::handleData);
     
+    connect(m_inputSocket, &QTcpSocket::connected, this, [this]() {
+        m_inputSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        m_inputSocket->write(QString("INPUT_CHANNEL|%1\n").arg(m_pcId).toUtf8());
+    });
+    
+    connect(m_inputSocket, &QTcpSocket::readyRead, this, &RemoteControlClient::handleInputData);
+    
+    connect(m_inputSocket, &QTcpSocket::disconnected, this, [this]() {
+        // Input falls back to the text commands on the control socket
+        m_inputReady = false;
+        m_inputBuffer.clear();
+    });
+    
     connect(m_socket, QOverload<QAbstractSocket::SocketError>::of(&QTcpSocket::errorOccurred),
             this, [this](QAbstractSocket::SocketError socketError) {
         qDebug() << "[RemoteControlClient] Socket error:" << m_socket->errorString();
@@ -38,6 +57,11 @@ void RemoteControlClient::connectToPC(const QString &pcId, const QString &relayS
         m_socket->write(request.toUtf8());
         m_socket->flush();
         qDebug() << "[RemoteControlClient] Sent connection request:" << request.trimmed();
+        
+        m_pcId = pcId;
+        m_relayServer = relayServer;
+        m_relayPort = relayPort;
+        openInputChannel();
     } else {
         qDebug() << "[RemoteControlClient] Failed to connect to relay server";
         emit error("Failed to connect to relay server");
@@ -50,41 +74,146 @@ void RemoteControlClient::disconnect() {
         m_socket->flush();
         m_socket->disconnectFromHost();
     }
+    m_inputSocket->abort();
+    m_inputReady = false;
 }
 
 void RemoteControlClient::sendMouseMove(int x, int y) {
     if (!m_connected) return;
+    if (sendInputFrame(RemoteAccessSystem::InputFrame::MOVE, 0, x, y)) return;
+    
     QString cmd = QString("MOUSE_MOVE|%1|%2\n").arg(x).arg(y);
     m_socket->write(cmd.toUtf8());
 }
 
 void RemoteControlClient::sendMouseClick(int button) {
     if (!m_connected) return;
+    if (sendInputFrame(RemoteAccessSystem::InputFrame::BUTTON_DOWN, button, 0, 0) &&
+        sendInputFrame(RemoteAccessSystem::InputFrame::BUTTON_UP, button, 0, 0)) return;
+    
     QString cmd = QString("MOUSE_CLICK|%1\n").arg(button);
     m_socket->write(cmd.toUtf8());
 }
 
 void RemoteControlClient::sendKeyPress(int key) {
     if (!m_connected) return;
+    if (sendInputFrame(RemoteAccessSystem::InputFrame::KEY_DOWN, 0, 0, 0, key) &&
+        sendInputFrame(RemoteAccessSystem::InputFrame::KEY_UP, 0, 0, 0, key)) return;
+    
     QString cmd = QString("KEY_PRESS|%1\n").arg(key);
     m_socket->write(cmd.toUtf8());
 }
 
+void RemoteControlClient::sendScroll(int steps) {
+    if (!m_connected || steps == 0) return;
+    sendInputFrame(RemoteAccessSystem::InputFrame::SCROLL, 0, 0, steps);
+}
+
+QString RemoteControlClient::inputLatencySummary() const {
+    return QString::fromStdString(m_inputLatency.summary());
+}
+
+void RemoteControlClient::openInputChannel() {
+    m_inputReady = false;
+    m_inputBuffer.clear();
+    m_inputSocket->abort();
+    m_inputSocket->connectToHost(m_relayServer, m_relayPort);
+}
+
+bool RemoteControlClient::sendInputFrame(uint8_t type, uint8_t button, int x, int y, uint32_t value) {
+    if (!m_inputReady) return false;
+    
+    RemoteAccessSystem::InputFrame frame;
+    frame.type = type;
+    frame.button = button;
+    frame.sequence = ++m_inputSequence;
+    frame.timestampUs = static_cast<uint32_t>(m_inputClock.nsecsElapsed() / 1000);
+    frame.x = static_cast<int16_t>(x);
+    frame.y = static_cast<int16_t>(y);
+    frame.value = value;
+    
+    char encoded[RemoteAccessSystem::InputFrame::kSize];
+    frame.encode(reinterpret_cast<uint8_t*>(encoded));
+    return m_inputSocket->write(encoded, sizeof(encoded)) == sizeof(encoded);
+}
+
+void RemoteControlClient::handleInputData() {
+    m_inputBuffer.append(m_inputSocket->readAll());
+    
+    if (!m_inputReady) {
+        int newline = m_inputBuffer.indexOf('\n');
+        if (newline < 0) return;
+        
+        QByteArray reply = m_inputBuffer.left(newline).trimmed();
+        m_inputBuffer.remove(0, newline + 1);
+        if (reply != "INPUT_READY") {
+            qDebug() << "[RemoteControlClient] Input channel refused:" << reply;
+            m_inputSocket->abort();
+            return;
+        }
+        m_inputReady = true;
+        qDebug() << "[RemoteControlClient] Low-latency input channel ready";
+    }
+    
+    const int frameSize = static_cast<int>(RemoteAccessSystem::InputFrame::kSize);
+    uint32_t now = static_cast<uint32_t>(m_inputClock.nsecsElapsed() / 1000);
+    
+    int offset = 0;
+    while (m_inputBuffer.size() - offset >= frameSize) {
+        RemoteAccessSystem::InputFrame ack;
+        if (ack.decode(reinterpret_cast<const uint8_t*>(m_inputBuffer.constData()) + offset) &&
+            ack.type == RemoteAccessSystem::InputFrame::ACK) {
+            m_inputLatency.record(now - ack.timestampUs);
+        }
+        offset += frameSize;
+    }
+    m_inputBuffer.remove(0, offset);
+}
+
 void RemoteControlClient::handleData() {
-    QByteArray data = m_socket->readAll();
-    qDebug() << "[RemoteControlClient] Received:" << data.trimmed();
+    m_buffer.append(m_socket->readAll());
     
-    QString message = QString::fromUtf8(data).trimmed();
+    while (!m_buffer.isEmpty()) {
+        if (m_frameBytesPending > 0) {
+            if (m_buffer.size() < m_frameBytesPending) return;
+            
+            QByteArray frame = m_buffer.left(m_frameBytesPending);
+            m_buffer.remove(0, m_frameBytesPending);
+            m_frameBytesPending = 0;
+            
+            // Ack as soon as the frame is off the wire so the PC can pace
+            // to what this link actually delivers
+            m_socket->write(QString("FRAME_ACK|%1\n").arg(m_frameSequence).toUtf8());
+            emit frameReceived(frame);
+            continue;
+        }
+        
+        int newline = m_buffer.indexOf('\n');
+        if (newline < 0) return;
+        
+        QByteArray line = m_buffer.left(newline);
+        m_buffer.remove(0, newline + 1);
+        handleLine(line);
+    }
+}
+
+void RemoteControlClient::handleLine(const QByteArray &line) {
+    QString message = QString::fromUtf8(line).trimmed();
+    if (message.isEmpty()) return;
     
     if (message.startsWith("CONNECTION_ESTABLISHED")) {
         qDebug() << "[RemoteControlClient] Remote control session established";
         emit sessionStarted();
     } else if (message.startsWith("SCREEN_FRAME|")) {
-        // Handle screen frame data
-        emit frameReceived(data);
+        // SCREEN_FRAME|<payload bytes>|<sequence>, payload follows
+        QStringList parts = message.split('|');
+        m_frameBytesPending = parts.size() >= 2 ? parts[1].toLongLong() : 0;
+        m_frameSequence = parts.size() >= 3 ? parts[2].toULongLong() : 0;
     } else if (message.startsWith("ERROR|")) {
         QString errorMsg = message.mid(6);
         emit error(errorMsg);
+    } else {
+        qDebug() << "[RemoteControlClient] Received:" << message;
     }
 }
 
@@ -0,0 +1,26 @@
+#ifndef CAPTURED_FRAME_H
+#define CAPTURED_FRAME_H
+
+#include <cstdint>
+#include <vector>
+
+struct CaptureRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// One captured frame. `pixels` is the full 32bpp BGRX framebuffer and is
+// only valid for the duration of the frame callback.
+struct CapturedFrame {
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    const uint8_t* pixels;
+    std::vector<CaptureRect> damage;   // regions refreshed since the last frame
+    uint64_t sequence;
+    uint64_t timestampUs;
+};
+
+#endif // CAPTURED_FRAME_H
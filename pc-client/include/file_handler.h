@@ -2,9 +2,13 @@
 #define FILE_HANDLER_H
 
 #include <string>
+#include <fstream>
 #include <map>
 #include <thread>
 #include <atomic>
+#include <initializer_list>
+#include <string_view>
+#include "wire_frame.h"
 
 // Forward declarations
 namespace RemoteAccessSystem {
@@ -30,21 +34,25 @@ private:
     std::string pcId;
     std::string relayHost;
     int relayPort;
+    int relaySharePort;     // relay's share link port, 0 if it serves none
     int relaySocket;
+    RemoteAccessSystem::Wire::Reader relayReader;
     std::atomic<bool> running;
+    uint32_t replyTo;       // request id of the request being handled; replies echo it
+    RemoteAccessSystem::Wire::TraceContext replyTrace;  // its span, if the relay traced it
     std::thread handlerThread;
     std::thread heartbeatThread;
-    std::map<std::string, std::string> shareTokens;
     RemoteAccessSystem::Common::HTTPServer* httpServer_;
     FileServer* fileServer_;
 
     void run();
-    void processRequest(const std::string& request);
+    void processRequest(const RemoteAccessSystem::Wire::FrameView& request);
     
     // Command handlers
     void handleListDir(const std::string& path);
     void handleGenerateUrl(const std::string& filePath);
     void handleDownload(const std::string& filePath);
+    void handleShareDownload(const std::string& token);
     void handleUpload(const std::string& remotePath, long long fileSize);
     void handleDelete(const std::string& filePath);
     void handleRename(const std::string& oldPath, const std::string& newPath);
@@ -55,8 +63,12 @@ private:
     bool copyFile(const std::string& src, const std::string& dest);
     bool copyDirectory(const std::string& src, const std::string& dest);
     bool removeDirectory(const std::string& path);
+    size_t sendFileData(std::ifstream& file);
     
-    void sendResponse(const std::string& response);
+    void sendMessage(RemoteAccessSystem::Wire::Type type,
+                     std::initializer_list<std::string_view> fields);
+    void sendResponse(const std::string& frame);
+    const RemoteAccessSystem::Wire::TraceContext* traceForReply() const;
     std::string generateToken(size_t length);
     std::string getLocalIPAddress();
 };
@@ -4,13 +4,12 @@
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
-#include <QMap>
-#include <QDateTime>
-
-struct ShareInfo {
-    QString filePath;
-    QDateTime expiryTime;
-};
+#include <QTimer>
+#include <QHash>
+#include <QSet>
+#include <initializer_list>
+#include <string_view>
+#include "wire_frame.h"
 
 class FileServer : public QObject {
     Q_OBJECT
@@ -29,6 +28,14 @@ private slots:
     void handleClientData(QTcpSocket *client);
 
 private:
+    void handleRequest(QTcpSocket *client, const RemoteAccessSystem::Wire::FrameView &request);
+    
+    // Replies in the format the client's last request used
+    void sendMessage(QTcpSocket *client, RemoteAccessSystem::Wire::Type type,
+                     std::initializer_list<std::string_view> fields);
+    void sendFrame(QTcpSocket *client, const std::string &frame);
+    bool isBinary(QTcpSocket *client) const;
+    
     // File operations
     void listDirectory(QTcpSocket *client, const QString &path);
     void downloadFile(QTcpSocket *client, const QString &path);
@@ -46,7 +53,11 @@ private:
     // Server instances
     QTcpServer *m_server;
     QTcpServer *m_httpServer;
-    QMap<QString, ShareInfo> m_shareLinks;
+    QTimer *m_expiryTimer;  // Drives ShareTokenStore expiry
+    
+    // Per-client framing state; binary frames and legacy text lines
+    QHash<QTcpSocket*, RemoteAccessSystem::Wire::Reader> m_readers;
+    QSet<QTcpSocket*> m_uploading;  // reading file data, not requests
 };
 
 #endif // FILE_SERVER_H
\ No newline at end of file
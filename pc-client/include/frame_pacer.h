@@ -0,0 +1,72 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+struct PacingSettings {
+    int fps;
+    int quality;    // lossy encoder quality, 1-100
+    int scale;      // tile downscale factor, 1 = full resolution
+};
+
+// Congestion-aware pacing for screen frames.
+//
+// Every frame sent is recorded with its size and send time, and the mobile
+// client acknowledges each one it has received (FRAME_ACK|seq). From that
+// the pacer keeps a smoothed RTT and a delivery-rate estimate, and only
+// lets a new frame out while the bytes in flight fit in what the link can
+// deliver within the latency target. Frames that don't fit are dropped at
+// the source instead of queuing behind the relay; the tile differ carries
+// their damage into the next frame that does go out.
+//
+// Quality is adjusted before frame rate, and frame rate before resolution.
+// Recovery goes in the opposite order.
+class FramePacer {
+public:
+    explicit FramePacer(int targetLatencyMs = 100);
+
+    void reset(const PacingSettings& initial);
+
+    // Returns false if the frame should be dropped
+    bool canSend(uint64_t nowUs);
+    void onFrameSent(uint64_t sequence, size_t bytes, uint64_t nowUs);
+    void onAck(uint64_t sequence, uint64_t nowUs);
+
+    PacingSettings settings() const;
+
+    // True once since the last call if settings() changed
+    bool takeSettingsChanged();
+
+    uint64_t smoothedRttUs() const;
+    double deliveryRateBytesPerSec() const;
+
+private:
+    struct InFlight {
+        uint64_t sequence;
+        size_t bytes;
+        uint64_t sentUs;
+    };
+
+    void expireLocked(uint64_t nowUs);
+    void adaptLocked(uint64_t nowUs);
+    size_t inFlightBytesLocked() const;
+
+    mutable std::mutex m_mutex;
+    uint64_t m_targetUs;
+
+    std::deque<InFlight> m_inFlight;
+    uint64_t m_srttUs;
+    uint64_t m_minRttUs;
+    double m_deliveryRate;       // bytes/s, smoothed
+    uint64_t m_lastAckUs;
+    uint64_t m_lastAdaptUs;
+    int m_lostSinceAdapt;
+
+    PacingSettings m_settings;
+    PacingSettings m_max;
+    bool m_changed;
+};
+
+#endif // FRAME_PACER_H
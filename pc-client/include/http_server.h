@@ -46,19 +46,21 @@ private:
      * Handle incoming HTTP requests
      * Supported endpoints:
      * - GET /qr or /qr.png - Returns QR code as PNG image
+     * - GET /qr.svg - Returns QR code as SVG image
      * - GET /share/{token} - Returns shared file
      * @param client The connected client socket
      */
     void HandleRequest(ACE_SOCK_Stream& client);
-    
+
     /**
-     * Generate PNG image data for QR code
-     * @param data The data to encode in the QR code
-     * @param size The size of the QR code in pixels (default: 400)
-     * @return Vector containing PNG image bytes
+     * Send the cached QR code, or 304 Not Modified if the client's
+     * If-None-Match matches the current ETag
+     * @param client The connected client socket
+     * @param request The raw HTTP request
+     * @param svg true to send the SVG rendering instead of the PNG
      */
-    std::vector<uint8_t> GenerateQRCodePNG(const std::string& data, int size = 400);
-    
+    void SendQRResponse(ACE_SOCK_Stream& client, const std::string& request, bool svg);
+
     /**
      * Send HTTP error response
      * @param client The connected client socket
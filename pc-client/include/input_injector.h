@@ -0,0 +1,50 @@
+#ifndef INPUT_INJECTOR_H
+#define INPUT_INJECTOR_H
+
+#include <X11/Xlib.h>
+#include <cstdint>
+
+// Synthesizes pointer and keyboard input on the local X display through
+// the XTEST extension.
+//
+// Calls only queue requests; nothing reaches the X server until flush(),
+// so a whole batch of decoded client events costs one XFlush. Pointer
+// motion is coalesced: only the latest position is kept, and it is sent
+// at most once per display refresh. A button or key event first sends
+// any pending motion, so a click always lands where the pointer was moved.
+//
+// Owns its own Display connection; use from one thread only.
+class InputInjector {
+public:
+    InputInjector();
+    ~InputInjector();
+
+    bool init(const char* displayName = nullptr);
+    bool isAvailable() const { return m_display != nullptr; }
+
+    void moveTo(int x, int y);
+    void button(int button, bool pressed);
+    bool key(KeySym keysym, bool pressed);
+
+    // Sends queued requests and any motion that is due. Returns the
+    // microseconds until deferred motion should be flushed, 0 if none.
+    uint64_t flush(uint64_t nowUs);
+
+    // No RandR here, so the refresh interval defaults to 60 Hz
+    void setRefreshRate(int hz);
+
+private:
+    void sendMotion(uint64_t nowUs);
+
+    Display* m_display;
+    int m_screen;
+    uint64_t m_refreshIntervalUs;
+
+    bool m_motionPending;
+    int m_motionX;
+    int m_motionY;
+    uint64_t m_lastMotionUs;
+    bool m_dirty;             // requests queued since the last XFlush
+};
+
+#endif // INPUT_INJECTOR_H
@@ -0,0 +1,55 @@
+#ifndef QR_ASSET_CACHE_H
+#define QR_ASSET_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+/**
+ * Pre-rendered QR code for one version of the connection info.
+ * Immutable once published, so it can be sent without holding any lock.
+ */
+struct QRAsset {
+    uint64_t version;
+    std::string data;
+    std::string etag;
+    std::vector<uint8_t> png;
+    std::string svg;
+};
+
+class QRAssetCache {
+public:
+    explicit QRAssetCache(int size = 400);
+
+    /**
+     * Render the PNG and SVG for the given connection info if it differs
+     * from the cached version, otherwise return the cached asset
+     * @param data Connection info to encode
+     * @return Current asset, or nullptr if rendering failed
+     */
+    std::shared_ptr<const QRAsset> Update(const std::string& data);
+
+    /**
+     * Get the most recently rendered asset
+     * @return Current asset, or nullptr if nothing has been rendered yet
+     */
+    std::shared_ptr<const QRAsset> Get() const;
+
+private:
+    static std::string MakeETag(const std::string& data, uint64_t version);
+
+    mutable std::mutex mutex_;
+    std::shared_ptr<const QRAsset> current_;
+    uint64_t version_;
+    int size_;
+};
+
+} // namespace Common
+} // namespace RemoteAccessSystem
+
+#endif // QR_ASSET_CACHE_H
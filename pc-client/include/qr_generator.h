@@ -3,14 +3,23 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 
 namespace RemoteAccessSystem {
 namespace Common {
 
 class QRGenerator {
 public:
+    // 1-bit palette PNG with a 2-module quiet zone
     static std::vector<uint8_t> GeneratePNG(const std::string& data, int size = 300);
     static std::string GenerateSVG(const std::string& data, int size = 300);
+
+    /**
+     * Encode the data once and render both the PNG and the SVG from it
+     * @return false if the QR code could not be generated
+     */
+    static bool GenerateAssets(const std::string& data, int size,
+                               std::vector<uint8_t>& png, std::string& svg);
 };
 
 } // namespace Common
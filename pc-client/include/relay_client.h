@@ -4,6 +4,9 @@
 #include <ace/SOCK_Stream.h>
 #include <ace/SOCK_Connector.h>
 #include "../../common/include/crypto.h"
+#include "../../common/include/record_layer.h"
+#include "../../common/include/key_exchange.h"
+#include <memory>
 #include <string>
 #include <vector>
 #include <cstdint>
@@ -38,7 +41,8 @@ public:
     RelayClient();
     ~RelayClient();
 
-    // Connect to the relay server
+    // Connect to the relay server and agree on session keys; a reconnect
+    // from the same instance resumes with the ticket from last time
     bool Connect(const std::string& relay_address);
 
     // Register PC with the relay server
@@ -53,9 +57,14 @@ public:
 
 private:
     ACE_SOCK_Stream socket_;
-    Crypto crypto_;
-    std::vector<unsigned char> key_;
-    std::vector<unsigned char> iv_;
+    std::unique_ptr<RecordLayer> records_;  // set once the handshake is done
+    SessionTicket ticket_;
+    
+    bool Handshake();
+    bool SendFrame(const std::vector<unsigned char>& data);
+    bool ReceiveFrame(std::vector<unsigned char>& data);
+    std::vector<unsigned char> send_buffer_;
+    std::vector<unsigned char> recv_buffer_;
     
     // File operation handlers
     bool HandleDownload(const std::string& file_path, Message& response);
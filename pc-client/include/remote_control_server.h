@@ -4,20 +4,79 @@
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QPointer>
+#include <QHash>
+#include <QTimer>
+#include "screen_capture.h"
+#include "tile_differ.h"
+#include "tile_encoder.h"
+#include "frame_pacer.h"
+#include "input_injector.h"
+#include "input_frame.h"
+#include "latency_histogram.h"
 
 class RemoteControlServer : public QObject {
     Q_OBJECT
 
 public:
     explicit RemoteControlServer(QObject *parent = nullptr);
+    ~RemoteControlServer();
     bool start(int port = 2812);
+    
+    // Makes this PC reachable for remote control through the relay: parks
+    // an outbound control socket (CONTROL_REGISTER) and opens the binary
+    // input channel (INPUT_REGISTER)
+    void connectToRelay(const QString &relayServer, int relayPort, const QString &pcId);
+    
+    // One-way input delay above the best observed path, sender to injection
+    QString inputLatencySummary() const;
 
 private slots:
     void handleNewConnection();
     void handleClientCommand(QTcpSocket *client);
 
 private:
+    void attachClient(QTcpSocket *client);
+    void handleLine(QTcpSocket *client, const QByteArray &line);
+    
+    // Relay control session
+    void parkControlSocket();
+    void connectInputChannel();
+    void flushInput();
+    
+    // Binary input channel
+    void handleInputData();
+    void applyInputFrame(const RemoteAccessSystem::InputFrame &frame);
+    void recordInputLatency(uint32_t senderTimestampUs, uint64_t injectedUs);
+    
+    // Screen sharing
+    void startScreenShare(QTcpSocket *client, int fps);
+    void stopScreenShare();
+    void sendFrame(const CapturedFrame &frame);
+
     QTcpServer *m_server;
+    QHash<QTcpSocket*, QByteArray> m_buffers;   // partial lines per client
+    InputInjector m_injector;
+    QTimer *m_motionTimer;                      // flushes deferred motion
+    
+    QString m_relayServer;
+    int m_relayPort;
+    QString m_pcId;
+    QPointer<QTcpSocket> m_parkedSocket;        // waiting for CONTROL_SESSION
+    QTimer *m_parkRetryTimer;
+    
+    QTcpSocket *m_inputSocket;
+    QTimer *m_inputRetryTimer;
+    QByteArray m_inputBuffer;
+    RemoteAccessSystem::LatencyHistogram m_inputLatency;
+    bool m_haveInputBaseline;
+    uint32_t m_inputBaseline;                   // min (receive - send), mod 2^32
+    uint64_t m_inputSamplesLogged;
+    ScreenCapture m_capture;
+    TileDiffer m_differ;        // Capture thread only
+    TileEncoder m_encoder;
+    FramePacer m_pacer;
+    QPointer<QTcpSocket> m_screenClient;
 };
 
 #endif // REMOTE_CONTROL_SERVER_H
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef SCREEN_CAPTURE_H
+#define SCREEN_CAPTURE_H
+
+#include "captured_frame.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Screen capture engine for the remote-control pipeline.
+//
+// Pixels are read with XShmGetImage into one shared-memory segment that is
+// allocated once for the whole screen and reused. When the XDamage
+// extension is available only damaged rectangles are fetched from the X
+// server and frames with no damage are skipped entirely; otherwise every
+// tick grabs the full screen.
+//
+// The engine owns its own Display connection and runs on its own thread.
+// Set DISPLAY (e.g. an Xvfb instance) to choose the screen.
+class ScreenCapture {
+public:
+    using FrameCallback = std::function<void(const CapturedFrame&)>;
+
+    ScreenCapture();
+    ~ScreenCapture();
+
+    bool init(const char* displayName = nullptr);
+    bool start(int fps, FrameCallback callback);
+    void stop();
+
+    void setFrameRate(int fps);
+    int frameRate() const { return m_fps.load(); }
+    bool isRunning() const { return m_running.load(); }
+    bool hasDamage() const { return m_damageAvailable; }
+
+    // Grabs the full screen synchronously (also used for the first frame)
+    bool captureFull(CapturedFrame& frame);
+
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+
+private:
+    void run();
+    bool grabRect(const CaptureRect& rect);
+    bool collectDamage(std::vector<CaptureRect>& rects);
+    void fillFrame(CapturedFrame& frame, std::vector<CaptureRect>&& damage);
+    void cleanup();
+
+    Display* m_display;
+    Window m_root;
+    uint32_t m_width;
+    uint32_t m_height;
+
+    XImage* m_image;
+    XShmSegmentInfo m_shmInfo;
+    bool m_shmAttached;
+
+    bool m_damageAvailable;
+    int m_damageEventBase;
+    Damage m_damage;
+
+    std::vector<uint8_t> m_framebuffer;
+    uint64_t m_sequence;
+
+    std::mutex m_captureMutex;
+    std::atomic<bool> m_running;
+    std::atomic<int> m_fps;
+    FrameCallback m_callback;
+    std::thread m_thread;
+};
+
+#endif // SCREEN_CAPTURE_H
@@ -0,0 +1,123 @@
+#ifndef SHARE_TOKEN_STORE_H
+#define SHARE_TOKEN_STORE_H
+
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+/**
+ * Process-wide store of file share tokens, used by FileHandler, FileServer
+ * and HTTPServer.
+ *
+ * Lookups go through a hash map. Expiry is driven by a hashed timing wheel
+ * that is advanced on every call (and by Expire()), so expired tokens are
+ * reaped without scanning the whole table. An expired token is kept as a
+ * tombstone for kTombstoneSeconds after its expiry, so its link reports
+ * Expired (410) rather than NotFound (404); after that it is forgotten.
+ * Every insert/remove is appended to a log file that is replayed, and
+ * compacted, on Open().
+ *
+ * Log records, one per line:
+ *   S|token|expiry_unix|file_path   path with '\\' and '\n' escaped
+ *   A|token|expiry_unix|file_path   unescaped, from older logs (read only)
+ *   D|token
+ */
+class ShareTokenStore {
+public:
+    enum class LookupResult {
+        Found,
+        NotFound,
+        Expired
+    };
+
+    static ShareTokenStore& Instance();
+
+    /**
+     * Load tokens from the log file and keep it open for appends
+     * @param log_path Path to the append-only token log
+     * @return true if the log is open for writing
+     */
+    bool Open(const std::string& log_path);
+
+    /**
+     * Add or replace a share token
+     * @param token Unique token for accessing the file
+     * @param file_path Full path to the shared file
+     * @param ttl_seconds Lifetime of the token
+     */
+    void Add(const std::string& token, const std::string& file_path,
+             int64_t ttl_seconds = 24 * 3600);
+
+    /**
+     * Resolve a share token to its file path
+     * @param token Token taken from the share URL
+     * @param file_path Set to the shared file path when Found
+     * @param expiry If given, set to the token's expiry (unix time) when Found
+     * @return Expired for a token that expired less than kTombstoneSeconds
+     *         ago, NotFound for one never issued, removed or long gone
+     */
+    LookupResult Lookup(const std::string& token, std::string& file_path,
+                        int64_t* expiry = nullptr);
+
+    bool Remove(const std::string& token);
+
+    /**
+     * Reap every token whose expiry has passed
+     * @return Number of tokens that expired
+     */
+    size_t Expire();
+
+    // Live tokens, not counting tombstones
+    size_t Size() const;
+
+    static const int64_t kTombstoneSeconds = 7 * 24 * 3600;
+
+private:
+    ShareTokenStore();
+    ShareTokenStore(const ShareTokenStore&) = delete;
+    ShareTokenStore& operator=(const ShareTokenStore&) = delete;
+
+    struct Entry {
+        std::string file_path;
+        int64_t expiry;
+        bool expired;       // tombstone, kept until expiry + kTombstoneSeconds
+    };
+
+    static int64_t DueTime(const Entry& entry);
+    static std::string EscapePath(const std::string& path);
+    static std::string UnescapePath(const std::string& path);
+
+    // 1024 slots of 60 seconds; longer lifetimes wrap around and are
+    // re-checked against their expiry when the slot comes round again
+    static const int64_t kTickSeconds = 60;
+    static const size_t kWheelSlots = 1024;
+
+    size_t SlotFor(int64_t due) const;
+    void Schedule(const std::string& token, int64_t due);
+    void ExpireLocked(const std::string& token, Entry& entry);
+    size_t AdvanceLocked(int64_t now);
+    void AppendLocked(const std::string& record);
+    void CompactLocked();
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> tokens_;     // live tokens and tombstones
+    size_t tombstones_;
+    std::vector<std::vector<std::string>> wheel_;
+    int64_t current_tick_;
+
+    std::string log_path_;
+    std::ofstream log_;
+    size_t log_records_;
+};
+
+} // namespace Common
+} // namespace RemoteAccessSystem
+
+#endif // SHARE_TOKEN_STORE_H
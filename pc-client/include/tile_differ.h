@@ -0,0 +1,47 @@
+#ifndef TILE_DIFFER_H
+#define TILE_DIFFER_H
+
+#include "captured_frame.h"
+#include <cstdint>
+#include <vector>
+
+// Splits captured frames into 64x64 tiles and finds the ones that differ
+// from the last frame that was actually sent.
+//
+// Only tiles touched by reported damage are compared, and damage keeps
+// accumulating across frames that the caller skipped, so nothing is lost
+// when frames are dropped. Tile compares use the widest SIMD kernel the CPU
+// supports (AVX2, SSE4.1, or memcmp), chosen once at startup.
+class TileDiffer {
+public:
+    static const int kTileSize = 64;
+
+    TileDiffer();
+
+    // Marks the tiles covered by these rectangles as candidates
+    void addDamage(const std::vector<CaptureRect>& damage);
+
+    // Compares candidate tiles against the reference frame, appends the
+    // ones that changed to `dirty`, and copies them into the reference.
+    // The first frame, and any frame after reset() or a change of
+    // resolution or stride, reports every tile.
+    void diff(const CapturedFrame& frame, std::vector<CaptureRect>& dirty);
+
+    void reset();
+
+    static const char* kernelName();
+
+private:
+    void resize(uint32_t width, uint32_t height, uint32_t stride);
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_stride;          // row pitch of the frame and the reference
+    int m_tilesX;
+    int m_tilesY;
+    bool m_keyFrame;
+    std::vector<uint8_t> m_reference;
+    std::vector<uint8_t> m_candidates;
+};
+
+#endif // TILE_DIFFER_H
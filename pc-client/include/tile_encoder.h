@@ -0,0 +1,93 @@
+#ifndef TILE_ENCODER_H
+#define TILE_ENCODER_H
+
+#include "screen_capture.h"
+#include "protocol.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tile formats carried in ScreenTile::format (extends ScreenFrame::format)
+enum TileFormat : uint8_t {
+    TILE_FORMAT_RGB = 0,
+    TILE_FORMAT_JPEG = 1,
+    TILE_FORMAT_PNG = 2,
+    TILE_FORMAT_QOI = 3,
+    TILE_FORMAT_WEBP = 4
+};
+
+// One codec instance is owned by each worker thread, so implementations
+// can keep their compressor state between tiles without locking.
+class TileCodec {
+public:
+    virtual ~TileCodec() {}
+    virtual TileFormat format() const = 0;
+    virtual bool encode(const uint8_t* bgrx, size_t stride, int width, int height,
+                        int quality, std::vector<uint8_t>& out) = 0;
+};
+
+struct EncoderSettings {
+    int quality;            // lossy quality, 1-100
+    bool allowLossless;     // use QOI for low-colour (text/UI) tiles
+    bool preferWebp;        // use WebP instead of JPEG when built with it
+    int scale;              // downscale tiles by this factor before encoding
+};
+
+// Encodes the dirty tiles of a frame in parallel.
+//
+// Each tile picks its own codec: tiles with few distinct colours (text,
+// UI chrome) go through the lossless QOI path, which is both sharper and
+// usually smaller for them; everything else goes through libjpeg-turbo
+// (or WebP). Settings can be changed between frames, e.g. by the frame
+// pacer reacting to bandwidth. Downscaled tiles keep their on-screen
+// rectangle; the receiver stretches the decoded image back over it.
+class TileEncoder {
+public:
+    explicit TileEncoder(int threads = 0);
+    ~TileEncoder();
+
+    void setSettings(const EncoderSettings& settings);
+    EncoderSettings settings() const;
+
+    // Blocks until every tile is encoded; tiles[i] corresponds to rects[i]
+    void encode(const CapturedFrame& frame, const std::vector<CaptureRect>& rects,
+                std::vector<RemoteAccessSystem::ScreenTile>& tiles);
+
+    static bool hasWebp();
+
+private:
+    struct Worker {
+        std::unique_ptr<TileCodec> jpeg;
+        std::unique_ptr<TileCodec> qoi;
+        std::unique_ptr<TileCodec> webp;
+        std::vector<uint8_t> scaled;
+        std::thread thread;
+    };
+
+    void workerLoop(Worker* worker);
+    void encodeTile(Worker* worker, size_t index);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_workReady;
+    std::condition_variable m_workDone;
+    bool m_stopping;
+    uint64_t m_generation;
+    size_t m_busyWorkers;
+
+    // Current job, valid while m_busyWorkers > 0
+    const CapturedFrame* m_frame;
+    const std::vector<CaptureRect>* m_rects;
+    std::vector<RemoteAccessSystem::ScreenTile>* m_tiles;
+    EncoderSettings m_jobSettings;
+    std::atomic<size_t> m_nextTile;
+
+    EncoderSettings m_settings;
+};
+
+#endif // TILE_ENCODER_H
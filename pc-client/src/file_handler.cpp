@@ -1,9 +1,12 @@
 #include "file_handler.h"
 #include "http_server.h"
 #include "file_server.h"
-#include <iostream>
+#include "share_token_store.h"
+#include "async_log.h"
+#include "trace.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/ip.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
@@ -20,12 +23,16 @@
 #include <net/if.h>
 #include <sys/types.h>
 
+namespace Wire = RemoteAccessSystem::Wire;
+namespace Trace = RemoteAccessSystem::Trace;
+
 FileHandler::FileHandler(const std::string& pcId, 
                          RemoteAccessSystem::Common::HTTPServer* httpServer,
                          FileServer* fileServer)
-    : pcId(pcId), relaySocket(-1), running(false), 
+    : pcId(pcId), relaySharePort(0), relaySocket(-1), running(false), replyTo(0),
       httpServer_(httpServer), fileServer_(fileServer)
 {
+    Trace::Exporter::instance().setService("pc-client");
 }
 
 FileHandler::~FileHandler()
@@ -35,11 +42,9 @@ FileHandler::~FileHandler()
 
 std::string FileHandler::getFilePath(const std::string& token)
 {
-    auto it = shareTokens.find(token);
-    if (it != shareTokens.end()) {
-        return it->second;
-    }
-    return "";
+    std::string filePath;
+    RemoteAccessSystem::Common::ShareTokenStore::Instance().Lookup(token, filePath);
+    return filePath;
 }
 
 std::string FileHandler::getLocalIPAddress()
@@ -49,7 +54,7 @@ std::string FileHandler::getLocalIPAddress()
     std::string result = "localhost";
     
     if (getifaddrs(&ifaddr) == -1) {
-        std::cerr << "[FileHandler] getifaddrs failed" << std::endl;
+        LOG_ERROR("FileHandler", "getifaddrs failed", {"error", strerror(errno)});
         return result;
     }
     
@@ -81,7 +86,7 @@ std::string FileHandler::getLocalIPAddress()
                 ip.substr(0, 3) == "10." || 
                 ip.substr(0, 4) == "172.") {
                 result = ip;
-                std::cout << "[FileHandler] Using local IP: " << ip << std::endl;
+                LOG_INFO("FileHandler", "Using local IP", {"ip", ip});
                 freeifaddrs(ifaddr);
                 return result;
             }
@@ -96,9 +101,9 @@ std::string FileHandler::getLocalIPAddress()
     freeifaddrs(ifaddr);
     
     if (result != "localhost") {
-        std::cout << "[FileHandler] Using fallback IP: " << result << std::endl;
+        LOG_INFO("FileHandler", "Using fallback IP", {"ip", result});
     } else {
-        std::cout << "[FileHandler] WARNING: Could not find local IP, using localhost" << std::endl;
+        LOG_WARN("FileHandler", "Could not find local IP, using localhost");
     }
     
     return result;
@@ -111,7 +116,7 @@ int FileHandler::connect_to_relay(const std::string& host, int port)
     
     relaySocket = socket(AF_INET, SOCK_STREAM, 0);
     if (relaySocket < 0) {
-        std::cerr << "[FileHandler] Failed to create socket" << std::endl;
+        LOG_ERROR("FileHandler", "Failed to create socket", {"error", strerror(errno)});
         return -1;
     }
 
@@ -119,6 +124,11 @@ int FileHandler::connect_to_relay(const std::string& host, int port)
     int keepalive = 1;
     setsockopt(relaySocket, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(keepalive));
     
+    // File data is bulk traffic; remote-control sockets are marked low
+    // delay so screen frames and input go out ahead of it
+    int tos = IPTOS_THROUGHPUT;
+    setsockopt(relaySocket, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    
     struct timeval timeout;
     timeout.tv_sec = 30;
     timeout.tv_usec = 0;
@@ -130,44 +140,54 @@ int FileHandler::connect_to_relay(const std::string& host, int port)
     serverAddr.sin_port = htons(port);
     
     if (inet_pton(AF_INET, host.c_str(), &serverAddr.sin_addr) <= 0) {
-        std::cerr << "[FileHandler] Invalid address" << std::endl;
+        LOG_ERROR("FileHandler", "Invalid address", {"host", host});
         close(relaySocket);
         relaySocket = -1;
         return -1;
     }
 
     if (connect(relaySocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        std::cerr << "[FileHandler] Connection failed" << std::endl;
+        LOG_ERROR("FileHandler", "Connection failed", {"error", strerror(errno)});
         close(relaySocket);
         relaySocket = -1;
         return -1;
     }
 
-    std::cout << "[FileHandler] Connected to relay server" << std::endl;
+    LOG_INFO("FileHandler", "Connected to relay server");
     
-    // Send correct registration command that matches relay_server.cpp
-    std::string registration = "FILE_HANDLER_REGISTER|" + pcId + "\n";
-    send(relaySocket, registration.c_str(), registration.length(), 0);
-    std::cout << "[FileHandler] Sent registration: " << registration << std::endl;
+    // Register in the binary frame format; the relay answers in kind.
+    // TRACE: requests may come traced, and their replies go back traced
+    relayReader = Wire::Reader();
+    sendMessage(Wire::Type::FILE_HANDLER_REGISTER, {pcId, "TRACE"});
+    LOG_INFO("FileHandler", "Sent registration", {"pc_id", pcId});
     
     // Wait for registration confirmation
     char response[256];
-    memset(response, 0, sizeof(response));
-    int bytesRead = recv(relaySocket, response, sizeof(response) - 1, 0);
-    if (bytesRead > 0) {
-        std::string resp(response, bytesRead);
-        std::cout << "[FileHandler] Registration response: " << resp << std::endl;
+    Wire::FrameView reply;
+    Wire::Reader::Result result = Wire::Reader::NEED_MORE;
+    while (result == Wire::Reader::NEED_MORE) {
+        int bytesRead = recv(relaySocket, response, sizeof(response), 0);
+        if (bytesRead <= 0) break;
+        relayReader.append(response, bytesRead);
+        result = relayReader.next(reply);
+    }
+    
+    if (result == Wire::Reader::FRAME) {
+        LOG_DEBUG("FileHandler", "Registration response", {"type", Wire::typeName(reply.type())},
+                  {"detail", reply.field(0)});
         
-        if (resp.find("OK|FILE_HANDLER_REGISTERED") != std::string::npos) {
-            std::cout << "[FileHandler] ✅ File handler registered successfully!" << std::endl;
-        } else if (resp.find("ERROR") != std::string::npos) {
-            std::cerr << "[FileHandler] ❌ Registration failed: " << resp << std::endl;
+        // Relays that serve share links add the port they serve them on
+        if (reply.type() == Wire::Type::OK && reply.field(0) == "FILE_HANDLER_REGISTERED") {
+            relaySharePort = reply.fieldCount() >= 2 ? static_cast<int>(reply.fieldU64(1)) : 0;
+            LOG_INFO("FileHandler", "File handler registered", {"share_port", relaySharePort});
+        } else if (reply.type() == Wire::Type::ERROR) {
+            LOG_ERROR("FileHandler", "Registration failed", {"error", reply.field(0)});
             close(relaySocket);
             relaySocket = -1;
             return -1;
         }
     } else {
-        std::cerr << "[FileHandler] No response from relay server" << std::endl;
+        LOG_ERROR("FileHandler", "No response from relay server");
     }
     
     // Start handler thread
@@ -179,9 +199,10 @@ int FileHandler::connect_to_relay(const std::string& host, int port)
         while (running && relaySocket >= 0) {
             std::this_thread::sleep_for(std::chrono::seconds(30));
             if (relaySocket >= 0) {
-                std::string heartbeat = "HEARTBEAT|" + pcId + "\n";
-                send(relaySocket, heartbeat.c_str(), heartbeat.length(), 0);
-                std::cout << "[FileHandler] Heartbeat sent" << std::endl;
+                std::string heartbeat;
+                Wire::appendMessage(heartbeat, true, Wire::Type::HEARTBEAT, {pcId});
+                sendResponse(heartbeat);
+                LOG_DEBUG("FileHandler", "Heartbeat sent");
             }
         }
     });
@@ -204,22 +225,38 @@ void FileHandler::shutdown()
     }
 }
 
-void FileHandler::sendResponse(const std::string& response)
+void FileHandler::sendMessage(Wire::Type type, std::initializer_list<std::string_view> fields)
+{
+    std::string frame;
+    Wire::appendMessage(frame, true, type, fields, replyTo, traceForReply());
+    sendResponse(frame);
+}
+
+const Wire::TraceContext* FileHandler::traceForReply() const
+{
+    return replyTrace.valid() ? &replyTrace : nullptr;
+}
+
+void FileHandler::sendResponse(const std::string& frame)
 {
     if (relaySocket < 0) {
-        std::cerr << "[FileHandler] Cannot send response: socket not connected" << std::endl;
+        LOG_WARN("FileHandler", "Cannot send response: socket not connected");
         return;
     }
     
-    ssize_t bytesSent = send(relaySocket, response.c_str(), response.length(), 0);
-    if (bytesSent < 0) {
-        std::cerr << "[FileHandler] Failed to send response: " << strerror(errno) << std::endl;
-    } else if (static_cast<size_t>(bytesSent) < response.length()) {
-        std::cerr << "[FileHandler] Partial send: " << bytesSent << "/" << response.length() << " bytes" << std::endl;
-    } else {
-        std::cout << "[FileHandler] Sent response: " << response.substr(0, 50) 
-                  << (response.length() > 50 ? "..." : "") << std::endl;
+    // A short send would leave the relay mid-frame, so finish it
+    size_t totalSent = 0;
+    while (totalSent < frame.length()) {
+        ssize_t bytesSent = send(relaySocket, frame.data() + totalSent, frame.length() - totalSent, MSG_NOSIGNAL);
+        if (bytesSent <= 0) {
+            LOG_WARN("FileHandler", "Failed to send response", {"error", strerror(errno)});
+            return;
+        }
+        totalSent += bytesSent;
     }
+    
+    LOG_DEBUG("FileHandler", "Sent response", {"type", Wire::typeName(Wire::FrameView(frame.data()).type())},
+              {"bytes", frame.length()});
 }
 
 std::string FileHandler::generateToken(unsigned long length)
@@ -238,144 +275,156 @@ std::string FileHandler::generateToken(unsigned long length)
         token += charset[dis(gen)];
     }
     
-    std::cout << "[FileHandler] Generated token: " << token << std::endl;
+    LOG_DEBUG("FileHandler", "Generated token", {"token", token});
     return token;
 }
 
 void FileHandler::run()
 {
     char buffer[4096];
-    std::string accumulated;
 
     while (running && relaySocket >= 0) {
-        memset(buffer, 0, sizeof(buffer));
-        int bytesRead = recv(relaySocket, buffer, sizeof(buffer) - 1, 0);
+        int bytesRead = recv(relaySocket, buffer, sizeof(buffer), 0);
         
         if (bytesRead <= 0) {
             if (bytesRead == 0) {
-                std::cout << "[FileHandler] Connection closed by relay server" << std::endl;
+                LOG_INFO("FileHandler", "Connection closed by relay server");
             } else {
-                std::cerr << "[FileHandler] recv error: " << strerror(errno) << std::endl;
+                LOG_WARN("FileHandler", "recv error", {"error", strerror(errno)});
             }
             break;
         }
 
-        accumulated += std::string(buffer, bytesRead);
+        relayReader.append(buffer, bytesRead);
         
-        size_t pos;
-        while ((pos = accumulated.find('\n')) != std::string::npos) {
-            std::string request = accumulated.substr(0, pos);
-            accumulated = accumulated.substr(pos + 1);
-            
-            std::cout << "[FileHandler] Received request: " << request << std::endl;
+        Wire::FrameView request;
+        Wire::Reader::Result result;
+        while ((result = relayReader.next(request)) == Wire::Reader::FRAME) {
+            LOG_DEBUG("FileHandler", "Received request", {"type", Wire::typeName(request.type())});
             
+            // The relay matches replies to requests by this id
+            replyTo = request.requestId();
+            Trace::Span span = Trace::Span::child(std::string("FileHandler ") + Wire::typeName(request.type()),
+                                                  request.trace());
+            replyTrace = span.context();
             try {
                 processRequest(request);
             } catch (const std::exception& e) {
-                std::cerr << "[FileHandler] Exception processing request: " << e.what() << std::endl;
-                sendResponse("ERROR|Internal error processing request\n");
+                LOG_ERROR("FileHandler", "Exception processing request", {"error", e.what()});
+                sendMessage(Wire::Type::ERROR, {"Internal error processing request"});
             }
+            span.finish();
+            replyTrace = Wire::TraceContext();
+        }
+        
+        if (result == Wire::Reader::BAD_FRAME) {
+            LOG_WARN("FileHandler", "Malformed frame from relay server");
+            break;
         }
     }
 }
 
-void FileHandler::processRequest(const std::string& request)
+void FileHandler::processRequest(const Wire::FrameView& request)
 {
-    std::istringstream iss(request);
-    std::string command;
-    std::getline(iss, command, '|');
-
-    if (command == "PONG") {
-        std::cout << "[FileHandler] Received PONG from server" << std::endl;
-    }
-    else if (command == "OK") {
-        // Acknowledgment
-        std::cout << "[FileHandler] Received OK acknowledgment" << std::endl;
-    }
-    else if (command == "LIST_DIR") {
-        std::string id, path;
-        std::getline(iss, id, '|');
-        std::getline(iss, path);
-        std::cout << "[FileHandler] Processing LIST_DIR for path: " << path << std::endl;
-        handleListDir(path);
-    }
-    else if (command == "GENERATE_URL") {
-        std::string id, filePath;
-        std::getline(iss, id, '|');
-        std::getline(iss, filePath);
-        std::cout << "[FileHandler] Processing GENERATE_URL for: " << filePath << std::endl;
-        handleGenerateUrl(filePath);
-    }
-    else if (command == "DOWNLOAD") {
-        std::string id, filePath;
-        std::getline(iss, id, '|');
-        std::getline(iss, filePath);
-        std::cout << "[FileHandler] Processing DOWNLOAD for: " << filePath << std::endl;
-        handleDownload(filePath);
-    }
-    else if (command == "UPLOAD") {
-        std::string id, remotePath, sizeStr;
-        std::getline(iss, id, '|');
-        std::getline(iss, remotePath, '|');
-        std::getline(iss, sizeStr);
-        long long fileSize = std::stoll(sizeStr);
-        std::cout << "[FileHandler] Processing UPLOAD to: " << remotePath 
-                  << " size: " << fileSize << " bytes" << std::endl;
-        handleUpload(remotePath, fileSize);
-    }
-    else if (command == "DELETE") {
-        std::string id, filePath;
-        std::getline(iss, id, '|');
-        std::getline(iss, filePath);
-        std::cout << "[FileHandler] Processing DELETE for: " << filePath << std::endl;
-        handleDelete(filePath);
-    }
-    else if (command == "RENAME") {
-        std::string id, oldPath, newPath;
-        std::getline(iss, id, '|');
-        std::getline(iss, oldPath, '|');
-        std::getline(iss, newPath);
-        std::cout << "[FileHandler] Processing RENAME from: " << oldPath << " to: " << newPath << std::endl;
-        handleRename(oldPath, newPath);
-    }
-    else if (command == "COPY") {
-        std::string id, srcPath, destPath;
-        std::getline(iss, id, '|');
-        std::getline(iss, srcPath, '|');
-        std::getline(iss, destPath);
-        std::cout << "[FileHandler] Processing COPY from: " << srcPath << " to: " << destPath << std::endl;
-        handleCopy(srcPath, destPath);
-    }
-    else if (command == "CREATE_FOLDER") {
-        std::string id, folderPath;
-        std::getline(iss, id, '|');
-        std::getline(iss, folderPath);
-        std::cout << "[FileHandler] Processing CREATE_FOLDER at: " << folderPath << std::endl;
-        handleCreateFolder(folderPath);
-    }
-    else {
-        std::cout << "[FileHandler] ⚠️  Unknown command: " << command << std::endl;
-        sendResponse("ERROR|Unknown command: " + command + "\n");
+    // Requests from the relay carry the PC id first: TYPE|pc_id|args...
+    static constexpr Wire::Command<FileHandler> kCommands[] = {
+        { Wire::Type::PONG, 0, [](FileHandler&, const Wire::FrameView&) {
+            LOG_DEBUG("FileHandler", "Received PONG from server");
+        } },
+        { Wire::Type::OK, 0, [](FileHandler&, const Wire::FrameView&) {
+            // Acknowledgment
+            LOG_DEBUG("FileHandler", "Received OK acknowledgment");
+        } },
+        { Wire::Type::LIST_DIR, 2, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string path = r.fieldString(1);
+            LOG_DEBUG("FileHandler", "Processing LIST_DIR", {"path", path});
+            handler.handleListDir(path);
+        } },
+        { Wire::Type::GENERATE_URL, 2, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string filePath = r.fieldString(1);
+            LOG_DEBUG("FileHandler", "Processing GENERATE_URL", {"path", filePath});
+            handler.handleGenerateUrl(filePath);
+        } },
+        { Wire::Type::DOWNLOAD, 2, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string filePath = r.fieldString(1);
+            LOG_DEBUG("FileHandler", "Processing DOWNLOAD", {"path", filePath});
+            handler.handleDownload(filePath);
+        } },
+        { Wire::Type::SHARE_DOWNLOAD, 2, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string token = r.fieldString(1);
+            LOG_DEBUG("FileHandler", "Processing SHARE_DOWNLOAD");
+            handler.handleShareDownload(token);
+        } },
+        { Wire::Type::UPLOAD, 3, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string remotePath = r.fieldString(1);
+            long long fileSize = static_cast<long long>(r.fieldU64(2));
+            LOG_DEBUG("FileHandler", "Processing UPLOAD", {"path", remotePath}, {"bytes", fileSize});
+            handler.handleUpload(remotePath, fileSize);
+        } },
+        { Wire::Type::DELETE, 2, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string filePath = r.fieldString(1);
+            LOG_DEBUG("FileHandler", "Processing DELETE", {"path", filePath});
+            handler.handleDelete(filePath);
+        } },
+        { Wire::Type::RENAME, 3, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string oldPath = r.fieldString(1);
+            std::string newPath = r.fieldString(2);
+            LOG_DEBUG("FileHandler", "Processing RENAME", {"from", oldPath}, {"to", newPath});
+            handler.handleRename(oldPath, newPath);
+        } },
+        { Wire::Type::COPY, 3, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string srcPath = r.fieldString(1);
+            std::string destPath = r.fieldString(2);
+            LOG_DEBUG("FileHandler", "Processing COPY", {"from", srcPath}, {"to", destPath});
+            handler.handleCopy(srcPath, destPath);
+        } },
+        { Wire::Type::CREATE_FOLDER, 2, [](FileHandler& handler, const Wire::FrameView& r) {
+            std::string folderPath = r.fieldString(1);
+            LOG_DEBUG("FileHandler", "Processing CREATE_FOLDER", {"path", folderPath});
+            handler.handleCreateFolder(folderPath);
+        } }
+    };
+    static constexpr Wire::Dispatcher kDispatcher(kCommands);
+    
+    switch (kDispatcher.dispatch(*this, request)) {
+    case Wire::DispatchResult::HANDLED:
+        break;
+    case Wire::DispatchResult::MISSING_FIELDS: {
+        std::string command = Wire::typeName(request.type());
+        LOG_WARN("FileHandler", "Malformed request", {"command", command});
+        sendMessage(Wire::Type::ERROR, {"Invalid " + command + " format"});
+        break;
+    }
+    case Wire::DispatchResult::UNKNOWN_COMMAND: {
+        std::string command = request.type() == Wire::Type::UNKNOWN
+            ? request.fieldString(0) : Wire::typeName(request.type());
+        LOG_WARN("FileHandler", "Unknown command", {"command", command});
+        sendMessage(Wire::Type::ERROR, {"Unknown command: " + command});
+        break;
+    }
     }
 }
 
 void FileHandler::handleListDir(const std::string& path)
 {
-    std::cout << "[FileHandler] Listing directory: " << path << std::endl;
+    LOG_INFO("FileHandler", "Listing directory", {"path", path});
     
     DIR* dir = opendir(path.c_str());
     if (!dir) {
-        std::string errorMsg = "ERROR|Directory not found: " + path + "\n";
-        sendResponse(errorMsg);
-        std::cerr << "[FileHandler] " << errorMsg;
+        std::string errorMsg = "Directory not found: " + path;
+        sendMessage(Wire::Type::ERROR, {errorMsg});
+        LOG_WARN("FileHandler", "Listing failed", {"error", errorMsg});
         return;
     }
 
-    std::string response = "DIR_LIST|";
+    // One (name, type, size) record per entry. A directory too big for
+    // one frame is listed as far as it fits.
+    std::string response;
+    Wire::Builder list(response, Wire::Type::DIR_LIST, replyTo, Wire::FLAG_NONE, traceForReply());
     struct dirent* entry;
     int count = 0;
     
-    while ((entry = readdir(dir)) != nullptr) {
+    while (!list.overflowed() && (entry = readdir(dir)) != nullptr) {
         std::string name = entry->d_name;
         if (name == "." || name == "..") continue;
 
@@ -386,68 +435,74 @@ void FileHandler::handleListDir(const std::string& path)
             std::string type = S_ISDIR(st.st_mode) ? "dir" : "file";
             long size = S_ISREG(st.st_mode) ? st.st_size : 0;
             
-            response += name + "|" + type + "|" + std::to_string(size) + ";";
-            count++;
+            if (list.addRecord({name, type, std::to_string(size)})) {
+                count++;
+            }
         }
     }
     
     closedir(dir);
-    response += "\n";
+    list.finish();
     
     sendResponse(response);
-    std::cout << "[FileHandler] ✅ Sent directory listing with " << count << " entries" << std::endl;
+    if (list.overflowed()) {
+        LOG_WARN("FileHandler", "Directory listing truncated to one frame", {"path", path}, {"entries", count});
+    } else {
+        LOG_INFO("FileHandler", "Sent directory listing", {"entries", count});
+    }
 }
 
 void FileHandler::handleGenerateUrl(const std::string& filePath)
 {
-    std::cout << "[FileHandler] Generating share URL for: " << filePath << std::endl;
+    LOG_INFO("FileHandler", "Generating share URL", {"path", filePath});
     
     // Check if file exists
     struct stat st;
     if (stat(filePath.c_str(), &st) != 0) {
-        sendResponse("ERROR|File not found\n");
-        std::cerr << "[FileHandler] File not found: " << filePath << std::endl;
+        sendMessage(Wire::Type::ERROR, {"File not found"});
+        LOG_WARN("FileHandler", "File not found", {"path", filePath});
         return;
     }
 
     // Generate random token
     std::string token = generateToken(32);
     
-    // Add token to FileServer (not HTTPServer!)
+    // Add token to FileServer (not HTTPServer!); it lands in the shared token store
     if (fileServer_) {
         fileServer_->addShareToken(QString::fromStdString(token), 
                                    QString::fromStdString(filePath));
-        std::cout << "[FileHandler] ✅ Token added to FileServer: " << token 
-                  << " -> " << filePath << std::endl;
+        LOG_DEBUG("FileHandler", "Token added to FileServer", {"token", token}, {"path", filePath});
     } else {
-        std::cerr << "[FileHandler] ERROR: FileServer is null!" << std::endl;
-        sendResponse("ERROR|File server not available\n");
+        LOG_ERROR("FileHandler", "FileServer is null");
+        sendMessage(Wire::Type::ERROR, {"File server not available"});
         return;
     }
-    
-    // Also keep local copy for reference
-    shareTokens[token] = filePath;
 
-    // Get local IP address and FileServer port
-    std::string localIP = getLocalIPAddress();
-    int fileServerPort = fileServer_ ? fileServer_->getHttpPort() : 8082;
-    std::string shareUrl = "http://" + localIP + ":" + 
-                          std::to_string(fileServerPort) + "/share/" + token;
+    // Links go through the relay, which caches what it fetches, when it
+    // serves them; otherwise straight to this PC's FileServer
+    std::string shareUrl;
+    if (relaySharePort != 0) {
+        shareUrl = "http://" + relayHost + ":" + std::to_string(relaySharePort) +
+                   "/share/" + pcId + "/" + token;
+    } else {
+        std::string localIP = getLocalIPAddress();
+        int fileServerPort = fileServer_ ? fileServer_->getHttpPort() : 8082;
+        shareUrl = "http://" + localIP + ":" + std::to_string(fileServerPort) + "/share/" + token;
+    }
     
-    std::string response = "SHARE_URL|" + shareUrl + "\n";
-    sendResponse(response);
+    sendMessage(Wire::Type::SHARE_URL, {shareUrl});
     
-    std::cout << "[FileHandler] ✅ Generated share URL: " << shareUrl << std::endl;
+    LOG_INFO("FileHandler", "Generated share URL", {"url", shareUrl});
 }
 
 void FileHandler::handleDownload(const std::string& filePath)
 {
-    std::cout << "[FileHandler] Downloading file: " << filePath << std::endl;
+    LOG_INFO("FileHandler", "Downloading file", {"path", filePath});
     
     std::ifstream file(filePath, std::ios::binary);
     if (!file.is_open()) {
-        sendResponse("ERROR|File not found\n");
-        std::cerr << "[FileHandler] Cannot open file: " << filePath << std::endl;
+        sendMessage(Wire::Type::ERROR, {"File not found"});
+        LOG_WARN("FileHandler", "Cannot open file", {"path", filePath});
         return;
     }
 
@@ -455,54 +510,101 @@ void FileHandler::handleDownload(const std::string& filePath)
     size_t fileSize = file.tellg();
     file.seekg(0, std::ios::beg);
 
-    std::string response = "DOWNLOAD_START|" + std::to_string(fileSize) + "\n";
-    sendResponse(response);
-    std::cout << "[FileHandler] Sending file, size: " << fileSize << " bytes" << std::endl;
+    std::string sizeField = std::to_string(fileSize);
+    sendMessage(Wire::Type::DOWNLOAD_START, {sizeField});
+    LOG_INFO("FileHandler", "Sending file", {"bytes", fileSize});
+
+    size_t totalSent = sendFileData(file);
+    file.close();
+    LOG_INFO("FileHandler", "File download complete", {"bytes", totalSent});
+}
+
+// SHARE_DOWNLOAD: the relay fetching a share link's file. Answered like
+// DOWNLOAD, with the file name and the link's expiry ahead of the size so
+// the relay can name the download and knows how long it may cache it; a
+// bad link gets ERROR with the HTTP status to give (404 or 410).
+void FileHandler::handleShareDownload(const std::string& token)
+{
+    std::string filePath;
+    int64_t expiry = 0;
+    auto found = RemoteAccessSystem::Common::ShareTokenStore::Instance().Lookup(token, filePath, &expiry);
+    if (found == RemoteAccessSystem::Common::ShareTokenStore::LookupResult::Expired) {
+        sendMessage(Wire::Type::ERROR, {"Share link expired", "410"});
+        return;
+    }
+    if (found != RemoteAccessSystem::Common::ShareTokenStore::LookupResult::Found) {
+        sendMessage(Wire::Type::ERROR, {"Share link not found", "404"});
+        return;
+    }
 
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        sendMessage(Wire::Type::ERROR, {"File not found", "404"});
+        LOG_WARN("FileHandler", "Cannot open shared file", {"path", filePath});
+        return;
+    }
+
+    file.seekg(0, std::ios::end);
+    size_t fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    std::string fileName = filePath.substr(filePath.find_last_of('/') + 1);
+    std::string expiryField = std::to_string(expiry);
+    std::string sizeField = std::to_string(fileSize);
+    sendMessage(Wire::Type::DOWNLOAD_START, {fileName, expiryField, sizeField});
+    LOG_INFO("FileHandler", "Sending shared file", {"path", filePath}, {"bytes", fileSize});
+
+    size_t totalSent = sendFileData(file);
+    file.close();
+    LOG_INFO("FileHandler", "Shared file sent", {"bytes", totalSent});
+}
+
+// Raw file bytes behind a DOWNLOAD_START; returns how many went out
+size_t FileHandler::sendFileData(std::ifstream& file)
+{
     char buffer[8192];
     size_t totalSent = 0;
     while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
         ssize_t sent = send(relaySocket, buffer, file.gcount(), 0);
         if (sent <= 0) {
-            std::cerr << "[FileHandler] Send failed during download" << std::endl;
+            LOG_WARN("FileHandler", "Send failed during download");
             break;
         }
         totalSent += sent;
     }
-
-    file.close();
-    std::cout << "[FileHandler] ✅ File download complete, sent " << totalSent << " bytes" << std::endl;
+    return totalSent;
 }
 
 void FileHandler::handleUpload(const std::string& remotePath, long long fileSize)
 {
-    std::cout << "[FileHandler] Receiving upload to: " << remotePath 
-              << " size: " << fileSize << " bytes" << std::endl;
+    LOG_INFO("FileHandler", "Receiving upload", {"path", remotePath}, {"bytes", fileSize});
     
     // Send ready signal
-    std::string response = "UPLOAD_READY\n";
-    sendResponse(response);
+    sendMessage(Wire::Type::UPLOAD_READY, {});
     
     // Open file for writing
     std::ofstream outFile(remotePath, std::ios::binary);
     if (!outFile.is_open()) {
-        sendResponse("ERROR|Cannot create file\n");
-        std::cerr << "[FileHandler] Cannot create file: " << remotePath << std::endl;
+        sendMessage(Wire::Type::ERROR, {"Cannot create file"});
+        LOG_WARN("FileHandler", "Cannot create file", {"path", remotePath});
         return;
     }
     
-    // Receive file data
+    // Receive file data, starting with whatever arrived behind the request
     char buffer[8192];
-    long long received = 0;
+    std::string_view early = relayReader.pending();
+    long long received = std::min(static_cast<long long>(early.size()), fileSize);
+    outFile.write(early.data(), received);
+    relayReader.consume(received);
     
     while (received < fileSize) {
         size_t toRead = std::min((long long)sizeof(buffer), fileSize - received);
         ssize_t bytesRead = recv(relaySocket, buffer, toRead, 0);
         
         if (bytesRead <= 0) {
-            std::cerr << "[FileHandler] Connection lost during upload" << std::endl;
+            LOG_WARN("FileHandler", "Connection lost during upload");
             outFile.close();
-            sendResponse("ERROR|Upload interrupted\n");
+            sendMessage(Wire::Type::ERROR, {"Upload interrupted"});
             return;
         }
         
@@ -510,24 +612,24 @@ void FileHandler::handleUpload(const std::string& remotePath, long long fileSize
         received += bytesRead;
         
         if (received % 1048576 == 0) { // Log every 1MB
-            std::cout << "[FileHandler] Upload progress: " << received << "/" << fileSize << " bytes" << std::endl;
+            LOG_DEBUG("FileHandler", "Upload progress", {"received", received}, {"bytes", fileSize});
         }
     }
     
     outFile.close();
-    std::cout << "[FileHandler] ✅ Upload complete: " << received << " bytes received" << std::endl;
-    sendResponse("UPLOAD_COMPLETE\n");
+    LOG_INFO("FileHandler", "Upload complete", {"bytes", received});
+    sendMessage(Wire::Type::UPLOAD_COMPLETE, {});
 }
 
 void FileHandler::handleDelete(const std::string& filePath)
 {
-    std::cout << "[FileHandler] Deleting: " << filePath << std::endl;
+    LOG_INFO("FileHandler", "Deleting", {"path", filePath});
     
     struct stat st;
     if (stat(filePath.c_str(), &st) != 0) {
-        std::string errorMsg = "ERROR|File not found: " + filePath + "\n";
-        sendResponse(errorMsg);
-        std::cerr << "[FileHandler] File not found: " << filePath << std::endl;
+        std::string errorMsg = "File not found: " + filePath;
+        sendMessage(Wire::Type::ERROR, {errorMsg});
+        LOG_WARN("FileHandler", "File not found", {"path", filePath});
         return;
     }
     
@@ -535,57 +637,57 @@ void FileHandler::handleDelete(const std::string& filePath)
     if (S_ISDIR(st.st_mode)) {
         // Delete directory recursively
         if (removeDirectory(filePath)) {
-            sendResponse("DELETE_OK\n");
-            std::cout << "[FileHandler] ✅ Directory deleted successfully: " << filePath << std::endl;
+            sendMessage(Wire::Type::DELETE_OK, {});
+            LOG_INFO("FileHandler", "Directory deleted", {"path", filePath});
         } else {
-            std::string errorMsg = "ERROR|Failed to delete directory: " + std::string(strerror(errno)) + "\n";
-            sendResponse(errorMsg);
-            std::cerr << "[FileHandler] Failed to delete directory: " << filePath << std::endl;
+            std::string errorMsg = "Failed to delete directory: " + std::string(strerror(errno));
+            sendMessage(Wire::Type::ERROR, {errorMsg});
+            LOG_WARN("FileHandler", "Failed to delete directory", {"path", filePath});
         }
     } else {
         // Delete file
         if (remove(filePath.c_str()) == 0) {
-            sendResponse("DELETE_OK\n");
-            std::cout << "[FileHandler] ✅ File deleted successfully: " << filePath << std::endl;
+            sendMessage(Wire::Type::DELETE_OK, {});
+            LOG_INFO("FileHandler", "File deleted", {"path", filePath});
         } else {
-            std::string errorMsg = "ERROR|Failed to delete file: " + std::string(strerror(errno)) + "\n";
-            sendResponse(errorMsg);
-            std::cerr << "[FileHandler] Failed to delete file: " << filePath << " - " << strerror(errno) << std::endl;
+            std::string errorMsg = "Failed to delete file: " + std::string(strerror(errno));
+            sendMessage(Wire::Type::ERROR, {errorMsg});
+            LOG_WARN("FileHandler", "Failed to delete file", {"path", filePath}, {"error", strerror(errno)});
         }
     }
 }
 
 void FileHandler::handleRename(const std::string& oldPath, const std::string& newPath)
 {
-    std::cout << "[FileHandler] Renaming: " << oldPath << " to " << newPath << std::endl;
+    LOG_INFO("FileHandler", "Renaming", {"from", oldPath}, {"to", newPath});
     
     struct stat st;
     if (stat(oldPath.c_str(), &st) != 0) {
-        std::string errorMsg = "ERROR|Source file not found: " + oldPath + "\n";
-        sendResponse(errorMsg);
-        std::cerr << "[FileHandler] Source file not found: " << oldPath << std::endl;
+        std::string errorMsg = "Source file not found: " + oldPath;
+        sendMessage(Wire::Type::ERROR, {errorMsg});
+        LOG_WARN("FileHandler", "Source file not found", {"path", oldPath});
         return;
     }
     
     if (rename(oldPath.c_str(), newPath.c_str()) == 0) {
-        sendResponse("RENAME_OK\n");
-        std::cout << "[FileHandler] ✅ Renamed successfully: " << oldPath << " -> " << newPath << std::endl;
+        sendMessage(Wire::Type::RENAME_OK, {});
+        LOG_INFO("FileHandler", "Renamed", {"from", oldPath}, {"to", newPath});
     } else {
-        std::string errorMsg = "ERROR|Failed to rename: " + std::string(strerror(errno)) + "\n";
-        sendResponse(errorMsg);
-        std::cerr << "[FileHandler] Failed to rename: " << strerror(errno) << std::endl;
+        std::string errorMsg = "Failed to rename: " + std::string(strerror(errno));
+        sendMessage(Wire::Type::ERROR, {errorMsg});
+        LOG_WARN("FileHandler", "Failed to rename", {"error", strerror(errno)});
     }
 }
 
 void FileHandler::handleCopy(const std::string& srcPath, const std::string& destPath)
 {
-    std::cout << "[FileHandler] Copying: " << srcPath << " to " << destPath << std::endl;
+    LOG_INFO("FileHandler", "Copying", {"from", srcPath}, {"to", destPath});
     
     struct stat st;
     if (stat(srcPath.c_str(), &st) != 0) {
-        std::string errorMsg = "ERROR|Source file not found: " + srcPath + "\n";
-        sendResponse(errorMsg);
-        std::cerr << "[FileHandler] Source file not found: " << srcPath << std::endl;
+        std::string errorMsg = "Source file not found: " + srcPath;
+        sendMessage(Wire::Type::ERROR, {errorMsg});
+        LOG_WARN("FileHandler", "Source file not found", {"path", srcPath});
         return;
     }
     
@@ -602,54 +704,53 @@ void FileHandler::handleCopy(const std::string& srcPath, const std::string& dest
     if (S_ISDIR(st.st_mode)) {
         // Copy directory recursively
         if (copyDirectory(srcPath, finalDestPath)) {
-            sendResponse("COPY_OK\n");
-            std::cout << "[FileHandler] ✅ Directory copied successfully" << std::endl;
+            sendMessage(Wire::Type::COPY_OK, {});
+            LOG_INFO("FileHandler", "Directory copied");
         } else {
-            std::string errorMsg = "ERROR|Failed to copy directory: " + std::string(strerror(errno)) + "\n";
-            sendResponse(errorMsg);
-            std::cerr << "[FileHandler] Failed to copy directory" << std::endl;
+            std::string errorMsg = "Failed to copy directory: " + std::string(strerror(errno));
+            sendMessage(Wire::Type::ERROR, {errorMsg});
+            LOG_WARN("FileHandler", "Failed to copy directory");
         }
     } else {
         // Copy file
         if (copyFile(srcPath, finalDestPath)) {
-            sendResponse("COPY_OK\n");
-            std::cout << "[FileHandler] ✅ File copied successfully" << std::endl;
+            sendMessage(Wire::Type::COPY_OK, {});
+            LOG_INFO("FileHandler", "File copied");
         } else {
-            std::string errorMsg = "ERROR|Failed to copy file: " + std::string(strerror(errno)) + "\n";
-            sendResponse(errorMsg);
-            std::cerr << "[FileHandler] Failed to copy file" << std::endl;
+            std::string errorMsg = "Failed to copy file: " + std::string(strerror(errno));
+            sendMessage(Wire::Type::ERROR, {errorMsg});
+            LOG_WARN("FileHandler", "Failed to copy file");
         }
     }
 }
 
 void FileHandler::handleCreateFolder(const std::string& folderPath)
 {
-    std::cout << "[FileHandler] Creating folder: " << folderPath << std::endl;
+    LOG_INFO("FileHandler", "Creating folder", {"path", folderPath});
     
     // Check if path already exists
     struct stat st;
     if (stat(folderPath.c_str(), &st) == 0) {
         if (S_ISDIR(st.st_mode)) {
-            std::string errorMsg = "ERROR|Folder already exists: " + folderPath + "\n";
-            sendResponse(errorMsg);
-            std::cerr << "[FileHandler] Folder already exists: " << folderPath << std::endl;
+            std::string errorMsg = "Folder already exists: " + folderPath;
+            sendMessage(Wire::Type::ERROR, {errorMsg});
+            LOG_WARN("FileHandler", "Folder already exists", {"path", folderPath});
         } else {
-            std::string errorMsg = "ERROR|Path exists but is not a directory: " + folderPath + "\n";
-            sendResponse(errorMsg);
-            std::cerr << "[FileHandler] Path exists but is not a directory: " << folderPath << std::endl;
+            std::string errorMsg = "Path exists but is not a directory: " + folderPath;
+            sendMessage(Wire::Type::ERROR, {errorMsg});
+            LOG_WARN("FileHandler", "Path exists but is not a directory", {"path", folderPath});
         }
         return;
     }
     
     // Create the directory with permissions 0755 (rwxr-xr-x)
     if (mkdir(folderPath.c_str(), 0755) == 0) {
-        sendResponse("CREATE_FOLDER_OK\n");
-        std::cout << "[FileHandler] ✅ Folder created successfully: " << folderPath << std::endl;
+        sendMessage(Wire::Type::CREATE_FOLDER_OK, {});
+        LOG_INFO("FileHandler", "Folder created", {"path", folderPath});
     } else {
-        std::string errorMsg = "ERROR|Failed to create folder: " + std::string(strerror(errno)) + "\n";
-        sendResponse(errorMsg);
-        std::cerr << "[FileHandler] Failed to create folder: " << folderPath 
-                  << " - " << strerror(errno) << std::endl;
+        std::string errorMsg = "Failed to create folder: " + std::string(strerror(errno));
+        sendMessage(Wire::Type::ERROR, {errorMsg});
+        LOG_WARN("FileHandler", "Failed to create folder", {"path", folderPath}, {"error", strerror(errno)});
     }
 }
 
@@ -657,13 +758,13 @@ bool FileHandler::copyFile(const std::string& src, const std::string& dest)
 {
     std::ifstream srcFile(src, std::ios::binary);
     if (!srcFile.is_open()) {
-        std::cerr << "[FileHandler] Cannot open source file: " << src << std::endl;
+        LOG_WARN("FileHandler", "Cannot open source file", {"path", src});
         return false;
     }
     
     std::ofstream destFile(dest, std::ios::binary);
     if (!destFile.is_open()) {
-        std::cerr << "[FileHandler] Cannot create destination file: " << dest << std::endl;
+        LOG_WARN("FileHandler", "Cannot create destination file", {"path", dest});
         return false;
     }
     
@@ -671,7 +772,7 @@ bool FileHandler::copyFile(const std::string& src, const std::string& dest)
     while (srcFile.read(buffer, sizeof(buffer)) || srcFile.gcount() > 0) {
         destFile.write(buffer, srcFile.gcount());
         if (!destFile) {
-            std::cerr << "[FileHandler] Write error during copy" << std::endl;
+            LOG_WARN("FileHandler", "Write error during copy");
             srcFile.close();
             destFile.close();
             return false;
@@ -694,14 +795,13 @@ bool FileHandler::copyDirectory(const std::string& src, const std::string& dest)
 {
     // Create destination directory
     if (mkdir(dest.c_str(), 0755) != 0 && errno != EEXIST) {
-        std::cerr << "[FileHandler] Cannot create directory: " << dest 
-                  << " - " << strerror(errno) << std::endl;
+        LOG_WARN("FileHandler", "Cannot create directory", {"path", dest}, {"error", strerror(errno)});
         return false;
     }
     
     DIR* dir = opendir(src.c_str());
     if (!dir) {
-        std::cerr << "[FileHandler] Cannot open source directory: " << src << std::endl;
+        LOG_WARN("FileHandler", "Cannot open source directory", {"path", src});
         return false;
     }
     
@@ -720,12 +820,12 @@ bool FileHandler::copyDirectory(const std::string& src, const std::string& dest)
             if (S_ISDIR(st.st_mode)) {
                 if (!copyDirectory(srcPath, destPath)) {
                     success = false;
-                    std::cerr << "[FileHandler] Failed to copy subdirectory: " << srcPath << std::endl;
+                    LOG_WARN("FileHandler", "Failed to copy subdirectory", {"path", srcPath});
                 }
             } else {
                 if (!copyFile(srcPath, destPath)) {
                     success = false;
-                    std::cerr << "[FileHandler] Failed to copy file: " << srcPath << std::endl;
+                    LOG_WARN("FileHandler", "Failed to copy file", {"path", srcPath});
                 }
             }
         }
@@ -739,7 +839,7 @@ bool FileHandler::removeDirectory(const std::string& path)
 {
     DIR* dir = opendir(path.c_str());
     if (!dir) {
-        std::cerr << "[FileHandler] Cannot open directory for deletion: " << path << std::endl;
+        LOG_WARN("FileHandler", "Cannot open directory for deletion", {"path", path});
         return false;
     }
     
@@ -760,8 +860,7 @@ bool FileHandler::removeDirectory(const std::string& path)
                 }
             } else {
                 if (remove(fullPath.c_str()) != 0) {
-                    std::cerr << "[FileHandler] Failed to delete file: " << fullPath 
-                              << " - " << strerror(errno) << std::endl;
+                    LOG_WARN("FileHandler", "Failed to delete file", {"path", fullPath}, {"error", strerror(errno)});
                     success = false;
                 }
             }
@@ -774,8 +873,7 @@ bool FileHandler::removeDirectory(const std::string& path)
         if (rmdir(path.c_str()) == 0) {
             return true;
         } else {
-            std::cerr << "[FileHandler] Failed to remove directory: " << path 
-                      << " - " << strerror(errno) << std::endl;
+            LOG_WARN("FileHandler", "Failed to remove directory", {"path", path}, {"error", strerror(errno)});
             return false;
         }
     }
@@ -1,6 +1,6 @@
 #include "file_manager.h"
 #include "../../common/include/utils.h"
-#include <ace/Log_Msg.h>
+#include "async_log.h"
 #include <filesystem>
 #include <fstream>
 
@@ -11,7 +11,7 @@ std::vector<std::string> FileManager::ListDirectory(const std::string& path) {
     std::vector<std::string> files;
     
     if (!IsValidPath(path)) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Invalid directory path: %s\n"), path.c_str()));
+        LOG_ERROR("FileManager", "Invalid directory path", {"path", path});
         return files;
     }
     
@@ -20,7 +20,7 @@ std::vector<std::string> FileManager::ListDirectory(const std::string& path) {
             files.push_back(entry.path().string());
         }
     } catch (const std::exception& e) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Error listing directory: %s\n"), e.what()));
+        LOG_ERROR("FileManager", "Error listing directory", {"path", path}, {"error", e.what()});
     }
     
     return files;
@@ -28,13 +28,13 @@ std::vector<std::string> FileManager::ListDirectory(const std::string& path) {
 
 std::vector<unsigned char> FileManager::ReadFile(const std::string& path) {
     if (!IsValidPath(path)) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Invalid file path: %s\n"), path.c_str()));
+        LOG_ERROR("FileManager", "Invalid file path", {"path", path});
         return {};
     }
     
     std::ifstream file(path, std::ios::binary);
     if (!file) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Cannot open file: %s\n"), path.c_str()));
+        LOG_ERROR("FileManager", "Cannot open file", {"path", path});
         return {};
     }
     
@@ -50,13 +50,13 @@ std::vector<unsigned char> FileManager::ReadFile(const std::string& path) {
 
 bool FileManager::WriteFile(const std::string& path, const std::vector<unsigned char>& data) {
     if (!IsValidPath(path)) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Invalid file path: %s\n"), path.c_str()));
+        LOG_ERROR("FileManager", "Invalid file path", {"path", path});
         return false;
     }
     
     std::ofstream file(path, std::ios::binary);
     if (!file) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Cannot create file: %s\n"), path.c_str()));
+        LOG_ERROR("FileManager", "Cannot create file", {"path", path});
         return false;
     }
     
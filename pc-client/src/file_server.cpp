@@ -1,5 +1,6 @@
 #include "file_server.h"
-#include <QDebug>
+#include "share_token_store.h"
+#include "async_log.h"
 #include <QFile>
 #include <QFileInfo>
 #include <QDir>
@@ -7,161 +8,229 @@
 #include <QDateTime>
 #include <QNetworkInterface>
 
+namespace Wire = RemoteAccessSystem::Wire;
+
+static QString fieldText(const Wire::FrameView &frame, size_t index) {
+    std::string_view field = frame.field(index);
+    return QString::fromUtf8(field.data(), static_cast<int>(field.size()));
+}
+
 FileServer::FileServer(QObject *parent)
-    : QObject(parent), m_server(new QTcpServer(this)), m_httpServer(new QTcpServer(this)) {
+    : QObject(parent), m_server(new QTcpServer(this)), m_httpServer(new QTcpServer(this)),
+      m_expiryTimer(new QTimer(this)) {
     
     connect(m_server, &QTcpServer::newConnection, this, &FileServer::handleNewConnection);
     connect(m_httpServer, &QTcpServer::newConnection, this, &FileServer::handleHttpConnection);
+    
+    // Reap expired share links once a minute (the store's tick size)
+    connect(m_expiryTimer, &QTimer::timeout, this, []() {
+        RemoteAccessSystem::Common::ShareTokenStore::Instance().Expire();
+    });
+    m_expiryTimer->start(60000);
 }
 
 bool FileServer::start(int port, int httpPort) {
     if (!m_server->listen(QHostAddress::Any, port)) {
-        qDebug() << "[FileServer] Failed to start on port" << port;
+        LOG_ERROR("FileServer", "Failed to start", {"port", port});
         return false;
     }
     
     if (!m_httpServer->listen(QHostAddress::Any, httpPort)) {
-        qDebug() << "[FileServer] Failed to start HTTP server on port" << httpPort;
+        LOG_ERROR("FileServer", "Failed to start HTTP server", {"port", httpPort});
         return false;
     }
     
-    qDebug() << "[FileServer] Started on port" << port;
-    qDebug() << "[FileServer] HTTP server started on port" << httpPort;
+    LOG_INFO("FileServer", "Started", {"port", port});
+    LOG_INFO("FileServer", "HTTP server started", {"port", httpPort});
     return true;
 }
 
 // ADD THIS NEW METHOD IMPLEMENTATION
 void FileServer::addShareToken(const QString& token, const QString& filePath, int expiryHours) {
-    qDebug() << "[FileServer] Adding share token:" << token << "for file:" << filePath;
+    LOG_INFO("FileServer", "Adding share token", {"token", token.toStdString()}, {"file", filePath.toStdString()});
     
-    ShareInfo info;
-    info.filePath = filePath;
-    info.expiryTime = QDateTime::currentDateTime().addSecs(expiryHours * 3600);
-    m_shareLinks[token] = info;
+    RemoteAccessSystem::Common::ShareTokenStore::Instance().Add(
+        token.toStdString(), filePath.toStdString(), static_cast<int64_t>(expiryHours) * 3600);
     
-    qDebug() << "[FileServer] Token added, expires:" << info.expiryTime.toString();
+    LOG_DEBUG("FileServer", "Token added",
+              {"expires", QDateTime::currentDateTime().addSecs(expiryHours * 3600).toString(Qt::ISODate).toStdString()});
 }
 
 void FileServer::handleNewConnection() {
     QTcpSocket *client = m_server->nextPendingConnection();
-    qDebug() << "[FileServer] New client connected:" << client->peerAddress();
+    LOG_INFO("FileServer", "New client connected", {"address", client->peerAddress().toString().toStdString()});
     
     connect(client, &QTcpSocket::readyRead, this, [this, client]() {
         handleClientData(client);
     });
     
+    connect(client, &QTcpSocket::disconnected, this, [this, client]() {
+        m_readers.remove(client);
+        m_uploading.remove(client);
+    });
     connect(client, &QTcpSocket::disconnected, client, &QTcpSocket::deleteLater);
 }
 
 void FileServer::handleClientData(QTcpSocket *client) {
-    QByteArray data = client->readAll();
-    QString command = QString::fromUtf8(data).trimmed();
+    // uploadFile() is draining this socket itself
+    if (m_uploading.contains(client)) return;
     
-    qDebug() << "[FileServer] Command received:" << command;
-    
-    QStringList parts = command.split('|');
-    if (parts.isEmpty()) {
-        qDebug() << "[FileServer] Empty command received";
-        return;
+    QByteArray data = client->readAll();
+    m_readers[client].append(data.constData(), data.size());
+    
+    Wire::FrameView request;
+    Wire::Reader::Result result;
+    while (true) {
+        // An upload can wait on the socket long enough for it to drop
+        auto it = m_readers.find(client);
+        if (it == m_readers.end()) return;
+    
+        result = it->next(request);
+        if (result != Wire::Reader::FRAME) break;
+        handleRequest(client, request);
     }
     
-    QString cmd = parts[0];
-    
-    // Handle LIST command (mobile app sends this)
-    if (cmd == "LIST" && parts.size() >= 2) {
-        qDebug() << "[FileServer] Processing LIST command for path:" << parts[1];
-        listDirectory(client, parts[1]);
-        
-    // Also support LIST_DIR for backward compatibility
-    } else if (cmd == "LIST_DIR" && parts.size() >= 2) {
-        qDebug() << "[FileServer] Processing LIST_DIR command for path:" << parts[1];
-        listDirectory(client, parts[1]);
-        
-    } else if (cmd == "DOWNLOAD" && parts.size() >= 2) {
-        qDebug() << "[FileServer] Processing DOWNLOAD command for:" << parts[1];
-        downloadFile(client, parts[1]);
-        
-    } else if (cmd == "GET" && parts.size() >= 2) {
-        qDebug() << "[FileServer] Processing GET command for:" << parts[1];
-        downloadFile(client, parts[1]);
-        
-    } else if (cmd == "UPLOAD" && parts.size() >= 3) {
-        qDebug() << "[FileServer] Processing UPLOAD command";
-        uploadFile(client, parts[1], parts[2].toLongLong());
-        
-    } else if (cmd == "PUT" && parts.size() >= 3) {
-        qDebug() << "[FileServer] Processing PUT command";
-        uploadFile(client, parts[1], parts[2].toLongLong());
-        
-    } else if (cmd == "DELETE" && parts.size() >= 2) {
-        qDebug() << "[FileServer] Processing DELETE command";
-        deleteFile(client, parts[1]);
-        
-    } else if (cmd == "MKDIR" && parts.size() >= 2) {
-        qDebug() << "[FileServer] Processing MKDIR command";
-        createDirectory(client, parts[1]);
-        
-    } else if (cmd == "GENERATE_LINK" && parts.size() >= 3) {
-        qDebug() << "[FileServer] Processing GENERATE_LINK command";
-        generateShareLink(client, parts[1], parts[2].toInt());
-        
-    } else {
-        qDebug() << "[FileServer] Unknown command:" << cmd << "with" << parts.size() << "parts";
-        client->write("ERROR|Unknown command\n");
-        client->flush();
+    if (result == Wire::Reader::BAD_FRAME) {
+        LOG_WARN("FileServer", "Malformed frame, closing client");
+        client->disconnectFromHost();
     }
 }
 
+void FileServer::handleRequest(QTcpSocket *client, const Wire::FrameView &request) {
+    struct Call {
+        FileServer *server;
+        QTcpSocket *client;
+    };
+    
+    // Direct commands carry no PC id: LIST|path, PUT|path|size, ...
+    // LIST_DIR, DOWNLOAD and UPLOAD are accepted for backward compatibility.
+    static constexpr Wire::Command<Call> kCommands[] = {
+        { Wire::Type::LIST, 1, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing LIST", {"path", fieldText(r, 0).toStdString()});
+            call.server->listDirectory(call.client, fieldText(r, 0));
+        } },
+        { Wire::Type::LIST_DIR, 1, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing LIST_DIR", {"path", fieldText(r, 0).toStdString()});
+            call.server->listDirectory(call.client, fieldText(r, 0));
+        } },
+        { Wire::Type::DOWNLOAD, 1, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing DOWNLOAD", {"path", fieldText(r, 0).toStdString()});
+            call.server->downloadFile(call.client, fieldText(r, 0));
+        } },
+        { Wire::Type::GET, 1, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing GET", {"path", fieldText(r, 0).toStdString()});
+            call.server->downloadFile(call.client, fieldText(r, 0));
+        } },
+        { Wire::Type::UPLOAD, 2, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing UPLOAD");
+            call.server->uploadFile(call.client, fieldText(r, 0), static_cast<qint64>(r.fieldU64(1)));
+        } },
+        { Wire::Type::PUT, 2, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing PUT");
+            call.server->uploadFile(call.client, fieldText(r, 0), static_cast<qint64>(r.fieldU64(1)));
+        } },
+        { Wire::Type::DELETE, 1, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing DELETE");
+            call.server->deleteFile(call.client, fieldText(r, 0));
+        } },
+        { Wire::Type::MKDIR, 1, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing MKDIR");
+            call.server->createDirectory(call.client, fieldText(r, 0));
+        } },
+        { Wire::Type::GENERATE_LINK, 2, [](Call &call, const Wire::FrameView &r) {
+            LOG_DEBUG("FileServer", "Processing GENERATE_LINK");
+            call.server->generateShareLink(call.client, fieldText(r, 0), static_cast<int>(r.fieldU64(1)));
+        } }
+    };
+    static constexpr Wire::Dispatcher kDispatcher(kCommands);
+    
+    Wire::Type type = request.type();
+    LOG_DEBUG("FileServer", "Command received", {"type", Wire::typeName(type)},
+              {"framing", isBinary(client) ? "binary" : "text"});
+    
+    Call call{ this, client };
+    switch (kDispatcher.dispatch(call, request)) {
+    case Wire::DispatchResult::HANDLED:
+        break;
+    case Wire::DispatchResult::MISSING_FIELDS:
+        LOG_WARN("FileServer", "Too few fields", {"type", Wire::typeName(type)}, {"fields", request.fieldCount()});
+        sendMessage(client, Wire::Type::ERROR, {std::string("Invalid ") + Wire::typeName(type) + " format"});
+        break;
+    case Wire::DispatchResult::UNKNOWN_COMMAND:
+        LOG_WARN("FileServer", "Unknown command", {"type", Wire::typeName(type)});
+        sendMessage(client, Wire::Type::ERROR, {"Unknown command"});
+        break;
+    }
+}
+
+bool FileServer::isBinary(QTcpSocket *client) const {
+    auto it = m_readers.constFind(client);
+    return it != m_readers.constEnd() && it->binary();
+}
+
+void FileServer::sendMessage(QTcpSocket *client, Wire::Type type,
+                             std::initializer_list<std::string_view> fields) {
+    std::string out;
+    Wire::appendMessage(out, isBinary(client), type, fields);
+    client->write(out.data(), static_cast<qint64>(out.size()));
+    client->flush();
+}
+
+void FileServer::sendFrame(QTcpSocket *client, const std::string &frame) {
+    std::string out;
+    Wire::appendMessage(out, isBinary(client), Wire::FrameView(frame.data()));
+    client->write(out.data(), static_cast<qint64>(out.size()));
+    client->flush();
+}
+
 void FileServer::listDirectory(QTcpSocket *client, const QString &path) {
-    qDebug() << "[FileServer] Listing directory:" << path;
+    LOG_INFO("FileServer", "Listing directory", {"path", path.toStdString()});
     
     QDir dir(path);
     if (!dir.exists()) {
-        qDebug() << "[FileServer] Directory does not exist:" << path;
-        client->write("ERROR|Directory not found\n");
-        client->flush();
+        LOG_WARN("FileServer", "Directory does not exist", {"path", path.toStdString()});
+        sendMessage(client, Wire::Type::ERROR, {"Directory not found"});
         return;
     }
     
     QFileInfoList entries = dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot);
-    QStringList result;
+    
+    // Fields: path, then (filename, type, size) per entry. As text:
+    // FILE_LIST|path|file1,type,size;file2,type,size;...
+    std::string response;
+    Wire::Builder list(response, Wire::Type::FILE_LIST);
+    list.add(path.toStdString());
     
     for (const QFileInfo &info : entries) {
-        QString type = info.isDir() ? "DIR" : "FILE";
-        QString size = info.isDir() ? "0" : QString::number(info.size());
-        
-        // Format: filename,type,size
-        QString entry = QString("%1,%2,%3").arg(info.fileName()).arg(type).arg(size);
-        result << entry;
+        std::string size = std::to_string(info.isDir() ? 0 : static_cast<uint64_t>(info.size()));
+        if (!list.addRecord({info.fileName().toStdString(), info.isDir() ? "DIR" : "FILE", size})) {
+            LOG_WARN("FileServer", "Listing truncated to one frame", {"path", path.toStdString()});
+            break;
+        }
         
-        qDebug() << "[FileServer]   -" << entry;
+        LOG_TRACE("FileServer", "Entry", {"name", info.fileName().toStdString()});
     }
     
-    // Response format: FILE_LIST|path|file1,type,size;file2,type,size;...
-    QString response = QString("FILE_LIST|%1|%2\n").arg(path).arg(result.join(';'));
-    client->write(response.toUtf8());
-    client->flush();
+    list.finish();
+    sendFrame(client, response);
     
-    qDebug() << "[FileServer] Sent" << entries.size() << "entries for" << path;
+    LOG_INFO("FileServer", "Sent listing", {"entries", entries.size()}, {"path", path.toStdString()});
 }
 
 void FileServer::downloadFile(QTcpSocket *client, const QString &path) {
-    qDebug() << "[FileServer] Download requested:" << path;
+    LOG_INFO("FileServer", "Download requested", {"path", path.toStdString()});
     
     QFile file(path);
     if (!file.open(QIODevice::ReadOnly)) {
-        qDebug() << "[FileServer] Failed to open file:" << path;
-        client->write("ERROR|Failed to open file\n");
-        client->flush();
+        LOG_WARN("FileServer", "Failed to open file", {"path", path.toStdString()});
+        sendMessage(client, Wire::Type::ERROR, {"Failed to open file"});
         return;
     }
     
     qint64 fileSize = file.size();
-    QString header = QString("FILE_DATA|%1\n").arg(fileSize);
-    client->write(header.toUtf8());
-    client->flush();
+    sendMessage(client, Wire::Type::FILE_DATA, {std::to_string(fileSize)});
     
-    qDebug() << "[FileServer] Sending file:" << path << "(" << fileSize << "bytes)";
+    LOG_INFO("FileServer", "Sending file", {"path", path.toStdString()}, {"bytes", fileSize});
     
     // Send file in chunks
     qint64 totalSent = 0;
@@ -174,29 +243,33 @@ void FileServer::downloadFile(QTcpSocket *client, const QString &path) {
     
     file.close();
     
-    qDebug() << "[FileServer] Download complete:" << totalSent << "of" << fileSize << "bytes sent";
+    LOG_INFO("FileServer", "Download complete", {"sent", totalSent}, {"bytes", fileSize});
 }
 
 void FileServer::uploadFile(QTcpSocket *client, const QString &path, qint64 size) {
-    qDebug() << "[FileServer] Upload requested:" << path << "(" << size << "bytes)";
+    LOG_INFO("FileServer", "Upload requested", {"path", path.toStdString()}, {"bytes", size});
     
     QFile file(path);
     if (!file.open(QIODevice::WriteOnly)) {
-        qDebug() << "[FileServer] Failed to create file:" << path;
-        client->write("ERROR|Failed to create file\n");
-        client->flush();
+        LOG_WARN("FileServer", "Failed to create file", {"path", path.toStdString()});
+        sendMessage(client, Wire::Type::ERROR, {"Failed to create file"});
         return;
     }
     
     // Acknowledge ready to receive
-    client->write("READY\n");
-    client->flush();
+    sendMessage(client, Wire::Type::READY, {});
     
-    // Read file data
-    qint64 received = 0;
+    // Read file data, starting with whatever arrived behind the request
+    Wire::Reader &reader = m_readers[client];
+    std::string_view early = reader.pending();
+    qint64 received = qMin(static_cast<qint64>(early.size()), size);
+    file.write(early.data(), received);
+    reader.consume(static_cast<size_t>(received));
+    
+    m_uploading.insert(client);
     while (received < size) {
         if (!client->waitForReadyRead(30000)) {
-            qDebug() << "[FileServer] Timeout waiting for data";
+            LOG_WARN("FileServer", "Timeout waiting for data");
             break;
         }
         
@@ -205,25 +278,24 @@ void FileServer::uploadFile(QTcpSocket *client, const QString &path, qint64 size
         received += data.size();
         
         if (received % (1024 * 1024) == 0) {
-            qDebug() << "[FileServer] Upload progress:" << received << "/" << size;
+            LOG_DEBUG("FileServer", "Upload progress", {"received", received}, {"bytes", size});
         }
     }
     
+    m_uploading.remove(client);
     file.close();
     
     if (received == size) {
-        client->write("OK|Upload complete\n");
-        client->flush();
-        qDebug() << "[FileServer] Upload complete:" << received << "bytes";
+        sendMessage(client, Wire::Type::OK, {"Upload complete"});
+        LOG_INFO("FileServer", "Upload complete", {"bytes", received});
     } else {
-        client->write("ERROR|Upload incomplete\n");
-        client->flush();
-        qDebug() << "[FileServer] Upload failed, received" << received << "of" << size;
+        sendMessage(client, Wire::Type::ERROR, {"Upload incomplete"});
+        LOG_WARN("FileServer", "Upload failed", {"received", received}, {"bytes", size});
     }
 }
 
 void FileServer::deleteFile(QTcpSocket *client, const QString &path) {
-    qDebug() << "[FileServer] Delete requested:" << path;
+    LOG_INFO("FileServer", "Delete requested", {"path", path.toStdString()});
     
     QFileInfo info(path);
     
@@ -237,39 +309,34 @@ void FileServer::deleteFile(QTcpSocket *client, const QString &path) {
     }
     
     if (success) {
-        client->write("OK|File deleted\n");
-        client->flush();
-        qDebug() << "[FileServer] Deleted:" << path;
+        sendMessage(client, Wire::Type::OK, {"File deleted"});
+        LOG_INFO("FileServer", "Deleted", {"path", path.toStdString()});
     } else {
-        client->write("ERROR|Failed to delete file\n");
-        client->flush();
-        qDebug() << "[FileServer] Failed to delete:" << path;
+        sendMessage(client, Wire::Type::ERROR, {"Failed to delete file"});
+        LOG_WARN("FileServer", "Failed to delete", {"path", path.toStdString()});
     }
 }
 
 void FileServer::createDirectory(QTcpSocket *client, const QString &path) {
-    qDebug() << "[FileServer] Create directory requested:" << path;
+    LOG_INFO("FileServer", "Create directory requested", {"path", path.toStdString()});
     
     QDir dir;
     if (dir.mkpath(path)) {
-        client->write("OK|Directory created\n");
-        client->flush();
-        qDebug() << "[FileServer] Created directory:" << path;
+        sendMessage(client, Wire::Type::OK, {"Directory created"});
+        LOG_INFO("FileServer", "Created directory", {"path", path.toStdString()});
     } else {
-        client->write("ERROR|Failed to create directory\n");
-        client->flush();
-        qDebug() << "[FileServer] Failed to create directory:" << path;
+        sendMessage(client, Wire::Type::ERROR, {"Failed to create directory"});
+        LOG_WARN("FileServer", "Failed to create directory", {"path", path.toStdString()});
     }
 }
 
 void FileServer::generateShareLink(QTcpSocket *client, const QString &path, int expiryHours) {
-    qDebug() << "[FileServer] Generate share link:" << path << "expiry:" << expiryHours << "hours";
+    LOG_INFO("FileServer", "Generate share link", {"path", path.toStdString()}, {"expiry_hours", expiryHours});
     
     QFile file(path);
     if (!file.exists()) {
-        qDebug() << "[FileServer] File not found for share link:" << path;
-        client->write("ERROR|File not found\n");
-        client->flush();
+        LOG_WARN("FileServer", "File not found for share link", {"path", path.toStdString()});
+        sendMessage(client, Wire::Type::ERROR, {"File not found"});
         return;
     }
     
@@ -280,10 +347,7 @@ void FileServer::generateShareLink(QTcpSocket *client, const QString &path, int
     ).toHex();
     
     // Store share info
-    ShareInfo info;
-    info.filePath = path;
-    info.expiryTime = QDateTime::currentDateTime().addSecs(expiryHours * 3600);
-    m_shareLinks[token] = info;
+    addShareToken(token, path, expiryHours);
     
     // Generate URL
     QString url = QString("http://%1:%2/share/%3")
@@ -291,12 +355,9 @@ void FileServer::generateShareLink(QTcpSocket *client, const QString &path, int
         .arg(m_httpServer->serverPort())
         .arg(token);
     
-    QString response = QString("SHARE_LINK|%1\n").arg(url);
-    client->write(response.toUtf8());
-    client->flush();
+    sendMessage(client, Wire::Type::SHARE_LINK, {url.toStdString()});
     
-    qDebug() << "[FileServer] Generated share link:" << url;
-    qDebug() << "[FileServer] Expires:" << info.expiryTime.toString();
+    LOG_INFO("FileServer", "Generated share link", {"url", url.toStdString()});
 }
 
 void FileServer::handleHttpConnection() {
@@ -306,7 +367,7 @@ void FileServer::handleHttpConnection() {
         QByteArray request = client->readAll();
         QString requestStr = QString::fromUtf8(request);
         
-        qDebug() << "[FileServer] HTTP request:" << requestStr.left(100);
+        LOG_DEBUG("FileServer", "HTTP request", {"request", requestStr.left(100).toStdString()});
         
         // Parse HTTP GET request
         QStringList lines = requestStr.split('\n');
@@ -341,10 +402,14 @@ void FileServer::handleHttpConnection() {
 }
 
 void FileServer::serveSharedFile(QTcpSocket *client, const QString &token) {
-    qDebug() << "[FileServer] Serving shared file, token:" << token;
+    LOG_INFO("FileServer", "Serving shared file", {"token", token.toStdString()});
     
-    if (!m_shareLinks.contains(token)) {
-        qDebug() << "[FileServer] Share link not found:" << token;
+    std::string filePath;
+    auto result = RemoteAccessSystem::Common::ShareTokenStore::Instance().Lookup(
+        token.toStdString(), filePath);
+    
+    if (result == RemoteAccessSystem::Common::ShareTokenStore::LookupResult::NotFound) {
+        LOG_WARN("FileServer", "Share link not found", {"token", token.toStdString()});
         QString response = "HTTP/1.1 404 Not Found\r\n\r\nShare link not found or expired";
         client->write(response.toUtf8());
         client->flush();
@@ -352,12 +417,9 @@ void FileServer::serveSharedFile(QTcpSocket *client, const QString &token) {
         return;
     }
     
-    ShareInfo info = m_shareLinks[token];
-    
     // Check expiry
-    if (QDateTime::currentDateTime() > info.expiryTime) {
-        qDebug() << "[FileServer] Share link expired:" << token;
-        m_shareLinks.remove(token);
+    if (result == RemoteAccessSystem::Common::ShareTokenStore::LookupResult::Expired) {
+        LOG_WARN("FileServer", "Share link expired", {"token", token.toStdString()});
         QString response = "HTTP/1.1 410 Gone\r\n\r\nShare link has expired";
         client->write(response.toUtf8());
         client->flush();
@@ -365,10 +427,12 @@ void FileServer::serveSharedFile(QTcpSocket *client, const QString &token) {
         return;
     }
     
+    QString sharedPath = QString::fromStdString(filePath);
+    
     // Serve file
-    QFile file(info.filePath);
+    QFile file(sharedPath);
     if (!file.open(QIODevice::ReadOnly)) {
-        qDebug() << "[FileServer] Failed to open shared file:" << info.filePath;
+        LOG_WARN("FileServer", "Failed to open shared file", {"path", sharedPath.toStdString()});
         QString response = "HTTP/1.1 500 Internal Server Error\r\n\r\nFailed to open file";
         client->write(response.toUtf8());
         client->flush();
@@ -376,7 +440,7 @@ void FileServer::serveSharedFile(QTcpSocket *client, const QString &token) {
         return;
     }
     
-    QFileInfo fileInfo(info.filePath);
+    QFileInfo fileInfo(sharedPath);
     QString fileName = fileInfo.fileName();
     qint64 fileSize = file.size();
     
@@ -400,7 +464,7 @@ void FileServer::serveSharedFile(QTcpSocket *client, const QString &token) {
     client->flush();
     file.close();
     
-    qDebug() << "[FileServer] Served shared file:" << info.filePath << "(" << fileSize << "bytes)";
+    LOG_INFO("FileServer", "Served shared file", {"path", sharedPath.toStdString()}, {"bytes", fileSize});
     
     client->disconnectFromHost();
 }
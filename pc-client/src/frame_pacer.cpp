@@ -0,0 +1,186 @@
+#include "frame_pacer.h"
+#include "async_log.h"
+#include <algorithm>
+
+namespace {
+
+// Adapt at most this often so one slow ack can't swing the settings
+const uint64_t kAdaptIntervalUs = 500000;
+
+// Unacked frames older than this are treated as lost
+const uint64_t kMinLossTimeoutUs = 1000000;
+
+const size_t kMaxFramesInFlight = 4;
+
+const int kMinQuality = 30;
+const int kMinFps = 5;
+const int kMaxScale = 4;
+
+}
+
+FramePacer::FramePacer(int targetLatencyMs)
+    : m_targetUs(static_cast<uint64_t>(targetLatencyMs) * 1000),
+      m_srttUs(0), m_minRttUs(0), m_deliveryRate(0),
+      m_lastAckUs(0), m_lastAdaptUs(0), m_lostSinceAdapt(0),
+      m_changed(false)
+{
+    reset({ 15, 70, 1 });
+}
+
+void FramePacer::reset(const PacingSettings& initial)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_inFlight.clear();
+    m_srttUs = 0;
+    m_minRttUs = 0;
+    m_deliveryRate = 0;
+    m_lastAckUs = 0;
+    m_lastAdaptUs = 0;
+    m_lostSinceAdapt = 0;
+    m_settings = initial;
+    m_max = initial;
+    m_changed = true;
+}
+
+bool FramePacer::canSend(uint64_t nowUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    expireLocked(nowUs);
+
+    // Always keep one frame moving so a stalled estimate can recover
+    if (m_inFlight.empty()) {
+        return true;
+    }
+    if (m_srttUs == 0 || m_inFlight.size() >= kMaxFramesInFlight) {
+        return false;
+    }
+
+    // Bytes the link can drain within the latency target
+    double budget = m_deliveryRate * (static_cast<double>(m_targetUs) / 1e6);
+    return static_cast<double>(inFlightBytesLocked()) < budget;
+}
+
+void FramePacer::onFrameSent(uint64_t sequence, size_t bytes, uint64_t nowUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_inFlight.push_back({ sequence, bytes, nowUs });
+}
+
+void FramePacer::onAck(uint64_t sequence, uint64_t nowUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Acks are cumulative: everything up to `sequence` has arrived
+    size_t delivered = 0;
+    uint64_t sentUs = 0;
+    while (!m_inFlight.empty() && m_inFlight.front().sequence <= sequence) {
+        delivered += m_inFlight.front().bytes;
+        sentUs = m_inFlight.front().sentUs;
+        m_inFlight.pop_front();
+    }
+    if (delivered == 0) {
+        return;
+    }
+
+    uint64_t rtt = nowUs > sentUs ? nowUs - sentUs : 1;
+    m_srttUs = m_srttUs == 0 ? rtt : (m_srttUs * 7 + rtt) / 8;
+    m_minRttUs = m_minRttUs == 0 ? rtt : std::min(m_minRttUs, rtt);
+
+    // Delivery rate over the interval since the previous ack, or over the
+    // RTT when this is the first ack after an idle period
+    uint64_t interval = rtt;
+    if (m_lastAckUs != 0 && nowUs > m_lastAckUs && nowUs - m_lastAckUs < rtt) {
+        interval = nowUs - m_lastAckUs;
+    }
+    double sample = delivered / (std::max<uint64_t>(interval, 1000) / 1e6);
+    m_deliveryRate = m_deliveryRate == 0 ? sample : m_deliveryRate * 0.75 + sample * 0.25;
+    m_lastAckUs = nowUs;
+
+    adaptLocked(nowUs);
+}
+
+void FramePacer::expireLocked(uint64_t nowUs)
+{
+    uint64_t timeout = std::max(kMinLossTimeoutUs, m_srttUs * 4);
+    while (!m_inFlight.empty() && nowUs - m_inFlight.front().sentUs > timeout) {
+        m_inFlight.pop_front();
+        m_lostSinceAdapt++;
+    }
+    if (m_lostSinceAdapt > 0) {
+        adaptLocked(nowUs);
+    }
+}
+
+size_t FramePacer::inFlightBytesLocked() const
+{
+    size_t total = 0;
+    for (const InFlight& frame : m_inFlight) {
+        total += frame.bytes;
+    }
+    return total;
+}
+
+void FramePacer::adaptLocked(uint64_t nowUs)
+{
+    if (nowUs - m_lastAdaptUs < kAdaptIntervalUs) {
+        return;
+    }
+    m_lastAdaptUs = nowUs;
+
+    PacingSettings next = m_settings;
+    bool congested = m_srttUs > m_targetUs || m_lostSinceAdapt > 0;
+    m_lostSinceAdapt = 0;
+
+    if (congested) {
+        if (next.quality > kMinQuality) {
+            next.quality = std::max(kMinQuality, next.quality - 15);
+        } else if (next.fps > kMinFps) {
+            next.fps = std::max(kMinFps, next.fps * 2 / 3);
+        } else if (next.scale < kMaxScale) {
+            next.scale *= 2;
+        }
+    } else if (m_srttUs < m_targetUs / 2) {
+        if (next.scale > 1) {
+            next.scale /= 2;
+        } else if (next.fps < m_max.fps) {
+            next.fps = std::min(m_max.fps, next.fps + 2);
+        } else if (next.quality < m_max.quality) {
+            next.quality = std::min(m_max.quality, next.quality + 5);
+        }
+    }
+
+    if (next.fps != m_settings.fps || next.quality != m_settings.quality ||
+        next.scale != m_settings.scale) {
+        LOG_INFO("FramePacer", "Adjusted", {"srtt_ms", m_srttUs / 1000},
+                 {"rate_kbps", static_cast<uint64_t>(m_deliveryRate / 1024)}, {"fps", next.fps},
+                 {"quality", next.quality}, {"scale", next.scale});
+        m_settings = next;
+        m_changed = true;
+    }
+}
+
+PacingSettings FramePacer::settings() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_settings;
+}
+
+bool FramePacer::takeSettingsChanged()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool changed = m_changed;
+    m_changed = false;
+    return changed;
+}
+
+uint64_t FramePacer::smoothedRttUs() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_srttUs;
+}
+
+double FramePacer::deliveryRateBytesPerSec() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_deliveryRate;
+}
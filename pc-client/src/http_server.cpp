@@ -1,8 +1,9 @@
 #include "../include/http_server.h"
-#include <ace/Log_Msg.h>
+#include "../include/qr_asset_cache.h"
+#include "../include/share_token_store.h"
+#include "async_log.h"
 #include <ace/OS_NS_sys_stat.h>
 #include <qrencode.h>
-#include <png.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -16,15 +17,26 @@
 namespace RemoteAccessSystem {
 namespace Common {
 
-// Global state for PC connection info and shared files
-static std::map<std::string, std::string> share_tokens;
-static std::mutex token_mutex;
+// Global state for PC connection info (share tokens live in ShareTokenStore)
 static std::string g_pc_id;
 static std::string g_username;
 static std::string g_relay_server = "127.0.0.1";
 static uint16_t g_relay_port = 2810;
 static std::string g_auth_token;
 
+// QR code rendered once per connection-info change
+static QRAssetCache g_qr_cache(400);
+
+static std::string BuildConnectionInfo() {
+    std::ostringstream data;
+    data << g_pc_id << "|" 
+         << g_username << "|" 
+         << g_relay_server << "|" 
+         << g_relay_port << "|"
+         << g_auth_token;
+    return data.str();
+}
+
 // Constructor & Destructor
 HTTPServer::HTTPServer() : running_(false) {}
 HTTPServer::~HTTPServer() { Stop(); }
@@ -42,8 +54,11 @@ void SetPCInfo(const std::string& pc_id, const std::string& username,
         g_auth_token = GenerateAuthToken();
     }
     
-    ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] PC info set: %s@%s:%d (token: %s)\n"),
-              username.c_str(), relay_server.c_str(), relay_port, g_auth_token.c_str()));
+    // Re-render the QR assets now rather than on the first /qr request
+    g_qr_cache.Update(BuildConnectionInfo());
+    
+    LOG_INFO("HTTPServer", "PC info set", {"username", username}, {"relay_server", relay_server},
+             {"relay_port", relay_port}, {"token", g_auth_token});
 }
 
 // Generate secure authentication token
@@ -61,10 +76,8 @@ std::string GenerateAuthToken() {
 
 // Add file sharing token
 void AddShareToken(const std::string& token, const std::string& file_path) {
-    std::lock_guard<std::mutex> lock(token_mutex);
-    share_tokens[token] = file_path;
-    ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] Token added: %s -> %s\n"), 
-              token.c_str(), file_path.c_str()));
+    ShareTokenStore::Instance().Add(token, file_path);
+    LOG_INFO("HTTPServer", "Token added", {"token", token}, {"path", file_path});
 }
 
 // Get connection info for QR code
@@ -73,25 +86,19 @@ std::string HTTPServer::GetConnectionInfo() const {
 }
 
 std::string HTTPServer::GenerateQRData() const {
-    std::ostringstream data;
-    data << g_pc_id << "|" 
-         << g_username << "|" 
-         << g_relay_server << "|" 
-         << g_relay_port << "|"
-         << g_auth_token;
-    return data.str();
+    return BuildConnectionInfo();
 }
 
 // Start HTTP server
 bool HTTPServer::Start(const std::string& address, uint16_t port) {
     ACE_INET_Addr server_addr(port, address.c_str());
     if (acceptor_.open(server_addr, 1) == -1) {
-        ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("[HTTPServer] Failed to open %s:%d\n"),
-                         address.c_str(), port), false);
+        LOG_ERROR("HTTPServer", "Failed to open", {"address", address}, {"port", port});
+        return false;
     }
     
     running_ = true;
-    ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] Started on %s:%d\n"), address.c_str(), port));
+    LOG_INFO("HTTPServer", "Started", {"address", address}, {"port", port});
     
     // Start accepting connections in a separate thread
     std::thread([this]() {
@@ -113,86 +120,7 @@ bool HTTPServer::Start(const std::string& address, uint16_t port) {
 void HTTPServer::Stop() {
     running_ = false;
     acceptor_.close();
-    ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] Stopped\n")));
-}
-
-// Generate QR code as PNG image
-std::vector<uint8_t> HTTPServer::GenerateQRCodePNG(const std::string& data, int size) {
-    // Generate QR code using libqrencode
-    QRcode* qr = QRcode_encodeString(data.c_str(), 0, QR_ECLEVEL_M, QR_MODE_8, 1);
-    if (!qr) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT("[HTTPServer] QR code generation failed\n")));
-        return {};
-    }
-    
-    int qr_width = qr->width;
-    int scale = size / qr_width;
-    if (scale < 1) scale = 1;
-    int img_size = qr_width * scale;
-    
-    // Create PNG in memory
-    std::vector<uint8_t> png_data;
-    
-    // Use memory buffer instead of file
-    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-    if (!png) {
-        QRcode_free(qr);
-        return {};
-    }
-    
-    png_infop info = png_create_info_struct(png);
-    if (!info) {
-        png_destroy_write_struct(&png, nullptr);
-        QRcode_free(qr);
-        return {};
-    }
-    
-    // Set up custom write function to write to vector
-    png_set_write_fn(png, &png_data, 
-        [](png_structp png_ptr, png_bytep data, png_size_t length) {
-            std::vector<uint8_t>* vec = static_cast<std::vector<uint8_t>*>(png_get_io_ptr(png_ptr));
-            vec->insert(vec->end(), data, data + length);
-        }, 
-        nullptr);
-    
-    // Set PNG parameters
-    png_set_IHDR(png, info, img_size, img_size, 8, PNG_COLOR_TYPE_RGB,
-                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-    png_write_info(png, info);
-    
-    // Create image data (white background, black QR modules)
-    std::vector<uint8_t> row_data(img_size * 3, 255); // RGB white
-    
-    for (int y = 0; y < img_size; ++y) {
-        int qr_y = y / scale;
-        for (int x = 0; x < img_size; ++x) {
-            int qr_x = x / scale;
-            int idx = qr_y * qr_width + qr_x;
-            
-            if (qr->data[idx] & 1) {
-                // Black module
-                row_data[x * 3 + 0] = 0;
-                row_data[x * 3 + 1] = 0;
-                row_data[x * 3 + 2] = 0;
-            } else {
-                // White module
-                row_data[x * 3 + 0] = 255;
-                row_data[x * 3 + 1] = 255;
-                row_data[x * 3 + 2] = 255;
-            }
-        }
-        png_write_row(png, row_data.data());
-        
-        // Reset to white for next row
-        std::fill(row_data.begin(), row_data.end(), 255);
-    }
-    
-    png_write_end(png, nullptr);
-    png_destroy_write_struct(&png, &info);
-    QRcode_free(qr);
-    
-    ACE_DEBUG((LM_DEBUG, ACE_TEXT("[HTTPServer] Generated QR PNG: %zu bytes\n"), png_data.size()));
-    return png_data;
+    LOG_INFO("HTTPServer", "Stopped");
 }
 
 // Send error response
@@ -250,8 +178,61 @@ void HTTPServer::SendFileResponse(ACE_SOCK_Stream& client, const std::string& fi
         client.send(buffer, file.gcount());
     }
     
-    ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] File sent: %s (%zu bytes)\n"), 
-              filename.c_str(), size));
+    LOG_INFO("HTTPServer", "File sent", {"file", filename}, {"bytes", size});
+}
+
+// Send cached QR code (PNG or SVG) with ETag revalidation
+void HTTPServer::SendQRResponse(ACE_SOCK_Stream& client, const std::string& request, bool svg) {
+    std::shared_ptr<const QRAsset> asset = g_qr_cache.Update(GenerateQRData());
+    if (!asset) {
+        SendErrorResponse(client, 500, "QR code generation failed");
+        return;
+    }
+    
+    // Look for If-None-Match among the request headers
+    std::string if_none_match;
+    size_t pos = request.find("\r\nIf-None-Match:");
+    if (pos == std::string::npos) pos = request.find("\r\nif-none-match:");
+    if (pos != std::string::npos) {
+        size_t value_start = request.find(':', pos) + 1;
+        size_t value_end = request.find("\r\n", value_start);
+        if_none_match = request.substr(value_start, value_end - value_start);
+        size_t first = if_none_match.find_first_not_of(" \t");
+        size_t last = if_none_match.find_last_not_of(" \t");
+        if_none_match = (first == std::string::npos) ? "" : if_none_match.substr(first, last - first + 1);
+    }
+    
+    std::ostringstream header;
+    if (if_none_match == asset->etag) {
+        header << "HTTP/1.1 304 Not Modified\r\n"
+               << "ETag: " << asset->etag << "\r\n"
+               << "Cache-Control: no-cache\r\n"
+               << "Access-Control-Allow-Origin: *\r\n"
+               << "\r\n";
+        std::string h = header.str();
+        client.send(h.c_str(), h.length());
+        LOG_DEBUG("HTTPServer", "QR code not modified", {"etag", asset->etag});
+        return;
+    }
+    
+    const char* content_type = svg ? "image/svg+xml" : "image/png";
+    const void* body = svg ? static_cast<const void*>(asset->svg.data())
+                           : static_cast<const void*>(asset->png.data());
+    size_t body_size = svg ? asset->svg.size() : asset->png.size();
+    
+    header << "HTTP/1.1 200 OK\r\n"
+           << "Content-Type: " << content_type << "\r\n"
+           << "Content-Length: " << body_size << "\r\n"
+           << "ETag: " << asset->etag << "\r\n"
+           << "Cache-Control: no-cache\r\n"
+           << "Access-Control-Allow-Origin: *\r\n"
+           << "\r\n";
+    
+    std::string h = header.str();
+    client.send(h.c_str(), h.length());
+    client.send(body, body_size);
+    
+    LOG_INFO("HTTPServer", "QR code sent", {"bytes", body_size}, {"version", asset->version});
 }
 
 // Handle incoming HTTP requests
@@ -280,34 +261,12 @@ void HTTPServer::HandleRequest(ACE_SOCK_Stream& client) {
         remote_host = remote_addr.get_host_addr();
     }
     
-    ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] %s %s from %s\n"), 
-              method.c_str(), path.c_str(), remote_host.c_str()));
+    LOG_INFO("HTTPServer", "Request", {"method", method}, {"path", path}, {"from", remote_host});
     
-    // Check if path starts with /qr (handles /qr, /qr.png, /qr?anything)
+    // Check if path starts with /qr (handles /qr, /qr.png, /qr.svg, /qr?anything)
     if (path.find("/qr") == 0) {
-        ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] Matched QR endpoint!\n")));
-        std::string qr_data = GenerateQRData();
-        ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] Generating QR code: %s\n"), qr_data.c_str()));
-        
-        auto png = GenerateQRCodePNG(qr_data, 400);
-        if (png.empty()) {
-            SendErrorResponse(client, 500, "QR code generation failed");
-            return;
-        }
-        
-        std::ostringstream header;
-        header << "HTTP/1.1 200 OK\r\n"
-               << "Content-Type: image/png\r\n"
-               << "Content-Length: " << png.size() << "\r\n"
-               << "Cache-Control: no-cache\r\n"
-               << "Access-Control-Allow-Origin: *\r\n"
-               << "\r\n";
-        
-        std::string h = header.str();
-        client.send(h.c_str(), h.length());
-        client.send(png.data(), png.size());
-        
-        ACE_DEBUG((LM_INFO, ACE_TEXT("[HTTPServer] QR code sent: %zu bytes\n"), png.size()));
+        bool svg = path.find("/qr.svg") == 0;
+        SendQRResponse(client, request, svg);
         return;
     }
     
@@ -319,15 +278,7 @@ void HTTPServer::HandleRequest(ACE_SOCK_Stream& client) {
         std::string token = (q != std::string::npos) ? token_part.substr(0, q) : token_part;
         
         std::string file_path;
-        {
-            std::lock_guard<std::mutex> lock(token_mutex);
-            auto it = share_tokens.find(token);
-            if (it != share_tokens.end()) {
-                file_path = it->second;
-            }
-        }
-        
-        if (file_path.empty()) {
+        if (ShareTokenStore::Instance().Lookup(token, file_path) != ShareTokenStore::LookupResult::Found) {
             SendErrorResponse(client, 404, "Token not found or expired");
             return;
         }
@@ -369,7 +320,7 @@ void HTTPServer::HandleRequest(ACE_SOCK_Stream& client) {
 void DisplayQRCodeInTerminal(const std::string& data) {
     QRcode* qr = QRcode_encodeString(data.c_str(), 0, QR_ECLEVEL_M, QR_MODE_8, 1);
     if (!qr) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT("[HTTPServer] Failed to generate QR code for terminal\n")));
+        LOG_ERROR("HTTPServer", "Failed to generate QR code for terminal");
         return;
     }
     
@@ -417,13 +368,7 @@ extern "C" {
     
     const char* http_server_get_qr_data() {
         static std::string qr_data;
-        std::ostringstream data;
-        data << RemoteAccessSystem::Common::g_pc_id << "|" 
-             << RemoteAccessSystem::Common::g_username << "|" 
-             << RemoteAccessSystem::Common::g_relay_server << "|" 
-             << RemoteAccessSystem::Common::g_relay_port << "|"
-             << RemoteAccessSystem::Common::g_auth_token;
-        qr_data = data.str();
+        qr_data = RemoteAccessSystem::Common::BuildConnectionInfo();
         return qr_data.c_str();
     }
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "input_injector.h"
+#include <X11/extensions/XTest.h>
+#include <chrono>
+#include "async_log.h"
+
+namespace {
+
+uint64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+InputInjector::InputInjector()
+    : m_display(nullptr), m_screen(0), m_refreshIntervalUs(1000000 / 60),
+      m_motionPending(false), m_motionX(0), m_motionY(0), m_lastMotionUs(0),
+      m_dirty(false)
+{
+}
+
+InputInjector::~InputInjector()
+{
+    if (m_display) {
+        flush(nowUs() + m_refreshIntervalUs);
+        XCloseDisplay(m_display);
+    }
+}
+
+bool InputInjector::init(const char* displayName)
+{
+    if (m_display) {
+        return true;
+    }
+
+    m_display = XOpenDisplay(displayName);
+    if (!m_display) {
+        LOG_ERROR("InputInjector", "Cannot open display", {"display", displayName ? displayName : "$DISPLAY"});
+        return false;
+    }
+
+    int eventBase = 0, errorBase = 0, major = 0, minor = 0;
+    if (!XTestQueryExtension(m_display, &eventBase, &errorBase, &major, &minor)) {
+        LOG_ERROR("InputInjector", "XTEST extension not available");
+        XCloseDisplay(m_display);
+        m_display = nullptr;
+        return false;
+    }
+
+    // Keep injecting while another client holds a server grab
+    XTestGrabControl(m_display, True);
+    m_screen = DefaultScreen(m_display);
+
+    LOG_INFO("InputInjector", "XTEST ready", {"version", std::to_string(major) + "." + std::to_string(minor)});
+    return true;
+}
+
+void InputInjector::setRefreshRate(int hz)
+{
+    if (hz > 0) {
+        m_refreshIntervalUs = 1000000 / hz;
+    }
+}
+
+void InputInjector::moveTo(int x, int y)
+{
+    m_motionX = x;
+    m_motionY = y;
+    m_motionPending = true;
+}
+
+void InputInjector::sendMotion(uint64_t nowUs)
+{
+    XTestFakeMotionEvent(m_display, m_screen, m_motionX, m_motionY, CurrentTime);
+    m_motionPending = false;
+    m_lastMotionUs = nowUs;
+    m_dirty = true;
+}
+
+void InputInjector::button(int button, bool pressed)
+{
+    if (!m_display) return;
+    if (m_motionPending) {
+        sendMotion(nowUs());
+    }
+    XTestFakeButtonEvent(m_display, button, pressed ? True : False, CurrentTime);
+    m_dirty = true;
+}
+
+bool InputInjector::key(KeySym keysym, bool pressed)
+{
+    if (!m_display) return false;
+
+    KeyCode keycode = XKeysymToKeycode(m_display, keysym);
+    if (keycode == 0) {
+        return false;
+    }
+    if (m_motionPending) {
+        sendMotion(nowUs());
+    }
+    XTestFakeKeyEvent(m_display, keycode, pressed ? True : False, CurrentTime);
+    m_dirty = true;
+    return true;
+}
+
+uint64_t InputInjector::flush(uint64_t nowUs)
+{
+    if (!m_display) return 0;
+
+    uint64_t wait = 0;
+    if (m_motionPending) {
+        uint64_t elapsed = nowUs - m_lastMotionUs;
+        if (m_lastMotionUs == 0 || elapsed >= m_refreshIntervalUs) {
+            sendMotion(nowUs);
+        } else {
+            wait = m_refreshIntervalUs - elapsed;
+        }
+    }
+
+    if (m_dirty) {
+        XFlush(m_display);
+        m_dirty = false;
+    }
+    return wait;
+}
@@ -2,12 +2,15 @@
 #include <QDebug>
 #include <QTcpSocket>
 #include <QTimer>
+#include <QDir>
 #include <iostream>
 #include "pc_identifier.h"
 #include "remote_control_server.h"
 #include "file_server.h"
 #include "http_server.h"
 #include "file_handler.h"
+#include "share_token_store.h"
+#include "async_log.h"
 
 class RelayRegistration : public QObject {
     Q_OBJECT
@@ -21,19 +24,19 @@ public:
     }
     
     void registerWithRelay(const QString &relayServer, int port) {
-        qDebug() << "[PCClient] Connecting to relay server" << relayServer << ":" << port;
+        LOG_DEBUG("PCClient", "Connecting to relay server", {"host", relayServer.toStdString()}, {"port", port});
         m_socket->connectToHost(relayServer, port);
     }
     
 private slots:
     void onConnected() {
-        qDebug() << "[PCClient] Connected to relay server";
+        // REGISTER|pc_id|usb_id|username: the relay lists and indexes PCs
+        // by the last field, so the owner goes there (hostname as the id)
         QString message = QString("REGISTER|%1|%2|%3\n")
             .arg(m_pcId)
-            .arg(m_username)
-            .arg(m_hostname);
+            .arg(m_hostname)
+            .arg(m_username);
         
-        qDebug() << "[PCClient] Sending:" << message.trimmed();
         m_socket->write(message.toUtf8());
         m_socket->flush();
     }
@@ -41,19 +44,19 @@ private slots:
     void onReadyRead() {
         QByteArray data = m_socket->readAll();
         QString response = QString::fromUtf8(data).trimmed();
-        qDebug() << "[PCClient] Relay response:" << response;
         
         if (response.startsWith("OK|")) {
-            qDebug() << "✅ Registration successful!";
+            LOG_DEBUG("PCClient", "Registered with relay", {"pc_id", m_pcId.toStdString()});
         } else if (response.startsWith("ERROR|")) {
-            qDebug() << "❌ Registration failed:" << response;
+            LOG_WARN("PCClient", "Relay registration failed", {"pc_id", m_pcId.toStdString()},
+                     {"response", response.toStdString()});
         }
         
         m_socket->disconnectFromHost();
     }
     
     void onError(QAbstractSocket::SocketError error) {
-        qDebug() << "[PCClient] Connection error:" << m_socket->errorString();
+        LOG_WARN("PCClient", "Relay registration connection error", {"error", m_socket->errorString().toStdString()});
     }
     
 private:
@@ -141,11 +144,19 @@ int main(int argc, char *argv[]) {
         relayPort
     );
     
+    // Restore share links from the previous run
+    QString dataDir = QDir::homePath() + "/.remote-access";
+    QDir().mkpath(dataDir);
+    if (!RemoteAccessSystem::Common::ShareTokenStore::Instance().Open(
+            (dataDir + "/share_tokens.log").toStdString())) {
+        LOG_WARN("PCClient", "Share links will not persist across restarts");
+    }
+    
     // Start HTTP server for QR code and file sharing
     qDebug() << "🌐 Starting HTTP Server...";
     RemoteAccessSystem::Common::HTTPServer httpServer;
     if (!httpServer.Start("0.0.0.0", 8080)) {
-        qDebug() << "❌ Failed to start HTTP server";
+        LOG_ERROR("PCClient", "Failed to start HTTP server", {"port", 8080});
         return 1;
     }
     qDebug() << "✅ HTTP Server started on port 8080";
@@ -155,10 +166,11 @@ int main(int argc, char *argv[]) {
     qDebug() << "🎮 Starting Remote Control Server...";
     RemoteControlServer remoteServer;
     if (!remoteServer.start(2812)) {
-        qDebug() << "❌ Failed to start remote control server";
+        LOG_ERROR("PCClient", "Failed to start remote control server", {"port", 2812});
         return 1;
     }
     qDebug() << "✅ Remote Control Server started on port 2812";
+    remoteServer.connectToRelay(relayServer, relayPort, pcId);
     qDebug() << "";
     
     // Start File Server (try different HTTP ports until one works)
@@ -178,7 +190,7 @@ int main(int argc, char *argv[]) {
     }
 
     if (!fileServerStarted) {
-        qDebug() << "❌ Failed to start file server - no available HTTP ports";
+        LOG_ERROR("PCClient", "Failed to start file server, no available HTTP ports");
         return 1;
     }
     qDebug() << "";
@@ -192,8 +204,8 @@ int main(int argc, char *argv[]) {
     if (fileHandler->connect_to_relay(relayServer.toStdString(), relayPort) == 0) {
         qDebug() << "✅ File Handler connected to relay server";
     } else {
-        qDebug() << "❌ Failed to connect File Handler to relay server";
-        qDebug() << "⚠️  File operations will not work!";
+        LOG_ERROR("PCClient", "File Handler could not connect to relay, file operations will not work",
+                  {"host", relayServer.toStdString()}, {"port", relayPort});
     }
     qDebug() << "";
     // ============================================================
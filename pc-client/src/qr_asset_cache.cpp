@@ -0,0 +1,57 @@
+#include "../include/qr_asset_cache.h"
+#include "../include/qr_generator.h"
+#include "async_log.h"
+#include <sstream>
+#include <iomanip>
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+QRAssetCache::QRAssetCache(int size)
+    : version_(0)
+    , size_(size) {
+}
+
+std::string QRAssetCache::MakeETag(const std::string& data, uint64_t version) {
+    // FNV-1a over the encoded data; the version keeps tags unique per render
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+
+    std::ostringstream oss;
+    oss << "\"qr-" << version << "-" << std::hex << std::setw(16) << std::setfill('0') << hash << "\"";
+    return oss.str();
+}
+
+std::shared_ptr<const QRAsset> QRAssetCache::Update(const std::string& data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (current_ && current_->data == data) {
+        return current_;
+    }
+
+    auto asset = std::make_shared<QRAsset>();
+    if (!QRGenerator::GenerateAssets(data, size_, asset->png, asset->svg)) {
+        LOG_ERROR("QRAssetCache", "Failed to render QR assets");
+        return nullptr;
+    }
+
+    asset->version = ++version_;
+    asset->data = data;
+    asset->etag = MakeETag(data, asset->version);
+    current_ = asset;
+
+    LOG_INFO("QRAssetCache", "Rendered", {"version", asset->version}, {"png_bytes", asset->png.size()},
+             {"svg_bytes", asset->svg.size()});
+    return current_;
+}
+
+std::shared_ptr<const QRAsset> QRAssetCache::Get() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+}
+
+} // namespace Common
+} // namespace RemoteAccessSystem
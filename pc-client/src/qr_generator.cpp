@@ -1,69 +1,62 @@
 #include "../include/qr_generator.h"
 #include <qrencode.h>
 #include <png.h>
-#include <ace/Log_Msg.h>
+#include "async_log.h"
+#include <algorithm>
 #include <cstring>
 #include <sstream>
 
 namespace RemoteAccessSystem {
 namespace Common {
 
-std::vector<uint8_t> QRGenerator::GeneratePNG(const std::string& data, int size) {
+namespace {
+
+struct QRLayout {
+    int scale;
+    int margin;
+    int total_size;
+};
+
+QRLayout ComputeLayout(int qr_size, int size) {
+    QRLayout layout;
+    layout.scale = size / qr_size;
+    if (layout.scale < 1) layout.scale = 1;
+    layout.margin = layout.scale * 2;
+    layout.total_size = (qr_size * layout.scale) + (layout.margin * 2);
+    return layout;
+}
+
+// Renders the modules as a 1-bit palette PNG (index 0 = white, 1 = black).
+// Every module row is packed once and emitted `scale` times, so the encoder
+// only ever sees total_size / 8 bytes per row instead of total_size * 3.
+std::vector<uint8_t> RenderPNG(const QRcode* qr, int size) {
     std::vector<uint8_t> png_data;
-    
-    QRcode* qr = QRcode_encodeString(data.c_str(), 0, QR_ECLEVEL_M, QR_MODE_8, 1);
-    if (!qr) {
-        ACE_ERROR((LM_ERROR, "[QRGenerator] Failed to generate QR code\n"));
-        return png_data;
-    }
-    
+
     int qr_size = qr->width;
-    int scale = size / qr_size;
-    if (scale < 1) scale = 1;
-    int img_size = qr_size * scale;
-    int margin = scale * 2;
-    int total_size = img_size + (margin * 2);
-    
-    std::vector<uint8_t> image(total_size * total_size * 3, 255);
-    
-    for (int y = 0; y < qr_size; y++) {
-        for (int x = 0; x < qr_size; x++) {
-            if (qr->data[y * qr_size + x] & 1) {
-                for (int dy = 0; dy < scale; dy++) {
-                    for (int dx = 0; dx < scale; dx++) {
-                        int px = (x * scale + dx + margin);
-                        int py = (y * scale + dy + margin);
-                        int idx = (py * total_size + px) * 3;
-                        if (idx + 2 < (int)image.size()) {
-                            image[idx] = 0;
-                            image[idx + 1] = 0;
-                            image[idx + 2] = 0;
-                        }
-                    }
-                }
-            }
-        }
-    }
-    
-    QRcode_free(qr);
-    
+    QRLayout layout = ComputeLayout(qr_size, size);
+    size_t row_bytes = (layout.total_size + 7) / 8;
+
+    std::vector<uint8_t> blank_row(row_bytes, 0);
+    std::vector<uint8_t> module_row(row_bytes, 0);
+
     png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
     if (!png) {
-        ACE_ERROR((LM_ERROR, "[QRGenerator] Failed to create PNG write struct\n"));
+        LOG_ERROR("QRGenerator", "Failed to create PNG write struct");
         return png_data;
     }
-    
+
     png_infop info = png_create_info_struct(png);
     if (!info) {
         png_destroy_write_struct(&png, nullptr);
         return png_data;
     }
-    
+
     if (setjmp(png_jmpbuf(png))) {
         png_destroy_write_struct(&png, &info);
+        png_data.clear();
         return png_data;
     }
-    
+
     struct PNGWriter {
         static void write_data(png_structp png_ptr, png_bytep data, png_size_t length) {
             std::vector<uint8_t>* p = (std::vector<uint8_t>*)png_get_io_ptr(png_ptr);
@@ -71,54 +64,127 @@ std::vector<uint8_t> QRGenerator::GeneratePNG(const std::string& data, int size)
         }
         static void flush_data(png_structp png_ptr) {}
     };
-    
+
     png_set_write_fn(png, &png_data, PNGWriter::write_data, PNGWriter::flush_data);
-    png_set_IHDR(png, info, total_size, total_size, 8,
-                 PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+    png_set_IHDR(png, info, layout.total_size, layout.total_size, 1,
+                 PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
                  PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+    png_color palette[2] = {
+        {255, 255, 255},
+        {0, 0, 0}
+    };
+    png_set_PLTE(png, info, palette, 2);
+
+    // Row filters only cost time on bilevel images
+    png_set_filter(png, 0, PNG_FILTER_NONE);
     png_write_info(png, info);
-    
-    std::vector<png_bytep> rows(total_size);
-    for (int y = 0; y < total_size; y++) {
-        rows[y] = &image[y * total_size * 3];
+
+    for (int y = 0; y < layout.margin; y++) {
+        png_write_row(png, blank_row.data());
     }
-    png_write_image(png, rows.data());
+
+    for (int y = 0; y < qr_size; y++) {
+        std::fill(module_row.begin(), module_row.end(), 0);
+        for (int x = 0; x < qr_size; x++) {
+            if (!(qr->data[y * qr_size + x] & 1)) continue;
+
+            int px = layout.margin + x * layout.scale;
+            for (int dx = 0; dx < layout.scale; dx++, px++) {
+                module_row[px >> 3] |= static_cast<uint8_t>(0x80 >> (px & 7));
+            }
+        }
+
+        for (int dy = 0; dy < layout.scale; dy++) {
+            png_write_row(png, module_row.data());
+        }
+    }
+
+    for (int y = 0; y < layout.margin; y++) {
+        png_write_row(png, blank_row.data());
+    }
+
     png_write_end(png, nullptr);
     png_destroy_write_struct(&png, &info);
-    
-    ACE_DEBUG((LM_INFO, "[QRGenerator] Generated PNG: %zu bytes\n", png_data.size()));
+
     return png_data;
 }
 
-std::string QRGenerator::GenerateSVG(const std::string& data, int size) {
-    QRcode* qr = QRcode_encodeString(data.c_str(), 0, QR_ECLEVEL_M, QR_MODE_8, 1);
-    if (!qr) return "";
-    
+// Adjacent dark modules in a row are merged into a single <rect>
+std::string RenderSVG(const QRcode* qr, int size) {
     int qr_size = qr->width;
-    int scale = size / qr_size;
-    if (scale < 1) scale = 1;
-    int margin = scale * 2;
-    int total_size = (qr_size * scale) + (margin * 2);
-    
+    QRLayout layout = ComputeLayout(qr_size, size);
+
     std::ostringstream svg;
     svg << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
         << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" "
-        << "width=\"" << total_size << "\" height=\"" << total_size << "\">\n"
-        << "<rect width=\"" << total_size << "\" height=\"" << total_size << "\" fill=\"white\"/>\n"
+        << "width=\"" << layout.total_size << "\" height=\"" << layout.total_size << "\">\n"
+        << "<rect width=\"" << layout.total_size << "\" height=\"" << layout.total_size << "\" fill=\"white\"/>\n"
         << "<g fill=\"black\">\n";
-    
+
     for (int y = 0; y < qr_size; y++) {
-        for (int x = 0; x < qr_size; x++) {
-            if (qr->data[y * qr_size + x] & 1) {
-                svg << "<rect x=\"" << (x * scale + margin) << "\" y=\"" << (y * scale + margin) 
-                    << "\" width=\"" << scale << "\" height=\"" << scale << "\"/>\n";
+        int x = 0;
+        while (x < qr_size) {
+            if (!(qr->data[y * qr_size + x] & 1)) {
+                x++;
+                continue;
             }
+
+            int run_start = x;
+            while (x < qr_size && (qr->data[y * qr_size + x] & 1)) {
+                x++;
+            }
+
+            svg << "<rect x=\"" << (run_start * layout.scale + layout.margin)
+                << "\" y=\"" << (y * layout.scale + layout.margin)
+                << "\" width=\"" << ((x - run_start) * layout.scale)
+                << "\" height=\"" << layout.scale << "\"/>\n";
         }
     }
     svg << "</g>\n</svg>";
-    QRcode_free(qr);
     return svg.str();
 }
 
+} // namespace
+
+std::vector<uint8_t> QRGenerator::GeneratePNG(const std::string& data, int size) {
+    QRcode* qr = QRcode_encodeString(data.c_str(), 0, QR_ECLEVEL_M, QR_MODE_8, 1);
+    if (!qr) {
+        LOG_ERROR("QRGenerator", "Failed to generate QR code");
+        return {};
+    }
+
+    std::vector<uint8_t> png_data = RenderPNG(qr, size);
+    QRcode_free(qr);
+
+    LOG_INFO("QRGenerator", "Generated PNG", {"bytes", png_data.size()});
+    return png_data;
+}
+
+std::string QRGenerator::GenerateSVG(const std::string& data, int size) {
+    QRcode* qr = QRcode_encodeString(data.c_str(), 0, QR_ECLEVEL_M, QR_MODE_8, 1);
+    if (!qr) return "";
+
+    std::string svg = RenderSVG(qr, size);
+    QRcode_free(qr);
+    return svg;
+}
+
+bool QRGenerator::GenerateAssets(const std::string& data, int size,
+                                 std::vector<uint8_t>& png, std::string& svg) {
+    QRcode* qr = QRcode_encodeString(data.c_str(), 0, QR_ECLEVEL_M, QR_MODE_8, 1);
+    if (!qr) {
+        LOG_ERROR("QRGenerator", "Failed to generate QR code");
+        return false;
+    }
+
+    png = RenderPNG(qr, size);
+    svg = RenderSVG(qr, size);
+    QRcode_free(qr);
+
+    LOG_INFO("QRGenerator", "Generated assets", {"png_bytes", png.size()}, {"svg_bytes", svg.size()});
+    return !png.empty();
+}
+
 } // namespace Common
 } // namespace RemoteAccessSystem
@@ -1,8 +1,9 @@
 #include "relay_client.h"
 #include "../../common/include/utils.h"
 #include "../../common/include/crypto.h"
+#include "../../common/include/async_log.h"
 #include "file_manager.h"
-#include <ace/Log_Msg.h>
+#include <cstring>
 #include <numeric>
 #include <sstream>
 #include <fstream>
@@ -14,10 +15,8 @@ namespace RemoteAccessSystem {
 namespace Common {
 
 RelayClient::RelayClient()
-    : socket_()
-    , crypto_() {
-    key_ = Crypto::GenerateKey();
-    iv_ = Crypto::GenerateIV();
+    : socket_() {
+    send_buffer_.reserve(RecordLayer::MAX_RECORD);
 }
 
 RelayClient::~RelayClient() {
@@ -31,13 +30,66 @@ bool RelayClient::Connect(const std::string& relay_address) {
     ACE_SOCK_Connector connector;
     
     if (connector.connect(socket_, addr) == -1) {
-        ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("Failed to connect to relay server\n")), false);
+        LOG_ERROR("RelayClient", "Failed to connect to relay server");
+        return false;
     }
     
-    ACE_DEBUG((LM_INFO, ACE_TEXT("Connected to relay server: %s\n"), relay_address.c_str()));
+    LOG_INFO("RelayClient", "Connected to relay server", {"address", relay_address});
+    return Handshake();
+}
+
+bool RelayClient::Handshake() {
+    // Keys are agreed once per connection; messages only seal and open
+    records_.reset();
+    KeyExchange exchange;
+    SessionKeys keys;
+    SessionTicket next;
+    std::vector<unsigned char> reply;
+    
+    bool done = SendFrame(exchange.ClientHello(&ticket_)) && ReceiveFrame(reply) &&
+                exchange.ClientFinish(reply, keys, next);
+    if (!done && exchange.Retry()) {
+        // Ticket refused (relay restarted or it expired): full exchange
+        ticket_ = SessionTicket();
+        done = SendFrame(exchange.ClientHello()) && ReceiveFrame(reply) &&
+               exchange.ClientFinish(reply, keys, next);
+    }
+    if (!done) {
+        ticket_ = SessionTicket();
+        LOG_ERROR("RelayClient", "Key exchange with relay server failed");
+        return false;
+    }
+    
+    ticket_ = std::move(next);
+    records_.reset(new RecordLayer(CipherSuite::AES_256_GCM,
+                                   keys.client_key, keys.client_iv,
+                                   keys.server_key, keys.server_iv));
+    
+    LOG_INFO("RelayClient", "Session keys established", {"handshake", exchange.Resumed() ? "resumed" : "full"});
     return true;
 }
 
+// Handshake messages: u32 size prefix and the raw bytes, like sealed
+// messages but before any keys exist
+bool RelayClient::SendFrame(const std::vector<unsigned char>& data) {
+    uint32_t size = data.size();
+    iovec iov[2];
+    iov[0].iov_base = &size;
+    iov[0].iov_len = sizeof(size);
+    iov[1].iov_base = const_cast<unsigned char*>(data.data());
+    iov[1].iov_len = data.size();
+    return socket_.sendv_n(iov, 2) != -1;
+}
+
+bool RelayClient::ReceiveFrame(std::vector<unsigned char>& data) {
+    uint32_t size;
+    if (socket_.recv_n(&size, sizeof(size)) == -1 || size > RecordLayer::MAX_RECORD) {
+        return false;
+    }
+    data.resize(size);
+    return size == 0 || socket_.recv_n(data.data(), size) != -1;
+}
+
 bool RelayClient::Register(const std::string& pc_id) {
     Message msg;
     msg.type = MessageType::AUTH_REQUEST;
@@ -49,41 +101,71 @@ bool RelayClient::Register(const std::string& pc_id) {
 }
 
 bool RelayClient::SendMessage(const Message& msg) {
+    if (!records_) {
+        LOG_ERROR("RelayClient", "Not connected to relay server");
+        return false;
+    }
+    
     // Serialize message
     std::vector<unsigned char> data = SerializeMessage(msg);
     
-    // Encrypt data
-    std::vector<unsigned char> encrypted = crypto_.Encrypt(data, key_, iv_);
+    // Seal as 16 KB AES-GCM records into the reused send buffer
+    send_buffer_.clear();
+    records_->SealStream(data.data(), data.size(), send_buffer_);
     
-    // Send size first
-    uint32_t size = encrypted.size();
-    if (socket_.send_n(&size, sizeof(size)) == -1) {
-        ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("Failed to send message size\n")), false);
-    }
+    // Size prefix and records in one gathered write
+    uint32_t size = send_buffer_.size();
+    iovec iov[2];
+    iov[0].iov_base = &size;
+    iov[0].iov_len = sizeof(size);
+    iov[1].iov_base = send_buffer_.data();
+    iov[1].iov_len = send_buffer_.size();
     
-    // Send encrypted data
-    if (socket_.send_n(encrypted.data(), encrypted.size()) == -1) {
-        ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("Failed to send message data\n")), false);
+    if (socket_.sendv_n(iov, 2) == -1) {
+        LOG_ERROR("RelayClient", "Failed to send message");
+        return false;
     }
     
     return true;
 }
 
 bool RelayClient::ReceiveMessage(Message& msg) {
+    if (!records_) {
+        LOG_ERROR("RelayClient", "Not connected to relay server");
+        return false;
+    }
+    
     // Receive size
     uint32_t size;
     if (socket_.recv_n(&size, sizeof(size)) == -1) {
-        ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("Failed to receive message size\n")), false);
+        LOG_ERROR("RelayClient", "Failed to receive message size");
+        return false;
     }
     
-    // Receive encrypted data
-    std::vector<unsigned char> encrypted(size);
-    if (socket_.recv_n(encrypted.data(), size) == -1) {
-        ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("Failed to receive message data\n")), false);
+    // Receive sealed records
+    recv_buffer_.resize(size);
+    if (socket_.recv_n(recv_buffer_.data(), size) == -1) {
+        LOG_ERROR("RelayClient", "Failed to receive message data");
+        return false;
     }
     
-    // Decrypt data
-    std::vector<unsigned char> data = crypto_.Decrypt(encrypted, key_, iv_);
+    // Open each record in place and gather the plaintext
+    std::vector<unsigned char> data;
+    data.reserve(size);
+    size_t offset = 0;
+    while (offset < size) {
+        unsigned char* record = recv_buffer_.data() + offset;
+        size_t record_size = size - offset >= RecordLayer::HEADER_SIZE
+            ? RecordLayer::RecordSizeFromHeader(record) : 0;
+        size_t length = 0;
+        if (record_size == 0 || record_size > size - offset ||
+            !records_->Open(record, record_size, record + RecordLayer::HEADER_SIZE, length)) {
+            LOG_ERROR("RelayClient", "Failed to authenticate message");
+            return false;
+        }
+        data.insert(data.end(), record + RecordLayer::HEADER_SIZE, record + RecordLayer::HEADER_SIZE + length);
+        offset += record_size;
+    }
     
     // Deserialize message
     msg = DeserializeMessage(data);
@@ -183,7 +265,7 @@ bool RelayClient::HandleMessage(const Message& message, Message& response) {
         }
         
         default:
-            ACE_ERROR((LM_ERROR, ACE_TEXT("Unknown message type: %d\n"), static_cast<int>(message.type)));
+            LOG_WARN("RelayClient", "Unknown message type", {"type", static_cast<int>(message.type)});
             return false;
     }
     return true;
@@ -207,13 +289,13 @@ bool RelayClient::HandleDownload(const std::string& file_path, Message& response
         response.type = MessageType::FILE_DOWNLOAD;
         response.payload = fm.ReadFile(file_path);
         
-        ACE_DEBUG((LM_INFO, ACE_TEXT("Download completed: %s\n"), file_path.c_str()));
+        LOG_INFO("RelayClient", "Download completed", {"path", file_path});
         return true;
         
     } catch (const std::exception& e) {
         response.type = MessageType::FILE_DOWNLOAD;
         response.payload = Utils::StringToBytes(std::string("ERROR|") + e.what());
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Download error: %s\n"), e.what()));
+        LOG_ERROR("RelayClient", "Download failed", {"error", e.what()});
         return false;
     }
 }
@@ -243,14 +325,13 @@ bool RelayClient::HandleCopy(const std::string& source_path, const std::string&
         response.type = MessageType::FILE_COPY;
         response.payload = Utils::StringToBytes("COPY_SUCCESS");
         
-        ACE_DEBUG((LM_INFO, ACE_TEXT("Copy completed: %s -> %s\n"), 
-                   source_path.c_str(), dest.string().c_str()));
+        LOG_INFO("RelayClient", "Copy completed", {"from", source_path}, {"to", dest.string()});
         return true;
         
     } catch (const std::exception& e) {
         response.type = MessageType::FILE_COPY;
         response.payload = Utils::StringToBytes(std::string("ERROR|Copy failed: ") + e.what());
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Copy error: %s\n"), e.what()));
+        LOG_ERROR("RelayClient", "Copy failed", {"error", e.what()});
         return false;
     }
 }
@@ -275,14 +356,13 @@ bool RelayClient::HandleMove(const std::string& source_path, const std::string&
         response.type = MessageType::FILE_MOVE;
         response.payload = Utils::StringToBytes("MOVE_SUCCESS");
         
-        ACE_DEBUG((LM_INFO, ACE_TEXT("Move completed: %s -> %s\n"), 
-                   source_path.c_str(), dest.string().c_str()));
+        LOG_INFO("RelayClient", "Move completed", {"from", source_path}, {"to", dest.string()});
         return true;
         
     } catch (const std::exception& e) {
         response.type = MessageType::FILE_MOVE;
         response.payload = Utils::StringToBytes(std::string("ERROR|Move failed: ") + e.what());
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Move error: %s\n"), e.what()));
+        LOG_ERROR("RelayClient", "Move failed", {"error", e.what()});
         return false;
     }
 }
@@ -306,14 +386,13 @@ bool RelayClient::HandleRename(const std::string& old_path, const std::string& n
         response.type = MessageType::FILE_RENAME;
         response.payload = Utils::StringToBytes("RENAME_SUCCESS");
         
-        ACE_DEBUG((LM_INFO, ACE_TEXT("Rename completed: %s -> %s\n"), 
-                   old_path.c_str(), new_path.c_str()));
+        LOG_INFO("RelayClient", "Rename completed", {"from", old_path}, {"to", new_path});
         return true;
         
     } catch (const std::exception& e) {
         response.type = MessageType::FILE_RENAME;
         response.payload = Utils::StringToBytes(std::string("ERROR|Rename failed: ") + e.what());
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Rename error: %s\n"), e.what()));
+        LOG_ERROR("RelayClient", "Rename failed", {"error", e.what()});
         return false;
     }
 }
@@ -335,13 +414,13 @@ bool RelayClient::HandleDelete(const std::string& file_path, Message& response)
         response.type = MessageType::FILE_DELETE;
         response.payload = Utils::StringToBytes("DELETE_SUCCESS");
         
-        ACE_DEBUG((LM_INFO, ACE_TEXT("Delete completed: %s\n"), file_path.c_str()));
+        LOG_INFO("RelayClient", "Delete completed", {"path", file_path});
         return true;
         
     } catch (const std::exception& e) {
         response.type = MessageType::FILE_DELETE;
         response.payload = Utils::StringToBytes(std::string("ERROR|Delete failed: ") + e.what());
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Delete error: %s\n"), e.what()));
+        LOG_ERROR("RelayClient", "Delete failed", {"error", e.what()});
         return false;
     }
 }
@@ -359,41 +438,38 @@ bool RelayClient::HandleCreateFolder(const std::string& folder_path, Message& re
         response.type = MessageType::CREATE_FOLDER;
         response.payload = Utils::StringToBytes("CREATE_FOLDER_SUCCESS");
         
-        ACE_DEBUG((LM_INFO, ACE_TEXT("Folder created: %s\n"), folder_path.c_str()));
+        LOG_INFO("RelayClient", "Folder created", {"path", folder_path});
         return true;
         
     } catch (const std::exception& e) {
         response.type = MessageType::CREATE_FOLDER;
         response.payload = Utils::StringToBytes(std::string("ERROR|Create folder failed: ") + e.what());
-        ACE_ERROR((LM_ERROR, ACE_TEXT("Create folder error: %s\n"), e.what()));
+        LOG_ERROR("RelayClient", "Create folder failed", {"error", e.what()});
         return false;
     }
 }
 
 std::vector<unsigned char> RelayClient::SerializeMessage(const Message& msg) {
-    std::vector<unsigned char> data;
+    // type(1) message_id(8) timestamp(8) payload_size(4), little-endian
+    const size_t header_size = 21;
+    std::vector<unsigned char> data(header_size + msg.payload.size());
+    unsigned char* out = data.data();
     
-    // Add type
-    data.push_back(static_cast<unsigned char>(msg.type));
-    
-    // Add message_id (8 bytes)
+    *out++ = static_cast<unsigned char>(msg.type);
     for (int i = 0; i < 8; ++i) {
-        data.push_back((msg.message_id >> (i * 8)) & 0xFF);
+        *out++ = (msg.message_id >> (i * 8)) & 0xFF;
     }
-    
-    // Add timestamp (8 bytes)
     for (int i = 0; i < 8; ++i) {
-        data.push_back((msg.timestamp >> (i * 8)) & 0xFF);
+        *out++ = (msg.timestamp >> (i * 8)) & 0xFF;
     }
-    
-    // Add payload size (4 bytes)
     uint32_t payload_size = msg.payload.size();
     for (int i = 0; i < 4; ++i) {
-        data.push_back((payload_size >> (i * 8)) & 0xFF);
+        *out++ = (payload_size >> (i * 8)) & 0xFF;
     }
     
-    // Add payload
-    data.insert(data.end(), msg.payload.begin(), msg.payload.end());
+    if (!msg.payload.empty()) {
+        std::memcpy(out, msg.payload.data(), msg.payload.size());
+    }
     
     return data;
 }
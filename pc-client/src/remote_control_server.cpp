@@ -1,25 +1,107 @@
 #include "remote_control_server.h"
-#include <QDebug>
+#include "protocol.h"
+#include "async_log.h"
+#include <QMetaObject>
+#include <X11/keysym.h>
+#include <netinet/ip.h>
+#include <chrono>
+
+static uint64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// KEY_PRESS carries a Qt::Key code. Latin-1 keys share their value with
+// the X keysym; other printable characters use the Unicode keysym range.
+static KeySym keysymForQtKey(int key) {
+    if (key > 0 && key < 0x100) return key;
+    if (key >= 0x100 && key < 0x01000000) return 0x01000000 | key;
+    
+    if (key >= Qt::Key_F1 && key <= Qt::Key_F24) return XK_F1 + (key - Qt::Key_F1);
+    
+    switch (key) {
+    case Qt::Key_Escape:    return XK_Escape;
+    case Qt::Key_Tab:       return XK_Tab;
+    case Qt::Key_Backtab:   return XK_ISO_Left_Tab;
+    case Qt::Key_Backspace: return XK_BackSpace;
+    case Qt::Key_Return:    return XK_Return;
+    case Qt::Key_Enter:     return XK_KP_Enter;
+    case Qt::Key_Insert:    return XK_Insert;
+    case Qt::Key_Delete:    return XK_Delete;
+    case Qt::Key_Pause:     return XK_Pause;
+    case Qt::Key_Print:     return XK_Print;
+    case Qt::Key_Home:      return XK_Home;
+    case Qt::Key_End:       return XK_End;
+    case Qt::Key_Left:      return XK_Left;
+    case Qt::Key_Up:        return XK_Up;
+    case Qt::Key_Right:     return XK_Right;
+    case Qt::Key_Down:      return XK_Down;
+    case Qt::Key_PageUp:    return XK_Page_Up;
+    case Qt::Key_PageDown:  return XK_Page_Down;
+    case Qt::Key_Shift:     return XK_Shift_L;
+    case Qt::Key_Control:   return XK_Control_L;
+    case Qt::Key_Meta:      return XK_Super_L;
+    case Qt::Key_Alt:       return XK_Alt_L;
+    case Qt::Key_CapsLock:  return XK_Caps_Lock;
+    case Qt::Key_NumLock:   return XK_Num_Lock;
+    case Qt::Key_Menu:      return XK_Menu;
+    default:                return NoSymbol;
+    }
+}
 
 RemoteControlServer::RemoteControlServer(QObject *parent)
-    : QObject(parent), m_server(new QTcpServer(this)) {
+    : QObject(parent), m_server(new QTcpServer(this)), m_motionTimer(new QTimer(this)),
+      m_relayPort(0), m_parkRetryTimer(new QTimer(this)),
+      m_inputSocket(nullptr), m_inputRetryTimer(nullptr), m_haveInputBaseline(false),
+      m_inputBaseline(0), m_inputSamplesLogged(0), m_pacer(100) {
     
     connect(m_server, &QTcpServer::newConnection, this, &RemoteControlServer::handleNewConnection);
+    
+    m_motionTimer->setSingleShot(true);
+    m_motionTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_motionTimer, &QTimer::timeout, this, &RemoteControlServer::flushInput);
+    
+    m_parkRetryTimer->setSingleShot(true);
+    m_parkRetryTimer->setInterval(5000);
+    connect(m_parkRetryTimer, &QTimer::timeout, this, &RemoteControlServer::parkControlSocket);
+    
+    QTimer *statsTimer = new QTimer(this);
+    connect(statsTimer, &QTimer::timeout, this, [this]() {
+        if (m_inputLatency.count() != m_inputSamplesLogged) {
+            m_inputSamplesLogged = m_inputLatency.count();
+            LOG_INFO("RemoteControl", "Input latency", {"summary", m_inputLatency.summary()});
+        }
+    });
+    statsTimer->start(30000);
+}
+
+RemoteControlServer::~RemoteControlServer() {
+    stopScreenShare();
 }
 
 bool RemoteControlServer::start(int port) {
     if (!m_server->listen(QHostAddress::Any, port)) {
-        qDebug() << "[RemoteControl] Failed to start on port" << port;
+        LOG_ERROR("RemoteControl", "Failed to start", {"port", port});
         return false;
     }
     
-    qDebug() << "[RemoteControl] Server started on port" << port;
+    if (!m_injector.init()) {
+        LOG_WARN("RemoteControl", "Input injection unavailable, events will be ignored");
+    }
+    
+    LOG_INFO("RemoteControl", "Server started", {"port", port});
     return true;
 }
 
 void RemoteControlServer::handleNewConnection() {
     QTcpSocket *client = m_server->nextPendingConnection();
-    qDebug() << "[RemoteControl] New client connected:" << client->peerAddress();
+    LOG_INFO("RemoteControl", "New client connected", {"address", client->peerAddress().toString().toStdString()});
+    attachClient(client);
+}
+
+// Shared by LAN clients and relay sessions: from here on both look the same
+void RemoteControlServer::attachClient(QTcpSocket *client) {
+    client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
     
     // Send connection established message
     client->write("CONNECTION_ESTABLISHED\n");
@@ -29,41 +111,376 @@ void RemoteControlServer::handleNewConnection() {
         handleClientCommand(client);
     });
     
-    connect(client, &QTcpSocket::disconnected, this, [client]() {
-        qDebug() << "[RemoteControl] Client disconnected";
+    connect(client, &QTcpSocket::disconnected, this, [this, client]() {
+        LOG_INFO("RemoteControl", "Client disconnected");
+        if (m_screenClient == client) {
+            stopScreenShare();
+        }
+        m_buffers.remove(client);
         client->deleteLater();
     });
 }
 
 void RemoteControlServer::handleClientCommand(QTcpSocket *client) {
-    QByteArray data = client->readAll();
-    QString command = QString::fromUtf8(data).trimmed();
+    // One read may hold several commands, or end halfway through one
+    QByteArray &buffer = m_buffers[client];
+    buffer.append(client->readAll());
     
-    qDebug() << "[RemoteControl] Command:" << command;
+    int start = 0;
+    int newline;
+    while ((newline = buffer.indexOf('\n', start)) >= 0) {
+        handleLine(client, buffer.mid(start, newline - start));
+        start = newline + 1;
+    }
+    buffer.remove(0, start);
     
-    QStringList parts = command.split('|');
-    if (parts.isEmpty()) return;
+    // Whole batch goes to the X server in one flush
+    flushInput();
+}
+
+void RemoteControlServer::flushInput() {
+    uint64_t waitUs = m_injector.flush(nowUs());
+    if (waitUs > 0 && !m_motionTimer->isActive()) {
+        m_motionTimer->start(static_cast<int>((waitUs + 999) / 1000));
+    }
+}
+
+void RemoteControlServer::handleLine(QTcpSocket *client, const QByteArray &line) {
+    QString command = QString::fromUtf8(line).trimmed();
+    if (command.isEmpty()) return;
     
+    QStringList parts = command.split('|');
     QString cmd = parts[0];
     
     if (cmd == "MOUSE_MOVE" && parts.size() >= 3) {
-        int x = parts[1].toInt();
-        int y = parts[2].toInt();
-        // TODO: Implement actual mouse movement using X11
-        qDebug() << "[RemoteControl] Mouse move:" << x << y;
+        m_injector.moveTo(parts[1].toInt(), parts[2].toInt());
         
     } else if (cmd == "MOUSE_CLICK" && parts.size() >= 2) {
-        int button = parts[1].toInt();
-        // TODO: Implement actual mouse click using X11
-        qDebug() << "[RemoteControl] Mouse click:" << button;
+        // X button numbers: 1 left, 2 middle, 3 right, 4/5 wheel
+        int button = qMax(1, parts[1].toInt());
+        m_injector.button(button, true);
+        m_injector.button(button, false);
         
     } else if (cmd == "KEY_PRESS" && parts.size() >= 2) {
         int key = parts[1].toInt();
-        // TODO: Implement actual key press using X11
-        qDebug() << "[RemoteControl] Key press:" << key;
+        KeySym keysym = keysymForQtKey(key);
+        if (keysym == NoSymbol || !m_injector.key(keysym, true)) {
+            LOG_DEBUG("RemoteControl", "No keycode for key", {"key", key});
+            return;
+        }
+        m_injector.key(keysym, false);
+        
+    } else if (cmd == "SCREEN_SHARE_REQUEST") {
+        int fps = parts.size() >= 2 ? parts[1].toInt() : 15;
+        startScreenShare(client, fps);
+        
+    } else if (cmd == "INPUT_STATS") {
+        client->write(("INPUT_STATS|" + inputLatencySummary() + "\n").toUtf8());
+        
+    } else if (cmd == "FRAME_ACK" && parts.size() >= 2) {
+        m_pacer.onAck(parts[1].toULongLong(), nowUs());
+        
+    } else if (cmd == "SCREEN_SHARE_STOP") {
+        stopScreenShare();
         
     } else if (cmd == "DISCONNECT") {
-        qDebug() << "[RemoteControl] Client requested disconnect";
+        LOG_INFO("RemoteControl", "Client requested disconnect");
         client->disconnectFromHost();
+        
+    } else {
+        LOG_WARN("RemoteControl", "Unknown command", {"command", command.toStdString()});
+    }
+}
+
+void RemoteControlServer::connectToRelay(const QString &relayServer, int relayPort,
+                                         const QString &pcId) {
+    m_relayServer = relayServer;
+    m_relayPort = relayPort;
+    m_pcId = pcId;
+    
+    parkControlSocket();
+    connectInputChannel();
+}
+
+// The PC has no listening port reachable from outside, so it keeps one
+// outbound connection parked at the relay. CONNECT_TO_PC from a mobile is
+// paired with it, the relay writes CONTROL_SESSION, and from then on the
+// socket carries the normal control protocol. Another one is parked right
+// away for the next session.
+void RemoteControlServer::parkControlSocket() {
+    if (m_parkedSocket) return;
+    
+    QTcpSocket *socket = new QTcpSocket(this);
+    m_parkedSocket = socket;
+    
+    connect(socket, &QTcpSocket::connected, this, [this, socket]() {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        socket->setSocketOption(QAbstractSocket::TypeOfServiceOption, IPTOS_LOWDELAY);
+        socket->write(QString("CONTROL_REGISTER|%1\n").arg(m_pcId).toUtf8());
+    });
+    
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+        if (!socket->canReadLine()) return;
+        
+        QByteArray line = socket->readLine().trimmed();
+        if (line != "CONTROL_SESSION") {
+            LOG_WARN("RemoteControl", "Relay refused control socket", {"reply", line.toStdString()});
+            socket->abort();
+            return;
+        }
+        
+        LOG_INFO("RemoteControl", "Relay session started");
+        disconnect(socket, nullptr, this, nullptr);
+        m_parkedSocket.clear();
+        attachClient(socket);
+        
+        // Commands that arrived along with the session marker
+        if (socket->bytesAvailable() > 0) {
+            handleClientCommand(socket);
+        }
+        parkControlSocket();
+    });
+    
+    auto retry = [this, socket]() {
+        if (m_parkedSocket == socket) {
+            m_parkedSocket.clear();
+            socket->deleteLater();
+            m_parkRetryTimer->start();
+        }
+    };
+    connect(socket, &QTcpSocket::disconnected, this, retry);
+    connect(socket, &QTcpSocket::errorOccurred, this, [socket, retry](QAbstractSocket::SocketError) {
+        if (socket->state() == QAbstractSocket::UnconnectedState) {
+            retry();
+        }
+    });
+    
+    socket->connectToHost(m_relayServer, m_relayPort);
+}
+
+void RemoteControlServer::connectInputChannel() {
+    if (!m_inputSocket) {
+        m_inputSocket = new QTcpSocket(this);
+        
+        connect(m_inputSocket, &QTcpSocket::connected, this, [this]() {
+            m_inputSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            m_inputSocket->setSocketOption(QAbstractSocket::TypeOfServiceOption, IPTOS_LOWDELAY);
+            m_inputSocket->write(QString("INPUT_REGISTER|%1\n").arg(m_pcId).toUtf8());
+            m_inputBuffer.clear();
+            m_haveInputBaseline = false;
+            LOG_INFO("RemoteControl", "Input channel registered with relay");
+        });
+        
+        connect(m_inputSocket, &QTcpSocket::readyRead, this, &RemoteControlServer::handleInputData);
+        
+        // Both signals can fire for one failure; restarting the timer
+        // keeps it to a single reconnect attempt
+        m_inputRetryTimer = new QTimer(this);
+        m_inputRetryTimer->setSingleShot(true);
+        m_inputRetryTimer->setInterval(5000);
+        connect(m_inputRetryTimer, &QTimer::timeout, this, [this]() {
+            m_inputSocket->connectToHost(m_relayServer, m_relayPort);
+        });
+        
+        connect(m_inputSocket, &QTcpSocket::disconnected, this, [this]() {
+            LOG_WARN("RemoteControl", "Input channel lost, reconnecting in 5s");
+            m_inputRetryTimer->start();
+        });
+        
+        connect(m_inputSocket, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError) {
+            if (m_inputSocket->state() == QAbstractSocket::UnconnectedState) {
+                m_inputRetryTimer->start();
+            }
+        });
+    }
+    
+    m_inputSocket->abort();
+    m_inputSocket->connectToHost(m_relayServer, m_relayPort);
+}
+
+void RemoteControlServer::handleInputData() {
+    using RemoteAccessSystem::InputFrame;
+    
+    uint64_t received = nowUs();
+    m_inputBuffer.append(m_inputSocket->readAll());
+    
+    // Inject every complete frame as it is parsed; a partial one stays buffered
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(m_inputBuffer.constData());
+    int offset = 0;
+    bool injectedAny = false;
+    InputFrame last = {};
+    while (m_inputBuffer.size() - offset >= static_cast<int>(InputFrame::kSize)) {
+        InputFrame frame;
+        if (frame.decode(data + offset) && frame.type != InputFrame::ACK) {
+            applyInputFrame(frame);
+            last = frame;
+            injectedAny = true;
+        }
+        offset += InputFrame::kSize;
+    }
+    m_inputBuffer.remove(0, offset);
+    
+    if (!injectedAny) return;
+    
+    // One flush and one ack for the last event of the read
+    flushInput();
+    
+    uint64_t injected = nowUs();
+    recordInputLatency(last.timestampUs, injected);
+    
+    InputFrame ack;
+    ack.type = InputFrame::ACK;
+    ack.button = 0;
+    ack.sequence = last.sequence;
+    ack.timestampUs = last.timestampUs;
+    ack.x = ack.y = 0;
+    ack.value = static_cast<uint32_t>(injected - received);
+    
+    char encoded[InputFrame::kSize];
+    ack.encode(reinterpret_cast<uint8_t*>(encoded));
+    m_inputSocket->write(encoded, sizeof(encoded));
+}
+
+void RemoteControlServer::applyInputFrame(const RemoteAccessSystem::InputFrame &frame) {
+    using RemoteAccessSystem::InputFrame;
+    
+    switch (frame.type) {
+    case InputFrame::MOVE:
+        m_injector.moveTo(frame.x, frame.y);
+        break;
+    case InputFrame::BUTTON_DOWN:
+    case InputFrame::BUTTON_UP:
+        m_injector.button(qMax(1, int(frame.button)), frame.type == InputFrame::BUTTON_DOWN);
+        break;
+    case InputFrame::SCROLL: {
+        // Wheel steps are X buttons 4 (up) and 5 (down)
+        int button = frame.y > 0 ? 4 : 5;
+        for (int i = 0; i < qAbs(int(frame.y)); i++) {
+            m_injector.button(button, true);
+            m_injector.button(button, false);
+        }
+        break;
+    }
+    case InputFrame::KEY_DOWN:
+    case InputFrame::KEY_UP: {
+        KeySym keysym = keysymForQtKey(static_cast<int>(frame.value));
+        if (keysym != NoSymbol) {
+            m_injector.key(keysym, frame.type == InputFrame::KEY_DOWN);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// The sender's clock is unrelated to ours, so receive - send is offset by
+// an unknown constant. Its minimum approximates the uncongested path;
+// what is recorded is the delay on top of that.
+void RemoteControlServer::recordInputLatency(uint32_t senderTimestampUs, uint64_t injectedUs) {
+    uint32_t oneWay = static_cast<uint32_t>(injectedUs) - senderTimestampUs;
+    int32_t excess = static_cast<int32_t>(oneWay - m_inputBaseline);
+    
+    // A new sender (different clock) shows up as a jump of many seconds
+    if (!m_haveInputBaseline || excess < 0 || excess > 10000000) {
+        m_inputBaseline = oneWay;
+        m_haveInputBaseline = true;
+        excess = 0;
+    }
+    m_inputLatency.record(static_cast<uint64_t>(excess));
+}
+
+QString RemoteControlServer::inputLatencySummary() const {
+    return QString::fromStdString(m_inputLatency.summary());
+}
+
+void RemoteControlServer::startScreenShare(QTcpSocket *client, int fps) {
+    if (m_capture.isRunning()) {
+        if (m_screenClient == client) {
+            m_pacer.reset({ fps, m_pacer.settings().quality, 1 });
+            LOG_INFO("RemoteControl", "Screen share frame rate changed", {"fps", m_capture.frameRate()});
+            return;
+        }
+        stopScreenShare();
+    }
+    
+    if (!m_capture.init()) {
+        client->write("SCREEN_SHARE_RESPONSE|ERROR|Screen capture unavailable\n");
+        client->flush();
+        return;
+    }
+    
+    m_screenClient = client;
+    m_differ.reset();
+    m_pacer.reset({ fps, 70, 1 });
+    
+    QString response = QString("SCREEN_SHARE_RESPONSE|OK|%1|%2\n")
+        .arg(m_capture.width()).arg(m_capture.height());
+    client->write(response.toUtf8());
+    client->flush();
+    
+    m_capture.start(fps, [this](const CapturedFrame &frame) {
+        sendFrame(frame);
+    });
+    
+    LOG_INFO("RemoteControl", "Screen share started", {"fps", m_capture.frameRate()});
+}
+
+void RemoteControlServer::stopScreenShare() {
+    if (!m_capture.isRunning()) return;
+    
+    m_capture.stop();
+    m_screenClient.clear();
+    LOG_INFO("RemoteControl", "Screen share stopped");
+}
+
+// Runs on the capture thread
+void RemoteControlServer::sendFrame(const CapturedFrame &frame) {
+    // Damage from skipped frames is kept so the next diff still covers it
+    m_differ.addDamage(frame.damage);
+    
+    // Drop the frame rather than queue it behind a congested link
+    uint64_t now = nowUs();
+    if (!m_pacer.canSend(now)) {
+        return;
     }
-}
\ No newline at end of file
+    
+    if (m_pacer.takeSettingsChanged()) {
+        PacingSettings pacing = m_pacer.settings();
+        m_capture.setFrameRate(pacing.fps);
+        EncoderSettings encoding = m_encoder.settings();
+        encoding.quality = pacing.quality;
+        encoding.scale = pacing.scale;
+        m_encoder.setSettings(encoding);
+    }
+    
+    std::vector<CaptureRect> dirty;
+    m_differ.diff(frame, dirty);
+    if (dirty.empty()) {
+        return;
+    }
+    
+    RemoteAccessSystem::ScreenFrame screenFrame;
+    screenFrame.width = frame.width;
+    screenFrame.height = frame.height;
+    screenFrame.format = TILE_FORMAT_RGB; // per-tile formats in tiles[i].format
+    m_encoder.encode(frame, dirty, screenFrame.tiles);
+    
+    // SCREEN_FRAME|<payload bytes>|<sequence>; the client acks the sequence
+    // Tiles are serialized straight into the outgoing buffer, one copy
+    size_t payloadSize = screenFrame.serializedSize();
+    QByteArray message = QByteArray("SCREEN_FRAME|") + QByteArray::number(qulonglong(payloadSize))
+                       + "|" + QByteArray::number(qulonglong(frame.sequence)) + "\n";
+    int headerSize = message.size();
+    message.resize(headerSize + static_cast<int>(payloadSize));
+    screenFrame.serializeTo(message.data() + headerSize, payloadSize);
+    
+    m_pacer.onFrameSent(frame.sequence, message.size(), now);
+    
+    QMetaObject::invokeMethod(this, [this, message]() {
+        if (m_screenClient) {
+            m_screenClient->write(message);
+            m_screenClient->flush();
+        }
+    }, Qt::QueuedConnection);
+}
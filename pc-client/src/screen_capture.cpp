@@ -0,0 +1,347 @@
+#include "screen_capture.h"
+#include "async_log.h"
+#include <X11/Xutil.h>
+#include <X11/extensions/Xfixes.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// Beyond this many damage rectangles one bounding-box grab is cheaper than
+// a round trip per rectangle
+const int kMaxDamageRects = 16;
+
+uint64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+ScreenCapture::ScreenCapture()
+    : m_display(nullptr), m_root(0), m_width(0), m_height(0),
+      m_image(nullptr), m_shmAttached(false),
+      m_damageAvailable(false), m_damageEventBase(0), m_damage(0),
+      m_sequence(0), m_running(false), m_fps(15)
+{
+    std::memset(&m_shmInfo, 0, sizeof(m_shmInfo));
+    m_shmInfo.shmid = -1;
+    m_shmInfo.shmaddr = reinterpret_cast<char*>(-1);
+}
+
+ScreenCapture::~ScreenCapture()
+{
+    stop();
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+    cleanup();
+}
+
+bool ScreenCapture::init(const char* displayName)
+{
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+    if (m_display) {
+        return true;
+    }
+
+    m_display = XOpenDisplay(displayName);
+    if (!m_display) {
+        LOG_ERROR("ScreenCapture", "Cannot open display", {"display", displayName ? displayName : "$DISPLAY"});
+        return false;
+    }
+
+    int screen = DefaultScreen(m_display);
+    m_root = RootWindow(m_display, screen);
+    m_width = DisplayWidth(m_display, screen);
+    m_height = DisplayHeight(m_display, screen);
+
+    if (!XShmQueryExtension(m_display)) {
+        LOG_ERROR("ScreenCapture", "MIT-SHM extension not available");
+        cleanup();
+        return false;
+    }
+
+    m_image = XShmCreateImage(m_display, DefaultVisual(m_display, screen),
+                              DefaultDepth(m_display, screen), ZPixmap,
+                              nullptr, &m_shmInfo, m_width, m_height);
+    if (!m_image || m_image->bits_per_pixel != 32) {
+        LOG_ERROR("ScreenCapture", "Unsupported visual (need 32bpp ZPixmap)");
+        cleanup();
+        return false;
+    }
+
+    // One segment sized for the whole screen, reused for every grab
+    m_shmInfo.shmid = shmget(IPC_PRIVATE, m_image->bytes_per_line * m_image->height,
+                             IPC_CREAT | 0600);
+    if (m_shmInfo.shmid < 0) {
+        LOG_ERROR("ScreenCapture", "shmget failed", {"error", strerror(errno)});
+        cleanup();
+        return false;
+    }
+
+    m_shmInfo.shmaddr = m_image->data = static_cast<char*>(shmat(m_shmInfo.shmid, nullptr, 0));
+    m_shmInfo.readOnly = False;
+    if (m_shmInfo.shmaddr == reinterpret_cast<char*>(-1)) {
+        LOG_ERROR("ScreenCapture", "shmat failed", {"error", strerror(errno)});
+        cleanup();
+        return false;
+    }
+
+    if (!XShmAttach(m_display, &m_shmInfo)) {
+        LOG_ERROR("ScreenCapture", "XShmAttach failed");
+        cleanup();
+        return false;
+    }
+    XSync(m_display, False);
+    m_shmAttached = true;
+
+    // Mark for removal now so the segment cannot leak if we crash
+    shmctl(m_shmInfo.shmid, IPC_RMID, nullptr);
+
+    m_framebuffer.assign(static_cast<size_t>(m_width) * 4 * m_height, 0);
+
+    int damageErrorBase = 0;
+    int fixesEventBase = 0, fixesErrorBase = 0;
+    if (XDamageQueryExtension(m_display, &m_damageEventBase, &damageErrorBase) &&
+        XFixesQueryExtension(m_display, &fixesEventBase, &fixesErrorBase)) {
+        m_damage = XDamageCreate(m_display, m_root, XDamageReportNonEmpty);
+        m_damageAvailable = true;
+    } else {
+        LOG_WARN("ScreenCapture", "XDamage not available, grabbing full frames");
+    }
+
+    LOG_INFO("ScreenCapture", "Initialized", {"width", m_width}, {"height", m_height},
+             {"xdamage", m_damageAvailable});
+    return true;
+}
+
+bool ScreenCapture::start(int fps, FrameCallback callback)
+{
+    if (m_running.load() || !m_display) {
+        return false;
+    }
+
+    setFrameRate(fps);
+    m_callback = std::move(callback);
+    m_running = true;
+    m_thread = std::thread(&ScreenCapture::run, this);
+
+    LOG_INFO("ScreenCapture", "Started", {"fps", m_fps.load()});
+    return true;
+}
+
+void ScreenCapture::stop()
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    LOG_INFO("ScreenCapture", "Stopped", {"frames", m_sequence});
+}
+
+void ScreenCapture::setFrameRate(int fps)
+{
+    if (fps < 1) fps = 1;
+    if (fps > 60) fps = 60;
+    m_fps = fps;
+}
+
+bool ScreenCapture::captureFull(CapturedFrame& frame)
+{
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+    if (!m_display) {
+        return false;
+    }
+
+    CaptureRect full = { 0, 0, static_cast<int>(m_width), static_cast<int>(m_height) };
+    if (!grabRect(full)) {
+        return false;
+    }
+
+    // Discard damage that the full grab already covers
+    std::vector<CaptureRect> ignored;
+    collectDamage(ignored);
+
+    fillFrame(frame, std::vector<CaptureRect>{ full });
+    return true;
+}
+
+void ScreenCapture::run()
+{
+    CapturedFrame frame;
+    if (captureFull(frame)) {
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        m_callback(frame);
+    }
+
+    auto nextTick = std::chrono::steady_clock::now();
+    while (m_running.load()) {
+        nextTick += std::chrono::microseconds(1000000 / m_fps.load());
+        std::this_thread::sleep_until(nextTick);
+
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+
+        std::vector<CaptureRect> damage;
+        if (m_damageAvailable) {
+            if (!collectDamage(damage) || damage.empty()) {
+                continue;
+            }
+        } else {
+            damage.push_back({ 0, 0, static_cast<int>(m_width), static_cast<int>(m_height) });
+        }
+
+        bool ok = true;
+        for (const CaptureRect& rect : damage) {
+            ok = grabRect(rect) && ok;
+        }
+        if (!ok) {
+            continue;
+        }
+
+        fillFrame(frame, std::move(damage));
+        m_callback(frame);
+
+        // Don't try to catch up on ticks missed by a slow consumer
+        auto now = std::chrono::steady_clock::now();
+        if (nextTick < now) {
+            nextTick = now;
+        }
+    }
+}
+
+bool ScreenCapture::grabRect(const CaptureRect& rect)
+{
+    // Fetch just this rectangle: the server lays it out tightly packed at
+    // the start of the segment, so shrink the image to match and copy the
+    // rows into place in the persistent framebuffer
+    int fullWidth = m_image->width;
+    int fullHeight = m_image->height;
+    int fullStride = m_image->bytes_per_line;
+
+    m_image->width = rect.width;
+    m_image->height = rect.height;
+    m_image->bytes_per_line = rect.width * 4;
+
+    Status status = XShmGetImage(m_display, m_root, m_image, rect.x, rect.y, AllPlanes);
+
+    m_image->width = fullWidth;
+    m_image->height = fullHeight;
+    m_image->bytes_per_line = fullStride;
+
+    if (!status) {
+        LOG_WARN("ScreenCapture", "XShmGetImage failed");
+        return false;
+    }
+
+    size_t stride = static_cast<size_t>(m_width) * 4;
+    size_t rowBytes = static_cast<size_t>(rect.width) * 4;
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(m_image->data);
+    uint8_t* dst = m_framebuffer.data() + rect.y * stride + rect.x * 4;
+
+    if (rowBytes == stride) {
+        std::memcpy(dst, src, rowBytes * rect.height);
+    } else {
+        for (int y = 0; y < rect.height; y++) {
+            std::memcpy(dst + y * stride, src + y * rowBytes, rowBytes);
+        }
+    }
+    return true;
+}
+
+bool ScreenCapture::collectDamage(std::vector<CaptureRect>& rects)
+{
+    if (!m_damageAvailable) {
+        return false;
+    }
+
+    // With XDamageReportNonEmpty the server only notifies when the damage
+    // region goes from empty to non-empty, so no event means nothing changed
+    bool notified = false;
+    while (XPending(m_display)) {
+        XEvent event;
+        XNextEvent(m_display, &event);
+        if (event.type == m_damageEventBase + XDamageNotify) {
+            notified = true;
+        }
+    }
+    if (!notified) {
+        return true;
+    }
+
+    XserverRegion region = XFixesCreateRegion(m_display, nullptr, 0);
+    XDamageSubtract(m_display, m_damage, None, region);
+
+    int count = 0;
+    XRectangle* xrects = XFixesFetchRegion(m_display, region, &count);
+
+    int minX = m_width, minY = m_height, maxX = 0, maxY = 0;
+    for (int i = 0; i < count; i++) {
+        int x0 = std::max<int>(0, xrects[i].x);
+        int y0 = std::max<int>(0, xrects[i].y);
+        int x1 = std::min<int>(m_width, xrects[i].x + xrects[i].width);
+        int y1 = std::min<int>(m_height, xrects[i].y + xrects[i].height);
+        if (x1 <= x0 || y1 <= y0) continue;
+
+        rects.push_back({ x0, y0, x1 - x0, y1 - y0 });
+        minX = std::min(minX, x0);
+        minY = std::min(minY, y0);
+        maxX = std::max(maxX, x1);
+        maxY = std::max(maxY, y1);
+    }
+
+    if (xrects) XFree(xrects);
+    XFixesDestroyRegion(m_display, region);
+
+    if (static_cast<int>(rects.size()) > kMaxDamageRects) {
+        rects.assign(1, CaptureRect{ minX, minY, maxX - minX, maxY - minY });
+    }
+    return true;
+}
+
+void ScreenCapture::fillFrame(CapturedFrame& frame, std::vector<CaptureRect>&& damage)
+{
+    frame.width = m_width;
+    frame.height = m_height;
+    frame.stride = m_width * 4;
+    frame.pixels = m_framebuffer.data();
+    frame.damage = std::move(damage);
+    frame.sequence = ++m_sequence;
+    frame.timestampUs = nowUs();
+}
+
+// Callers hold m_captureMutex
+void ScreenCapture::cleanup()
+{
+    if (m_damage) {
+        XDamageDestroy(m_display, m_damage);
+        m_damage = 0;
+        m_damageAvailable = false;
+    }
+    if (m_shmAttached) {
+        XShmDetach(m_display, &m_shmInfo);
+        m_shmAttached = false;
+    }
+    if (m_image) {
+        m_image->data = nullptr;
+        XDestroyImage(m_image);
+        m_image = nullptr;
+    }
+    if (m_shmInfo.shmaddr != reinterpret_cast<char*>(-1)) {
+        shmdt(m_shmInfo.shmaddr);
+        m_shmInfo.shmaddr = reinterpret_cast<char*>(-1);
+    }
+    if (m_shmInfo.shmid >= 0) {
+        shmctl(m_shmInfo.shmid, IPC_RMID, nullptr);
+        m_shmInfo.shmid = -1;
+    }
+    if (m_display) {
+        XCloseDisplay(m_display);
+        m_display = nullptr;
+    }
+}
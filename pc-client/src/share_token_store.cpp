@@ -0,0 +1,312 @@
+#include "../include/share_token_store.h"
+#include "async_log.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace RemoteAccessSystem {
+namespace Common {
+
+ShareTokenStore& ShareTokenStore::Instance() {
+    static ShareTokenStore instance;
+    return instance;
+}
+
+ShareTokenStore::ShareTokenStore()
+    : tombstones_(0)
+    , wheel_(kWheelSlots)
+    , current_tick_(static_cast<int64_t>(std::time(nullptr)) / kTickSeconds)
+    , log_records_(0) {
+}
+
+int64_t ShareTokenStore::DueTime(const Entry& entry) {
+    return entry.expired ? entry.expiry + kTombstoneSeconds : entry.expiry;
+}
+
+// Paths may hold any byte but NUL; escaping '\n' keeps one record per line
+std::string ShareTokenStore::EscapePath(const std::string& path) {
+    std::string escaped;
+    escaped.reserve(path.size());
+    for (char c : path) {
+        if (c == '\\') {
+            escaped += "\\\\";
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string ShareTokenStore::UnescapePath(const std::string& path) {
+    std::string plain;
+    plain.reserve(path.size());
+    for (size_t i = 0; i < path.size(); i++) {
+        if (path[i] == '\\' && i + 1 < path.size()) {
+            i++;
+            plain += path[i] == 'n' ? '\n' : path[i];
+        } else {
+            plain += path[i];
+        }
+    }
+    return plain;
+}
+
+bool ShareTokenStore::Open(const std::string& log_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (log_.is_open()) {
+        log_.close();
+    }
+    log_path_ = log_path;
+    log_records_ = 0;
+    tokens_.clear();
+    tombstones_ = 0;
+    for (auto& bucket : wheel_) {
+        bucket.clear();
+    }
+
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+
+    // Replay the log; later records win
+    std::ifstream in(log_path_);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.size() < 3 || line[1] != '|') continue;
+        log_records_++;
+
+        if (line[0] == 'S' || line[0] == 'A') {
+            size_t p1 = line.find('|', 2);
+            if (p1 == std::string::npos) continue;
+            size_t p2 = line.find('|', p1 + 1);
+            if (p2 == std::string::npos) continue;
+
+            std::string token = line.substr(2, p1 - 2);
+            int64_t expiry = std::strtoll(line.c_str() + p1 + 1, nullptr, 10);
+            std::string path = line.substr(p2 + 1);
+            tokens_[token] = Entry{line[0] == 'S' ? UnescapePath(path) : path, expiry, false};
+        } else if (line[0] == 'D') {
+            tokens_.erase(line.substr(2));
+        }
+    }
+    in.close();
+
+    // Recently expired tokens come back as tombstones
+    size_t expired = 0;
+    for (auto it = tokens_.begin(); it != tokens_.end();) {
+        if (it->second.expiry <= now) {
+            it->second.expired = true;
+            expired++;
+        }
+        if (DueTime(it->second) <= now) {
+            it = tokens_.erase(it);
+            continue;
+        }
+        if (it->second.expired) {
+            tombstones_++;
+        }
+        Schedule(it->first, DueTime(it->second));
+        ++it;
+    }
+
+    LOG_INFO("ShareTokenStore", "Loaded", {"path", log_path_}, {"tokens", tokens_.size() - tombstones_},
+             {"expired", expired});
+
+    if (log_records_ > tokens_.size()) {
+        CompactLocked();
+    } else {
+        log_.open(log_path_, std::ios::app);
+    }
+
+    if (!log_.is_open()) {
+        LOG_ERROR("ShareTokenStore", "Failed to open", {"path", log_path_});
+        return false;
+    }
+    return true;
+}
+
+void ShareTokenStore::Add(const std::string& token, const std::string& file_path,
+                          int64_t ttl_seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    AdvanceLocked(now);
+
+    int64_t expiry = now + ttl_seconds;
+    auto it = tokens_.find(token);
+    if (it != tokens_.end() && it->second.expired) {
+        tombstones_--;
+    }
+    tokens_[token] = Entry{file_path, expiry, false};
+    Schedule(token, expiry);
+
+    AppendLocked("S|" + token + "|" + std::to_string(expiry) + "|" + EscapePath(file_path));
+}
+
+ShareTokenStore::LookupResult ShareTokenStore::Lookup(const std::string& token,
+                                                      std::string& file_path, int64_t* expiry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    AdvanceLocked(now);
+
+    auto it = tokens_.find(token);
+    if (it == tokens_.end()) {
+        return LookupResult::NotFound;
+    }
+    if (it->second.expired) {
+        return LookupResult::Expired;
+    }
+
+    // The wheel only reaps at tick granularity
+    if (it->second.expiry <= now) {
+        ExpireLocked(it->first, it->second);
+        return LookupResult::Expired;
+    }
+
+    file_path = it->second.file_path;
+    if (expiry) {
+        *expiry = it->second.expiry;
+    }
+    return LookupResult::Found;
+}
+
+bool ShareTokenStore::Remove(const std::string& token) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = tokens_.find(token);
+    if (it == tokens_.end()) {
+        return false;
+    }
+    if (it->second.expired) {
+        tombstones_--;
+    }
+    tokens_.erase(it);
+    AppendLocked("D|" + token);
+    return true;
+}
+
+size_t ShareTokenStore::Expire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return AdvanceLocked(static_cast<int64_t>(std::time(nullptr)));
+}
+
+size_t ShareTokenStore::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tokens_.size() - tombstones_;
+}
+
+size_t ShareTokenStore::SlotFor(int64_t due) const {
+    // First tick that starts at or after the due time
+    int64_t tick = (due + kTickSeconds - 1) / kTickSeconds;
+    return static_cast<size_t>(tick % static_cast<int64_t>(kWheelSlots));
+}
+
+void ShareTokenStore::Schedule(const std::string& token, int64_t due) {
+    wheel_[SlotFor(due)].push_back(token);
+}
+
+// Turns a live token into a tombstone, due for removal a grace period on
+void ShareTokenStore::ExpireLocked(const std::string& token, Entry& entry) {
+    entry.expired = true;
+    tombstones_++;
+    Schedule(token, DueTime(entry));
+}
+
+size_t ShareTokenStore::AdvanceLocked(int64_t now) {
+    int64_t target_tick = now / kTickSeconds;
+    if (target_tick <= current_tick_) {
+        return 0;
+    }
+
+    // After a full rotation every slot has been visited once
+    int64_t steps = target_tick - current_tick_;
+    if (steps > static_cast<int64_t>(kWheelSlots)) {
+        steps = static_cast<int64_t>(kWheelSlots);
+    }
+
+    size_t removed = 0;
+    for (int64_t i = 0; i < steps; i++) {
+        size_t slot = static_cast<size_t>((target_tick - steps + 1 + i) % static_cast<int64_t>(kWheelSlots));
+        std::vector<std::string>& bucket = wheel_[slot];
+
+        size_t keep = 0;
+        for (size_t j = 0; j < bucket.size(); j++) {
+            auto it = tokens_.find(bucket[j]);
+            // Removed, re-added, or turned tombstone: due in another slot
+            if (it == tokens_.end() || SlotFor(DueTime(it->second)) != slot) {
+                continue;
+            }
+            if (DueTime(it->second) <= now) {
+                if (it->second.expired) {
+                    tombstones_--;
+                    tokens_.erase(it);
+                } else {
+                    ExpireLocked(it->first, it->second);
+                    removed++;
+                }
+                continue;
+            }
+            // Expires on a later rotation
+            if (keep != j) {
+                bucket[keep] = std::move(bucket[j]);
+            }
+            keep++;
+        }
+        bucket.resize(keep);
+    }
+    current_tick_ = target_tick;
+
+    if (removed > 0) {
+        LOG_INFO("ShareTokenStore", "Expired", {"tokens", removed}, {"active", tokens_.size() - tombstones_});
+    }
+    return removed;
+}
+
+void ShareTokenStore::AppendLocked(const std::string& record) {
+    if (!log_.is_open()) {
+        return;
+    }
+
+    log_ << record << '\n';
+    log_.flush();
+    log_records_++;
+
+    // Expired tokens are never written as deletions, so rewrite the log
+    // once dead records clearly outnumber live ones
+    if (log_records_ > 2 * tokens_.size() + 64) {
+        CompactLocked();
+    }
+}
+
+void ShareTokenStore::CompactLocked() {
+    if (log_.is_open()) {
+        log_.close();
+    }
+
+    std::string tmp_path = log_path_ + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        if (!out) {
+            LOG_ERROR("ShareTokenStore", "Failed to compact", {"path", log_path_});
+            log_.open(log_path_, std::ios::app);
+            return;
+        }
+        for (const auto& kv : tokens_) {
+            out << "S|" << kv.first << "|" << kv.second.expiry << "|"
+                << EscapePath(kv.second.file_path) << '\n';
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), log_path_.c_str()) != 0) {
+        LOG_ERROR("ShareTokenStore", "Failed to replace", {"path", log_path_});
+        std::remove(tmp_path.c_str());
+    } else {
+        log_records_ = tokens_.size();
+    }
+
+    log_.open(log_path_, std::ios::app);
+}
+
+} // namespace Common
+} // namespace RemoteAccessSystem
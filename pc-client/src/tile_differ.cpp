@@ -0,0 +1,175 @@
+#include "tile_differ.h"
+#include <algorithm>
+#include <cstring>
+#include "async_log.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TILE_DIFFER_X86 1
+#endif
+
+namespace {
+
+// Returns true if `rows` rows of `rowBytes` bytes are identical
+typedef bool (*TileCompareFn)(const uint8_t* a, const uint8_t* b, size_t stride,
+                              size_t rowBytes, int rows);
+
+bool compareScalar(const uint8_t* a, const uint8_t* b, size_t stride,
+                   size_t rowBytes, int rows)
+{
+    for (int y = 0; y < rows; y++, a += stride, b += stride) {
+        if (std::memcmp(a, b, rowBytes) != 0) return false;
+    }
+    return true;
+}
+
+#ifdef TILE_DIFFER_X86
+
+__attribute__((target("sse4.1")))
+bool compareSSE41(const uint8_t* a, const uint8_t* b, size_t stride,
+                  size_t rowBytes, int rows)
+{
+    size_t vecBytes = rowBytes & ~size_t(15);
+    for (int y = 0; y < rows; y++, a += stride, b += stride) {
+        __m128i acc = _mm_setzero_si128();
+        for (size_t i = 0; i < vecBytes; i += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            acc = _mm_or_si128(acc, _mm_xor_si128(va, vb));
+        }
+        if (!_mm_testz_si128(acc, acc)) return false;
+        if (vecBytes != rowBytes &&
+            std::memcmp(a + vecBytes, b + vecBytes, rowBytes - vecBytes) != 0) return false;
+    }
+    return true;
+}
+
+__attribute__((target("avx2")))
+bool compareAVX2(const uint8_t* a, const uint8_t* b, size_t stride,
+                 size_t rowBytes, int rows)
+{
+    size_t vecBytes = rowBytes & ~size_t(31);
+    for (int y = 0; y < rows; y++, a += stride, b += stride) {
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t i = 0; i < vecBytes; i += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            acc = _mm256_or_si256(acc, _mm256_xor_si256(va, vb));
+        }
+        if (!_mm256_testz_si256(acc, acc)) return false;
+        if (vecBytes != rowBytes &&
+            std::memcmp(a + vecBytes, b + vecBytes, rowBytes - vecBytes) != 0) return false;
+    }
+    return true;
+}
+
+#endif
+
+struct Kernel {
+    TileCompareFn compare;
+    const char* name;
+};
+
+Kernel selectKernel()
+{
+#ifdef TILE_DIFFER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return { compareAVX2, "avx2" };
+    if (__builtin_cpu_supports("sse4.1")) return { compareSSE41, "sse4.1" };
+#endif
+    return { compareScalar, "scalar" };
+}
+
+const Kernel& kernel()
+{
+    static const Kernel selected = selectKernel();
+    return selected;
+}
+
+}
+
+const int TileDiffer::kTileSize;
+
+TileDiffer::TileDiffer()
+    : m_width(0), m_height(0), m_stride(0), m_tilesX(0), m_tilesY(0), m_keyFrame(true)
+{
+}
+
+const char* TileDiffer::kernelName()
+{
+    return kernel().name;
+}
+
+void TileDiffer::reset()
+{
+    m_keyFrame = true;
+}
+
+void TileDiffer::resize(uint32_t width, uint32_t height, uint32_t stride)
+{
+    m_width = width;
+    m_height = height;
+    m_stride = stride;
+    m_tilesX = (width + kTileSize - 1) / kTileSize;
+    m_tilesY = (height + kTileSize - 1) / kTileSize;
+    // Laid out like the frame, row padding included, so one stride walks both
+    m_reference.assign(static_cast<size_t>(stride) * height, 0);
+    m_candidates.assign(static_cast<size_t>(m_tilesX) * m_tilesY, 0);
+    m_keyFrame = true;
+
+    LOG_INFO("TileDiffer", "Reset", {"tiles_x", m_tilesX}, {"tiles_y", m_tilesY}, {"kernel", kernelName()});
+}
+
+void TileDiffer::addDamage(const std::vector<CaptureRect>& damage)
+{
+    if (m_keyFrame) {
+        return;
+    }
+
+    for (const CaptureRect& rect : damage) {
+        int tx0 = std::max(0, rect.x / kTileSize);
+        int ty0 = std::max(0, rect.y / kTileSize);
+        int tx1 = std::min(m_tilesX - 1, (rect.x + rect.width - 1) / kTileSize);
+        int ty1 = std::min(m_tilesY - 1, (rect.y + rect.height - 1) / kTileSize);
+        for (int ty = ty0; ty <= ty1; ty++) {
+            std::fill(m_candidates.begin() + ty * m_tilesX + tx0,
+                      m_candidates.begin() + ty * m_tilesX + tx1 + 1, 1);
+        }
+    }
+}
+
+void TileDiffer::diff(const CapturedFrame& frame, std::vector<CaptureRect>& dirty)
+{
+    if (frame.width != m_width || frame.height != m_height || frame.stride != m_stride) {
+        resize(frame.width, frame.height, frame.stride);
+    }
+
+    const size_t stride = frame.stride;
+    const TileCompareFn compare = kernel().compare;
+
+    for (int ty = 0; ty < m_tilesY; ty++) {
+        int y = ty * kTileSize;
+        int h = std::min<int>(kTileSize, m_height - y);
+
+        for (int tx = 0; tx < m_tilesX; tx++) {
+            uint8_t& candidate = m_candidates[ty * m_tilesX + tx];
+            if (!m_keyFrame && !candidate) continue;
+            candidate = 0;
+
+            int x = tx * kTileSize;
+            int w = std::min<int>(kTileSize, m_width - x);
+            size_t offset = y * stride + x * 4;
+            const uint8_t* cur = frame.pixels + offset;
+            uint8_t* ref = m_reference.data() + offset;
+
+            if (!m_keyFrame && compare(cur, ref, stride, w * 4, h)) continue;
+
+            for (int row = 0; row < h; row++) {
+                std::memcpy(ref + row * stride, cur + row * stride, w * 4);
+            }
+            dirty.push_back({ x, y, w, h });
+        }
+    }
+
+    m_keyFrame = false;
+}
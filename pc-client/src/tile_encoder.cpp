@@ -0,0 +1,435 @@
+#include "tile_encoder.h"
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "async_log.h"
+#include <jpeglib.h>
+
+#ifdef HAVE_WEBP
+#include <webp/encode.h>
+#endif
+
+namespace {
+
+void toRGB(const uint8_t* bgrx, size_t stride, int width, int height, std::vector<uint8_t>& out)
+{
+    out.resize(static_cast<size_t>(width) * height * 3);
+    uint8_t* dst = out.data();
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = bgrx + y * stride;
+        for (int x = 0; x < width; x++, src += 4, dst += 3) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// libjpeg-turbo
+
+struct JpegErrorManager {
+    jpeg_error_mgr base;
+    jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo)
+{
+    JpegErrorManager* err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    longjmp(err->jump, 1);
+}
+
+class JpegCodec : public TileCodec {
+public:
+    JpegCodec()
+    {
+        m_cinfo.err = jpeg_std_error(&m_error.base);
+        m_error.base.error_exit = jpegErrorExit;
+        jpeg_create_compress(&m_cinfo);
+    }
+
+    ~JpegCodec() override
+    {
+        jpeg_destroy_compress(&m_cinfo);
+    }
+
+    TileFormat format() const override { return TILE_FORMAT_JPEG; }
+
+    bool encode(const uint8_t* bgrx, size_t stride, int width, int height,
+                int quality, std::vector<uint8_t>& out) override
+    {
+        // Members rather than locals so they survive the longjmp
+        m_buffer = nullptr;
+        m_size = 0;
+
+        if (setjmp(m_error.jump)) {
+            jpeg_abort_compress(&m_cinfo);
+            free(m_buffer);
+            return false;
+        }
+
+        jpeg_mem_dest(&m_cinfo, &m_buffer, &m_size);
+        m_cinfo.image_width = width;
+        m_cinfo.image_height = height;
+
+#ifdef JCS_EXTENSIONS
+        // libjpeg-turbo reads the X server's BGRX layout directly
+        m_cinfo.input_components = 4;
+        m_cinfo.in_color_space = JCS_EXT_BGRX;
+#else
+        m_cinfo.input_components = 3;
+        m_cinfo.in_color_space = JCS_RGB;
+        toRGB(bgrx, stride, width, height, m_rgb);
+        bgrx = m_rgb.data();
+        stride = static_cast<size_t>(width) * 3;
+#endif
+
+        jpeg_set_defaults(&m_cinfo);
+        jpeg_set_quality(&m_cinfo, quality, TRUE);
+        m_cinfo.dct_method = JDCT_IFAST;
+
+        m_rows.resize(height);
+        for (int y = 0; y < height; y++) {
+            m_rows[y] = const_cast<JSAMPROW>(bgrx + y * stride);
+        }
+
+        jpeg_start_compress(&m_cinfo, TRUE);
+        jpeg_write_scanlines(&m_cinfo, m_rows.data(), height);
+        jpeg_finish_compress(&m_cinfo);
+
+        out.assign(m_buffer, m_buffer + m_size);
+        free(m_buffer);
+        m_buffer = nullptr;
+        return true;
+    }
+
+private:
+    jpeg_compress_struct m_cinfo;
+    unsigned char* m_buffer;
+    unsigned long m_size;
+    JpegErrorManager m_error;
+    std::vector<JSAMPROW> m_rows;
+    std::vector<uint8_t> m_rgb;
+};
+
+// ---------------------------------------------------------------------------
+// QOI (https://qoiformat.org), 3 channels, sRGB
+
+class QoiCodec : public TileCodec {
+public:
+    TileFormat format() const override { return TILE_FORMAT_QOI; }
+
+    bool encode(const uint8_t* bgrx, size_t stride, int width, int height,
+                int quality, std::vector<uint8_t>& out) override
+    {
+        enum {
+            OP_INDEX = 0x00, OP_DIFF = 0x40, OP_LUMA = 0x80,
+            OP_RUN = 0xc0, OP_RGB = 0xfe
+        };
+
+        out.clear();
+        out.reserve(14 + static_cast<size_t>(width) * height * 4 + 8);
+
+        auto put32 = [&out](uint32_t v) {
+            out.push_back(v >> 24);
+            out.push_back(v >> 16);
+            out.push_back(v >> 8);
+            out.push_back(v);
+        };
+
+        out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+        put32(width);
+        put32(height);
+        out.push_back(3);   // channels
+        out.push_back(0);   // sRGB
+
+        uint8_t index[64][3];
+        std::memset(index, 0, sizeof(index));
+        uint8_t pr = 0, pg = 0, pb = 0;
+        int run = 0;
+        const size_t total = static_cast<size_t>(width) * height;
+        size_t n = 0;
+
+        for (int y = 0; y < height; y++) {
+            const uint8_t* src = bgrx + y * stride;
+            for (int x = 0; x < width; x++, src += 4, n++) {
+                uint8_t r = src[2], g = src[1], b = src[0];
+
+                if (r == pr && g == pg && b == pb) {
+                    run++;
+                    if (run == 62 || n + 1 == total) {
+                        out.push_back(OP_RUN | (run - 1));
+                        run = 0;
+                    }
+                    continue;
+                }
+
+                if (run > 0) {
+                    out.push_back(OP_RUN | (run - 1));
+                    run = 0;
+                }
+
+                int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+                if (index[hash][0] == r && index[hash][1] == g && index[hash][2] == b) {
+                    out.push_back(OP_INDEX | hash);
+                } else {
+                    index[hash][0] = r;
+                    index[hash][1] = g;
+                    index[hash][2] = b;
+
+                    int8_t vr = r - pr;
+                    int8_t vg = g - pg;
+                    int8_t vb = b - pb;
+                    int8_t vgr = vr - vg;
+                    int8_t vgb = vb - vg;
+
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                        out.push_back(OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                    } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                        out.push_back(OP_LUMA | (vg + 32));
+                        out.push_back((vgr + 8) << 4 | (vgb + 8));
+                    } else {
+                        out.push_back(OP_RGB);
+                        out.push_back(r);
+                        out.push_back(g);
+                        out.push_back(b);
+                    }
+                }
+                pr = r;
+                pg = g;
+                pb = b;
+            }
+        }
+
+        static const uint8_t padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+        out.insert(out.end(), padding, padding + 8);
+        return true;
+    }
+};
+
+#ifdef HAVE_WEBP
+class WebpCodec : public TileCodec {
+public:
+    TileFormat format() const override { return TILE_FORMAT_WEBP; }
+
+    bool encode(const uint8_t* bgrx, size_t stride, int width, int height,
+                int quality, std::vector<uint8_t>& out) override
+    {
+        toRGB(bgrx, stride, width, height, m_rgb);
+
+        uint8_t* output = nullptr;
+        size_t size = WebPEncodeRGB(m_rgb.data(), width, height, width * 3,
+                                    static_cast<float>(quality), &output);
+        if (size == 0) {
+            return false;
+        }
+        out.assign(output, output + size);
+        WebPFree(output);
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> m_rgb;
+};
+#endif
+
+// Text and UI tiles are dominated by runs of identical pixels; photos and
+// video almost never repeat a pixel exactly
+bool looksSynthetic(const uint8_t* bgrx, size_t stride, int width, int height)
+{
+    size_t same = 0;
+    size_t total = 0;
+    for (int y = 0; y < height; y += 2) {
+        const uint32_t* row = reinterpret_cast<const uint32_t*>(bgrx + y * stride);
+        for (int x = 1; x < width; x++) {
+            same += ((row[x] ^ row[x - 1]) & 0x00ffffff) == 0;
+        }
+        total += width - 1;
+    }
+    return total == 0 || same * 10 >= total * 6;
+}
+
+// Box-filters a BGRX block down by `scale` in both directions
+void downscale(const uint8_t* bgrx, size_t stride, int width, int height, int scale,
+               std::vector<uint8_t>& out, int& outWidth, int& outHeight)
+{
+    outWidth = std::max(1, width / scale);
+    outHeight = std::max(1, height / scale);
+    out.resize(static_cast<size_t>(outWidth) * outHeight * 4);
+
+    for (int oy = 0; oy < outHeight; oy++) {
+        int y0 = oy * scale;
+        int y1 = std::min(height, y0 + scale);
+        for (int ox = 0; ox < outWidth; ox++) {
+            int x0 = ox * scale;
+            int x1 = std::min(width, x0 + scale);
+            unsigned sum[3] = { 0, 0, 0 };
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* p = bgrx + y * stride + x0 * 4;
+                for (int x = x0; x < x1; x++, p += 4) {
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                }
+            }
+            unsigned count = (y1 - y0) * (x1 - x0);
+            uint8_t* dst = &out[(static_cast<size_t>(oy) * outWidth + ox) * 4];
+            dst[0] = sum[0] / count;
+            dst[1] = sum[1] / count;
+            dst[2] = sum[2] / count;
+            dst[3] = 0;
+        }
+    }
+}
+
+}
+
+TileEncoder::TileEncoder(int threads)
+    : m_stopping(false), m_generation(0), m_busyWorkers(0),
+      m_frame(nullptr), m_rects(nullptr), m_tiles(nullptr), m_nextTile(0)
+{
+    m_settings.quality = 70;
+    m_settings.allowLossless = true;
+    m_settings.preferWebp = false;
+    m_settings.scale = 1;
+    m_jobSettings = m_settings;
+
+    if (threads <= 0) {
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        threads = std::min(8, std::max(1, cores - 1));
+    }
+
+    for (int i = 0; i < threads; i++) {
+        std::unique_ptr<Worker> worker(new Worker);
+        worker->jpeg.reset(new JpegCodec);
+        worker->qoi.reset(new QoiCodec);
+#ifdef HAVE_WEBP
+        worker->webp.reset(new WebpCodec);
+#endif
+        worker->thread = std::thread(&TileEncoder::workerLoop, this, worker.get());
+        m_workers.push_back(std::move(worker));
+    }
+
+    LOG_INFO("TileEncoder", "Workers started", {"threads", threads}, {"webp", hasWebp()});
+}
+
+TileEncoder::~TileEncoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workReady.notify_all();
+    for (auto& worker : m_workers) {
+        worker->thread.join();
+    }
+}
+
+bool TileEncoder::hasWebp()
+{
+#ifdef HAVE_WEBP
+    return true;
+#else
+    return false;
+#endif
+}
+
+void TileEncoder::setSettings(const EncoderSettings& settings)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_settings = settings;
+    m_settings.quality = std::min(100, std::max(1, settings.quality));
+    m_settings.scale = std::max(1, settings.scale);
+}
+
+EncoderSettings TileEncoder::settings() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_settings;
+}
+
+void TileEncoder::encode(const CapturedFrame& frame, const std::vector<CaptureRect>& rects,
+                         std::vector<RemoteAccessSystem::ScreenTile>& tiles)
+{
+    tiles.resize(rects.size());
+    if (rects.empty()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_frame = &frame;
+    m_rects = &rects;
+    m_tiles = &tiles;
+    m_jobSettings = m_settings;
+    m_nextTile = 0;
+    m_busyWorkers = m_workers.size();
+    m_generation++;
+    m_workReady.notify_all();
+
+    m_workDone.wait(lock, [this]() { return m_busyWorkers == 0; });
+    m_frame = nullptr;
+    m_rects = nullptr;
+    m_tiles = nullptr;
+}
+
+void TileEncoder::workerLoop(Worker* worker)
+{
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workReady.wait(lock, [&]() { return m_stopping || m_generation != seen; });
+            if (m_stopping) return;
+            seen = m_generation;
+        }
+
+        size_t count = m_rects->size();
+        for (size_t i = m_nextTile.fetch_add(1); i < count; i = m_nextTile.fetch_add(1)) {
+            encodeTile(worker, i);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0) {
+            m_workDone.notify_one();
+        }
+    }
+}
+
+void TileEncoder::encodeTile(Worker* worker, size_t index)
+{
+    const CaptureRect& rect = (*m_rects)[index];
+    RemoteAccessSystem::ScreenTile& tile = (*m_tiles)[index];
+    const uint8_t* pixels = m_frame->pixels + rect.y * m_frame->stride + rect.x * 4;
+    size_t stride = m_frame->stride;
+
+    tile.x = static_cast<uint16_t>(rect.x);
+    tile.y = static_cast<uint16_t>(rect.y);
+    tile.width = static_cast<uint16_t>(rect.width);
+    tile.height = static_cast<uint16_t>(rect.height);
+
+    int width = rect.width;
+    int height = rect.height;
+    if (m_jobSettings.scale > 1) {
+        downscale(pixels, stride, rect.width, rect.height, m_jobSettings.scale,
+                  worker->scaled, width, height);
+        pixels = worker->scaled.data();
+        stride = static_cast<size_t>(width) * 4;
+    }
+
+    TileCodec* codec = worker->jpeg.get();
+    if (m_jobSettings.allowLossless && looksSynthetic(pixels, stride, width, height)) {
+        codec = worker->qoi.get();
+    } else if (m_jobSettings.preferWebp && worker->webp) {
+        codec = worker->webp.get();
+    }
+
+    if (codec->encode(pixels, stride, width, height, m_jobSettings.quality, tile.data)) {
+        tile.format = codec->format();
+        return;
+    }
+
+    toRGB(pixels, stride, width, height, tile.data);
+    tile.format = TILE_FORMAT_RGB;
+}
@@ -0,0 +1,658 @@
+// Load generator for relay_server_standalone over loopback. Build the
+// relay-bench target and run it against a relay: it brings up N simulated
+// PCs (REGISTER, FILE_HANDLER_REGISTER, heartbeats, synthetic answers to
+// file requests) and M simulated mobiles, each running a closed loop of
+// LIST_DIR (over a CONNECT session) / DOWNLOAD / UPLOAD in the given mix.
+// After a warmup it reports ops/s, errors and p50/p99/p99.9 latency per
+// operation, transfer rates, and the relay's CPU and RSS over the run.
+//
+//   relay-bench --relay ./relay_server      start a relay, measure, stop it
+//   relay-bench --pid $(pidof relay_server) drive one that is running
+//
+// The relay listens on 2810; a relay started with --relay must find that
+// port free. Clients run on the same machine, so the numbers include them.
+
+#include "wire_frame.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Wire = RemoteAccessSystem::Wire;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 2810;
+    int pcs = 4;
+    int mobiles = 16;
+    int seconds = 10;
+    int warmup = 2;
+    int mix[3] = { 80, 10, 10 };    // LIST_DIR : DOWNLOAD : UPLOAD
+    size_t file_size = 64 * 1024;
+    int entries = 50;
+    int heartbeat_ms = 1000;        // real PCs: 30 s
+    std::string relay;
+    pid_t pid = 0;
+};
+
+enum Op { LIST_DIR, DOWNLOAD, UPLOAD, OP_COUNT };
+static const char* const kOpNames[OP_COUNT] = { "LIST_DIR", "DOWNLOAD", "UPLOAD" };
+
+enum Phase { WARMUP, MEASURE, STOP };
+static std::atomic<int> g_phase(WARMUP);
+
+struct OpStats {
+    std::vector<uint32_t> latency_us;
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+};
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        std::exit(1);
+    }
+}
+
+static std::string pcId(int index) {
+    return "bench-pc-" + std::to_string(index);
+}
+
+static int connectTo(const Options& options) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    if (fd < 0 || inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1 ||
+        connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    
+    // Requests are small frames; a stuck relay fails the op instead of
+    // hanging the run
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval timeout = { 10, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static bool sendAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    return sendAll(fd, data.data(), data.size());
+}
+
+// Blocking reads of Wire frames and of the raw bytes that follow them
+class FrameSocket {
+public:
+    explicit FrameSocket(int fd) : m_fd(fd) {}
+    
+    int fd() const { return m_fd; }
+    Wire::Reader& reader() { return m_reader; }
+    
+    // One recv() into the reader; false on close, error or timeout
+    bool fill() {
+        ssize_t n = recv(m_fd, m_buffer, sizeof(m_buffer), 0);
+        if (n <= 0) return false;
+        m_reader.append(m_buffer, n);
+        return true;
+    }
+    
+    bool read(Wire::FrameView& frame) {
+        while (true) {
+            Wire::Reader::Result result = m_reader.next(frame);
+            if (result == Wire::Reader::FRAME) return true;
+            if (result == Wire::Reader::BAD_FRAME || !fill()) return false;
+        }
+    }
+    
+    // Reads and discards exactly `length` bytes
+    bool skip(size_t length) {
+        size_t buffered = std::min(m_reader.pending().size(), length);
+        m_reader.consume(buffered);
+        length -= buffered;
+        while (length > 0) {
+            ssize_t n = recv(m_fd, m_buffer, std::min(length, sizeof(m_buffer)), 0);
+            if (n <= 0) return false;
+            length -= n;
+        }
+        return true;
+    }
+
+private:
+    int m_fd;
+    Wire::Reader m_reader;
+    char m_buffer[64 * 1024];
+};
+
+// ============================================================================
+// Simulated PC
+// ============================================================================
+
+// Upload data shares the FileHandler connection with requests the relay
+// forwards meanwhile. The bench payload never contains the frame magic, so
+// a frame landing between data chunks is picked out and kept for later.
+static bool receiveUpload(FrameSocket& socket, size_t length, std::vector<std::string>& deferred) {
+    while (length > 0) {
+        std::string_view pending = socket.reader().pending();
+        if (!pending.empty() && static_cast<uint8_t>(pending[0]) == Wire::kMagic) {
+            Wire::FrameView frame;
+            Wire::Reader::Result result = socket.reader().next(frame);
+            if (result == Wire::Reader::FRAME) {
+                deferred.emplace_back(frame.bytes());
+                continue;
+            }
+            if (result == Wire::Reader::BAD_FRAME) return false;
+        } else if (!pending.empty()) {
+            size_t run = 0;
+            while (run < pending.size() && run < length && static_cast<uint8_t>(pending[run]) != Wire::kMagic) {
+                run++;
+            }
+            socket.reader().consume(run);
+            length -= run;
+            continue;
+        }
+        if (!socket.fill()) return false;
+    }
+    return true;
+}
+
+static bool answer(FrameSocket& socket, const Wire::FrameView& frame, const Options& options,
+                   const std::string& file_data, std::vector<std::string>& deferred) {
+    uint32_t id = frame.requestId();
+    std::string out;
+    
+    switch (frame.type()) {
+    case Wire::Type::LIST_DIR: {
+        Wire::Builder list(out, Wire::Type::DIR_LIST, id);
+        for (int i = 0; i < options.entries; i++) {
+            list.add("file-" + std::to_string(i) + ".dat").add("file").addNumber(options.file_size);
+        }
+        list.finish();
+        return sendAll(socket.fd(), out);
+    }
+    case Wire::Type::DOWNLOAD: {
+        std::string size = std::to_string(file_data.size());
+        Wire::appendMessage(out, true, Wire::Type::DOWNLOAD_START, {frame.field(1), size}, id);
+        return sendAll(socket.fd(), out) && sendAll(socket.fd(), file_data);
+    }
+    case Wire::Type::UPLOAD: {
+        size_t size = frame.fieldU64(2);
+        Wire::appendMessage(out, true, Wire::Type::UPLOAD_READY, {}, id);
+        if (!sendAll(socket.fd(), out) || !receiveUpload(socket, size, deferred)) return false;
+        out.clear();
+        Wire::appendMessage(out, true, Wire::Type::UPLOAD_COMPLETE, {}, id);
+        return sendAll(socket.fd(), out);
+    }
+    case Wire::Type::GENERATE_URL:
+        Wire::appendMessage(out, true, Wire::Type::SHARE_URL, {"http://127.0.0.1/bench"}, id);
+        return sendAll(socket.fd(), out);
+    default:
+        return true;    // PONG to heartbeats, OKs
+    }
+}
+
+// FileHandler side of one PC: answers whatever the relay forwards and
+// heartbeats on schedule, until the run ends or the relay hangs up
+static void runPC(int index, int file_fd, const Options& options, const std::string& file_data) {
+    FrameSocket socket(file_fd);
+    std::string id = pcId(index);
+    std::vector<std::string> deferred;
+    auto interval = std::chrono::milliseconds(options.heartbeat_ms);
+    auto next_beat = std::chrono::steady_clock::now() + interval;
+    
+    while (g_phase != STOP) {
+        if (!deferred.empty()) {
+            std::string frame = std::move(deferred.front());
+            deferred.erase(deferred.begin());
+            if (!answer(socket, Wire::FrameView(frame.data()), options, file_data, deferred)) break;
+            continue;
+        }
+        
+        Wire::FrameView frame;
+        Wire::Reader::Result result = socket.reader().next(frame);
+        if (result == Wire::Reader::FRAME) {
+            if (!answer(socket, frame, options, file_data, deferred)) break;
+            continue;
+        }
+        if (result == Wire::Reader::BAD_FRAME) break;
+        
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_beat) {
+            std::string heartbeat;
+            Wire::appendMessage(heartbeat, true, Wire::Type::HEARTBEAT, {id});
+            if (!sendAll(file_fd, heartbeat)) break;
+            next_beat = now + interval;
+        }
+        
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_beat - now).count();
+        struct pollfd readable = { file_fd, POLLIN, 0 };
+        int ready = poll(&readable, 1, static_cast<int>(std::min<long long>(std::max<long long>(wait, 0), 100)));
+        if (ready > 0 && !socket.fill()) break;
+    }
+    
+    if (g_phase != STOP) {
+        std::fprintf(stderr, "warning: %s lost its FileHandler connection\n", id.c_str());
+    }
+}
+
+// REGISTER on a main connection (held open for the run) and
+// FILE_HANDLER_REGISTER on a second one, which is returned
+static int registerPC(int index, const Options& options, int& main_fd) {
+    std::string id = pcId(index);
+    std::string frame;
+    Wire::FrameView reply;
+    
+    main_fd = connectTo(options);
+    check(main_fd >= 0, "PC connect");
+    Wire::appendMessage(frame, true, Wire::Type::REGISTER, {id, "bench-usb", "bench"});
+    FrameSocket main_socket(main_fd);
+    check(sendAll(main_fd, frame) && main_socket.read(reply) && reply.type() == Wire::Type::OK, "REGISTER");
+    
+    int file_fd = connectTo(options);
+    check(file_fd >= 0, "FileHandler connect");
+    frame.clear();
+    Wire::appendMessage(frame, true, Wire::Type::FILE_HANDLER_REGISTER, {id});
+    check(sendAll(file_fd, frame), "FILE_HANDLER_REGISTER");
+    
+    // Read the OK byte by byte so nothing after it is taken from runPC()
+    std::string ok;
+    char byte;
+    while (ok.size() < Wire::kHeaderSize || ok.size() < Wire::FrameView(ok.data()).size()) {
+        check(recv(file_fd, &byte, 1, 0) == 1, "FILE_HANDLER_REGISTER reply");
+        ok += byte;
+    }
+    check(Wire::FrameView(ok.data()).type() == Wire::Type::OK, "FILE_HANDLER_REGISTER accepted");
+    return file_fd;
+}
+
+// ============================================================================
+// Simulated mobile
+// ============================================================================
+
+class Mobile {
+public:
+    Mobile(int index, const Options& options)
+        : m_index(index), m_options(options), m_pc(pcId(index % options.pcs)),
+          m_session(-1), m_next_request(1), m_upload(options.file_size, 'u') {}
+    
+    ~Mobile() {
+        closeSession();
+    }
+    
+    bool listDir(uint64_t& bytes) {
+        if (m_session.fd() < 0 && !openSession()) return false;
+        
+        uint32_t id = m_next_request++;
+        std::string frame;
+        Wire::appendMessage(frame, true, Wire::Type::LIST_DIR, {m_pc, "/bench"}, id);
+        if (!sendAll(m_session.fd(), frame)) return dropSession();
+        
+        Wire::FrameView reply;
+        while (m_session.read(reply)) {
+            if (reply.requestId() != id) continue;
+            bytes += reply.size();
+            return reply.type() == Wire::Type::DIR_LIST;
+        }
+        return dropSession();
+    }
+    
+    bool download(uint64_t& bytes) {
+        int fd = connectTo(m_options);
+        if (fd < 0) return false;
+        
+        std::string frame;
+        Wire::appendMessage(frame, true, Wire::Type::DOWNLOAD, {m_pc, "/bench/file.dat"});
+        FrameSocket socket(fd);
+        Wire::FrameView reply;
+        bool ok = sendAll(fd, frame) && socket.read(reply) && reply.type() == Wire::Type::DOWNLOAD_START;
+        if (ok) {
+            size_t size = reply.fieldU64(reply.fieldCount() - 1);
+            ok = socket.skip(size);
+            if (ok) bytes += size;
+        }
+        close(fd);
+        return ok;
+    }
+    
+    bool upload(uint64_t& bytes) {
+        int fd = connectTo(m_options);
+        if (fd < 0) return false;
+        
+        std::string frame;
+        std::string path = "/bench/upload-" + std::to_string(m_index) + ".dat";
+        Wire::appendMessage(frame, true, Wire::Type::UPLOAD, {m_pc, path, std::to_string(m_upload.size())});
+        FrameSocket socket(fd);
+        Wire::FrameView reply;
+        bool ok = sendAll(fd, frame) && socket.read(reply) && reply.type() == Wire::Type::UPLOAD_READY &&
+                  sendAll(fd, m_upload) && socket.read(reply) &&
+                  (reply.type() == Wire::Type::UPLOAD_COMPLETE || reply.type() == Wire::Type::UPLOAD_SUCCESS);
+        if (ok) bytes += m_upload.size();
+        close(fd);
+        return ok;
+    }
+
+private:
+    bool openSession() {
+        int fd = connectTo(m_options);
+        if (fd < 0) return false;
+        
+        std::string frame;
+        std::string mobile_id = "bench-mobile-" + std::to_string(m_index);
+        Wire::appendMessage(frame, true, Wire::Type::CONNECT, {mobile_id, m_pc, "bench-token"});
+        m_session = FrameSocket(fd);
+        Wire::FrameView reply;
+        if (!sendAll(fd, frame) || !m_session.read(reply) || reply.type() != Wire::Type::OK) {
+            return dropSession();
+        }
+        return true;
+    }
+    
+    bool dropSession() {
+        if (m_session.fd() >= 0) {
+            close(m_session.fd());
+            m_session = FrameSocket(-1);
+        }
+        return false;
+    }
+    
+    void closeSession() {
+        if (m_session.fd() >= 0) {
+            std::string frame;
+            Wire::appendMessage(frame, true, Wire::Type::DISCONNECT, {});
+            sendAll(m_session.fd(), frame);
+            dropSession();
+        }
+    }
+    
+    int m_index;
+    const Options& m_options;
+    std::string m_pc;
+    FrameSocket m_session;
+    uint32_t m_next_request;
+    std::string m_upload;
+};
+
+static void runMobile(int index, const Options& options, OpStats* stats) {
+    Mobile mobile(index, options);
+    std::mt19937 random(index + 1);
+    std::discrete_distribution<int> pick({ double(options.mix[0]), double(options.mix[1]), double(options.mix[2]) });
+    
+    while (g_phase != STOP) {
+        int op = pick(random);
+        uint64_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = op == LIST_DIR ? mobile.listDir(bytes) : op == DOWNLOAD ? mobile.download(bytes)
+                                                                          : mobile.upload(bytes);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        
+        if (g_phase != MEASURE) continue;
+        if (ok) {
+            stats[op].latency_us.push_back(static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+            stats[op].bytes += bytes;
+        } else {
+            stats[op].errors++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+// ============================================================================
+// Relay process
+// ============================================================================
+
+struct ProcessSample {
+    double cpu_seconds = 0;
+    long rss_kb = 0;
+    long peak_rss_kb = 0;
+};
+
+static bool sampleProcess(pid_t pid, ProcessSample& sample) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+    FILE* file = std::fopen(path, "r");
+    if (!file) return false;
+    char line[1024];
+    bool ok = std::fgets(line, sizeof(line), file) != nullptr;
+    std::fclose(file);
+    
+    // utime and stime are fields 14 and 15; the command name (field 2)
+    // may contain spaces, so count from the ')' that closes it
+    const char* rest = ok ? std::strrchr(line, ')') : nullptr;
+    unsigned long long utime = 0, stime = 0;
+    if (!rest || std::sscanf(rest + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+                             &utime, &stime) != 2) {
+        return false;
+    }
+    sample.cpu_seconds = double(utime + stime) / sysconf(_SC_CLK_TCK);
+    
+    std::snprintf(path, sizeof(path), "/proc/%d/status", static_cast<int>(pid));
+    file = std::fopen(path, "r");
+    if (!file) return false;
+    while (std::fgets(line, sizeof(line), file)) {
+        std::sscanf(line, "VmRSS: %ld", &sample.rss_kb);
+        std::sscanf(line, "VmHWM: %ld", &sample.peak_rss_kb);
+    }
+    std::fclose(file);
+    return true;
+}
+
+// Starts the relay with its log discarded and waits for it to listen
+static pid_t startRelay(const Options& options) {
+    pid_t pid = fork();
+    check(pid >= 0, "fork");
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execl(options.relay.c_str(), options.relay.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    
+    for (int attempt = 0; attempt < 100; attempt++) {
+        int status;
+        check(waitpid(pid, &status, WNOHANG) == 0, "relay start (is port 2810 already in use?)");
+        int fd = connectTo(options);
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    kill(pid, SIGKILL);
+    check(false, "relay listening");
+    return -1;
+}
+
+// SIGTERM only takes effect once the relay's accept() returns, so it is
+// woken with a connection; SIGKILL if it still has not exited
+static void stopRelay(pid_t pid, const Options& options) {
+    kill(pid, SIGTERM);
+    for (int attempt = 0; attempt < 100; attempt++) {
+        int fd = connectTo(options);
+        if (fd >= 0) close(fd);
+        if (waitpid(pid, nullptr, WNOHANG) == pid) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static double percentile(const std::vector<uint32_t>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)] / 1000.0;
+}
+
+static void printRow(const char* name, std::vector<uint32_t>& latency, uint64_t errors, double seconds) {
+    std::sort(latency.begin(), latency.end());
+    std::printf("  %-10s %9zu %10.0f %8llu %9.2f %9.2f %9.2f\n", name, latency.size(), latency.size() / seconds,
+                static_cast<unsigned long long>(errors), percentile(latency, 0.5), percentile(latency, 0.99),
+                percentile(latency, 0.999));
+}
+
+static void usage(const char* program) {
+    std::fprintf(stderr,
+                 "usage: %s [--relay PATH | --pid PID] [--host ADDR] [--port N]\n"
+                 "          [--pcs N] [--mobiles N] [--seconds N] [--warmup N]\n"
+                 "          [--mix LIST:DOWNLOAD:UPLOAD] [--file-size BYTES] [--entries N]\n"
+                 "          [--heartbeat-ms N]\n",
+                 program);
+    std::exit(2);
+}
+
+static Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* value = argv[++i];
+        
+        if (flag == "--relay") options.relay = value;
+        else if (flag == "--pid") options.pid = std::atoi(value);
+        else if (flag == "--host") options.host = value;
+        else if (flag == "--port") options.port = static_cast<uint16_t>(std::atoi(value));
+        else if (flag == "--pcs") options.pcs = std::atoi(value);
+        else if (flag == "--mobiles") options.mobiles = std::atoi(value);
+        else if (flag == "--seconds") options.seconds = std::atoi(value);
+        else if (flag == "--warmup") options.warmup = std::atoi(value);
+        else if (flag == "--file-size") options.file_size = std::strtoull(value, nullptr, 10);
+        else if (flag == "--entries") options.entries = std::atoi(value);
+        else if (flag == "--heartbeat-ms") options.heartbeat_ms = std::atoi(value);
+        else if (flag == "--mix") {
+            if (std::sscanf(value, "%d:%d:%d", &options.mix[0], &options.mix[1], &options.mix[2]) != 3) {
+                usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+    
+    if (options.pcs < 1 || options.mobiles < 1 || options.seconds < 1 || options.heartbeat_ms < 1 ||
+        options.mix[0] < 0 || options.mix[1] < 0 || options.mix[2] < 0 ||
+        options.mix[0] + options.mix[1] + options.mix[2] == 0) {
+        usage(argv[0]);
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    Options options = parseOptions(argc, argv);
+    signal(SIGPIPE, SIG_IGN);
+    
+    pid_t relay_pid = options.pid;
+    bool started = false;
+    if (!options.relay.empty()) {
+        relay_pid = startRelay(options);
+        started = true;
+    }
+    
+    // PCs first: a mobile's CONNECT is refused while its PC is offline
+    std::string file_data(options.file_size, 'd');
+    std::vector<int> main_fds(options.pcs);
+    std::vector<int> file_fds(options.pcs);
+    for (int i = 0; i < options.pcs; i++) {
+        file_fds[i] = registerPC(i, options, main_fds[i]);
+    }
+    std::vector<std::thread> pcs;
+    for (int i = 0; i < options.pcs; i++) {
+        pcs.emplace_back(runPC, i, file_fds[i], std::cref(options), std::cref(file_data));
+    }
+    
+    std::vector<OpStats> stats(options.mobiles * OP_COUNT);
+    std::vector<std::thread> mobiles;
+    for (int i = 0; i < options.mobiles; i++) {
+        mobiles.emplace_back(runMobile, i, std::cref(options), &stats[i * OP_COUNT]);
+    }
+    
+    std::this_thread::sleep_for(std::chrono::seconds(options.warmup));
+    ProcessSample before, after;
+    bool sampled = relay_pid > 0 && sampleProcess(relay_pid, before);
+    auto start = std::chrono::steady_clock::now();
+    g_phase = MEASURE;
+    
+    std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+    g_phase = STOP;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sampled = sampled && sampleProcess(relay_pid, after);
+    
+    for (std::thread& mobile : mobiles) {
+        mobile.join();
+    }
+    for (int i = 0; i < options.pcs; i++) {
+        shutdown(file_fds[i], SHUT_RDWR);
+        pcs[i].join();
+        close(file_fds[i]);
+        close(main_fds[i]);
+    }
+    if (started) {
+        stopRelay(relay_pid, options);
+    }
+    
+    std::printf("relay-bench (%s:%u, %d PCs, %d mobiles, %.1f s, mix %d:%d:%d, %zu-byte files)\n",
+                options.host.c_str(), options.port, options.pcs, options.mobiles, seconds,
+                options.mix[0], options.mix[1], options.mix[2], options.file_size);
+    std::printf("  %-10s %9s %10s %8s %9s %9s %9s\n", "op", "count", "ops/s", "errors", "p50 ms", "p99 ms",
+                "p99.9 ms");
+    
+    std::vector<uint32_t> all;
+    uint64_t all_errors = 0;
+    uint64_t transferred[OP_COUNT] = {};
+    for (int op = 0; op < OP_COUNT; op++) {
+        std::vector<uint32_t> latency;
+        uint64_t errors = 0;
+        for (int i = 0; i < options.mobiles; i++) {
+            const OpStats& mobile = stats[i * OP_COUNT + op];
+            latency.insert(latency.end(), mobile.latency_us.begin(), mobile.latency_us.end());
+            errors += mobile.errors;
+            transferred[op] += mobile.bytes;
+        }
+        all.insert(all.end(), latency.begin(), latency.end());
+        all_errors += errors;
+        printRow(kOpNames[op], latency, errors, seconds);
+    }
+    printRow("all", all, all_errors, seconds);
+    
+    std::printf("  transfer: %.1f MB/s down, %.1f MB/s up\n", transferred[DOWNLOAD] / seconds / 1e6,
+                transferred[UPLOAD] / seconds / 1e6);
+    if (sampled) {
+        std::printf("  relay pid %d: CPU %.0f%% of one core, RSS %.1f MB (peak %.1f MB)\n",
+                    static_cast<int>(relay_pid), 100.0 * (after.cpu_seconds - before.cpu_seconds) / seconds,
+                    after.rss_kb / 1024.0, after.peak_rss_kb / 1024.0);
+    } else {
+        std::printf("  relay CPU/RSS: not sampled (pass --relay or --pid)\n");
+    }
+    return 0;
+}
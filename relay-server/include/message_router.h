@@ -2,7 +2,12 @@
 #define MESSAGE_ROUTER_H
 
 #include "message.h"
+#include "record_layer.h"
+#include "key_exchange.h"
+#include <ace/SOCK_Stream.h>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
 namespace RemoteAccessSystem {
@@ -13,17 +18,28 @@ public:
     MessageRouter() = default;
     ~MessageRouter() = default;
 
-    // Register a client (PC or mobile) with its ID
-    void RegisterClient(const std::string& client_id, ACE_SOCK_Stream& socket);
+    // Register a client (PC or mobile) with its ID. Runs the server side of
+    // the key exchange on the socket first; false if that fails.
+    bool RegisterClient(const std::string& client_id, ACE_SOCK_Stream& socket);
 
-    // Route a message to the destination client
+    // Route a message to the destination client, sealed with the keys
+    // agreed when it registered
     bool RouteMessage(const Message& message, const std::string& dest_id);
 
 private:
-    std::map<std::string, ACE_SOCK_Stream> clients_;
+    struct Route {
+        ACE_SOCK_Stream socket;
+        std::unique_ptr<RecordLayer> records;
+        std::vector<unsigned char> buffer;  // reused for sealed output
+        std::mutex mutex;                   // one sender at a time per sequence
+    };
+
+    TicketIssuer tickets_;
+    std::map<std::string, std::shared_ptr<Route>> clients_;
+    std::mutex clients_mutex_;
 };
 
 } // namespace Common
 } // namespace RemoteAccessSystem
 
-#endif // MESSAGE_ROUTER_H
\ No newline at end of file
+#endif // MESSAGE_ROUTER_H
@@ -6,6 +6,7 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include "timing_wheel.h"
 
 namespace RemoteAccessSystem {
 namespace RelayServer {
@@ -19,6 +20,7 @@ struct PCClient {
     int socket_fd;
     long last_heartbeat;
     bool is_online;
+    TimingWheel::TimerId deadline;
 };
 
 class RelayManager {
@@ -33,11 +35,17 @@ public:
     PCClient getPCInfo(const std::string& pc_id);
     
 private:
-    void cleanupOfflinePC();
+    // PCs that haven't sent a heartbeat for PC_TIMEOUT are dropped by a
+    // per-PC timer; heartbeats push it back
+    static constexpr std::chrono::minutes PC_TIMEOUT{5};
+    
+    void armDeadline(PCClient& pc);
+    void expirePC(const std::string& pc_id, TimingWheel::TimerId timer);
     
 private:
     std::map<std::string, PCClient> registered_pcs_;
     std::mutex mutex_;
+    TimingWheel timers_;    // last, so it stops before the map goes away
 };
 
 } // namespace RelayServer
@@ -0,0 +1,99 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RemoteAccessSystem {
+namespace RelayServer {
+
+// Hierarchical timing wheel for the relay's deadlines (PC heartbeats,
+// pending request timeouts).
+//
+// LEVELS wheels of SLOTS slots each; level 0 slots are one tick wide, each
+// level above is SLOTS times coarser. A timer goes into the level that
+// covers its remaining time and is moved down a level as that slot comes
+// around, so scheduling, rescheduling and cancelling are O(1) and each tick
+// touches only the slot it expires. With 100 ms ticks the wheel spans
+// about 19 days; longer delays are clamped to that.
+//
+// Timers live in a slab and are addressed by an id that carries a
+// generation, so a stale id (fired or cancelled) is simply refused.
+// Callbacks run on the wheel's thread without its lock held; they may
+// schedule or cancel timers themselves.
+class TimingWheel {
+public:
+    typedef uint64_t TimerId;
+    typedef std::function<void(TimerId)> Callback;
+
+    static constexpr TimerId INVALID_TIMER = 0;
+
+    explicit TimingWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100));
+    ~TimingWheel();
+
+    // Starts and stops the thread that advances the wheel in real time
+    void start();
+    void stop();
+
+    // Calls `callback` once, `delay` from now (rounded up to a tick)
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback);
+
+    // Moves a pending timer to `delay` from now; false if it already
+    // fired or was cancelled
+    bool reschedule(TimerId id, std::chrono::milliseconds delay);
+
+    bool cancel(TimerId id);
+
+    size_t pending() const;
+
+    // Advances `ticks` ticks and runs what expired; the thread calls this,
+    // and it can be driven by hand when the thread is not started
+    void advance(uint64_t ticks);
+
+private:
+    static constexpr unsigned LEVEL_BITS = 6;
+    static constexpr unsigned SLOTS = 1u << LEVEL_BITS;
+    static constexpr unsigned LEVELS = 4;
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Timer {
+        uint64_t expires;       // absolute tick
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;
+        uint16_t slot;          // level * SLOTS + index, while linked
+        bool linked;
+        Callback callback;
+    };
+
+    uint64_t ticksFor(std::chrono::milliseconds delay) const;
+    bool lookup(TimerId id, uint32_t& index) const;
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    void run();
+
+    const std::chrono::milliseconds m_tick;
+    mutable std::mutex m_mutex;
+    std::vector<Timer> m_timers;
+    std::vector<uint32_t> m_free;
+    uint32_t m_slots[LEVELS * SLOTS];
+    uint64_t m_now;             // ticks processed so far
+    size_t m_pending;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::mutex m_wait_mutex;
+    std::condition_variable m_wake;
+};
+
+} // namespace RelayServer
+} // namespace RemoteAccessSystem
+
+#endif // TIMING_WHEEL_H
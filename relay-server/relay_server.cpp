@@ -1,10 +1,55 @@
 #include "relay_server.h"
+#include "../common/include/perfect_hash.h"
 #include <ace/Log_Msg.h>
 #include <ace/OS_NS_unistd.h>
 #include <ace/OS_NS_sys_socket.h>
 #include <sstream>
+#include <string_view>
 #include <vector>
 
+namespace {
+
+// Commands handle_request understands; kRequestNames lists them in the
+// same order, so a name's index is its RequestCommand
+enum RequestCommand {
+    CMD_REGISTER_PC,
+    CMD_FILE_HANDLER_REGISTER,
+    CMD_PC_FILE,
+    CMD_QUERY_PC_LIST,
+    CMD_GET_PCS,
+    CMD_LIST_DIR,
+    CMD_DOWNLOAD_FILE,
+    CMD_DOWNLOAD,
+    CMD_GENERATE_URL,
+    CMD_DELETE,
+    CMD_RENAME,
+    CMD_COPY,
+    CMD_UPLOAD,
+    CMD_DIR_LISTING,
+    CMD_FILE_DATA,
+    CMD_HEARTBEAT,
+    CMD_DIR_LIST,
+    CMD_DOWNLOAD_START,
+    CMD_ERROR,
+    CMD_UPLOAD_COMPLETE,
+    CMD_UPLOAD_READY,
+    CMD_DELETE_OK,
+    CMD_RENAME_OK,
+    CMD_COPY_OK,
+    CMD_SHARE_URL,
+    CMD_COUNT
+};
+
+constexpr RemoteAccessSystem::NameIndex<CMD_COUNT> kRequestNames({
+    "REGISTER_PC", "FILE_HANDLER_REGISTER", "PC_FILE", "QUERY_PC_LIST", "GET_PCS",
+    "LIST_DIR", "DOWNLOAD_FILE", "DOWNLOAD", "GENERATE_URL", "DELETE", "RENAME",
+    "COPY", "UPLOAD", "DIR_LISTING", "FILE_DATA", "HEARTBEAT", "DIR_LIST",
+    "DOWNLOAD_START", "ERROR", "UPLOAD_COMPLETE", "UPLOAD_READY", "DELETE_OK",
+    "RENAME_OK", "COPY_OK", "SHARE_URL"
+});
+
+} // namespace
+
 RelayServer::RelayServer()
     : running_(false)
     , relay_port_(2810)
@@ -102,71 +147,77 @@ int RelayServer::handle_client(ACE_SOCK_Stream* client_stream) {
 }
 
 void RelayServer::handle_request(ACE_SOCK_Stream* client_stream, const std::string& request) {
-    // Support both old and new command formats
-    if (request.find("REGISTER_PC|") == 0) {
-        handle_pc_registration(client_stream, request.substr(12));
-    }
-    else if (request.find("FILE_HANDLER_REGISTER|") == 0) {
-        handle_file_handler_registration(client_stream, request.substr(22));
-    }
-    else if (request.find("PC_FILE|") == 0) {
-        handle_file_handler_registration(client_stream, request.substr(8));
-    }
-    else if (request == "QUERY_PC_LIST\n" || request == "QUERY_PC_LIST" || 
-             request == "GET_PCS\n" || request == "GET_PCS") {
+    // Support both old and new command formats: NAME|args or a bare NAME
+    size_t name_end = request.find_first_of("|\r\n");
+    std::string_view name(request.data(), name_end == std::string::npos ? request.size() : name_end);
+    std::string args = name_end != std::string::npos && request[name_end] == '|'
+        ? request.substr(name_end + 1) : std::string();
+    
+    switch (kRequestNames.find(name)) {
+    case CMD_REGISTER_PC:
+        handle_pc_registration(client_stream, args);
+        break;
+    case CMD_FILE_HANDLER_REGISTER:
+    case CMD_PC_FILE:
+        handle_file_handler_registration(client_stream, args);
+        break;
+    case CMD_QUERY_PC_LIST:
+    case CMD_GET_PCS:
         handle_pc_list_query(client_stream);
-    }
-    else if (request.find("LIST_DIR|") == 0) {
-        handle_list_dir_request(client_stream, request.substr(9));
-    }
-    else if (request.find("DOWNLOAD_FILE|") == 0) {
-        handle_download_request(client_stream, request.substr(14));
-    }
-    else if (request.find("DOWNLOAD|") == 0) {
-        handle_download_request(client_stream, request.substr(9));
-    }
-    else if (request.find("GENERATE_URL|") == 0) {
-        handle_generate_url_request(client_stream, request.substr(13));
-    }
-    else if (request.find("DELETE|") == 0) {
-        handle_delete_request(client_stream, request.substr(7));
-    }
-    else if (request.find("RENAME|") == 0) {
-        handle_rename_request(client_stream, request.substr(7));
-    }
-    else if (request.find("COPY|") == 0) {
-        handle_copy_request(client_stream, request.substr(5));
-    }
-    else if (request.find("UPLOAD|") == 0) {
-        handle_upload_request(client_stream, request.substr(7));
-    }
-    else if (request.find("DIR_LISTING|") == 0 || request.find("FILE_DATA|") == 0) {
+        break;
+    case CMD_LIST_DIR:
+        handle_list_dir_request(client_stream, args);
+        break;
+    case CMD_DOWNLOAD_FILE:
+    case CMD_DOWNLOAD:
+        handle_download_request(client_stream, args);
+        break;
+    case CMD_GENERATE_URL:
+        handle_generate_url_request(client_stream, args);
+        break;
+    case CMD_DELETE:
+        handle_delete_request(client_stream, args);
+        break;
+    case CMD_RENAME:
+        handle_rename_request(client_stream, args);
+        break;
+    case CMD_COPY:
+        handle_copy_request(client_stream, args);
+        break;
+    case CMD_UPLOAD:
+        handle_upload_request(client_stream, args);
+        break;
+    case CMD_DIR_LISTING:
+    case CMD_FILE_DATA:
         handle_pc_response(client_stream, request);
-    }
-    else if (request.find("HEARTBEAT") == 0) {
+        break;
+    case CMD_HEARTBEAT: {
         std::string response = "PONG\n";
         client_stream->send(response.c_str(), response.length());
         ACE_DEBUG((LM_DEBUG, "[RelayServer] Heartbeat acknowledged\n"));
         // Don't close - keep connection alive for heartbeats
-    }
-    else if (request.find("DIR_LIST|") == 0 || 
-             request.find("DOWNLOAD_START|") == 0 || 
-             request.find("ERROR|") == 0 || 
-             request.find("UPLOAD_COMPLETE") == 0 ||
-             request.find("UPLOAD_READY") == 0 ||
-             request.find("DELETE_OK") == 0 ||
-             request.find("RENAME_OK") == 0 ||
-             request.find("COPY_OK") == 0 ||
-             request.find("SHARE_URL|") == 0) {
+        break;
+    }
+    case CMD_DIR_LIST:
+    case CMD_DOWNLOAD_START:
+    case CMD_ERROR:
+    case CMD_UPLOAD_COMPLETE:
+    case CMD_UPLOAD_READY:
+    case CMD_DELETE_OK:
+    case CMD_RENAME_OK:
+    case CMD_COPY_OK:
+    case CMD_SHARE_URL:
         // Response from file handler - forward to waiting client
         handle_file_handler_response(client_stream, request);
-    }
-    else {
+        break;
+    default: {
         ACE_DEBUG((LM_WARNING, "[RelayServer] Unknown command: '%s'\n", request.c_str()));
         std::string error = "ERROR|Unknown command\n";
         client_stream->send(error.c_str(), error.length());
         client_stream->close();
         delete client_stream;
+        break;
+    }
     }
 }
 
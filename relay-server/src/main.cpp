@@ -1,5 +1,5 @@
 #include "relay_manager.h"
-#include <iostream>
+#include "async_log.h"
 #include <thread>
 #include <map>
 #include <mutex>
@@ -7,6 +7,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <cerrno>
 #include <cstring>
 #include <csignal>
 #include <atomic>
@@ -22,8 +23,7 @@ RelayManager* relay_manager = nullptr;
 std::map<std::string, int> pc_file_handlers;
 std::mutex file_handler_mutex;
 
-void signalHandler(int signal) {
-    std::cout << "\n[RelayServer] Shutting down..." << std::endl;
+void signalHandler(int) {
     running = false;
 }
 
@@ -44,7 +44,8 @@ void handleClient(int client_fd, RelayManager* manager) {
     if (bytes > 0) {
         buffer[bytes] = '\0';
         std::string data(buffer);
-        std::cout << "[RelayServer] Received: " << data << std::endl;
+        LOG_DEBUG("RelayServer", "Received", {"fd", client_fd},
+                  {"message", data.substr(0, data.find_last_not_of("\r\n") + 1)});
         
         if (data.find("REGISTER|") == 0) {
             // Handle PC registration
@@ -60,7 +61,7 @@ void handleClient(int client_fd, RelayManager* manager) {
                 
                 std::string response = "OK|REGISTERED\n";
                 send(client_fd, response.c_str(), response.length(), 0);
-                std::cout << "[RelayServer] PC registered: " << pc_id << " (" << username << ")" << std::endl;
+                LOG_INFO("RelayServer", "PC registered", {"pc_id", pc_id}, {"username", username});
                 
                 // Keep connection open for heartbeats
                 while (running) {
@@ -78,7 +79,7 @@ void handleClient(int client_fd, RelayManager* manager) {
                 }
                 
                 manager->unregisterPC(pc_id);
-                std::cout << "[RelayServer] PC unregistered: " << pc_id << std::endl;
+                LOG_INFO("RelayServer", "PC unregistered", {"pc_id", pc_id});
             }
         }
         else if (data.find("PC_FILE|") == 0) {
@@ -94,7 +95,7 @@ void handleClient(int client_fd, RelayManager* manager) {
                 
                 std::string response = "OK|FILE_REGISTERED\n";
                 send(client_fd, response.c_str(), response.length(), 0);
-                std::cout << "[RelayServer] File handler registered for PC: " << pc_id << std::endl;
+                LOG_INFO("RelayServer", "File handler registered", {"pc_id", pc_id});
                 
                 // Keep connection open for file operations
                 while (running) {
@@ -103,14 +104,14 @@ void handleClient(int client_fd, RelayManager* manager) {
                     
                     buffer[bytes] = '\0';
                     std::string msg(buffer);
-                    std::cout << "[RelayServer] File handler message: " << msg << std::endl;
+                    LOG_DEBUG("RelayServer", "File handler message", {"pc_id", pc_id}, {"message", msg});
                 }
                 
                 {
                     std::lock_guard<std::mutex> lock(file_handler_mutex);
                     pc_file_handlers.erase(pc_id);
                 }
-                std::cout << "[RelayServer] File handler disconnected for PC: " << pc_id << std::endl;
+                LOG_INFO("RelayServer", "File handler disconnected", {"pc_id", pc_id});
                 return; // Don't close socket here, already handled
             }
         }
@@ -134,15 +135,13 @@ int main() {
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
     
-    std::cout << "========================================" << std::endl;
-    std::cout << "  Relay Server v1.0" << std::endl;
-    std::cout << "========================================" << std::endl;
+    LOG_INFO("RelayServer", "Relay Server starting", {"version", "1.0"});
     
     relay_manager = new RelayManager();
     
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
-        std::cerr << "[RelayServer] Failed to create socket" << std::endl;
+        LOG_ERROR("RelayServer", "Failed to create socket", {"error", strerror(errno)});
         return 1;
     }
     
@@ -155,18 +154,18 @@ int main() {
     address.sin_port = htons(2810);
     
     if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-        std::cerr << "[RelayServer] Bind failed" << std::endl;
+        LOG_ERROR("RelayServer", "Bind failed", {"port", 2810}, {"error", strerror(errno)});
         close(server_fd);
         return 1;
     }
     
     if (listen(server_fd, 5) < 0) {
-        std::cerr << "[RelayServer] Listen failed" << std::endl;
+        LOG_ERROR("RelayServer", "Listen failed", {"error", strerror(errno)});
         close(server_fd);
         return 1;
     }
     
-    std::cout << "[RelayServer] Listening on port 2810" << std::endl;
+    LOG_INFO("RelayServer", "Listening", {"port", 2810});
     
     while (running) {
         struct sockaddr_in client_addr;
@@ -178,13 +177,15 @@ int main() {
             else break;
         }
         
-        std::cout << "[RelayServer] New client connected" << std::endl;
+        LOG_DEBUG("RelayServer", "New client connected", {"address", inet_ntoa(client_addr.sin_addr)},
+                  {"fd", client_fd});
         std::thread(&handleClient, client_fd, relay_manager).detach();
     }
     
+    LOG_INFO("RelayServer", "Shutting down");
     close(server_fd);
     delete relay_manager;
     
-    std::cout << "[RelayServer] Shutdown complete" << std::endl;
+    LOG_INFO("RelayServer", "Shutdown complete");
     return 0;
 }
\ No newline at end of file
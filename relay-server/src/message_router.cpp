@@ -1,35 +1,85 @@
-#include <tao/ORB.h>
 #include <ace/SOCK_Stream.h>
-#include <ace/SOCK_Acceptor.h>
-#include <ace/INET_Addr.h>
 #include <ace/Log_Msg.h>
-#include "protocol.h"
 #include "message.h"
-#include "crypto.h"
 #include "utils.h"
 #include "message_router.h"
-#include "utils.h"
 
 namespace RemoteAccessSystem {
 namespace Common {
 
-void MessageRouter::RegisterClient(const std::string& client_id, ACE_SOCK_Stream& socket) {
-    clients_[client_id] = socket;
-    ACE_DEBUG((LM_INFO, ACE_TEXT( "Registered client: " + client_id);
+namespace {
+
+bool SendFrame(ACE_SOCK_Stream& socket, const unsigned char* data, uint32_t size) {
+    iovec iov[2];
+    iov[0].iov_base = &size;
+    iov[0].iov_len = sizeof(size);
+    iov[1].iov_base = const_cast<unsigned char*>(data);
+    iov[1].iov_len = size;
+    return socket.sendv_n(iov, 2) != -1;
 }
 
-bool MessageRouter::RouteMessage(const Message& message, const std::string& dest_id) {
-    auto it = clients_.find(dest_id);
-    if (it == clients_.end()) {
-        ACE_ERROR((LM_ERROR, ACE_TEXT( "Destination client not found: " + dest_id);
-        return false;
+} // namespace
+
+bool MessageRouter::RegisterClient(const std::string& client_id, ACE_SOCK_Stream& socket) {
+    SessionKeys keys;
+    KeyExchange::Mode mode = KeyExchange::Mode::RETRY;
+    std::vector<unsigned char> hello;
+    std::vector<unsigned char> reply;
+    
+    // A refused ticket gets one follow-up hello, which must be a full exchange
+    for (int attempt = 0; attempt < 2 && mode == KeyExchange::Mode::RETRY; ++attempt) {
+        uint32_t size = 0;
+        bool ok = socket.recv_n(&size, sizeof(size)) != -1 && size <= RecordLayer::MAX_RECORD;
+        if (ok) {
+            hello.resize(size);
+            ok = size == 0 || socket.recv_n(hello.data(), size) != -1;
+        }
+        ok = ok && tickets_.Accept(hello, reply, keys, mode) && SendFrame(socket, reply.data(), reply.size());
+        if (!ok) {
+            ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("Key exchange failed: %s\n"), client_id.c_str()), false);
+        }
+    }
+    if (mode == KeyExchange::Mode::RETRY) {
+        ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("Key exchange failed: %s\n"), client_id.c_str()), false);
     }
+    
+    auto route = std::make_shared<Route>();
+    route->socket = socket;
+    route->records.reset(new RecordLayer(CipherSuite::AES_256_GCM,
+                                         keys.server_key, keys.server_iv,
+                                         keys.client_key, keys.client_iv));
+    route->buffer.reserve(RecordLayer::MAX_RECORD);
+    
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        clients_[client_id] = route;
+    }
+    
+    ACE_DEBUG((LM_INFO, ACE_TEXT("Registered client: %s (%s)\n"), client_id.c_str(),
+               mode == KeyExchange::Mode::RESUMED ? "resumed" : "full handshake"));
+    return true;
+}
 
-    Protocol protocol(nullptr);
-    auto key = Crypto::GenerateKey();
-    auto iv = Crypto::GenerateIV();
-    return protocol.SendMessage(it->second, message, key, iv);
+bool MessageRouter::RouteMessage(const Message& message, const std::string& dest_id) {
+    std::shared_ptr<Route> route;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        auto it = clients_.find(dest_id);
+        if (it != clients_.end()) {
+            route = it->second;
+        }
+    }
+    if (!route) {
+        ACE_ERROR_RETURN((LM_ERROR, ACE_TEXT("Destination client not found: %s\n"), dest_id.c_str()), false);
+    }
+    
+    // Session keys were agreed at registration; per message only sealing
+    std::vector<uint8_t> data = message.Serialize();
+    std::lock_guard<std::mutex> lock(route->mutex);
+    route->buffer.clear();
+    route->records->SealStream(data.data(), data.size(), route->buffer);
+    return SendFrame(route->socket, route->buffer.data(), route->buffer.size());
 }
 
 } // namespace Common
-} // namespace RemoteAccessSystem
\ No newline at end of file
+} // namespace RemoteAccessSystem
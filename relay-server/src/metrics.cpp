@@ -0,0 +1,267 @@
+#include "metrics.h"
+#include "async_log.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t MAX_REQUEST_HEAD = 8192;
+const int REQUEST_TIMEOUT_SECONDS = 2;
+
+void appendNumber(std::string& out, double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.15g", value);
+    out += text;
+}
+
+void appendSample(std::string& out, const std::string& name, const std::string& labels, double value) {
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    appendNumber(out, value);
+    out += '\n';
+}
+
+bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+} // namespace
+
+Counter::Counter() {
+    for (Stripe& stripe : m_stripes) {
+        stripe.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const Stripe& stripe : m_stripes) {
+        total += stripe.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram::Histogram(double scale) : m_scale(scale) {
+    for (auto& stripe : m_stripes) {
+        stripe.reset(new Stripe());
+        for (auto& bucket : stripe->buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        stripe->sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t Histogram::bucketFor(uint64_t value) {
+    if (value < SUB_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    unsigned top = 63 - __builtin_clzll(value);
+    if (top >= MAX_BITS) {
+        return BUCKETS - 1;
+    }
+    
+    // The bits just below the top one pick the linear sub-bucket
+    unsigned shift = top - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + static_cast<size_t>((value >> shift) - SUB_COUNT);
+}
+
+uint64_t Histogram::upperBound(size_t bucket) {
+    if (bucket < SUB_COUNT) {
+        return bucket;
+    }
+    unsigned shift = static_cast<unsigned>(bucket / SUB_COUNT) - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_COUNT + bucket % SUB_COUNT) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+void Histogram::render(std::string& out, const std::string& name, const std::string& labels) const {
+    std::string prefix = labels.empty() ? std::string() : labels + ",";
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        uint64_t in_bucket = 0;
+        for (const auto& stripe : m_stripes) {
+            in_bucket += stripe->buckets[bucket].load(std::memory_order_relaxed);
+        }
+        if (in_bucket == 0) continue;
+        count += in_bucket;
+        
+        // The overflow bucket has no finite bound; +Inf covers it
+        if (bucket + 1 < BUCKETS) {
+            char le[48];
+            snprintf(le, sizeof(le), "le=\"%.9g\"", upperBound(bucket) * m_scale);
+            appendSample(out, name + "_bucket", prefix + le, static_cast<double>(count));
+        }
+    }
+    for (const auto& stripe : m_stripes) {
+        sum += stripe->sum.load(std::memory_order_relaxed);
+    }
+    
+    appendSample(out, name + "_bucket", prefix + "le=\"+Inf\"", static_cast<double>(count));
+    appendSample(out, name + "_sum", labels, sum * m_scale);
+    appendSample(out, name + "_count", labels, static_cast<double>(count));
+}
+
+MetricsRegistry::MetricsRegistry() : m_listener(-1), m_serving(false) {
+}
+
+MetricsRegistry::~MetricsRegistry() {
+    stop();
+}
+
+MetricsRegistry::Metric& MetricsRegistry::add(const std::string& name, const std::string& help, Kind kind,
+                                              const std::string& labels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_metrics.emplace_back(new Metric());
+    Metric& metric = *m_metrics.back();
+    metric.name = name;
+    metric.help = help;
+    metric.kind = kind;
+    metric.labels = labels;
+    return metric;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    Metric& metric = add(name, help, COUNTER, labels);
+    metric.counter.reset(new Counter());
+    return *metric.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    Metric& metric = add(name, help, GAUGE, labels);
+    metric.gauge.reset(new Gauge());
+    return *metric.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const std::string& labels, double scale) {
+    Metric& metric = add(name, help, HISTOGRAM, labels);
+    metric.histogram.reset(new Histogram(scale));
+    return *metric.histogram;
+}
+
+void MetricsRegistry::callback(const std::string& name, const std::string& help, Kind kind,
+                               const std::string& labels, std::function<double()> read) {
+    Metric& metric = add(name, help, kind, labels);
+    metric.read = std::move(read);
+}
+
+std::string MetricsRegistry::render() const {
+    static const char* const kTypes[] = { "counter", "gauge", "histogram" };
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string out;
+    
+    // Series of one name are written together under a single HELP/TYPE,
+    // whatever order they were registered in
+    std::vector<bool> written(m_metrics.size(), false);
+    for (size_t i = 0; i < m_metrics.size(); i++) {
+        if (written[i]) continue;
+        const Metric& family = *m_metrics[i];
+        out += "# HELP " + family.name + " " + family.help + "\n";
+        out += "# TYPE " + family.name + " " + kTypes[family.kind] + "\n";
+        
+        for (size_t j = i; j < m_metrics.size(); j++) {
+            const Metric& metric = *m_metrics[j];
+            if (written[j] || metric.name != family.name) continue;
+            written[j] = true;
+            
+            if (metric.read) {
+                appendSample(out, metric.name, metric.labels, metric.read());
+            } else if (metric.counter) {
+                appendSample(out, metric.name, metric.labels, static_cast<double>(metric.counter->value()));
+            } else if (metric.gauge) {
+                appendSample(out, metric.name, metric.labels, static_cast<double>(metric.gauge->value()));
+            } else if (metric.histogram) {
+                metric.histogram->render(out, metric.name, metric.labels);
+            }
+        }
+    }
+    return out;
+}
+
+bool MetricsRegistry::serve(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int opt = 1;
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 16) < 0) {
+        LOG_ERROR("Metrics", "Cannot listen", {"port", port}, {"error", strerror(errno)});
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    
+    m_listener = fd;
+    m_serving = true;
+    m_thread = std::thread(&MetricsRegistry::acceptLoop, this);
+    return true;
+}
+
+void MetricsRegistry::stop() {
+    if (m_serving.exchange(false)) {
+        // Wakes the blocked accept()
+        shutdown(m_listener, SHUT_RDWR);
+        m_thread.join();
+        close(m_listener);
+        m_listener = -1;
+    }
+}
+
+void MetricsRegistry::acceptLoop() {
+    while (m_serving) {
+        int fd = accept(m_listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        answer(fd);
+        close(fd);
+    }
+}
+
+// One request per connection; scrapes are rare, so they are answered in
+// turn on this thread
+void MetricsRegistry::answer(int fd) {
+    struct timeval tv;
+    tv.tv_sec = REQUEST_TIMEOUT_SECONDS;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    
+    std::string head;
+    char buffer[1024];
+    while (head.find("\r\n\r\n") == std::string::npos && head.size() < MAX_REQUEST_HEAD) {
+        ssize_t bytes = recv(fd, buffer, sizeof(buffer), 0);
+        if (bytes <= 0) return;
+        head.append(buffer, bytes);
+    }
+    
+    std::string line = head.substr(0, head.find("\r\n"));
+    bool metrics = line.compare(0, 13, "GET /metrics ") == 0 || line.compare(0, 13, "GET /metrics?") == 0;
+    
+    std::string body = metrics ? render() : std::string("Not Found\n");
+    std::string response = metrics ? "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                   : "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n";
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    response += body;
+    writeAll(fd, response.data(), response.size());
+}
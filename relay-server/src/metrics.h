@@ -0,0 +1,158 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Relay metrics in the Prometheus text format.
+//
+// Updates are lock-free and, for counters and histograms, spread over
+// per-thread stripes: each thread gets a stripe on first use and only
+// ever touches its own cache lines, so hot paths do not contend. A scrape
+// sums the stripes; it may see an update on one stripe and not yet on
+// another, which is fine for monitoring.
+//
+// Metrics are created once at startup and referenced from then on;
+// values that already live elsewhere (registry sizes, TLS stats) are read
+// through callbacks at scrape time instead.
+
+namespace MetricsDetail {
+
+const size_t STRIPES = 16;
+
+// This thread's stripe, assigned round-robin on first use
+inline size_t stripe() {
+    static std::atomic<size_t> next(0);
+    thread_local size_t mine = next.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+    return mine;
+}
+
+} // namespace MetricsDetail
+
+class Counter {
+public:
+    Counter();
+
+    void add(uint64_t n = 1) {
+        m_stripes[MetricsDetail::stripe()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> value;
+    };
+
+    Stripe m_stripes[MetricsDetail::STRIPES];
+};
+
+class Gauge {
+public:
+    Gauge() : m_value(0) {}
+
+    void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    void set(int64_t n) { m_value.store(n, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value;
+};
+
+// HDR-style histogram of non-negative integers (microseconds, bytes/s).
+// Buckets are log-linear: 2^SUB_BITS linear sub-buckets per power of two,
+// so any value is counted within 1/2^SUB_BITS (about 6%) of its true size
+// from 1 up to 2^MAX_BITS; larger values land in the last bucket. Exported
+// scaled by `scale` (1e-6 turns microseconds into the seconds Prometheus
+// expects), with one cumulative bucket per occupied HDR bucket.
+class Histogram {
+public:
+    explicit Histogram(double scale);
+
+    void record(uint64_t value) {
+        Stripe& stripe = *m_stripes[MetricsDetail::stripe()];
+        stripe.buckets[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+        stripe.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Appends the _bucket, _sum and _count lines for `name{labels}`
+    void render(std::string& out, const std::string& name, const std::string& labels) const;
+
+private:
+    static const unsigned SUB_BITS = 4;
+    static const unsigned SUB_COUNT = 1u << SUB_BITS;
+    static const unsigned MAX_BITS = 40;
+    static const size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> sum;
+    };
+
+    static size_t bucketFor(uint64_t value);
+    static uint64_t upperBound(size_t bucket);      // largest value in the bucket
+
+    double m_scale;
+    std::unique_ptr<Stripe> m_stripes[MetricsDetail::STRIPES];
+};
+
+class MetricsRegistry {
+public:
+    enum Kind { COUNTER, GAUGE, HISTOGRAM };
+
+    MetricsRegistry();
+    ~MetricsRegistry();
+
+    // `labels` is the Prometheus label set without braces, e.g.
+    // direction="upload"; metrics sharing a name share one HELP/TYPE
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+                         double scale = 1.0);
+
+    // A counter or gauge whose value is read from elsewhere at scrape time
+    void callback(const std::string& name, const std::string& help, Kind kind, const std::string& labels,
+                  std::function<double()> read);
+
+    // Every metric in the Prometheus text exposition format
+    std::string render() const;
+
+    // Serves GET /metrics over HTTP on `port` from a background thread;
+    // false (logged) if the port cannot be bound
+    bool serve(uint16_t port);
+    void stop();
+
+private:
+    struct Metric {
+        std::string name;
+        std::string help;
+        Kind kind;
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> read;
+    };
+
+    Metric& add(const std::string& name, const std::string& help, Kind kind, const std::string& labels);
+    void acceptLoop();
+    void answer(int fd);
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    mutable std::mutex m_mutex;         // registration vs. scrape; never taken by updates
+    std::vector<std::unique_ptr<Metric>> m_metrics;
+
+    int m_listener;
+    std::atomic<bool> m_serving;
+    std::thread m_thread;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,272 @@
+#include "pc_registry.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+PCRegistry::PCRegistry()
+    : m_next_watch(1), m_snapshot(std::make_shared<const Snapshot>()) {
+}
+
+PCRegistry::Shard& PCRegistry::shardFor(const std::string& pc_id) {
+    return m_shards[std::hash<std::string>()(pc_id) % SHARD_COUNT];
+}
+
+const PCRegistry::Shard& PCRegistry::shardFor(const std::string& pc_id) const {
+    return m_shards[std::hash<std::string>()(pc_id) % SHARD_COUNT];
+}
+
+int PCRegistry::registerPC(const std::string& pc_id, const std::string& usb_id,
+                           const std::string& username, int main_fd) {
+    bool listing_changed = true;
+    int previous = -1;
+    {
+        Shard& shard = shardFor(pc_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto inserted = shard.pcs.emplace(pc_id, PCInfo());
+        PCInfo& info = inserted.first->second;
+        if (inserted.second) {
+            info.pc_id = pc_id;
+            info.deadline = 0;
+        } else {
+            listing_changed = info.main_connection == -1 || info.username != username;
+            if (info.main_connection != main_fd) {
+                previous = info.main_connection;
+            }
+        }
+        info.usb_id = usb_id;
+        info.username = username;
+        info.main_connection = main_fd;
+        info.last_heartbeat = time(nullptr);
+    }
+    
+    if (listing_changed) {
+        reindex(pc_id);
+    }
+    return previous;
+}
+
+std::shared_ptr<FileChannel> PCRegistry::setFileConnection(const std::string& pc_id,
+                                                           std::shared_ptr<FileChannel> channel) {
+    Shard& shard = shardFor(pc_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto inserted = shard.pcs.emplace(pc_id, PCInfo());
+    PCInfo& info = inserted.first->second;
+    if (inserted.second) {
+        // FileHandler came up before REGISTER; not listed until it does
+        info.pc_id = pc_id;
+        info.main_connection = -1;
+        info.last_heartbeat = time(nullptr);
+        info.deadline = 0;
+    }
+    info.file_channel.swap(channel);
+    return channel;
+}
+
+void PCRegistry::clearFileConnection(const std::string& pc_id, const FileChannel* channel) {
+    Shard& shard = shardFor(pc_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pcs.find(pc_id);
+    if (it != shard.pcs.end() && it->second.file_channel.get() == channel) {
+        it->second.file_channel.reset();
+    }
+}
+
+void PCRegistry::touch(const std::string& pc_id) {
+    Shard& shard = shardFor(pc_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pcs.find(pc_id);
+    if (it != shard.pcs.end()) {
+        it->second.last_heartbeat = time(nullptr);
+    }
+}
+
+void PCRegistry::setDeadline(const std::string& pc_id, uint64_t timer) {
+    Shard& shard = shardFor(pc_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pcs.find(pc_id);
+    if (it != shard.pcs.end()) {
+        it->second.deadline = timer;
+    }
+}
+
+bool PCRegistry::removeIfDeadline(const std::string& pc_id, uint64_t timer, PCInfo& removed) {
+    {
+        Shard& shard = shardFor(pc_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.pcs.find(pc_id);
+        if (it == shard.pcs.end() || it->second.deadline != timer) {
+            return false;
+        }
+        removed = std::move(it->second);
+        shard.pcs.erase(it);
+    }
+    
+    reindex(pc_id);
+    return true;
+}
+
+bool PCRegistry::find(const std::string& pc_id, PCInfo& info) const {
+    const Shard& shard = shardFor(pc_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pcs.find(pc_id);
+    if (it == shard.pcs.end()) {
+        return false;
+    }
+    info = it->second;
+    return true;
+}
+
+std::shared_ptr<const PCRegistry::Snapshot> PCRegistry::online() const {
+    return std::atomic_load(&m_snapshot);
+}
+
+PCRegistry::Snapshot PCRegistry::onlineFor(const std::string& username,
+                                           const std::vector<std::string>& bound) const {
+    std::lock_guard<std::mutex> lock(m_index_mutex);
+    return listingFor(username, bound);
+}
+
+PCRegistry::WatchId PCRegistry::watch(const std::string& username, const std::vector<std::string>& bound,
+                                      PresenceCallback callback, Snapshot& current) {
+    std::lock_guard<std::mutex> lock(m_index_mutex);
+    WatchId id = m_next_watch++;
+    m_watchers[id] = Watcher{ username, bound, std::move(callback) };
+    if (!username.empty()) {
+        m_watching_user.emplace(username, id);
+    }
+    for (const std::string& pc_id : bound) {
+        m_watching_pc.emplace(pc_id, id);
+    }
+    current = listingFor(username, bound);
+    return id;
+}
+
+void PCRegistry::unwatch(WatchId id) {
+    std::lock_guard<std::mutex> lock(m_index_mutex);
+    auto watcher = m_watchers.find(id);
+    if (watcher == m_watchers.end()) {
+        return;
+    }
+    
+    auto forget = [id](std::unordered_multimap<std::string, WatchId>& index, const std::string& key) {
+        auto range = index.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                index.erase(it);
+                break;
+            }
+        }
+    };
+    if (!watcher->second.username.empty()) {
+        forget(m_watching_user, watcher->second.username);
+    }
+    for (const std::string& pc_id : watcher->second.bound) {
+        forget(m_watching_pc, pc_id);
+    }
+    m_watchers.erase(watcher);
+}
+
+PCRegistry::Snapshot PCRegistry::listingFor(const std::string& username,
+                                            const std::vector<std::string>& bound) const {
+    Snapshot listing;
+    if (!username.empty()) {
+        auto owned = m_owned.find(username);
+        if (owned != m_owned.end()) {
+            for (const std::string& pc_id : owned->second) {
+                listing.push_back(Listing{ pc_id, username });
+            }
+        }
+    }
+    for (const std::string& pc_id : bound) {
+        auto listed = m_listed.find(pc_id);
+        if (listed != m_listed.end() && listed->second != username) {
+            listing.push_back(Listing{ pc_id, listed->second });
+        }
+    }
+    
+    auto by_id = [](const Listing& a, const Listing& b) { return a.pc_id < b.pc_id; };
+    std::sort(listing.begin(), listing.end(), by_id);
+    listing.erase(std::unique(listing.begin(), listing.end(),
+                              [](const Listing& a, const Listing& b) { return a.pc_id == b.pc_id; }),
+                  listing.end());
+    return listing;
+}
+
+void PCRegistry::reindex(const std::string& pc_id) {
+    // The entry is re-read under the index lock, so concurrent changes to
+    // the same PC are applied in order and the index ends up matching it
+    std::lock_guard<std::mutex> index_lock(m_index_mutex);
+    bool online = false;
+    std::string owner;
+    {
+        const Shard& shard = shardFor(pc_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.pcs.find(pc_id);
+        if (it != shard.pcs.end() && it->second.main_connection != -1) {
+            online = true;
+            owner = it->second.username;
+        }
+    }
+    
+    auto listed = m_listed.find(pc_id);
+    if (listed != m_listed.end()) {
+        if (online && listed->second == owner) {
+            return;
+        }
+        Listing gone{ pc_id, listed->second };
+        auto owned = m_owned.find(gone.username);
+        owned->second.erase(pc_id);
+        if (owned->second.empty()) {
+            m_owned.erase(owned);
+        }
+        m_listed.erase(listed);
+        notify(gone, false);
+    }
+    if (online) {
+        m_listed.emplace(pc_id, owner);
+        m_owned[owner].insert(pc_id);
+        notify(Listing{ pc_id, owner }, true);
+    }
+    
+    // Full listing for old clients; m_listed is already in id order
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->reserve(m_listed.size());
+    for (const auto& pc : m_listed) {
+        snapshot->push_back(Listing{ pc.first, pc.second });
+    }
+    std::atomic_store(&m_snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
+
+void PCRegistry::notify(const Listing& pc, bool online) {
+    // A watcher can match both as owner and through a binding; it is told once
+    std::vector<WatchId> ids;
+    auto by_user = m_watching_user.equal_range(pc.username);
+    for (auto it = by_user.first; it != by_user.second; ++it) {
+        ids.push_back(it->second);
+    }
+    auto by_pc = m_watching_pc.equal_range(pc.pc_id);
+    for (auto it = by_pc.first; it != by_pc.second; ++it) {
+        ids.push_back(it->second);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    
+    for (WatchId id : ids) {
+        m_watchers[id].callback(pc, online);
+    }
+}
+
+std::vector<PCInfo> PCRegistry::drain() {
+    std::vector<PCInfo> drained;
+    for (Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& pc : shard.pcs) {
+            drained.push_back(std::move(pc.second));
+        }
+        shard.pcs.clear();
+    }
+    for (const PCInfo& pc : drained) {
+        reindex(pc.pc_id);
+    }
+    return drained;
+}
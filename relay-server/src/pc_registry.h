@@ -0,0 +1,152 @@
+#ifndef PC_REGISTRY_H
+#define PC_REGISTRY_H
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A PC's FileHandler connection. Requests to it come from many threads,
+// so every write holds `mutex`; the channel's reader thread owns the fd
+// and closes it under the same lock, so a thread holding a reference
+// never writes to a closed or reused descriptor.
+//
+// While the reader thread streams an upload's bytes into the fd it sets
+// `uploading`, and other writers wait on `writable` until it is done, so
+// no frame lands in the middle of the file data.
+struct FileChannel {
+    FileChannel(int fd, bool binary, bool traced)
+        : fd(fd), binary(binary), traced(traced), closed(false), uploading(false) {}
+
+    const int fd;
+    const bool binary;      // FileHandler speaks Wire frames, not text lines
+    const bool traced;      // ... and reads traced ones
+    std::mutex mutex;       // held for each write, and to close
+    std::condition_variable writable;
+    bool closed;
+    bool uploading;
+};
+
+struct PCInfo {
+    std::string pc_id;
+    std::string usb_id;
+    std::string username;
+    int main_connection;
+    std::shared_ptr<FileChannel> file_channel;  // null until a FileHandler registers
+    time_t last_heartbeat;
+    uint64_t deadline;      // relay's liveness timer for this PC, 0 if none
+};
+
+// Connected PCs, keyed by pc_id.
+//
+// Entries are spread over SHARD_COUNT hash shards, each with its own lock,
+// so registrations, heartbeats and lookups for different PCs do not wait
+// on each other. A shard lock is only held to copy or update one entry;
+// nothing else is called under it, so callers never nest it with their
+// own locks.
+//
+// Presence (which PCs are online, and whose) is kept in a separate index
+// that changes only when a PC comes online, goes away or changes owner,
+// never on heartbeats. It is keyed by owning user, so a mobile's listing
+// costs O(its user's PCs) instead of a walk over every PC, and it feeds
+// watchers that want those changes pushed as they happen. Old clients
+// that ask for everything read a full snapshot swapped in atomically.
+class PCRegistry {
+public:
+    struct Listing {
+        std::string pc_id;
+        std::string username;
+    };
+    typedef std::vector<Listing> Snapshot;
+
+    typedef uint64_t WatchId;
+    typedef std::function<void(const Listing& pc, bool online)> PresenceCallback;
+
+    PCRegistry();
+
+    // REGISTER: main connection and identity; an existing FileHandler
+    // channel for the same PC is kept. Returns the main connection it
+    // replaces (for the caller to close) or -1
+    int registerPC(const std::string& pc_id, const std::string& usb_id,
+                   const std::string& username, int main_fd);
+
+    // Installs the FileHandler channel; returns the one it replaces (for
+    // the caller to close) or null
+    std::shared_ptr<FileChannel> setFileConnection(const std::string& pc_id,
+                                                   std::shared_ptr<FileChannel> channel);
+
+    // Drops the FileHandler channel if it is still `channel`
+    void clearFileConnection(const std::string& pc_id, const FileChannel* channel);
+
+    void touch(const std::string& pc_id);
+
+    // Records the liveness timer armed for the PC
+    void setDeadline(const std::string& pc_id, uint64_t timer);
+
+    // Removes the PC if `timer` is still its liveness timer (it was not
+    // re-armed or replaced meanwhile) and hands back what it held
+    bool removeIfDeadline(const std::string& pc_id, uint64_t timer, PCInfo& removed);
+
+    // Copies the entry out; false if the PC is unknown
+    bool find(const std::string& pc_id, PCInfo& info) const;
+
+    // Every online PC sorted by id; safe to keep and read without locks
+    std::shared_ptr<const Snapshot> online() const;
+
+    // Online PCs owned by `username` plus those of `bound` (PCs the mobile
+    // was paired with) that are online, sorted by id
+    Snapshot onlineFor(const std::string& username, const std::vector<std::string>& bound) const;
+
+    // Calls `callback` whenever a PC of `username` or `bound` comes online
+    // or goes away, starting from `current` (taken atomically with the
+    // registration, so nothing is missed or repeated). Callbacks run with
+    // the index locked and must only queue work, never block.
+    WatchId watch(const std::string& username, const std::vector<std::string>& bound,
+                  PresenceCallback callback, Snapshot& current);
+    void unwatch(WatchId id);
+
+    // Empties the registry for shutdown and returns what it held
+    std::vector<PCInfo> drain();
+
+private:
+    static const size_t SHARD_COUNT = 16;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, PCInfo> pcs;
+    };
+
+    struct Watcher {
+        std::string username;
+        std::vector<std::string> bound;
+        PresenceCallback callback;
+    };
+
+    Shard& shardFor(const std::string& pc_id);
+    const Shard& shardFor(const std::string& pc_id) const;
+    void reindex(const std::string& pc_id);
+    void notify(const Listing& pc, bool online);
+    Snapshot listingFor(const std::string& username, const std::vector<std::string>& bound) const;
+
+    std::array<Shard, SHARD_COUNT> m_shards;
+
+    // Presence index; m_index_mutex is taken before shard locks
+    mutable std::mutex m_index_mutex;
+    std::map<std::string, std::string> m_listed;                    // online pc_id -> owner
+    std::unordered_map<std::string, std::set<std::string>> m_owned; // owner -> online pc_ids
+    std::unordered_map<WatchId, Watcher> m_watchers;
+    std::unordered_multimap<std::string, WatchId> m_watching_user;
+    std::unordered_multimap<std::string, WatchId> m_watching_pc;
+    WatchId m_next_watch;
+    std::shared_ptr<const Snapshot> m_snapshot;                     // all of m_listed
+};
+
+#endif // PC_REGISTRY_H
@@ -1,12 +1,13 @@
 #include "relay_manager.h"
-#include <iostream>
+#include "async_log.h"
 #include <chrono>
 
 namespace RemoteAccessSystem {
 namespace RelayServer {
 
 RelayManager::RelayManager() {
-    std::cout << "[RelayManager] Initialized" << std::endl;
+    timers_.start();
+    LOG_INFO("RelayManager", "Initialized");
 }
 
 bool RelayManager::registerPC(const std::string& pc_id, const std::string& pc_name,
@@ -22,8 +23,13 @@ bool RelayManager::registerPC(const std::string& pc_id, const std::string& pc_na
     pc.last_heartbeat = std::chrono::system_clock::now().time_since_epoch().count();
     pc.is_online = true;
     
+    auto existing = registered_pcs_.find(pc_id);
+    if (existing != registered_pcs_.end()) {
+        timers_.cancel(existing->second.deadline);
+    }
+    armDeadline(pc);
     registered_pcs_[pc_id] = pc;
-    std::cout << "[RelayManager] Registered PC: " << pc_name << " (" << pc_id << ")" << std::endl;
+    LOG_INFO("RelayManager", "Registered PC", {"pc_id", pc_id}, {"pc_name", pc_name});
     
     return true;
 }
@@ -36,8 +42,9 @@ bool RelayManager::unregisterPC(const std::string& pc_id) {
         return false;
     }
     
+    timers_.cancel(it->second.deadline);
     registered_pcs_.erase(it);
-    std::cout << "[RelayManager] Unregistered PC: " << pc_id << std::endl;
+    LOG_INFO("RelayManager", "Unregistered PC", {"pc_id", pc_id});
     return true;
 }
 
@@ -64,6 +71,9 @@ bool RelayManager::updateHeartbeat(const std::string& pc_id) {
     
     it->second.last_heartbeat = std::chrono::system_clock::now().time_since_epoch().count();
     it->second.is_online = true;
+    if (!timers_.reschedule(it->second.deadline, PC_TIMEOUT)) {
+        armDeadline(it->second);
+    }
     
     return true;
 }
@@ -79,21 +89,21 @@ PCClient RelayManager::getPCInfo(const std::string& pc_id) {
     return PCClient{};
 }
 
-void RelayManager::cleanupOfflinePC() {
-    // Cleanup PCs that haven't sent heartbeat for 5 minutes
-    long timeout = 300000000000; // 5 minutes in nanoseconds
-    long current_time = std::chrono::system_clock::now().time_since_epoch().count();
-    
+void RelayManager::armDeadline(PCClient& pc) {
+    std::string pc_id = pc.pc_id;
+    pc.deadline = timers_.schedule(PC_TIMEOUT, [this, pc_id](TimingWheel::TimerId timer) {
+        expirePC(pc_id, timer);
+    });
+}
+
+void RelayManager::expirePC(const std::string& pc_id, TimingWheel::TimerId timer) {
     std::lock_guard<std::mutex> lock(mutex_);
     
-    auto it = registered_pcs_.begin();
-    while (it != registered_pcs_.end()) {
-        if (current_time - it->second.last_heartbeat > timeout) {
-            std::cout << "[RelayManager] Removing offline PC: " << it->first << std::endl;
-            it = registered_pcs_.erase(it);
-        } else {
-            ++it;
-        }
+    // A heartbeat or re-registration may have replaced the timer meanwhile
+    auto it = registered_pcs_.find(pc_id);
+    if (it != registered_pcs_.end() && it->second.deadline == timer) {
+        LOG_INFO("RelayManager", "Removing offline PC", {"pc_id", pc_id});
+        registered_pcs_.erase(it);
     }
 }
 
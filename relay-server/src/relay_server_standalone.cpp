@@ -2,683 +2,1869 @@
 #include <thread>
 #include <mutex>
 #include <map>
+#include <set>
 #include <vector>
 #include <queue>
+#include <memory>
+#include <condition_variable>
+#include <random>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netinet/ip.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
 #include <csignal>
 #include <atomic>
 #include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <poll.h>
 #include <chrono>
+#include <string_view>
+#include "wire_frame.h"
+#include "tls_terminator.h"
+#include "pc_registry.h"
+#include "timing_wheel.h"
+#include "metrics.h"
+#include "share_cache.h"
+#include "async_log.h"
+#include "trace.h"
+
+namespace Wire = RemoteAccessSystem::Wire;
+namespace Trace = RemoteAccessSystem::Trace;
+using RemoteAccessSystem::RelayServer::TimingWheel;
 
 std::atomic<bool> running(true);
+TlsTerminator tls;
 
-struct PCInfo {
+// A mobile's long-lived CONNECT session. Requests on it carry the
+// mobile's own ids and are answered on it as the PC replies, in any order;
+// if the connection drops, the mobile can resume the session (and get the
+// answers that came in meanwhile) by presenting its token within
+// SESSION_GRACE.
+struct MobileSession {
+    std::string token;
     std::string pc_id;
-    std::string usb_id;
-    std::string username;
-    int main_connection;
-    int file_connection;
-    time_t last_heartbeat;
+    std::mutex mutex;               // guards the rest and writes to fd
+    int fd;                         // -1 while detached
+    bool binary;
+    bool closed;                    // ended or expired; answers are dropped
+    std::set<uint32_t> inflight;    // mobile request ids not yet answered
+    std::string backlog;            // answers that arrived while detached
+    uint64_t expiry;                // grace timer while detached
+};
+
+// A share link the HTTP front end asked a PC for. The FileHandler
+// channel's thread streams the answer to the HTTP client and into the
+// cache fill, then wakes the HTTP thread, which commits or drops the fill.
+struct ShareFetch {
+    int client_fd;
+    ShareCache::Fill fill;
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    int status = 0;         // HTTP error to answer with; 0 once the file went out
+    std::string file_name;
+    int64_t expiry = 0;     // the link's, from the PC
+    uint64_t size = 0;
+    uint64_t received = 0;
 };
 
 struct PendingRequest {
-    int mobile_client;
+    int mobile_client;      // one-shot connection, closed once answered; -1 on a session or share
+    std::shared_ptr<MobileSession> session;
+    uint32_t mobile_request;    // the mobile's id for it, echoed in the answer
     std::string request_type;
     std::string pc_id;
     std::string file_path;
     size_t file_size;
     size_t bytes_transferred;
     time_t timestamp;
+    bool binary;            // reply format the mobile used
+    TimingWheel::TimerId timeout;
+    std::chrono::steady_clock::time_point started;
+    Trace::Span span;       // relay's part of a traced request, receipt to answer
+    Trace::Span pc_wait;    // forwarded to the PC until its answer came in
+    std::shared_ptr<ShareFetch> share;  // set for a share link fetch
+};
+
+// Low-latency input channel: fixed 12-byte frames from the mobile to the
+// PC's input socket, acks the other way
+const size_t INPUT_FRAME_SIZE = 12;
+
+// One PC's input channel. Each direction has its own lock, held while
+// sending, so a slow socket holds up only its own route and direction;
+// input_mutex guards just the map and is never held across a send.
+struct InputRoute {
+    std::mutex to_pc;           // guards pc_connection and writes to it
+    int pc_connection;          // -1 once the PC side is closed
+    std::mutex to_mobile;       // guards the rest and writes to mobile_connection
+    int mobile_connection;
+    bool pc_gone;               // the PC's reader has finished; no new mobiles
 };
 
-std::map<std::string, PCInfo> connected_pcs;
-std::map<int, PendingRequest> pending_requests;  // mobile_socket -> request info
-std::mutex pc_mutex;
+PCRegistry connected_pcs;
+std::map<uint32_t, PendingRequest> pending_requests;  // relay request id -> request info
+std::map<std::string, std::shared_ptr<MobileSession>> mobile_sessions;  // token -> session
+uint32_t next_request_id = 1;                    // under request_mutex
+std::map<std::string, std::shared_ptr<InputRoute>> input_routes;  // pc_id -> input sockets
+std::map<std::string, int> parked_controls;      // pc_id -> idle PC control socket
 std::mutex request_mutex;
+std::mutex input_mutex;
+std::mutex control_mutex;
+std::mutex session_mutex;
 
-std::vector<std::string> split(const std::string& str, char delimiter) {
-    std::vector<std::string> parts;
-    size_t start = 0;
-    size_t end = str.find(delimiter);
-    
-    while (end != std::string::npos) {
-        parts.push_back(str.substr(start, end - start));
-        start = end + 1;
-        end = str.find(delimiter, start);
+// PCs re-register and their FileHandlers heartbeat every 30 s; a PC is
+// dropped after missing three rounds of both
+const std::chrono::seconds PC_TIMEOUT(90);
+const std::chrono::seconds REQUEST_TIMEOUT(300);
+const std::chrono::seconds SESSION_GRACE(60);
+const int SESSION_SEND_WAIT_MS = 100;   // longest a session answer may wait on a full socket
+
+TimingWheel timers;     // PC deadlines and request timeouts
+
+// Share links (/share/<pc_id>/<token>) are served over HTTP on
+// RELAY_SHARE_PORT (default 9811) from a disk cache, fetched from the PC
+// with SHARE_DOWNLOAD on a miss
+ShareCache share_cache;
+int share_listener = -1;
+uint16_t share_port_number = 0;
+std::thread share_thread;
+
+// Served at /metrics on RELAY_METRICS_PORT (default 9810). Sizes that the
+// relay already tracks are read at scrape time, see registerMetrics().
+MetricsRegistry metrics;
+Counter& accepted_connections = metrics.counter("relay_accepted_connections_total",
+                                                "Connections accepted on the relay port");
+Counter& bytes_to_mobile = metrics.counter("relay_bytes_total", "Bytes relayed between PCs and mobiles",
+                                           "direction=\"pc_to_mobile\"");
+Counter& bytes_to_pc = metrics.counter("relay_bytes_total", "Bytes relayed between PCs and mobiles",
+                                       "direction=\"mobile_to_pc\"");
+Counter& request_timeouts = metrics.counter("relay_request_timeouts_total",
+                                            "File requests the PC did not answer within REQUEST_TIMEOUT");
+Histogram& download_throughput = metrics.histogram("relay_transfer_throughput_bytes_per_second",
+                                                   "Throughput of each file transfer", "direction=\"download\"");
+Histogram& upload_throughput = metrics.histogram("relay_transfer_throughput_bytes_per_second",
+                                                 "Throughput of each file transfer", "direction=\"upload\"");
+Counter& share_hits = metrics.counter("relay_share_requests_total", "Share link downloads",
+                                      "source=\"cache\"");
+Counter& share_misses = metrics.counter("relay_share_requests_total", "Share link downloads",
+                                        "source=\"pc\"");
+
+// From a file request reaching the relay to its answer (for DOWNLOAD, the
+// last byte of data) going back to the mobile
+Histogram* requestLatency(const std::string& command) {
+    static const char* const kHelp = "Time from a mobile's file request to the relay's answer";
+    static Histogram& list_dir = metrics.histogram("relay_request_duration_seconds", kHelp,
+                                                   "command=\"LIST_DIR\"", 1e-6);
+    static Histogram& generate_url = metrics.histogram("relay_request_duration_seconds", kHelp,
+                                                       "command=\"GENERATE_URL\"", 1e-6);
+    static Histogram& download = metrics.histogram("relay_request_duration_seconds", kHelp,
+                                                   "command=\"DOWNLOAD\"", 1e-6);
+    static Histogram& upload = metrics.histogram("relay_request_duration_seconds", kHelp,
+                                                 "command=\"UPLOAD\"", 1e-6);
+    static Histogram& share = metrics.histogram("relay_request_duration_seconds", kHelp,
+                                                "command=\"SHARE_DOWNLOAD\"", 1e-6);
+    if (command == "LIST_DIR") return &list_dir;
+    if (command == "GENERATE_URL") return &generate_url;
+    if (command == "DOWNLOAD") return &download;
+    if (command == "UPLOAD") return &upload;
+    if (command == "SHARE_DOWNLOAD") return &share;
+    return nullptr;
+}
+
+void observeRequest(const PendingRequest& request) {
+    if (Histogram* latency = requestLatency(request.request_type)) {
+        auto elapsed = std::chrono::steady_clock::now() - request.started;
+        latency->record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+}
+
+// Bytes per second of a transfer of `bytes` that began at `started`
+void observeTransfer(Histogram& throughput, size_t bytes, std::chrono::steady_clock::time_point started) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (bytes > 0 && seconds > 0) {
+        throughput.record(static_cast<uint64_t>(bytes / seconds));
+    }
+}
+
+// Its reader thread owns the fd; this makes it exit and close it
+void shutdownFileChannel(FileChannel& channel) {
+    std::lock_guard<std::mutex> lock(channel.mutex);
+    if (!channel.closed) {
+        shutdown(channel.fd, SHUT_RDWR);
+    }
+}
+
+void expirePC(const std::string& pc_id, TimingWheel::TimerId timer) {
+    PCInfo pc;
+    if (!connected_pcs.removeIfDeadline(pc_id, timer, pc)) {
+        return;
+    }
+    LOG_INFO("RelayServer", "PC timed out", {"pc_id", pc_id});
+    if (pc.main_connection != -1) {
+        close(pc.main_connection);
+    }
+    if (pc.file_channel) {
+        shutdownFileChannel(*pc.file_channel);
+    }
+}
+
+// Pushes the PC's liveness deadline out to PC_TIMEOUT from now
+void refreshDeadline(const std::string& pc_id) {
+    PCInfo pc;
+    if (!connected_pcs.find(pc_id, pc)) {
+        return;
+    }
+    if (pc.deadline != TimingWheel::INVALID_TIMER && timers.reschedule(pc.deadline, PC_TIMEOUT)) {
+        return;
+    }
+    TimingWheel::TimerId timer = timers.schedule(PC_TIMEOUT, [pc_id](TimingWheel::TimerId id) {
+        expirePC(pc_id, id);
+    });
+    connected_pcs.setDeadline(pc_id, timer);
+}
+
+// Interactive traffic (remote control, input): no Nagle delay, and marked
+// so the kernel queues it ahead of bulk file data on the same links
+void setLowDelay(int fd) {
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    int tos = IPTOS_LOWDELAY;
+    setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    int priority = 6;
+    setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &priority, sizeof(priority));
+}
+
+// File transfer data: lowest band, so it yields to setLowDelay() sockets
+void setBulk(int fd) {
+    int tos = IPTOS_THROUGHPUT;
+    setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    int priority = 0;
+    setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &priority, sizeof(priority));
+}
+
+bool sendAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// Writes to a PC's FileHandler, after any upload streaming into it; false
+// if the channel has closed
+bool sendToFileHandler(FileChannel& channel, const std::string& out) {
+    std::unique_lock<std::mutex> lock(channel.mutex);
+    channel.writable.wait(lock, [&channel] { return !channel.uploading; });
+    return !channel.closed && sendAll(channel.fd, out.data(), out.size());
+}
+
+bool sendToFileHandler(FileChannel& channel, Wire::Type type, std::initializer_list<std::string_view> fields,
+                       uint32_t request_id) {
+    std::string out;
+    Wire::appendMessage(out, channel.binary, type, fields, request_id);
+    return sendToFileHandler(channel, out);
+}
+
+// Like sendAll, but gives up once the socket has stayed full for
+// `timeout_ms`, so a peer that stops reading cannot hold the caller
+bool sendWithin(int fd, const char* data, size_t length, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent > 0) {
+            data += sent;
+            length -= sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) return false;
+        
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        struct pollfd writable = { fd, POLLOUT, 0 };
+        if (left.count() <= 0 || poll(&writable, 1, static_cast<int>(left.count())) <= 0) return false;
+    }
+    return true;
+}
+
+// Replies in the format the peer used, so text clients keep working
+bool sendMessage(int fd, bool binary, Wire::Type type,
+                 std::initializer_list<std::string_view> fields, uint32_t request_id = 0) {
+    std::string out;
+    Wire::appendMessage(out, binary, type, fields, request_id);
+    return sendAll(fd, out.data(), out.size());
+}
+
+// Passes a frame on under the request id that means something to `fd`,
+// traced with `trace` if given
+bool forwardMessage(int fd, bool binary, const Wire::FrameView& frame, uint32_t request_id = 0,
+                    const Wire::TraceContext* trace = nullptr) {
+    std::string out;
+    Wire::appendMessage(out, binary, frame, request_id, trace);
+    return sendAll(fd, out.data(), out.size());
+}
+
+// Grace period for a detached session ran out: it ends for good
+void expireSession(const std::string& token, TimingWheel::TimerId timer) {
+    std::shared_ptr<MobileSession> session;
+    {
+        std::lock_guard<std::mutex> lock(session_mutex);
+        auto it = mobile_sessions.find(token);
+        if (it == mobile_sessions.end()) {
+            return;
+        }
+        session = it->second;
     }
     
-    parts.push_back(str.substr(start));
-    return parts;
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (session->fd != -1 || session->expiry != timer) {
+        return;
+    }
+    session->closed = true;
+    session->backlog.clear();
+    {
+        std::lock_guard<std::mutex> sessions_lock(session_mutex);
+        mobile_sessions.erase(token);
+    }
+    LOG_INFO("RelayServer", "Mobile session expired", {"pc_id", session->pc_id});
 }
 
-void handleDownloadDataTransfer(int pc_fd, int mobile_fd, size_t file_size) {
-    std::cout << "[RelayServer] Starting download data transfer: " << file_size << " bytes" << std::endl;
+// The session's connection is gone; it waits SESSION_GRACE for the
+// mobile to resume. session.mutex must be held.
+void startSessionGrace(MobileSession& session) {
+    session.fd = -1;
+    std::string token = session.token;
+    session.expiry = timers.schedule(SESSION_GRACE, [token](TimingWheel::TimerId timer) {
+        expireSession(token, timer);
+    });
+}
+
+// Answers request `mobile_request` of a session. While the mobile is away
+// the answer waits in the backlog for it to resume.
+//
+// This runs on the PC's FileHandler thread, so it never blocks on the
+// mobile: a connection that does not take the answer within
+// SESSION_SEND_WAIT_MS is shut down and detached, as if it had dropped.
+// The whole answer goes to the backlog, since part of it may have reached
+// the dead connection, and the mobile gets it when it resumes.
+void answerSession(MobileSession& session, uint32_t mobile_request, const Wire::FrameView& frame,
+                   const Wire::TraceContext* trace = nullptr) {
+    std::lock_guard<std::mutex> lock(session.mutex);
+    session.inflight.erase(mobile_request);
+    if (session.closed) {
+        return;
+    }
+    std::string out;
+    Wire::appendMessage(out, session.binary, frame, mobile_request, trace);
+    if (session.fd == -1) {
+        session.backlog += out;
+    } else if (!sendWithin(session.fd, out.data(), out.size(), SESSION_SEND_WAIT_MS)) {
+        LOG_WARN("RelayServer", "Mobile not reading, dropping its connection", {"pc_id", session.pc_id});
+        shutdown(session.fd, SHUT_RDWR);
+        startSessionGrace(session);
+        session.backlog += out;
+    }
+}
+
+void failSessionRequest(MobileSession& session, uint32_t mobile_request, const std::string& error) {
+    std::string frame;
+    Wire::appendMessage(frame, true, Wire::Type::ERROR, {error});
+    answerSession(session, mobile_request, Wire::FrameView(frame.data()));
+}
+
+// Delivers the PC's answer; a one-shot connection is closed after it. A
+// traced request is answered under the relay's span.
+void answerRequest(PendingRequest& request, const Wire::FrameView& frame) {
+    request.pc_wait.finish();
+    observeRequest(request);
+    bytes_to_mobile.add(frame.size());
+    const Wire::TraceContext* trace = request.span.active() ? &request.span.context() : nullptr;
+    if (request.session) {
+        answerSession(*request.session, request.mobile_request, frame, trace);
+    } else {
+        forwardMessage(request.mobile_client, request.binary, frame, request.mobile_request, trace);
+        close(request.mobile_client);
+    }
+    request.span.finish();
+}
+
+// Wakes the HTTP thread waiting on a share fetch
+void finishShareFetch(ShareFetch& fetch, int status, uint64_t received = 0) {
+    std::lock_guard<std::mutex> lock(fetch.mutex);
+    fetch.status = status;
+    fetch.received = received;
+    fetch.done = true;
+    fetch.done_cv.notify_all();
+}
+
+// Timeout for relay request `request_id`; ignored if the request has
+// finished or been re-armed since
+void expireRequest(uint32_t request_id, TimingWheel::TimerId timer) {
+    PendingRequest request;
+    {
+        std::lock_guard<std::mutex> lock(request_mutex);
+        auto it = pending_requests.find(request_id);
+        if (it == pending_requests.end() || it->second.timeout != timer) {
+            return;
+        }
+        request = std::move(it->second);
+        pending_requests.erase(it);
+    }
     
+    request_timeouts.add();
+    request.pc_wait.finish();
+    request.span.finish();
+    LOG_WARN("RelayServer", "Request timed out", {"type", request.request_type}, {"request_id", request_id});
+    if (request.share) {
+        finishShareFetch(*request.share, 504);
+    } else if (request.session) {
+        // The session itself is fine; only this request failed
+        failSessionRequest(*request.session, request.mobile_request, "Request timed out");
+    } else {
+        close(request.mobile_client);
+    }
+}
+
+// Stores a request, arms its timeout and returns the relay's id for it,
+// which goes to the FileHandler; request_mutex must be held
+uint32_t addPendingRequest(PendingRequest req) {
+    uint32_t request_id = next_request_id++;
+    if (request_id == 0) {
+        request_id = next_request_id++;
+    }
+    req.timeout = timers.schedule(REQUEST_TIMEOUT, [request_id](TimingWheel::TimerId timer) {
+        expireRequest(request_id, timer);
+    });
+    req.started = std::chrono::steady_clock::now();
+    pending_requests[request_id] = std::move(req);
+    return request_id;
+}
+
+// Drops a request and its timeout; request_mutex must be held
+std::map<uint32_t, PendingRequest>::iterator finishRequest(std::map<uint32_t, PendingRequest>::iterator it) {
+    timers.cancel(it->second.timeout);
+    return pending_requests.erase(it);
+}
+
+// The request a FileHandler reply answers: the one with the relay id the
+// reply echoes, or from PCs that echo none, the oldest of `request_type`
+// (any type if empty) that is not mid-transfer. request_mutex must be held.
+std::map<uint32_t, PendingRequest>::iterator findRequest(const std::string& pc_id, const std::string& request_type,
+                                                         uint32_t request_id) {
+    if (request_id != 0) {
+        auto it = pending_requests.find(request_id);
+        if (it != pending_requests.end() && it->second.pc_id != pc_id) {
+            return pending_requests.end();
+        }
+        return it;
+    }
+    for (auto it = pending_requests.begin(); it != pending_requests.end(); ++it) {
+        if (it->second.pc_id == pc_id && it->second.timeout != TimingWheel::INVALID_TIMER &&
+            (request_type.empty() || it->second.request_type == request_type)) {
+            return it;
+        }
+    }
+    return pending_requests.end();
+}
+
+// Removes the request a reply answers, for the caller to answer without
+// request_mutex held
+bool takeRequest(const std::string& pc_id, const std::string& request_type, uint32_t request_id,
+                 PendingRequest& request) {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    auto it = findRequest(pc_id, request_type, request_id);
+    if (it == pending_requests.end()) {
+        return false;
+    }
+    timers.cancel(it->second.timeout);
+    request = std::move(it->second);
+    pending_requests.erase(it);
+    return true;
+}
+
+// Moves exactly `length` bytes from one socket to the other. splice()
+// through a pipe keeps the data in the kernel, which also holds for kTLS
+// sockets where the kernel does the record crypto; descriptors that cannot
+// splice fall back to a copy loop. Returns the bytes moved.
+size_t relayBytes(int from_fd, int to_fd, size_t length, const char* label) {
+    const size_t CHUNK = 65536;
     char buffer[8192];
-    size_t total_transferred = 0;
+    int pipe_fds[2];
+    bool use_splice = pipe(pipe_fds) == 0;
+    bool have_pipe = use_splice;
+    size_t moved = 0;
+    int last_step = 0;
     
-    while (total_transferred < file_size && running) {
-        size_t remaining = file_size - total_transferred;
-        size_t to_read = std::min(remaining, sizeof(buffer));
-        
-        ssize_t bytes_read = recv(pc_fd, buffer, to_read, 0);
+    while (moved < length && running) {
+        size_t want = std::min(length - moved, CHUNK);
+        ssize_t got;
+        bool write_failed = false;
         
-        if (bytes_read <= 0) {
-            if (bytes_read == 0) {
-                std::cout << "[RelayServer] PC connection closed during download" << std::endl;
-            } else {
-                std::cout << "[RelayServer] Error reading from PC: " << strerror(errno) << std::endl;
+        if (use_splice) {
+            got = splice(from_fd, nullptr, pipe_fds[1], nullptr, want, SPLICE_F_MOVE);
+            if (got < 0 && errno == EINVAL && moved == 0) {
+                use_splice = false;
+                continue;
             }
-            break;
+            size_t in_pipe = got > 0 ? got : 0;
+            while (in_pipe > 0) {
+                unsigned int flags = SPLICE_F_MOVE | (moved + got < length ? SPLICE_F_MORE : 0);
+                ssize_t out = splice(pipe_fds[0], nullptr, to_fd, nullptr, in_pipe, flags);
+                if (out < 0 && errno == EINVAL) {
+                    // Destination cannot splice: drain the pipe by copying
+                    use_splice = false;
+                    while (in_pipe > 0) {
+                        ssize_t n = read(pipe_fds[0], buffer, std::min(in_pipe, sizeof(buffer)));
+                        if (n <= 0 || !sendAll(to_fd, buffer, n)) break;
+                        in_pipe -= n;
+                    }
+                    break;
+                }
+                if (out <= 0) break;
+                in_pipe -= out;
+            }
+            write_failed = in_pipe > 0;
+        } else {
+            got = recv(from_fd, buffer, std::min(want, sizeof(buffer)), 0);
+            write_failed = got > 0 && !sendAll(to_fd, buffer, got);
         }
         
-        ssize_t bytes_sent = send(mobile_fd, buffer, bytes_read, 0);
-        
-        if (bytes_sent <= 0) {
-            if (bytes_sent == 0) {
-                std::cout << "[RelayServer] Mobile connection closed during download" << std::endl;
+        if (got <= 0) {
+            if (got == 0) {
+                LOG_INFO("RelayServer", "Source closed during transfer", {"transfer", label});
             } else {
-                std::cout << "[RelayServer] Error sending to mobile: " << strerror(errno) << std::endl;
+                LOG_WARN("RelayServer", "Error reading during transfer", {"transfer", label},
+                         {"error", strerror(errno)});
             }
             break;
         }
+        if (write_failed) {
+            LOG_INFO("RelayServer", "Destination closed during transfer", {"transfer", label});
+            break;
+        }
         
-        total_transferred += bytes_sent;
+        moved += got;
         
-        if (total_transferred % 102400 == 0 || total_transferred == file_size) {
-            int progress = (total_transferred * 100) / file_size;
-            std::cout << "[RelayServer] Download progress: " << progress << "% (" 
-                      << total_transferred << "/" << file_size << " bytes)" << std::endl;
+        int step = static_cast<int>(moved * 10 / length);
+        if (step != last_step) {
+            last_step = step;
+            LOG_DEBUG("RelayServer", "Transfer progress", {"transfer", label}, {"percent", step * 10}, {"bytes", moved},
+                      {"total", length});
         }
     }
     
-    std::cout << "[RelayServer] Download data transfer complete: " << total_transferred << " bytes" << std::endl;
+    if (have_pipe) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+    return moved;
 }
 
-void handleUploadDataTransfer(int mobile_fd, int pc_fd, size_t file_size) {
-    std::cout << "[RelayServer] Starting upload data transfer: " << file_size << " bytes" << std::endl;
+void handleDownloadDataTransfer(int pc_fd, int mobile_fd, size_t file_size) {
+    LOG_INFO("RelayServer", "Starting download data transfer", {"bytes", file_size});
+    setBulk(pc_fd);
+    setBulk(mobile_fd);
     
-    char buffer[8192];
-    size_t total_transferred = 0;
+    auto started = std::chrono::steady_clock::now();
+    size_t total_transferred = relayBytes(pc_fd, mobile_fd, file_size, "Download");
+    bytes_to_mobile.add(total_transferred);
+    observeTransfer(download_throughput, total_transferred, started);
     
-    while (total_transferred < file_size && running) {
-        size_t remaining = file_size - total_transferred;
-        size_t to_read = std::min(remaining, sizeof(buffer));
-        
-        ssize_t bytes_read = recv(mobile_fd, buffer, to_read, 0);
-        
-        if (bytes_read <= 0) {
-            if (bytes_read == 0) {
-                std::cout << "[RelayServer] Mobile connection closed during upload" << std::endl;
-            } else {
-                std::cout << "[RelayServer] Error reading from mobile: " << strerror(errno) << std::endl;
-            }
-            break;
+    LOG_INFO("RelayServer", "Download data transfer complete", {"bytes", total_transferred});
+}
+
+// Runs on the channel's reader thread, which alone closes the fd, so the
+// splice itself needs no lock; `uploading` keeps other writers out of the
+// file data until it is done. shutdownFileChannel() still gets through and
+// ends the transfer.
+void handleUploadDataTransfer(int mobile_fd, FileChannel& channel, size_t file_size) {
+    {
+        std::lock_guard<std::mutex> lock(channel.mutex);
+        if (channel.closed) {
+            return;
         }
-        
-        ssize_t bytes_sent = send(pc_fd, buffer, bytes_read, 0);
-        
-        if (bytes_sent <= 0) {
-            if (bytes_sent == 0) {
-                std::cout << "[RelayServer] PC connection closed during upload" << std::endl;
-            } else {
-                std::cout << "[RelayServer] Error sending to PC: " << strerror(errno) << std::endl;
-            }
+        channel.uploading = true;
+    }
+    LOG_INFO("RelayServer", "Starting upload data transfer", {"bytes", file_size});
+    setBulk(mobile_fd);
+    setBulk(channel.fd);
+    
+    auto started = std::chrono::steady_clock::now();
+    size_t total_transferred = relayBytes(mobile_fd, channel.fd, file_size, "Upload");
+    {
+        std::lock_guard<std::mutex> lock(channel.mutex);
+        channel.uploading = false;
+    }
+    channel.writable.notify_all();
+    bytes_to_pc.add(total_transferred);
+    observeTransfer(upload_throughput, total_transferred, started);
+    
+    LOG_INFO("RelayServer", "Upload data transfer complete", {"bytes", total_transferred});
+}
+
+std::string shareHeaders(uint64_t size, const std::string& file_name) {
+    // The name comes from the PC; keep it from breaking out of the header
+    std::string safe_name = file_name;
+    for (char& c : safe_name) {
+        if (c == '"' || c == '\\' || c == '\r' || c == '\n') c = '_';
+    }
+    return "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+           "Content-Disposition: attachment; filename=\"" + safe_name + "\"\r\n"
+           "Content-Length: " + std::to_string(size) + "\r\nConnection: close\r\n\r\n";
+}
+
+// The PC's DOWNLOAD_START|file_name|expiry|size for a share fetch, and
+// the file data behind it: streamed to the HTTP client and teed into the
+// cache. The PC is drained to the end even if the client goes away, so
+// the channel stays in step and the cache still fills.
+void streamShare(PendingRequest& request, int pc_fd, Wire::Reader& reader, const Wire::FrameView& message) {
+    ShareFetch& fetch = *request.share;
+    size_t field_count = message.fieldCount();
+    fetch.size = message.fieldU64(field_count - 1);
+    if (field_count >= 3) {
+        fetch.file_name = message.fieldString(0);
+        fetch.expiry = static_cast<int64_t>(message.fieldU64(field_count - 2));
+    }
+    
+    auto started = std::chrono::steady_clock::now();
+    setBulk(pc_fd);
+    setBulk(fetch.client_fd);
+    std::string headers = shareHeaders(fetch.size, fetch.file_name.empty() ? "download" : fetch.file_name);
+    bool client_ok = sendAll(fetch.client_fd, headers.data(), headers.size());
+    
+    std::string_view early = reader.pending();
+    uint64_t received = std::min<uint64_t>(early.size(), fetch.size);
+    fetch.fill.append(early.data(), received);
+    client_ok = client_ok && sendAll(fetch.client_fd, early.data(), received);
+    reader.consume(received);
+    
+    char buffer[65536];
+    while (received < fetch.size && running) {
+        ssize_t bytes = recv(pc_fd, buffer, std::min<uint64_t>(sizeof(buffer), fetch.size - received), 0);
+        if (bytes <= 0) {
+            if (bytes < 0 && errno == EINTR) continue;
+            LOG_WARN("RelayServer", "PC stopped during share download", {"pc_id", request.pc_id},
+                     {"bytes", received}, {"total", fetch.size});
             break;
         }
-        
-        total_transferred += bytes_sent;
-        
-        if (total_transferred % 102400 == 0 || total_transferred == file_size) {
-            int progress = (total_transferred * 100) / file_size;
-            std::cout << "[RelayServer] Upload progress: " << progress << "% (" 
-                      << total_transferred << "/" << file_size << " bytes)" << std::endl;
-        }
+        fetch.fill.append(buffer, bytes);
+        client_ok = client_ok && sendAll(fetch.client_fd, buffer, bytes);
+        received += bytes;
     }
     
-    std::cout << "[RelayServer] Upload data transfer complete: " << total_transferred << " bytes" << std::endl;
+    observeTransfer(download_throughput, received, started);
+    observeRequest(request);
+    finishShareFetch(fetch, 0, received);
 }
 
-void handleFileConnection(int client_fd, const std::string& pc_id) {
-    std::cout << "[RelayServer] FileHandler connected for PC: " << pc_id << std::endl;
+void handleFileConnection(std::shared_ptr<FileChannel> channel, const std::string& pc_id, Wire::Reader reader) {
+    LOG_INFO("RelayServer", "FileHandler connected", {"pc_id", pc_id});
+    int client_fd = channel->fd;
     
-    // Send acknowledgment
-    std::string response = "OK|FILE_HANDLER_REGISTERED\n";
-    send(client_fd, response.c_str(), response.length(), 0);
+    // Send acknowledgment in the format the FileHandler registered with;
+    // binary ones also learn where the relay serves share links
+    if (channel->binary && share_listener != -1) {
+        std::string share_port = std::to_string(share_port_number);
+        sendToFileHandler(*channel, Wire::Type::OK, {"FILE_HANDLER_REGISTERED", share_port}, 0);
+    } else {
+        sendToFileHandler(*channel, Wire::Type::OK, {"FILE_HANDLER_REGISTERED"}, 0);
+    }
     
     // Keep connection open and handle file requests/responses
     char buffer[8192];
-    std::string accumulated_data;
     
     while (running) {
-        ssize_t bytes = recv(client_fd, buffer, sizeof(buffer) - 1, MSG_DONTWAIT);
-        
-        if (bytes > 0) {
-            buffer[bytes] = '\0';
-            accumulated_data += std::string(buffer);
+        // Frames that came in with the registration are handled first;
+        // then the thread waits in recv() for the PC, answering as soon as
+        // a reply is in
+        Wire::FrameView message;
+        Wire::Reader::Result result;
+        while ((result = reader.next(message)) == Wire::Reader::FRAME) {
+            LOG_DEBUG("FileHandler", "Received", {"pc_id", pc_id}, {"type", Wire::typeName(message.type())});
             
-            // Process complete messages (ending with \n)
-            size_t pos;
-            while ((pos = accumulated_data.find('\n')) != std::string::npos) {
-                std::string message = accumulated_data.substr(0, pos);
-                accumulated_data.erase(0, pos + 1);
-                
-                if (message.empty()) continue;
-                
-                std::cout << "[FileHandler-" << pc_id << "] Received: " << message << std::endl;
-                
-                // Handle responses from PC FileHandler
-                if (message.find("DIR_LIST|") == 0) {
-                    std::lock_guard<std::mutex> lock(request_mutex);
-                    for (auto it = pending_requests.begin(); it != pending_requests.end(); ++it) {
-                        if (it->second.pc_id == pc_id && it->second.request_type == "LIST_DIR") {
-                            std::cout << "[RelayServer] Forwarding DIR_LIST to mobile client fd=" << it->first << std::endl;
-                            std::string forward_msg = message + "\n";
-                            send(it->first, forward_msg.c_str(), forward_msg.length(), 0);
-                            close(it->first);
-                            pending_requests.erase(it);
-                            break;
-                        }
-                    }
+            // Handle responses from PC FileHandler
+            PendingRequest request;
+            if (message.type() == Wire::Type::DIR_LIST) {
+                if (takeRequest(pc_id, "LIST_DIR", message.requestId(), request)) {
+                    LOG_DEBUG("RelayServer", "Forwarding DIR_LIST to mobile",
+                              {"fd", request.session ? -1 : request.mobile_client});
+                    answerRequest(request, message);
                 }
-                else if (message.find("DOWNLOAD_START|") == 0) {
-                    // Format: DOWNLOAD_START|pc_id|file_path|file_size
-                    auto parts = split(message, '|');
-                    if (parts.size() >= 4) {
-                        size_t file_size = std::stoull(parts[3]);
+            }
+            else if (message.type() == Wire::Type::DOWNLOAD_START) {
+                // The size is the last field; older FileHandlers send only
+                // DOWNLOAD_START|file_size, newer ones may prefix the path
+                size_t field_count = message.fieldCount();
+                if (field_count >= 1) {
+                    size_t file_size = message.fieldU64(field_count - 1);
+                    
+                    // Taken out first so the transfer runs without
+                    // request_mutex held; a share fetch goes to its HTTP
+                    // client instead of a mobile
+                    bool taken = takeRequest(pc_id, "DOWNLOAD", message.requestId(), request);
+                    if (taken && request.share) {
+                        streamShare(request, client_fd, reader, message);
+                    } else if (taken) {
+                        int mobile_fd = request.mobile_client;
+                        LOG_INFO("RelayServer", "Starting download relay", {"bytes", file_size});
                         
-                        std::lock_guard<std::mutex> lock(request_mutex);
-                        for (auto it = pending_requests.begin(); it != pending_requests.end(); ++it) {
-                            if (it->second.pc_id == pc_id && it->second.request_type == "DOWNLOAD") {
-                                int mobile_fd = it->first;
-                                std::cout << "[RelayServer] Starting download relay for " << file_size << " bytes" << std::endl;
-                                
-                                // Send DOWNLOAD_START to mobile
-                                std::string start_msg = message + "\n";
-                                send(mobile_fd, start_msg.c_str(), start_msg.length(), 0);
-                                
-                                // Transfer file data from PC to mobile
-                                handleDownloadDataTransfer(client_fd, mobile_fd, file_size);
-                                
-                                close(mobile_fd);
-                                pending_requests.erase(it);
-                                break;
-                            }
-                        }
+                        // Send DOWNLOAD_START to mobile
+                        forwardMessage(mobile_fd, request.binary, message, request.mobile_request);
+                        
+                        // File data that arrived with the header goes first
+                        std::string_view early = reader.pending();
+                        size_t early_size = std::min(early.size(), file_size);
+                        sendAll(mobile_fd, early.data(), early_size);
+                        reader.consume(early_size);
+                        bytes_to_mobile.add(early_size);
+                        
+                        // Transfer the rest from PC to mobile
+                        handleDownloadDataTransfer(client_fd, mobile_fd, file_size - early_size);
+                        observeRequest(request);
+                        
+                        close(mobile_fd);
                     }
                 }
-                else if (message.find("SHARE_URL|") == 0) {
-                    std::lock_guard<std::mutex> lock(request_mutex);
-                    for (auto it = pending_requests.begin(); it != pending_requests.end(); ++it) {
-                        if (it->second.pc_id == pc_id && it->second.request_type == "GENERATE_URL") {
-                            std::cout << "[RelayServer] Forwarding SHARE_URL to mobile client fd=" << it->first << std::endl;
-                            std::string forward_msg = message + "\n";
-                            send(it->first, forward_msg.c_str(), forward_msg.length(), 0);
-                            close(it->first);
-                            pending_requests.erase(it);
-                            break;
-                        }
-                    }
+            }
+            else if (message.type() == Wire::Type::SHARE_URL) {
+                if (takeRequest(pc_id, "GENERATE_URL", message.requestId(), request)) {
+                    LOG_DEBUG("RelayServer", "Forwarding SHARE_URL to mobile",
+                              {"fd", request.session ? -1 : request.mobile_client});
+                    answerRequest(request, message);
                 }
-                else if (message.find("ERROR|") == 0) {
-                    std::cout << "[RelayServer] Error received from PC: " << message << std::endl;
-                    
-                    std::lock_guard<std::mutex> lock(request_mutex);
-                    for (auto it = pending_requests.begin(); it != pending_requests.end(); ++it) {
-                        if (it->second.pc_id == pc_id) {
-                            std::cout << "[RelayServer] Forwarding error to mobile client fd=" << it->first 
-                                      << " (request_type=" << it->second.request_type << ")" << std::endl;
-                            std::string forward_msg = message + "\n";
-                            send(it->first, forward_msg.c_str(), forward_msg.length(), 0);
-                            close(it->first);
-                            pending_requests.erase(it);
-                            break;
-                        }
+            }
+            else if (message.type() == Wire::Type::ERROR) {
+                LOG_WARN("RelayServer", "Error received from PC", {"error", message.field(0)});
+                
+                if (takeRequest(pc_id, "", message.requestId(), request)) {
+                    if (request.share) {
+                        // SHARE_DOWNLOAD errors carry the HTTP status to give
+                        int status = message.fieldCount() >= 2 ? static_cast<int>(message.fieldU64(1)) : 0;
+                        finishShareFetch(*request.share, status == 404 || status == 410 ? status : 502);
+                    } else {
+                        LOG_DEBUG("RelayServer", "Forwarding error to mobile",
+                                  {"request_type", request.request_type});
+                        answerRequest(request, message);
                     }
                 }
-                else if (message.find("UPLOAD_READY") == 0) {
-                    std::cout << "[RelayServer] PC ready for upload" << std::endl;
-                    
+            }
+            else if (message.type() == Wire::Type::UPLOAD_READY) {
+                LOG_INFO("RelayServer", "PC ready for upload");
+                
+                // The request stays pending for UPLOAD_COMPLETE, but its
+                // timeout is off while the data moves, outside the lock
+                uint32_t request_id = 0;
+                int mobile_fd = -1;
+                size_t file_size = 0;
+                bool mobile_binary = false;
+                uint32_t mobile_request = 0;
+                {
                     std::lock_guard<std::mutex> lock(request_mutex);
-                    for (auto it = pending_requests.begin(); it != pending_requests.end(); ++it) {
-                        if (it->second.pc_id == pc_id && it->second.request_type == "UPLOAD") {
-                            int mobile_fd = it->first;
-                            size_t file_size = it->second.file_size;
-                            
-                            std::cout << "[RelayServer] Found pending upload for mobile fd=" << mobile_fd 
-                                      << ", file_size=" << file_size << std::endl;
-                            
-                            // Send UPLOAD_READY to mobile
-                            std::string ready_msg = "UPLOAD_READY\n";
-                            ssize_t sent = send(mobile_fd, ready_msg.c_str(), ready_msg.length(), 0);
-                            
-                            if (sent <= 0) {
-                                std::cout << "[RelayServer] Failed to send UPLOAD_READY to mobile" << std::endl;
-                                close(mobile_fd);
-                                pending_requests.erase(it);
-                                break;
-                            }
-                            
-                            std::cout << "[RelayServer] Sent UPLOAD_READY to mobile, starting file data relay..." << std::endl;
-                            
-                            // Transfer file data from mobile to PC
-                            handleUploadDataTransfer(mobile_fd, client_fd, file_size);
-                            
-                            std::cout << "[RelayServer] File data relay complete, waiting for PC confirmation..." << std::endl;
-                            break;
-                        }
+                    auto it = findRequest(pc_id, "UPLOAD", message.requestId());
+                    if (it != pending_requests.end() && it->second.timeout != TimingWheel::INVALID_TIMER) {
+                        request_id = it->first;
+                        mobile_fd = it->second.mobile_client;
+                        file_size = it->second.file_size;
+                        mobile_binary = it->second.binary;
+                        mobile_request = it->second.mobile_request;
+                        timers.cancel(it->second.timeout);
+                        it->second.timeout = TimingWheel::INVALID_TIMER;
                     }
                 }
-                else if (message.find("UPLOAD_COMPLETE") == 0 || message.find("UPLOAD_SUCCESS") == 0) {
-                    std::cout << "[RelayServer] Upload completed, notifying mobile" << std::endl;
+                
+                if (mobile_fd != -1) {
+                    LOG_INFO("RelayServer", "Found pending upload", {"fd", mobile_fd}, {"file_size", file_size});
                     
-                    std::lock_guard<std::mutex> lock(request_mutex);
-                    for (auto it = pending_requests.begin(); it != pending_requests.end(); ++it) {
-                        if (it->second.pc_id == pc_id && it->second.request_type == "UPLOAD") {
-                            std::cout << "[RelayServer] Sending success notification to mobile fd=" << it->first << std::endl;
-                            std::string forward_msg = message + "\n";
-                            send(it->first, forward_msg.c_str(), forward_msg.length(), 0);
-                            close(it->first);
-                            pending_requests.erase(it);
-                            break;
+                    // Send UPLOAD_READY to mobile
+                    if (!sendMessage(mobile_fd, mobile_binary, Wire::Type::UPLOAD_READY, {}, mobile_request)) {
+                        LOG_WARN("RelayServer", "Failed to send UPLOAD_READY to mobile");
+                        std::lock_guard<std::mutex> lock(request_mutex);
+                        pending_requests.erase(request_id);
+                        close(mobile_fd);
+                    } else {
+                        LOG_INFO("RelayServer", "Sent UPLOAD_READY to mobile, starting file data relay");
+                        
+                        // Transfer file data from mobile to PC
+                        handleUploadDataTransfer(mobile_fd, *channel, file_size);
+                        
+                        LOG_INFO("RelayServer", "File data relay complete, waiting for PC confirmation");
+                        
+                        std::lock_guard<std::mutex> lock(request_mutex);
+                        auto it = pending_requests.find(request_id);
+                        if (it != pending_requests.end()) {
+                            it->second.timeout = timers.schedule(REQUEST_TIMEOUT, [request_id](TimingWheel::TimerId timer) {
+                                expireRequest(request_id, timer);
+                            });
                         }
                     }
                 }
-                else if (message.find("HEARTBEAT") == 0) {
-                    std::string pong = "PONG\n";
-                    send(client_fd, pong.c_str(), pong.length(), 0);
+            }
+            else if (message.type() == Wire::Type::UPLOAD_COMPLETE ||
+                     message.type() == Wire::Type::UPLOAD_SUCCESS) {
+                LOG_INFO("RelayServer", "Upload completed, notifying mobile");
+                
+                if (takeRequest(pc_id, "UPLOAD", message.requestId(), request)) {
+                    LOG_DEBUG("RelayServer", "Sending success notification to mobile",
+                              {"fd", request.mobile_client});
+                    answerRequest(request, message);
                 }
             }
+            else if (message.type() == Wire::Type::HEARTBEAT) {
+                connected_pcs.touch(pc_id);
+                refreshDeadline(pc_id);
+                sendToFileHandler(*channel, Wire::Type::PONG, {}, 0);
+            }
+        }
+        
+        if (result == Wire::Reader::BAD_FRAME) {
+            LOG_WARN("FileHandler", "Malformed frame from PC", {"pc_id", pc_id});
+            break;
         }
-        else if (bytes == 0) {
-            std::cout << "[FileHandler] Connection closed for PC: " << pc_id << std::endl;
+        
+        ssize_t bytes = recv(client_fd, buffer, sizeof(buffer), 0);
+        if (bytes == 0) {
+            LOG_INFO("FileHandler", "Connection closed", {"pc_id", pc_id});
             break;
         }
-        else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            std::cout << "[FileHandler] Error on connection for PC: " << pc_id << " - " << strerror(errno) << std::endl;
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            LOG_WARN("FileHandler", "Error on connection", {"pc_id", pc_id}, {"error", strerror(errno)});
             break;
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        reader.append(buffer, bytes);
     }
     
-    // Remove file connection from PC info
+    // Remove file connection from PC info, unless a newer one replaced it
+    connected_pcs.clearFileConnection(pc_id, channel.get());
     {
-        std::lock_guard<std::mutex> lock(pc_mutex);
-        auto it = connected_pcs.find(pc_id);
-        if (it != connected_pcs.end()) {
-            it->second.file_connection = -1;
-        }
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        channel->closed = true;
+        close(client_fd);
     }
-    
-    close(client_fd);
-    std::cout << "[FileHandler] Handler thread exiting for PC: " << pc_id << std::endl;
+    LOG_INFO("FileHandler", "Handler thread exiting", {"pc_id", pc_id});
 }
 
-void handleUploadRequest(int client_fd, const std::string& pc_id, const std::string& file_path, size_t file_size) {
-    std::cout << "[RelayServer] Handling upload in dedicated thread for fd=" << client_fd << std::endl;
+void handleUploadRequest(int client_fd, const std::string& pc_id, const std::string& file_path, size_t file_size,
+                         bool binary) {
+    LOG_INFO("RelayServer", "Handling upload in dedicated thread", {"fd", client_fd});
     
     // Find PC file handler
-    int pc_file_fd = -1;
-    {
-        std::lock_guard<std::mutex> lock(pc_mutex);
-        auto it = connected_pcs.find(pc_id);
-        if (it != connected_pcs.end() && it->second.file_connection != -1) {
-            pc_file_fd = it->second.file_connection;
-        }
-    }
-    
-    if (pc_file_fd == -1) {
-        std::cout << "[RelayServer] PC file handler not connected" << std::endl;
-        std::string error = "ERROR|PC file handler not connected\n";
-        send(client_fd, error.c_str(), error.length(), 0);
+    PCInfo pc;
+    if (!connected_pcs.find(pc_id, pc) || !pc.file_channel) {
+        LOG_WARN("RelayServer", "PC file handler not connected");
+        sendMessage(client_fd, binary, Wire::Type::ERROR, {"PC file handler not connected"});
         close(client_fd);
         return;
     }
     
     // Store pending upload request BEFORE forwarding to PC
+    uint32_t request_id;
     {
         std::lock_guard<std::mutex> req_lock(request_mutex);
         PendingRequest req;
         req.mobile_client = client_fd;
+        req.mobile_request = 0;
         req.request_type = "UPLOAD";
         req.pc_id = pc_id;
         req.file_path = file_path;
         req.file_size = file_size;
         req.bytes_transferred = 0;
         req.timestamp = time(nullptr);
-        pending_requests[client_fd] = req;
-        std::cout << "[RelayServer] Stored pending upload request for mobile fd=" << client_fd << std::endl;
+        req.binary = binary;
+        request_id = addPendingRequest(req);
+        LOG_DEBUG("RelayServer", "Stored pending upload request", {"fd", client_fd});
     }
     
     // Forward UPLOAD command to PC FileHandler
-    std::string forward_cmd = "UPLOAD|" + pc_id + "|" + file_path + "|" + std::to_string(file_size) + "\n";
-    ssize_t sent = send(pc_file_fd, forward_cmd.c_str(), forward_cmd.length(), 0);
-    
-    if (sent <= 0) {
-        std::cout << "[RelayServer] Failed to forward UPLOAD to PC" << std::endl;
-        std::string error = "ERROR|Failed to contact PC\n";
-        send(client_fd, error.c_str(), error.length(), 0);
+    std::string size_field = std::to_string(file_size);
+    if (!sendToFileHandler(*pc.file_channel, Wire::Type::UPLOAD, {pc_id, file_path, size_field}, request_id)) {
+        LOG_WARN("RelayServer", "Failed to forward UPLOAD to PC");
+        sendMessage(client_fd, binary, Wire::Type::ERROR, {"Failed to contact PC"});
         
         std::lock_guard<std::mutex> req_lock(request_mutex);
-        pending_requests.erase(client_fd);
+        auto it = pending_requests.find(request_id);
+        if (it != pending_requests.end()) {
+            finishRequest(it);
+        }
         close(client_fd);
         return;
     }
     
-    std::cout << "[RelayServer] Forwarded UPLOAD command to PC FileHandler, keeping mobile socket open" << std::endl;
+    LOG_INFO("RelayServer", "Forwarded UPLOAD command to PC FileHandler, keeping mobile socket open");
 }
 
-void handleDownloadRequest(int client_fd, const std::string& pc_id, const std::string& file_path) {
-    std::cout << "[RelayServer] Handling download request for fd=" << client_fd << std::endl;
+void handleDownloadRequest(int client_fd, const std::string& pc_id, const std::string& file_path, bool binary) {
+    LOG_INFO("RelayServer", "Handling download request", {"fd", client_fd});
     
     // Find PC file handler
-    int pc_file_fd = -1;
-    {
-        std::lock_guard<std::mutex> lock(pc_mutex);
-        auto it = connected_pcs.find(pc_id);
-        if (it != connected_pcs.end() && it->second.file_connection != -1) {
-            pc_file_fd = it->second.file_connection;
-        }
-    }
-    
-    if (pc_file_fd == -1) {
-        std::cout << "[RelayServer] PC file handler not connected" << std::endl;
-        std::string error = "ERROR|PC file handler not connected\n";
-        send(client_fd, error.c_str(), error.length(), 0);
+    PCInfo pc;
+    if (!connected_pcs.find(pc_id, pc) || !pc.file_channel) {
+        LOG_WARN("RelayServer", "PC file handler not connected");
+        sendMessage(client_fd, binary, Wire::Type::ERROR, {"PC file handler not connected"});
         close(client_fd);
         return;
     }
     
     // Store pending download request
+    uint32_t request_id;
     {
         std::lock_guard<std::mutex> req_lock(request_mutex);
         PendingRequest req;
         req.mobile_client = client_fd;
+        req.mobile_request = 0;
         req.request_type = "DOWNLOAD";
         req.pc_id = pc_id;
         req.file_path = file_path;
         req.file_size = 0;
         req.bytes_transferred = 0;
         req.timestamp = time(nullptr);
-        pending_requests[client_fd] = req;
-        std::cout << "[RelayServer] Stored pending download request for mobile fd=" << client_fd << std::endl;
+        req.binary = binary;
+        request_id = addPendingRequest(req);
+        LOG_DEBUG("RelayServer", "Stored pending download request", {"fd", client_fd});
     }
     
     // Forward DOWNLOAD command to PC FileHandler
-    std::string forward_cmd = "DOWNLOAD|" + pc_id + "|" + file_path + "\n";
-    ssize_t sent = send(pc_file_fd, forward_cmd.c_str(), forward_cmd.length(), 0);
-    
-    if (sent <= 0) {
-        std::cout << "[RelayServer] Failed to forward DOWNLOAD to PC" << std::endl;
-        std::string error = "ERROR|Failed to contact PC\n";
-        send(client_fd, error.c_str(), error.length(), 0);
+    if (!sendToFileHandler(*pc.file_channel, Wire::Type::DOWNLOAD, {pc_id, file_path}, request_id)) {
+        LOG_WARN("RelayServer", "Failed to forward DOWNLOAD to PC");
+        sendMessage(client_fd, binary, Wire::Type::ERROR, {"Failed to contact PC"});
         
         std::lock_guard<std::mutex> req_lock(request_mutex);
-        pending_requests.erase(client_fd);
+        auto it = pending_requests.find(request_id);
+        if (it != pending_requests.end()) {
+            finishRequest(it);
+        }
         close(client_fd);
         return;
     }
     
-    std::cout << "[RelayServer] Forwarded DOWNLOAD command to PC FileHandler, keeping mobile socket open" << std::endl;
+    LOG_INFO("RelayServer", "Forwarded DOWNLOAD command to PC FileHandler, keeping mobile socket open");
 }
 
-void handleClient(int client_fd) {
-    char buffer[1024];
-    ssize_t bytes = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-    if (bytes > 0) {
-        buffer[bytes] = '\0';
-        std::string message(buffer);
-        if (!message.empty() && message.back() == '\n') message.pop_back();
-        
-        std::cout << "[RelayServer] Received from fd=" << client_fd << ": " << message << std::endl;
+// Reads acks from the PC's input socket and passes them to whichever
+// mobile currently owns the channel. Lives as long as the PC connection.
+void handlePCInputConnection(std::shared_ptr<InputRoute> route, const std::string& pc_id) {
+    int pc_fd = route->pc_connection;
+    char buffer[INPUT_FRAME_SIZE * 64];
+    size_t buffered = 0;
+    
+    while (running) {
+        ssize_t bytes = recv(pc_fd, buffer + buffered, sizeof(buffer) - buffered, 0);
+        if (bytes <= 0) break;
+        buffered += bytes;
         
-        if (message.find("REGISTER|") == 0) {
-            auto parts = split(message, '|');
-            if (parts.size() >= 4) {
-                std::string pc_id = parts[1];
-                PCInfo info;
-                info.pc_id = pc_id;
-                info.usb_id = parts[2];
-                info.username = parts[3];
-                info.main_connection = client_fd;
-                info.file_connection = -1;
-                info.last_heartbeat = time(nullptr);
-                
-                {
-                    std::lock_guard<std::mutex> lock(pc_mutex);
-                    auto it = connected_pcs.find(pc_id);
-                    if (it != connected_pcs.end()) {
-                        info.file_connection = it->second.file_connection;
-                    }
-                    connected_pcs[pc_id] = info;
-                }
-                
-                std::string response = "OK|REGISTERED\n";
-                send(client_fd, response.c_str(), response.length(), 0);
-                std::cout << "[RelayServer] PC registered: " << pc_id << " (" << parts[3] << ")" << std::endl;
-                return;
-            } else {
-                send(client_fd, "ERROR|Invalid REGISTER format\n", 33, 0);
-                close(client_fd);
+        // Forward whole frames only so the mobile stream stays aligned
+        size_t whole = buffered - buffered % INPUT_FRAME_SIZE;
+        {
+            std::lock_guard<std::mutex> lock(route->to_mobile);
+            if (route->mobile_connection != -1) {
+                sendAll(route->mobile_connection, buffer, whole);
+                bytes_to_mobile.add(whole);
             }
         }
-        else if (message.find("FILE_HANDLER_REGISTER|") == 0) {
-            auto parts = split(message, '|');
-            if (parts.size() >= 2) {
-                std::string pc_id = parts[1];
-                
-                {
-                    std::lock_guard<std::mutex> lock(pc_mutex);
-                    auto it = connected_pcs.find(pc_id);
-                    if (it != connected_pcs.end()) {
-                        if (it->second.file_connection != -1) {
-                            close(it->second.file_connection);
-                        }
-                        it->second.file_connection = client_fd;
-                    } else {
-                        PCInfo info;
-                        info.pc_id = pc_id;
-                        info.main_connection = -1;
-                        info.file_connection = client_fd;
-                        info.last_heartbeat = time(nullptr);
-                        connected_pcs[pc_id] = info;
-                    }
-                }
-                
-                std::cout << "[RelayServer] FileHandler registered for PC: " << pc_id << std::endl;
-                std::thread(&handleFileConnection, client_fd, pc_id).detach();
-                return;
-            } else {
-                send(client_fd, "ERROR|Invalid FILE_HANDLER_REGISTER format\n", 45, 0);
-                close(client_fd);
+        memmove(buffer, buffer + whole, buffered - whole);
+        buffered -= whole;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(input_mutex);
+        auto it = input_routes.find(pc_id);
+        if (it != input_routes.end() && it->second == route) {
+            input_routes.erase(it);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(route->to_mobile);
+        route->pc_gone = true;
+        if (route->mobile_connection != -1) {
+            shutdown(route->mobile_connection, SHUT_RDWR);
+        }
+    }
+    {
+        // The mobile's thread may still hold the route; it must not
+        // write to a descriptor number that gets reused
+        std::lock_guard<std::mutex> lock(route->to_pc);
+        route->pc_connection = -1;
+        close(pc_fd);
+    }
+    LOG_INFO("RelayServer", "Input channel closed", {"pc_id", pc_id});
+}
+
+// Forwards input frames from a mobile to the PC until either side closes.
+// A mobile that is replaced, or whose PC goes away, is shut down, which
+// ends this loop.
+void handleMobileInputConnection(std::shared_ptr<InputRoute> route, int mobile_fd, const std::string& pc_id) {
+    char buffer[INPUT_FRAME_SIZE * 64];
+    size_t buffered = 0;
+    
+    while (running) {
+        ssize_t bytes = recv(mobile_fd, buffer + buffered, sizeof(buffer) - buffered, 0);
+        if (bytes <= 0) break;
+        buffered += bytes;
+        
+        size_t whole = buffered - buffered % INPUT_FRAME_SIZE;
+        {
+            std::lock_guard<std::mutex> lock(route->to_pc);
+            if (route->pc_connection == -1 || !sendAll(route->pc_connection, buffer, whole)) {
+                break;
             }
         }
-        else if (message.find("PC_FILE|") == 0) {
-            auto parts = split(message, '|');
-            if (parts.size() >= 2) {
-                std::string pc_id = parts[1];
+        bytes_to_pc.add(whole);
+        memmove(buffer, buffer + whole, buffered - whole);
+        buffered -= whole;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(route->to_mobile);
+        if (route->mobile_connection == mobile_fd) {
+            route->mobile_connection = -1;
+        }
+    }
+    close(mobile_fd);
+    LOG_INFO("RelayServer", "Mobile input channel closed", {"pc_id", pc_id});
+}
+
+// Copies one direction of a control session. Data is forwarded as soon
+// as it arrives; the only buffering is this one read.
+void forwardControlStream(int from_fd, int to_fd, Counter* relayed) {
+    char buffer[16384];
+    while (running) {
+        ssize_t bytes = recv(from_fd, buffer, sizeof(buffer), 0);
+        if (bytes <= 0 || !sendAll(to_fd, buffer, bytes)) break;
+        relayed->add(bytes);
+    }
+    // Wake the opposite direction so the session ends as a whole
+    shutdown(from_fd, SHUT_RDWR);
+    shutdown(to_fd, SHUT_RDWR);
+}
+
+// Remote-control session: a mobile's CONNECT_TO_PC paired with the PC's
+// parked control socket, spliced in both directions
+void handleControlSession(int mobile_fd, int pc_fd, const std::string& pc_id) {
+    LOG_INFO("RelayServer", "Control session started", {"pc_id", pc_id});
+    
+    std::thread pc_to_mobile(&forwardControlStream, pc_fd, mobile_fd, &bytes_to_mobile);
+    forwardControlStream(mobile_fd, pc_fd, &bytes_to_pc);
+    pc_to_mobile.join();
+    
+    close(mobile_fd);
+    close(pc_fd);
+    LOG_INFO("RelayServer", "Control session ended", {"pc_id", pc_id});
+}
+
+// Registers `client_fd` as the FileHandler connection for `pc_id`; the
+// one it replaces is shut down, for its reader thread to close
+std::shared_ptr<FileChannel> registerFileHandler(int client_fd, const std::string& pc_id, bool binary,
+                                                 bool traced) {
+    auto channel = std::make_shared<FileChannel>(client_fd, binary, traced);
+    std::shared_ptr<FileChannel> previous = connected_pcs.setFileConnection(pc_id, channel);
+    if (previous) {
+        shutdownFileChannel(*previous);
+    }
+    return channel;
+}
+
+// Forwards a mobile's LIST_DIR / GENERATE_URL to the PC FileHandler under
+// a relay request id; the answer goes back wherever `req` says. A traced
+// request reaches FileHandlers that take traces under the relay's span.
+bool forwardFileRequest(PendingRequest req, const Wire::FrameView& frame) {
+    PCInfo pc;
+    if (!connected_pcs.find(req.pc_id, pc) || !pc.file_channel) {
+        return false;
+    }
+    
+    std::string request_type = req.request_type;
+    req.pc_wait = Trace::Span::child("relay to FileHandler", req.span.context());
+    Wire::TraceContext trace = req.pc_wait.context();
+    bool traced = req.pc_wait.active() && pc.file_channel->traced;
+    uint32_t request_id;
+    {
+        std::lock_guard<std::mutex> req_lock(request_mutex);
+        req.file_size = 0;
+        req.bytes_transferred = 0;
+        req.timestamp = time(nullptr);
+        request_id = addPendingRequest(std::move(req));
+    }
+    
+    std::string out;
+    Wire::appendMessage(out, pc.file_channel->binary, frame, request_id, traced ? &trace : nullptr);
+    sendToFileHandler(*pc.file_channel, out);
+    bytes_to_pc.add(frame.size());
+    LOG_DEBUG("RelayServer", "Forwarded request to PC FileHandler", {"type", request_type});
+    return true;
+}
+
+std::string newSessionToken() {
+    std::random_device random;
+    std::string token;
+    char hex[9];
+    for (int i = 0; i < 4; i++) {
+        snprintf(hex, sizeof(hex), "%08x", random());
+        token += hex;
+    }
+    return token;
+}
+
+// Connection `fd` of a session is gone. Unless the mobile said DISCONNECT
+// the session waits SESSION_GRACE for it to come back.
+void detachSession(const std::shared_ptr<MobileSession>& session, int fd, bool ended) {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (session->fd != fd) {
+        return;     // already resumed on a newer connection
+    }
+    if (ended) {
+        session->fd = -1;
+        session->closed = true;
+        std::lock_guard<std::mutex> sessions_lock(session_mutex);
+        mobile_sessions.erase(session->token);
+        return;
+    }
+    startSessionGrace(*session);
+}
+
+// Makes `fd` the session's connection and sends the OK, followed by the
+// answers held for the mobile, in order. False if the session is closed.
+bool attachSession(MobileSession& session, int fd, bool binary, bool resumed) {
+    std::lock_guard<std::mutex> lock(session.mutex);
+    if (session.closed) {
+        return false;
+    }
+    timers.cancel(session.expiry);
+    if (session.fd != -1) {
+        shutdown(session.fd, SHUT_RDWR);    // the connection this one replaces
+    }
+    session.fd = fd;
+    session.binary = binary;
+    
+    // TRACE: the mobile may send traced requests on this session
+    sendMessage(fd, binary, Wire::Type::OK,
+                {"CONNECTED", session.pc_id, session.token, resumed ? "RESUMED" : "NEW", "TRACE"});
+    if (!session.backlog.empty()) {
+        sendAll(fd, session.backlog.data(), session.backlog.size());
+        session.backlog.clear();
+    }
+    return true;
+}
+
+// Mobile ConnectionManager session: reports whether the PC is online, then
+// carries the mobile's LIST_DIR / GENERATE_URL requests (pipelined, matched
+// by request id) and keep-alives until the mobile hangs up. A mobile that
+// presents the token of a session it lost resumes it.
+void handleMobileSession(int client_fd, Wire::Reader reader, const std::string& pc_id,
+                         const std::string& resume_token) {
+    PCInfo pc;
+    bool online = connected_pcs.find(pc_id, pc) && pc.main_connection != -1;
+    
+    bool binary = reader.binary();
+    if (!online) {
+        sendMessage(client_fd, binary, Wire::Type::PC_OFFLINE, {});
+        close(client_fd);
+        return;
+    }
+    
+    std::shared_ptr<MobileSession> session;
+    {
+        std::lock_guard<std::mutex> lock(session_mutex);
+        auto it = resume_token.empty() ? mobile_sessions.end() : mobile_sessions.find(resume_token);
+        if (it != mobile_sessions.end() && it->second->pc_id == pc_id) {
+            session = it->second;
+        }
+    }
+    
+    // A session that expired or was ended after the lookup is not resumed,
+    // since its answers would be dropped; the mobile gets a new one
+    bool resumed = session != nullptr && attachSession(*session, client_fd, binary, true);
+    if (!resumed) {
+        session = std::make_shared<MobileSession>();
+        session->token = newSessionToken();
+        session->pc_id = pc_id;
+        session->fd = -1;
+        session->closed = false;
+        session->expiry = TimingWheel::INVALID_TIMER;
+        {
+            std::lock_guard<std::mutex> lock(session_mutex);
+            mobile_sessions[session->token] = session;
+        }
+        attachSession(*session, client_fd, binary, false);
+    }
+    LOG_INFO("RelayServer", resumed ? "Mobile session resumed" : "Mobile session opened", {"pc_id", pc_id});
+    
+    char buffer[8192];
+    bool ended = false;
+    while (running && !ended) {
+        Wire::FrameView frame;
+        Wire::Reader::Result result;
+        while ((result = reader.next(frame)) == Wire::Reader::FRAME) {
+            if (frame.type() == Wire::Type::PING) {
+                std::lock_guard<std::mutex> lock(session->mutex);
+                sendMessage(client_fd, binary, Wire::Type::PONG, {}, frame.requestId());
+            } else if (frame.type() == Wire::Type::DISCONNECT) {
+                ended = true;
+                break;
+            } else if (frame.type() == Wire::Type::LIST_DIR || frame.type() == Wire::Type::GENERATE_URL) {
+                Trace::Span span = Trace::Span::child(std::string("relay ") + Wire::typeName(frame.type()),
+                                                      frame.trace());
+                uint32_t mobile_request = frame.requestId();
+                if (frame.fieldCount() < 2 || frame.fieldString(0) != pc_id) {
+                    failSessionRequest(*session, mobile_request, "Not connected to that PC");
+                    continue;
+                }
                 
-                {
-                    std::lock_guard<std::mutex> lock(pc_mutex);
-                    auto it = connected_pcs.find(pc_id);
-                    if (it != connected_pcs.end()) {
-                        if (it->second.file_connection != -1) {
-                            close(it->second.file_connection);
-                        }
-                        it->second.file_connection = client_fd;
-                    } else {
-                        PCInfo info;
-                        info.pc_id = pc_id;
-                        info.main_connection = -1;
-                        info.file_connection = client_fd;
-                        info.last_heartbeat = time(nullptr);
-                        connected_pcs[pc_id] = info;
+                // After a reconnect the mobile resends what it has no
+                // answer for; a copy still pending here is not sent twice
+                if (mobile_request != 0) {
+                    std::lock_guard<std::mutex> lock(session->mutex);
+                    if (!session->inflight.insert(mobile_request).second) {
+                        continue;
                     }
                 }
                 
-                std::cout << "[RelayServer] FileHandler registering for PC: " << pc_id << std::endl;
-                std::thread(&handleFileConnection, client_fd, pc_id).detach();
-                return;
-            } else {
-                send(client_fd, "ERROR|Invalid PC_FILE format\n", 31, 0);
-                close(client_fd);
-            }
-        }
-        else if (message.find("LIST_DIR|") == 0) {
-            // Format: LIST_DIR|pc_id|path
-            auto parts = split(message, '|');
-            if (parts.size() >= 3) {
-                std::string pc_id = parts[1];
-                std::string path = parts[2];
-                
-                std::lock_guard<std::mutex> lock(pc_mutex);
-                auto it = connected_pcs.find(pc_id);
-                if (it != connected_pcs.end() && it->second.file_connection != -1) {
-                    // Store pending request
-                    {
-                        std::lock_guard<std::mutex> req_lock(request_mutex);
-                        PendingRequest req;
-                        req.mobile_client = client_fd;
-                        req.request_type = "LIST_DIR";
-                        req.pc_id = pc_id;
-                        req.timestamp = time(nullptr);
-                        pending_requests[client_fd] = req;
-                    }
-                    
-                    // Forward to PC FileHandler
-                    std::string forward_cmd = "LIST_DIR|" + pc_id + "|" + path + "\n";
-                    send(it->second.file_connection, forward_cmd.c_str(), forward_cmd.length(), 0);
-                    std::cout << "[RelayServer] Forwarded LIST_DIR to PC FileHandler" << std::endl;
-                    return; // Keep socket open for response
-                } else {
-                    std::string error = "ERROR|PC file handler not connected\n";
-                    send(client_fd, error.c_str(), error.length(), 0);
-                    close(client_fd);
+                PendingRequest req;
+                req.mobile_client = -1;
+                req.session = session;
+                req.mobile_request = mobile_request;
+                req.request_type = Wire::typeName(frame.type());
+                req.pc_id = pc_id;
+                req.binary = binary;
+                req.span = std::move(span);
+                if (!forwardFileRequest(std::move(req), frame)) {
+                    failSessionRequest(*session, mobile_request, "PC file handler not connected");
                 }
-            } else {
-                send(client_fd, "ERROR|Invalid LIST_DIR format\n", 32, 0);
-                close(client_fd);
             }
         }
-        else if (message.find("DOWNLOAD|") == 0) {
-            // Format: DOWNLOAD|pc_id|file_path
-            auto parts = split(message, '|');
-            if (parts.size() >= 3) {
-                std::string pc_id = parts[1];
-                std::string file_path = parts[2];
-                
-                std::cout << "[RelayServer] DOWNLOAD request: " << file_path << std::endl;
-                
-                // Handle download in dedicated thread to keep socket open
-                std::thread(&handleDownloadRequest, client_fd, pc_id, file_path).detach();
-                return; // Socket will be managed by download thread
-            } else {
-                send(client_fd, "ERROR|Invalid DOWNLOAD format\n", 32, 0);
-                close(client_fd);
-            }
+        if (ended || result == Wire::Reader::BAD_FRAME) break;
+        
+        ssize_t bytes = recv(client_fd, buffer, sizeof(buffer), 0);
+        if (bytes <= 0) break;
+        reader.append(buffer, bytes);
+    }
+    
+    detachSession(session, client_fd, ended);
+    close(client_fd);
+    LOG_INFO("RelayServer", ended ? "Mobile session closed" : "Mobile session detached", {"pc_id", pc_id});
+}
+
+// What a handler for a connection's first message gets. Handlers that
+// keep the connection (sessions, file channels) move the reader along so
+// anything already buffered behind the first message is not lost.
+struct ClientRequest {
+    int fd;
+    bool binary;
+    Wire::Reader& reader;
+};
+
+// REGISTER|pc_id|usb_id|username
+void onRegister(ClientRequest& client, const Wire::FrameView& frame) {
+    std::string pc_id = frame.fieldString(0);
+    std::string username = frame.fieldString(2);
+    int previous = connected_pcs.registerPC(pc_id, frame.fieldString(1), username, client.fd);
+    if (previous != -1) {
+        close(previous);
+    }
+    refreshDeadline(pc_id);
+    
+    sendMessage(client.fd, client.binary, Wire::Type::OK, {"REGISTERED"});
+    LOG_INFO("RelayServer", "PC registered", {"pc_id", pc_id}, {"username", username});
+}
+
+// FILE_HANDLER_REGISTER|pc_id[|TRACE] (PC_FILE|pc_id from older clients);
+// TRACE says the FileHandler reads traced frames
+void onFileHandlerRegister(ClientRequest& client, const Wire::FrameView& frame) {
+    std::string pc_id = frame.fieldString(0);
+    bool traced = client.binary && frame.field(1) == "TRACE";
+    std::shared_ptr<FileChannel> channel = registerFileHandler(client.fd, pc_id, client.binary, traced);
+    refreshDeadline(pc_id);
+    
+    LOG_INFO("RelayServer", "FileHandler registered", {"pc_id", pc_id});
+    std::thread(&handleFileConnection, std::move(channel), pc_id, std::move(client.reader)).detach();
+}
+
+// LIST_DIR|pc_id|path, GENERATE_URL|pc_id|file_path
+void onFileRequest(ClientRequest& client, const Wire::FrameView& frame) {
+    PendingRequest req;
+    req.mobile_client = client.fd;
+    req.mobile_request = frame.requestId();
+    req.request_type = Wire::typeName(frame.type());
+    req.pc_id = frame.fieldString(0);
+    req.binary = client.binary;
+    req.span = Trace::Span::child("relay " + req.request_type, frame.trace());
+    if (!forwardFileRequest(std::move(req), frame)) {
+        sendMessage(client.fd, client.binary, Wire::Type::ERROR, {"PC file handler not connected"});
+        close(client.fd);
+    }
+    // Otherwise the socket stays open for the response
+}
+
+// DOWNLOAD|pc_id|file_path
+void onDownload(ClientRequest& client, const Wire::FrameView& frame) {
+    std::string file_path = frame.fieldString(1);
+    LOG_INFO("RelayServer", "DOWNLOAD request", {"path", file_path});
+    
+    // Handle download in dedicated thread to keep socket open
+    std::thread(&handleDownloadRequest, client.fd, frame.fieldString(0), file_path, client.binary).detach();
+}
+
+// UPLOAD|pc_id|file_path|file_size
+void onUpload(ClientRequest& client, const Wire::FrameView& frame) {
+    std::string file_path = frame.fieldString(1);
+    size_t file_size = frame.fieldU64(2);
+    LOG_INFO("RelayServer", "UPLOAD request", {"path", file_path}, {"bytes", file_size});
+    
+    // Handle upload in dedicated thread to keep socket open
+    std::thread(&handleUploadRequest, client.fd, frame.fieldString(0), file_path, file_size, client.binary).detach();
+}
+
+// CONNECT|mobile_id|pc_id|auth_token from the mobile ConnectionManager
+void onConnect(ClientRequest& client, const Wire::FrameView& frame) {
+    handleMobileSession(client.fd, std::move(client.reader), frame.fieldString(1),
+                        frame.fieldCount() > 3 ? frame.fieldString(3) : std::string());
+}
+
+// CONTROL_REGISTER|pc_id
+void onControlRegister(ClientRequest& client, const Wire::FrameView& frame) {
+    std::string pc_id = frame.fieldString(0);
+    setLowDelay(client.fd);
+    
+    {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        auto it = parked_controls.find(pc_id);
+        if (it != parked_controls.end()) {
+            close(it->second);
         }
-        else if (message.find("UPLOAD|") == 0) {
-            // Format: UPLOAD|pc_id|file_path|file_size
-            auto parts = split(message, '|');
-            if (parts.size() >= 4) {
-                std::string pc_id = parts[1];
-                std::string file_path = parts[2];
-                size_t file_size = std::stoull(parts[3]);
-                
-                std::cout << "[RelayServer] UPLOAD request: " << file_path << " (" << file_size << " bytes)" << std::endl;
-                
-                // Handle upload in dedicated thread to keep socket open
-                std::thread(&handleUploadRequest, client_fd, pc_id, file_path, file_size).detach();
-                return; // Socket will be managed by upload thread
-            } else {
-                send(client_fd, "ERROR|Invalid UPLOAD format\n", 30, 0);
-                close(client_fd);
+        parked_controls[pc_id] = client.fd;
+    }
+    
+    LOG_INFO("RelayServer", "Control socket parked", {"pc_id", pc_id});
+}
+
+// CONNECT_TO_PC|pc_id
+void onConnectToPC(ClientRequest& client, const Wire::FrameView& frame) {
+    std::string pc_id = frame.fieldString(0);
+    int pc_fd = -1;
+    
+    {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        auto it = parked_controls.find(pc_id);
+        if (it != parked_controls.end()) {
+            pc_fd = it->second;
+            parked_controls.erase(it);
+        }
+    }
+    
+    // Commands the mobile sent right behind the request are already in
+    // the reader; they go to the PC once the session is up. The control
+    // stream itself stays line-based and is spliced, not parsed.
+    std::string_view early_data = client.reader.pending();
+    
+    // The PC parks a fresh socket once it sees CONTROL_SESSION; a
+    // failed send means the parked one had already gone away
+    if (pc_fd != -1 && (!sendAll(pc_fd, "CONTROL_SESSION\n", 16) ||
+                        !sendAll(pc_fd, early_data.data(), early_data.size()))) {
+        close(pc_fd);
+        pc_fd = -1;
+    }
+    
+    if (pc_fd == -1) {
+        sendMessage(client.fd, client.binary, Wire::Type::ERROR, {"PC not available for remote control"});
+        close(client.fd);
+    } else {
+        setLowDelay(client.fd);
+        handleControlSession(client.fd, pc_fd, pc_id);
+    }
+}
+
+// INPUT_REGISTER|pc_id
+void onInputRegister(ClientRequest& client, const Wire::FrameView& frame) {
+    std::string pc_id = frame.fieldString(0);
+    setLowDelay(client.fd);
+    
+    std::shared_ptr<InputRoute> route = std::make_shared<InputRoute>();
+    route->pc_connection = client.fd;
+    route->mobile_connection = -1;
+    route->pc_gone = false;
+    std::shared_ptr<InputRoute> replaced;
+    {
+        std::lock_guard<std::mutex> lock(input_mutex);
+        auto it = input_routes.find(pc_id);
+        if (it != input_routes.end()) {
+            // Replaced by a reconnect; its reader thread cleans up. Its
+            // socket stays open until that thread gets input_mutex.
+            replaced = it->second;
+            shutdown(replaced->pc_connection, SHUT_RDWR);
+        }
+        input_routes[pc_id] = route;
+    }
+    if (replaced) {
+        std::lock_guard<std::mutex> lock(replaced->to_mobile);
+        if (replaced->mobile_connection != -1) {
+            shutdown(replaced->mobile_connection, SHUT_RDWR);
+        }
+    }
+    
+    LOG_INFO("RelayServer", "Input channel registered", {"pc_id", pc_id});
+    std::thread(&handlePCInputConnection, route, pc_id).detach();
+}
+
+// INPUT_CHANNEL|pc_id
+void onInputChannel(ClientRequest& client, const Wire::FrameView& frame) {
+    std::string pc_id = frame.fieldString(0);
+    std::shared_ptr<InputRoute> route;
+    {
+        std::lock_guard<std::mutex> lock(input_mutex);
+        auto it = input_routes.find(pc_id);
+        if (it != input_routes.end()) {
+            route = it->second;
+        }
+    }
+    
+    bool ready = false;
+    if (route) {
+        // One controller at a time; a new one takes over
+        std::lock_guard<std::mutex> lock(route->to_mobile);
+        if (!route->pc_gone) {
+            if (route->mobile_connection != -1) {
+                shutdown(route->mobile_connection, SHUT_RDWR);
             }
+            route->mobile_connection = client.fd;
+            ready = true;
         }
-        else if (message.find("GENERATE_URL|") == 0) {
-            // Format: GENERATE_URL|pc_id|file_path
-            auto parts = split(message, '|');
-            if (parts.size() >= 3) {
-                std::string pc_id = parts[1];
-                std::string file_path = parts[2];
-                
-                std::lock_guard<std::mutex> lock(pc_mutex);
-                auto it = connected_pcs.find(pc_id);
-                if (it != connected_pcs.end() && it->second.file_connection != -1) {
-                    {
-                        std::lock_guard<std::mutex> req_lock(request_mutex);
-                        PendingRequest req;
-                        req.mobile_client = client_fd;
-                        req.request_type = "GENERATE_URL";
-                        req.pc_id = pc_id;
-                        req.timestamp = time(nullptr);
-                        pending_requests[client_fd] = req;
-                    }
-                    
-                    std::string forward_cmd = "GENERATE_URL|" + pc_id + "|" + file_path + "\n";
-                    send(it->second.file_connection, forward_cmd.c_str(), forward_cmd.length(), 0);
-                    std::cout << "[RelayServer] Forwarded GENERATE_URL to PC FileHandler" << std::endl;
-                    return;
-                } else {
-                    std::string error = "ERROR|PC file handler not connected\n";
-                    send(client_fd, error.c_str(), error.length(), 0);
-                    close(client_fd);
-                }
+    }
+    
+    if (!ready) {
+        sendMessage(client.fd, client.binary, Wire::Type::ERROR, {"PC input channel not available"});
+        close(client.fd);
+        return;
+    }
+    
+    setLowDelay(client.fd);
+    sendMessage(client.fd, client.binary, Wire::Type::INPUT_READY, {});
+    LOG_INFO("RelayServer", "Mobile input channel opened", {"pc_id", pc_id});
+    std::thread(&handleMobileInputConnection, route, client.fd, pc_id).detach();
+}
+
+// Fields 1.. of GET_PCS / SUBSCRIBE_PCS: PCs the mobile is paired with
+std::vector<std::string> boundPCs(const Wire::FrameView& frame) {
+    std::vector<std::string> bound;
+    for (size_t i = 1; i < frame.fieldCount(); i++) {
+        bound.push_back(frame.fieldString(i));
+    }
+    return bound;
+}
+
+// PC_LIST with one (id, username, id) record per PC, as many as fit one
+// frame
+void sendPCList(int fd, bool binary, const PCRegistry::Snapshot& pcs) {
+    std::string response;
+    Wire::Builder list(response, Wire::Type::PC_LIST);
+    for (const PCRegistry::Listing& pc : pcs) {
+        if (!list.addRecord({pc.pc_id, pc.username, pc.pc_id})) {
+            LOG_WARN("RelayServer", "PC list truncated to one frame", {"pcs", pcs.size()});
+            break;
+        }
+    }
+    list.finish();
+    forwardMessage(fd, binary, Wire::FrameView(response.data()));
+}
+
+// GET_PCS|username[|pc_id...]: the user's online PCs and any online PC it
+// is paired with. A bare GET_PCS (app builds before per-user listing)
+// still gets every online PC.
+void onGetPCs(ClientRequest& client, const Wire::FrameView& frame) {
+    if (frame.fieldCount() == 0) {
+        sendPCList(client.fd, client.binary, *connected_pcs.online());
+    } else {
+        sendPCList(client.fd, client.binary, connected_pcs.onlineFor(frame.fieldString(0), boundPCs(frame)));
+    }
+    close(client.fd);
+}
+
+// Presence changes queued by the registry for one subscriber
+struct PresenceOutbox {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::string frames;
+};
+
+// SUBSCRIBE_PCS session: the current listing, then PC_ONLINE (one
+// PC_LIST record) / PC_OFFLINE|pc_id as the watched PCs come and go,
+// until the mobile sends DISCONNECT or hangs up
+void handlePresenceSubscription(int client_fd, Wire::Reader reader, const std::string& username,
+                                const std::vector<std::string>& bound) {
+    bool binary = reader.binary();
+    auto outbox = std::make_shared<PresenceOutbox>();
+    PCRegistry::Snapshot current;
+    PCRegistry::WatchId watch = connected_pcs.watch(username, bound,
+        [outbox, binary](const PCRegistry::Listing& pc, bool online) {
+            std::lock_guard<std::mutex> lock(outbox->mutex);
+            if (online) {
+                Wire::appendMessage(outbox->frames, binary, Wire::Type::PC_ONLINE,
+                                    {pc.pc_id, pc.username, pc.pc_id});
             } else {
-                send(client_fd, "ERROR|Invalid GENERATE_URL format\n", 36, 0);
-                close(client_fd);
+                Wire::appendMessage(outbox->frames, binary, Wire::Type::PC_OFFLINE, {pc.pc_id});
             }
+            outbox->ready.notify_one();
+        }, current);
+    
+    sendPCList(client_fd, binary, current);
+    LOG_INFO("RelayServer", "Presence subscription opened", {"username", username}, {"paired", bound.size()},
+             {"online", current.size()});
+    
+    char buffer[1024];
+    bool open = true;
+    std::string frames;
+    while (running && open) {
+        {
+            std::unique_lock<std::mutex> lock(outbox->mutex);
+            outbox->ready.wait_for(lock, std::chrono::milliseconds(100),
+                                   [&outbox] { return !outbox->frames.empty(); });
+            frames.swap(outbox->frames);
         }
-        else if (message.find("GET_PCS") == 0) {
-            std::string response = "PC_LIST|";
-            {
-                std::lock_guard<std::mutex> lock(pc_mutex);
-                for (const auto& pc : connected_pcs) {
-                    if (pc.second.main_connection != -1) {
-                        response += pc.second.pc_id + "," + pc.second.username + "," + pc.second.pc_id + ";";
-                    }
-                }
+        if (!frames.empty()) {
+            if (!sendAll(client_fd, frames.data(), frames.size())) break;
+            frames.clear();
+        }
+        
+        ssize_t bytes = recv(client_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) break;
+        if (bytes > 0) {
+            reader.append(buffer, bytes);
+        }
+        
+        Wire::FrameView frame;
+        Wire::Reader::Result result;
+        while ((result = reader.next(frame)) == Wire::Reader::FRAME) {
+            if (frame.type() == Wire::Type::PING) {
+                sendMessage(client_fd, binary, Wire::Type::PONG, {});
+            } else if (frame.type() == Wire::Type::DISCONNECT) {
+                open = false;
+                break;
             }
-            response += "\n";
-            send(client_fd, response.c_str(), response.length(), 0);
-            close(client_fd);
         }
-        else {
-            std::cout << "[RelayServer] Unknown command: " << message << std::endl;
-            close(client_fd);
+        if (result == Wire::Reader::BAD_FRAME) break;
+    }
+    
+    connected_pcs.unwatch(watch);
+    close(client_fd);
+    LOG_INFO("RelayServer", "Presence subscription closed", {"username", username});
+}
+
+// SUBSCRIBE_PCS|username[|pc_id...]
+void onSubscribePCs(ClientRequest& client, const Wire::FrameView& frame) {
+    std::thread(&handlePresenceSubscription, client.fd, std::move(client.reader),
+                frame.fieldString(0), boundPCs(frame)).detach();
+}
+
+// First messages the relay accepts, with the fields each must carry
+constexpr Wire::Command<ClientRequest> kClientCommands[] = {
+    { Wire::Type::REGISTER, 3, &onRegister },
+    { Wire::Type::FILE_HANDLER_REGISTER, 1, &onFileHandlerRegister },
+    { Wire::Type::PC_FILE, 1, &onFileHandlerRegister },
+    { Wire::Type::LIST_DIR, 2, &onFileRequest },
+    { Wire::Type::GENERATE_URL, 2, &onFileRequest },
+    { Wire::Type::DOWNLOAD, 2, &onDownload },
+    { Wire::Type::UPLOAD, 3, &onUpload },
+    { Wire::Type::CONNECT, 2, &onConnect },
+    { Wire::Type::CONTROL_REGISTER, 1, &onControlRegister },
+    { Wire::Type::CONNECT_TO_PC, 1, &onConnectToPC },
+    { Wire::Type::INPUT_REGISTER, 1, &onInputRegister },
+    { Wire::Type::INPUT_CHANNEL, 1, &onInputChannel },
+    { Wire::Type::GET_PCS, 0, &onGetPCs },
+    { Wire::Type::SUBSCRIBE_PCS, 1, &onSubscribePCs }
+};
+
+constexpr Wire::Dispatcher kClientDispatcher(kClientCommands);
+
+void handleClient(int client_fd) {
+    // TLS clients are unwrapped here; everything below sees plaintext
+    if (tls.enabled() && TlsTerminator::startsWithTls(client_fd)) {
+        client_fd = tls.accept(client_fd);
+        if (client_fd < 0) return;
+    }
+    
+    // Old clients send a text line, new ones a binary frame; Reader
+    // accepts both and replies go back in the same format
+    Wire::Reader reader;
+    Wire::FrameView frame;
+    Wire::Reader::Result result = Wire::Reader::NEED_MORE;
+    char buffer[1024];
+    
+    while (result == Wire::Reader::NEED_MORE) {
+        ssize_t bytes = recv(client_fd, buffer, sizeof(buffer), 0);
+        if (bytes <= 0) break;
+        reader.append(buffer, bytes);
+        result = reader.next(frame);
+    }
+    
+    if (result != Wire::Reader::FRAME) {
+        close(client_fd);
+        return;
+    }
+    
+    bool binary = reader.binary();
+    LOG_DEBUG("RelayServer", "Received", {"fd", client_fd}, {"type", Wire::typeName(frame.type())},
+              {"framing", binary ? "binary" : "text"}, {"fields", frame.fieldCount()});
+    
+    ClientRequest client{ client_fd, binary, reader };
+    switch (kClientDispatcher.dispatch(client, frame)) {
+    case Wire::DispatchResult::HANDLED:
+        break;
+    case Wire::DispatchResult::MISSING_FIELDS:
+        sendMessage(client_fd, binary, Wire::Type::ERROR,
+                    {std::string("Invalid ") + Wire::typeName(frame.type()) + " format"});
+        close(client_fd);
+        break;
+    case Wire::DispatchResult::UNKNOWN_COMMAND:
+        LOG_WARN("RelayServer", "Unknown command",
+                 {"command", frame.type() == Wire::Type::UNKNOWN ? frame.field(0)
+                                                                 : std::string_view(Wire::typeName(frame.type()))});
+        close(client_fd);
+        break;
+    }
+}
+
+void sendShareError(int fd, int status) {
+    const char* reason = status == 400 ? "Bad Request" : status == 404 ? "Not Found" : status == 410 ? "Gone"
+                       : status == 504 ? "Gateway Timeout" : "Bad Gateway";
+    std::string body = std::to_string(status) + " " + reason + "\n";
+    std::string response = "HTTP/1.1 " + body.substr(0, body.size() - 1) + "\r\nContent-Type: text/plain\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    sendAll(fd, response.data(), response.size());
+}
+
+// Sends a cached blob with sendfile(); false if it was evicted before it
+// could be opened
+bool sendCachedShare(int fd, const ShareCache::Entry& entry) {
+    int blob = open(entry.blob_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (blob < 0) {
+        return false;
+    }
+    std::string headers = shareHeaders(entry.size, entry.file_name);
+    off_t offset = 0;
+    if (sendAll(fd, headers.data(), headers.size())) {
+        setBulk(fd);
+        while (static_cast<uint64_t>(offset) < entry.size) {
+            ssize_t sent = sendfile(fd, blob, &offset, entry.size - offset);
+            if (sent <= 0) break;
         }
+    }
+    close(blob);
+    bytes_to_mobile.add(offset);
+    LOG_DEBUG("ShareCache", "Served from cache", {"bytes", offset}, {"total", entry.size});
+    return true;
+}
+
+// Asks the PC for share link `token` and waits while the FileHandler
+// channel streams it to `fetch.client_fd`; returns the HTTP status to
+// answer with if nothing was sent
+int fetchShare(const std::string& pc_id, const std::string& token, const std::shared_ptr<ShareFetch>& fetch) {
+    PCInfo pc;
+    if (!connected_pcs.find(pc_id, pc) || !pc.file_channel) {
+        return 502;
+    }
+    
+    uint32_t request_id;
+    {
+        std::lock_guard<std::mutex> lock(request_mutex);
+        PendingRequest req;
+        req.mobile_client = -1;
+        req.mobile_request = 0;
+        req.request_type = "SHARE_DOWNLOAD";
+        req.pc_id = pc_id;
+        req.file_size = 0;
+        req.bytes_transferred = 0;
+        req.timestamp = time(nullptr);
+        req.binary = true;
+        req.share = fetch;
+        request_id = addPendingRequest(std::move(req));
+    }
+    
+    if (!sendToFileHandler(*pc.file_channel, Wire::Type::SHARE_DOWNLOAD, {pc_id, token}, request_id)) {
+        std::lock_guard<std::mutex> lock(request_mutex);
+        auto it = pending_requests.find(request_id);
+        if (it != pending_requests.end()) {
+            finishRequest(it);
+        }
+        return 502;
+    }
+    
+    std::unique_lock<std::mutex> lock(fetch->mutex);
+    fetch->done_cv.wait(lock, [&] { return fetch->done; });
+    return fetch->status;
+}
+
+// GET /share/<pc_id>/<token>: from the cache if it has the link, else
+// from the PC, filling the cache on the way
+void handleShareClient(int fd) {
+    struct timeval timeout;
+    timeout.tv_sec = 10;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    // A stalled client must not hold up the PC's file channel for long
+    timeout.tv_sec = 30;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    
+    std::string head;
+    char buffer[1024];
+    while (head.find("\r\n") == std::string::npos && head.size() < 8192) {
+        ssize_t bytes = recv(fd, buffer, sizeof(buffer), 0);
+        if (bytes <= 0) {
+            close(fd);
+            return;
+        }
+        head.append(buffer, bytes);
+    }
+    
+    // Request line: GET /share/<pc_id>/<token> HTTP/1.1
+    std::string line = head.substr(0, head.find("\r\n"));
+    size_t path_end = line.find(' ', 4);
+    std::string path = line.compare(0, 11, "GET /share/") == 0 && path_end != std::string::npos
+        ? line.substr(11, path_end - 11) : std::string();
+    size_t slash = path.find('/');
+    if (slash == std::string::npos || slash == 0 || slash + 1 == path.size() ||
+        path.find('/', slash + 1) != std::string::npos) {
+        sendShareError(fd, line.compare(0, 4, "GET ") == 0 ? 404 : 400);
+        close(fd);
+        return;
+    }
+    std::string pc_id = path.substr(0, slash);
+    std::string token = path.substr(slash + 1);
+    
+    // A blob evicted between lookup and open is looked up once more
+    auto fetch = std::make_shared<ShareFetch>();
+    fetch->client_fd = fd;
+    ShareCache::Entry entry;
+    bool hit = share_cache.acquire(path, entry, fetch->fill);
+    if (hit && !sendCachedShare(fd, entry)) {
+        hit = share_cache.acquire(path, entry, fetch->fill) && sendCachedShare(fd, entry);
+    }
+    if (hit) {
+        share_hits.add();
+        close(fd);
+        return;
+    }
+    
+    share_misses.add();
+    int status = fetchShare(pc_id, token, fetch);
+    if (status != 0) {
+        share_cache.abort(fetch->fill);
+        sendShareError(fd, status);
+        LOG_INFO("ShareCache", "Share link refused", {"pc_id", pc_id}, {"status", status});
+    } else if (fetch->received == fetch->size) {
+        share_cache.commit(fetch->fill, fetch->size, fetch->file_name, fetch->expiry);
     } else {
-        close(client_fd);
+        share_cache.abort(fetch->fill);
     }
+    close(fd);
 }
 
-void cleanupStaleRequests() {
+void serveShareLinks() {
     while (running) {
-        std::this_thread::sleep_for(std::chrono::seconds(30));
-        
-        std::lock_guard<std::mutex> lock(request_mutex);
-        time_t now = time(nullptr);
-        
-        for (auto it = pending_requests.begin(); it != pending_requests.end(); ) {
-            if (now - it->second.timestamp > 300) { // 5 minutes timeout
-                std::cout << "[RelayServer] Cleaning up stale request: type=" 
-                          << it->second.request_type << ", fd=" << it->first << std::endl;
-                close(it->first);
-                it = pending_requests.erase(it);
-            } else {
-                ++it;
-            }
+        int fd = accept(share_listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
         }
+        std::thread(&handleShareClient, fd).detach();
     }
 }
 
+// Listens for share link downloads on `port`
+bool startShareServer(uint16_t port) {
+    const char* cache_dir = getenv("RELAY_SHARE_CACHE_DIR");
+    const char* cache_mb = getenv("RELAY_SHARE_CACHE_MB");
+    uint64_t cache_bytes = (cache_mb ? strtoull(cache_mb, nullptr, 10) : 1024) << 20;
+    if (!share_cache.init(cache_dir ? cache_dir : "/var/tmp/relay-share-cache", cache_bytes)) {
+        return false;
+    }
+    
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int opt = 1;
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 64) < 0) {
+        LOG_ERROR("RelayServer", "Cannot listen for share links", {"port", port}, {"error", strerror(errno)});
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    
+    share_listener = fd;
+    share_port_number = port;
+    share_thread = std::thread(&serveShareLinks);
+    return true;
+}
+
+// A "Key:   value" line of /proc/self/status, 0 if missing
+double procStatus(const char* key) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) return 0;
+    char line[256];
+    size_t key_length = strlen(key);
+    double value = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, key, key_length) == 0 && line[key_length] == ':') {
+            value = strtod(line + key_length + 1, nullptr);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+// Metrics read from state the relay keeps anyway, at scrape time only
+void registerMetrics() {
+    metrics.callback("relay_connected_pcs", "PCs registered and online", MetricsRegistry::GAUGE, "", [] {
+        return static_cast<double>(connected_pcs.online()->size());
+    });
+    metrics.callback("relay_pending_requests", "File requests waiting for the PC", MetricsRegistry::GAUGE, "", [] {
+        std::lock_guard<std::mutex> lock(request_mutex);
+        return static_cast<double>(pending_requests.size());
+    });
+    metrics.callback("relay_mobile_sessions", "Mobile CONNECT sessions, attached or in their grace period",
+                     MetricsRegistry::GAUGE, "", [] {
+        std::lock_guard<std::mutex> lock(session_mutex);
+        return static_cast<double>(mobile_sessions.size());
+    });
+    metrics.callback("relay_pending_timers", "Deadlines armed in the timing wheel", MetricsRegistry::GAUGE, "", [] {
+        return static_cast<double>(timers.pending());
+    });
+    metrics.callback("relay_threads", "Threads in the relay process", MetricsRegistry::GAUGE, "", [] {
+        return procStatus("Threads");
+    });
+    metrics.callback("process_resident_memory_bytes", "Resident set size", MetricsRegistry::GAUGE, "", [] {
+        return procStatus("VmRSS") * 1024;
+    });
+    metrics.callback("process_cpu_seconds_total", "User and system CPU time", MetricsRegistry::COUNTER, "", [] {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    });
+    metrics.callback("relay_tls_handshakes_total", "TLS handshakes completed", MetricsRegistry::COUNTER,
+                     "resumed=\"false\"", [] {
+        TlsTerminator::Stats stats = tls.stats();
+        return static_cast<double>(stats.handshakes - stats.resumed);
+    });
+    metrics.callback("relay_tls_handshakes_total", "TLS handshakes completed", MetricsRegistry::COUNTER,
+                     "resumed=\"true\"", [] {
+        return static_cast<double>(tls.stats().resumed);
+    });
+    metrics.callback("relay_tls_failures_total", "TLS handshakes that failed", MetricsRegistry::COUNTER, "", [] {
+        return static_cast<double>(tls.stats().failures);
+    });
+    
+    // Created up front so every command shows up before its first request
+    requestLatency("");
+}
+
 void signalHandler(int signal) {
-    std::cout << "\n[RelayServer] Shutting down..." << std::endl;
     running = false;
 }
 
@@ -691,15 +1877,19 @@ int main() {
     std::cout << "  Enhanced File Transfer Support" << std::endl;
     std::cout << "========================================" << std::endl;
     
+    // Everything after the banner goes through the asynchronous logger
+    RemoteAccessSystem::Common::AsyncLog::Start();
+    Trace::Exporter::instance().setService("relay");
+    
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
-        std::cerr << "[RelayServer] Failed to create socket: " << strerror(errno) << std::endl;
+        LOG_ERROR("RelayServer", "Failed to create socket", {"error", strerror(errno)});
         return 1;
     }
     
     int opt = 1;
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        std::cerr << "[RelayServer] setsockopt failed: " << strerror(errno) << std::endl;
+        LOG_ERROR("RelayServer", "setsockopt failed", {"error", strerror(errno)});
         close(server_fd);
         return 1;
     }
@@ -710,23 +1900,47 @@ int main() {
     address.sin_port = htons(2810);
     
     if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-        std::cerr << "[RelayServer] Bind failed: " << strerror(errno) << std::endl;
+        LOG_ERROR("RelayServer", "Bind failed", {"error", strerror(errno)});
         close(server_fd);
         return 1;
     }
     
     if (listen(server_fd, 10) < 0) {
-        std::cerr << "[RelayServer] Listen failed: " << strerror(errno) << std::endl;
+        LOG_ERROR("RelayServer", "Listen failed", {"error", strerror(errno)});
         close(server_fd);
         return 1;
     }
     
-    std::cout << "[RelayServer] Listening on port 2810" << std::endl;
-    std::cout << "[RelayServer] Waiting for connections..." << std::endl;
+    // TLS is optional while clients migrate; plaintext keeps working on
+    // the same port either way
+    const char* tls_cert = getenv("RELAY_TLS_CERT");
+    const char* tls_key = getenv("RELAY_TLS_KEY");
+    if (tls_cert && tls_key) {
+        if (!tls.init(tls_cert, tls_key)) {
+            close(server_fd);
+            return 1;
+        }
+        LOG_INFO("RelayServer", "TLS 1.3 enabled", {"certificate", tls_cert});
+    }
     
-    // Start cleanup thread
-    std::thread cleanup_thread(cleanupStaleRequests);
-    cleanup_thread.detach();
+    registerMetrics();
+    const char* metrics_port = getenv("RELAY_METRICS_PORT");
+    uint16_t scrape_port = metrics_port ? static_cast<uint16_t>(atoi(metrics_port)) : 9810;
+    if (scrape_port != 0 && metrics.serve(scrape_port)) {
+        LOG_INFO("RelayServer", "Metrics enabled",
+                 {"url", "http://0.0.0.0:" + std::to_string(scrape_port) + "/metrics"});
+    }
+    
+    const char* share_port = getenv("RELAY_SHARE_PORT");
+    uint16_t link_port = share_port ? static_cast<uint16_t>(atoi(share_port)) : 9811;
+    if (link_port != 0 && startShareServer(link_port)) {
+        LOG_INFO("RelayServer", "Share links enabled",
+                 {"url", "http://0.0.0.0:" + std::to_string(link_port) + "/share/"});
+    }
+    
+    LOG_INFO("RelayServer", "Listening", {"port", 2810});
+    
+    timers.start();
     
     while (running) {
         struct sockaddr_in client_addr;
@@ -735,46 +1949,67 @@ int main() {
         
         if (client_fd < 0) {
             if (running && errno != EINTR) {
-                std::cerr << "[RelayServer] Accept failed: " << strerror(errno) << std::endl;
+                LOG_ERROR("RelayServer", "Accept failed", {"error", strerror(errno)});
             }
             continue;
         }
         
+        accepted_connections.add();
+        
         char client_ip[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
         
-        std::cout << "[RelayServer] New client connected from " << client_ip 
-                  << ":" << ntohs(client_addr.sin_port) 
-                  << ", fd=" << client_fd << std::endl;
+        LOG_INFO("RelayServer", "New client connected", {"address", client_ip}, {"port", ntohs(client_addr.sin_port)},
+                 {"fd", client_fd});
         
         std::thread(&handleClient, client_fd).detach();
     }
     
     // Cleanup
-    std::cout << "[RelayServer] Closing all connections..." << std::endl;
+    LOG_INFO("RelayServer", "Shutting down, closing all connections");
+    timers.stop();
+    metrics.stop();
+    if (share_listener != -1) {
+        // Wakes the blocked accept()
+        shutdown(share_listener, SHUT_RDWR);
+        share_thread.join();
+        close(share_listener);
+    }
+    
+    for (const PCInfo& pc : connected_pcs.drain()) {
+        if (pc.main_connection != -1) {
+            close(pc.main_connection);
+        }
+        if (pc.file_channel) {
+            shutdownFileChannel(*pc.file_channel);
+        }
+    }
     
     {
-        std::lock_guard<std::mutex> lock(pc_mutex);
-        for (auto& pc : connected_pcs) {
-            if (pc.second.main_connection != -1) {
-                close(pc.second.main_connection);
-            }
-            if (pc.second.file_connection != -1) {
-                close(pc.second.file_connection);
-            }
+        std::lock_guard<std::mutex> lock(control_mutex);
+        for (auto& parked : parked_controls) {
+            close(parked.second);
         }
-        connected_pcs.clear();
+        parked_controls.clear();
     }
     
     {
         std::lock_guard<std::mutex> lock(request_mutex);
         for (auto& req : pending_requests) {
-            close(req.first);
+            if (!req.second.session) {
+                close(req.second.mobile_client);
+            }
         }
         pending_requests.clear();
     }
     
+    if (tls.enabled()) {
+        TlsTerminator::Stats stats = tls.stats();
+        LOG_INFO("RelayServer", "TLS handshakes", {"total", stats.handshakes}, {"resumed", stats.resumed},
+                 {"ktls", stats.ktls}, {"proxied", stats.proxied}, {"failed", stats.failures});
+    }
+    
     close(server_fd);
-    std::cout << "[RelayServer] Shutdown complete" << std::endl;
+    LOG_INFO("RelayServer", "Shutdown complete");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "share_cache.h"
+#include "async_log.h"
+#include <openssl/evp.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const char kBlobPrefix[] = "blob-";
+const char kLinkPrefix[] = "link-";
+const char kFillPrefix[] = ".fill-";
+const size_t kDigestHexLength = 64;
+
+std::string toHex(const unsigned char* data, unsigned int length) {
+    std::string hex;
+    char byte[3];
+    for (unsigned int i = 0; i < length; i++) {
+        snprintf(byte, sizeof(byte), "%02x", data[i]);
+        hex += byte;
+    }
+    return hex;
+}
+
+std::string sha256Hex(const std::string& data) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    if (EVP_Digest(data.data(), data.size(), digest, &length, EVP_sha256(), nullptr) != 1) {
+        return std::string();
+    }
+    return toHex(digest, length);
+}
+
+// `name` is `prefix` followed by a SHA-256 in lowercase hex; returns the digest
+bool digestName(const char* name, const char* prefix, std::string& digest) {
+    size_t prefix_length = strlen(prefix);
+    if (strncmp(name, prefix, prefix_length) != 0 || strlen(name) != prefix_length + kDigestHexLength) {
+        return false;
+    }
+    digest = name + prefix_length;
+    return digest.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+bool fillName(const char* name) {
+    size_t prefix_length = strlen(kFillPrefix);
+    return strncmp(name, kFillPrefix, prefix_length) == 0 && name[prefix_length] != '\0' &&
+           strspn(name + prefix_length, "0123456789") == strlen(name + prefix_length);
+}
+
+}
+
+ShareCache::Fill::Fill() : m_fd(-1), m_size(0), m_digest(nullptr) {
+}
+
+ShareCache::Fill::~Fill() {
+    discard();
+}
+
+// Drops the partial blob; the fill is then served uncached
+void ShareCache::Fill::discard() {
+    if (m_fd >= 0) {
+        close(m_fd);
+        unlink(m_tmp_path.c_str());
+        m_fd = -1;
+    }
+    if (m_digest) {
+        EVP_MD_CTX_free(m_digest);
+        m_digest = nullptr;
+    }
+}
+
+void ShareCache::Fill::append(const char* data, size_t length) {
+    if (m_fd < 0) {
+        return;
+    }
+
+    EVP_DigestUpdate(m_digest, data, length);
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = write(m_fd, data + written, length - written);
+        if (n <= 0) {
+            LOG_WARN("ShareCache", "Write failed, not caching", {"link", m_key}, {"error", strerror(errno)});
+            discard();
+            return;
+        }
+        written += n;
+    }
+    m_size += length;
+}
+
+ShareCache::ShareCache() : m_max_bytes(0), m_used_bytes(0), m_next_fill(0) {
+}
+
+bool ShareCache::init(const std::string& dir, uint64_t max_bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dir = dir;
+    m_max_bytes = max_bytes;
+
+    if (mkdir(m_dir.c_str(), 0700) == -1 && errno != EEXIST) {
+        LOG_ERROR("ShareCache", "Cannot create cache directory", {"dir", m_dir}, {"error", strerror(errno)});
+        return false;
+    }
+
+    loadLocked();
+    evictLocked();
+    LOG_INFO("ShareCache", "Caching shared files", {"dir", m_dir}, {"max_bytes", m_max_bytes},
+             {"links", m_links.size()}, {"used_bytes", m_used_bytes});
+    return true;
+}
+
+std::string ShareCache::linkPath(const std::string& key) const {
+    return m_dir + "/" + kLinkPrefix + sha256Hex(key);
+}
+
+// Link file: key, expiry, blob digest and file name, one per line; written
+// under a fill name and renamed, so a crash leaves no half-written link
+void ShareCache::writeLinkLocked(const std::string& key, const Link& link) {
+    std::string tmp_path = m_dir + "/" + kFillPrefix + std::to_string(m_next_fill++);
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        out << key << '\n' << link.expiry << '\n' << link.digest << '\n' << link.file_name;
+        if (!out) {
+            out.close();
+            unlink(tmp_path.c_str());
+            return;
+        }
+    }
+    if (rename(tmp_path.c_str(), linkPath(key).c_str()) == -1) {
+        unlink(tmp_path.c_str());
+    }
+}
+
+// Rebuilds the index from what a previous run left in the directory. Only
+// cache-owned names are looked at; LRU order follows the blobs' mtimes,
+// which are touched whenever a blob is served.
+void ShareCache::loadLocked() {
+    DIR* listing = opendir(m_dir.c_str());
+    if (!listing) {
+        return;
+    }
+
+    std::vector<std::pair<time_t, std::string>> blob_times;
+    std::vector<std::string> link_files;
+    struct dirent* entry;
+    while ((entry = readdir(listing)) != nullptr) {
+        std::string path = m_dir + "/" + entry->d_name;
+        std::string digest;
+        struct stat info;
+        if (fillName(entry->d_name)) {
+            unlink(path.c_str());
+        } else if (digestName(entry->d_name, kBlobPrefix, digest)) {
+            if (lstat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                Blob& blob = m_blobs[digest];
+                blob.path = path;
+                blob.size = info.st_size;
+                blob_times.emplace_back(info.st_mtime, digest);
+            }
+        } else if (digestName(entry->d_name, kLinkPrefix, digest)) {
+            link_files.push_back(path);
+        }
+    }
+    closedir(listing);
+
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    for (const std::string& path : link_files) {
+        std::ifstream in(path);
+        std::string key, expiry, digest;
+        std::getline(in, key);
+        std::getline(in, expiry);
+        std::getline(in, digest);
+        std::stringstream file_name;
+        file_name << in.rdbuf();
+
+        Link link{digest, file_name.str(), strtoll(expiry.c_str(), nullptr, 10)};
+        auto blob = m_blobs.find(digest);
+        if (key.empty() || linkPath(key) != path || blob == m_blobs.end() || link.expiry <= now) {
+            unlink(path.c_str());
+            continue;
+        }
+        blob->second.links.insert(key);
+        m_links[key] = link;
+    }
+
+    std::sort(blob_times.begin(), blob_times.end());
+    for (auto it = blob_times.rbegin(); it != blob_times.rend(); ++it) {
+        auto blob = m_blobs.find(it->second);
+        if (blob->second.links.empty()) {
+            unlink(blob->second.path.c_str());
+            m_blobs.erase(blob);
+            continue;
+        }
+        m_lru.push_back(it->second);
+        blob->second.lru_pos = std::prev(m_lru.end());
+        m_used_bytes += blob->second.size;
+    }
+}
+
+bool ShareCache::acquire(const std::string& key, Entry& entry, Fill& fill) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_fill_done.wait(lock, [&] { return m_filling.count(key) == 0; });
+
+    auto link = m_links.find(key);
+    if (link != m_links.end() && link->second.expiry <= static_cast<int64_t>(time(nullptr))) {
+        // Past the link's expiry the PC decides (410)
+        dropLinkLocked(key);
+        link = m_links.end();
+    }
+    if (link != m_links.end()) {
+        Blob& blob = m_blobs[link->second.digest];
+        m_lru.splice(m_lru.begin(), m_lru, blob.lru_pos);
+        utimensat(AT_FDCWD, blob.path.c_str(), nullptr, 0);
+        entry.blob_path = blob.path;
+        entry.size = blob.size;
+        entry.file_name = link->second.file_name;
+        return true;
+    }
+
+    m_filling.insert(key);
+    fill.m_key = key;
+    fill.m_tmp_path = m_dir + "/" + kFillPrefix + std::to_string(m_next_fill++);
+    fill.m_fd = open(fill.m_tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fill.m_fd < 0) {
+        LOG_WARN("ShareCache", "Cannot create blob, serving uncached", {"path", fill.m_tmp_path},
+                 {"error", strerror(errno)});
+        return false;
+    }
+    fill.m_digest = EVP_MD_CTX_new();
+    if (!fill.m_digest || EVP_DigestInit_ex(fill.m_digest, EVP_sha256(), nullptr) != 1) {
+        fill.discard();
+    }
+    return false;
+}
+
+void ShareCache::commit(Fill& fill, uint64_t expected_size, const std::string& file_name, int64_t expiry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    if (!fill.ok() || fill.m_size != expected_size || fill.m_size > m_max_bytes ||
+        EVP_DigestFinal_ex(fill.m_digest, digest, &digest_length) != 1) {
+        fill.discard();
+        finishFillLocked(fill.m_key);
+        return;
+    }
+    close(fill.m_fd);
+    fill.m_fd = -1;
+
+    std::string hex = toHex(digest, digest_length);
+
+    auto existing = m_blobs.find(hex);
+    if (existing != m_blobs.end()) {
+        // Same content already cached for another link
+        unlink(fill.m_tmp_path.c_str());
+        existing->second.links.insert(fill.m_key);
+        m_lru.splice(m_lru.begin(), m_lru, existing->second.lru_pos);
+    } else {
+        Blob blob;
+        blob.path = m_dir + "/" + kBlobPrefix + hex;
+        blob.size = fill.m_size;
+        if (rename(fill.m_tmp_path.c_str(), blob.path.c_str()) == -1) {
+            unlink(fill.m_tmp_path.c_str());
+            finishFillLocked(fill.m_key);
+            return;
+        }
+        blob.links.insert(fill.m_key);
+        m_lru.push_front(hex);
+        blob.lru_pos = m_lru.begin();
+        m_blobs[hex] = blob;
+        m_used_bytes += blob.size;
+    }
+    m_links[fill.m_key] = Link{hex, file_name, expiry};
+    writeLinkLocked(fill.m_key, m_links[fill.m_key]);
+
+    LOG_INFO("ShareCache", "Cached", {"link", fill.m_key}, {"sha256", hex}, {"bytes", fill.m_size},
+             {"used_bytes", m_used_bytes});
+
+    evictLocked();
+    finishFillLocked(fill.m_key);
+}
+
+void ShareCache::abort(Fill& fill) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fill.discard();
+    finishFillLocked(fill.m_key);
+}
+
+// Forgets a link, and its blob once no other link uses it
+void ShareCache::dropLinkLocked(const std::string& key) {
+    auto link = m_links.find(key);
+    if (link == m_links.end()) {
+        return;
+    }
+    auto blob = m_blobs.find(link->second.digest);
+    m_links.erase(link);
+    unlink(linkPath(key).c_str());
+    if (blob != m_blobs.end()) {
+        blob->second.links.erase(key);
+        if (blob->second.links.empty()) {
+            removeBlobLocked(blob);
+        }
+    }
+}
+
+// A reader that already opened the blob keeps its descriptor
+void ShareCache::removeBlobLocked(std::map<std::string, Blob>::iterator it) {
+    unlink(it->second.path.c_str());
+    for (const std::string& key : it->second.links) {
+        m_links.erase(key);
+        unlink(linkPath(key).c_str());
+    }
+    m_used_bytes -= it->second.size;
+    m_lru.erase(it->second.lru_pos);
+    m_blobs.erase(it);
+}
+
+void ShareCache::evictLocked() {
+    while (m_used_bytes > m_max_bytes && !m_lru.empty()) {
+        auto it = m_blobs.find(m_lru.back());
+        LOG_INFO("ShareCache", "Evicted", {"sha256", it->first}, {"bytes", it->second.size});
+        removeBlobLocked(it);
+    }
+}
+
+void ShareCache::finishFillLocked(const std::string& key) {
+    m_filling.erase(key);
+    m_fill_done.notify_all();
+}
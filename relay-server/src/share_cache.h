@@ -0,0 +1,111 @@
+#ifndef SHARE_CACHE_H
+#define SHARE_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+// Bounded on-disk LRU of share-link files the relay fetched from PCs.
+//
+// Blobs are stored once per SHA-256 of their content (<dir>/blob-<digest>)
+// and share links point at a blob, so one file shared under several links
+// costs the disk space of one copy. A link is served from its blob until
+// the expiry the PC gave for it; after that it is dropped and the PC is
+// asked again (and answers 410). The least recently served blob goes,
+// with every link pointing at it, once the byte budget is exceeded.
+//
+// Each link is also written to <dir>/link-<SHA-256 of pc_id/token>, so the
+// cache survives a restart. The cache only ever creates, reads or deletes
+// files named blob-*, link-* and .fill-* in its directory, so pointing it
+// at a shared directory does not touch anything else there.
+class ShareCache {
+public:
+    // A cached link, ready to serve
+    struct Entry {
+        std::string blob_path;
+        uint64_t size;
+        std::string file_name;
+    };
+
+    // A download from the PC being teed into the cache
+    class Fill {
+    public:
+        Fill();
+        ~Fill();
+        Fill(const Fill&) = delete;
+        Fill& operator=(const Fill&) = delete;
+
+        void append(const char* data, size_t length);
+        bool ok() const { return m_fd >= 0; }
+
+    private:
+        friend class ShareCache;
+        void discard();
+
+        std::string m_key;
+        std::string m_tmp_path;
+        int m_fd;
+        uint64_t m_size;
+        EVP_MD_CTX* m_digest;
+    };
+
+    ShareCache();
+
+    // Creates `dir` if needed and reloads the links and blobs a previous
+    // run left there. Expired links, blobs no link uses and interrupted
+    // fills are deleted; the most recently served blobs are kept within
+    // `max_bytes`.
+    bool init(const std::string& dir, uint64_t max_bytes);
+
+    // Looks up link `key`, first waiting out a fill of it already in
+    // progress so the PC is read only once. True on a hit; on a miss
+    // `fill` is started and the caller must commit() or abort() it.
+    bool acquire(const std::string& key, Entry& entry, Fill& fill);
+
+    // Publishes a finished fill; `expected_size` guards against short reads
+    void commit(Fill& fill, uint64_t expected_size, const std::string& file_name, int64_t expiry);
+    void abort(Fill& fill);
+
+private:
+    struct Link {
+        std::string digest;
+        std::string file_name;
+        int64_t expiry;
+    };
+
+    struct Blob {
+        std::string path;
+        uint64_t size;
+        std::set<std::string> links;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    std::string linkPath(const std::string& key) const;
+    void writeLinkLocked(const std::string& key, const Link& link);
+    void loadLocked();
+    void dropLinkLocked(const std::string& key);
+    void removeBlobLocked(std::map<std::string, Blob>::iterator it);
+    void evictLocked();
+    void finishFillLocked(const std::string& key);
+
+    std::mutex m_mutex;
+    std::condition_variable m_fill_done;
+
+    std::string m_dir;
+    uint64_t m_max_bytes;
+    uint64_t m_used_bytes;
+    uint64_t m_next_fill;
+
+    std::map<std::string, Link> m_links;      // pc_id/token -> blob
+    std::map<std::string, Blob> m_blobs;      // digest -> blob
+    std::list<std::string> m_lru;             // digests, front = most recently served
+    std::set<std::string> m_filling;
+};
+
+#endif // SHARE_CACHE_H
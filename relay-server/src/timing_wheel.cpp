@@ -0,0 +1,204 @@
+#include "timing_wheel.h"
+#include <algorithm>
+
+namespace RemoteAccessSystem {
+namespace RelayServer {
+
+TimingWheel::TimingWheel(std::chrono::milliseconds tick)
+    : m_tick(std::max(tick, std::chrono::milliseconds(1))), m_now(0), m_pending(0), m_running(false) {
+    std::fill(m_slots, m_slots + LEVELS * SLOTS, NIL);
+}
+
+TimingWheel::~TimingWheel() {
+    stop();
+}
+
+void TimingWheel::start() {
+    if (!m_running.exchange(true)) {
+        m_thread = std::thread(&TimingWheel::run, this);
+    }
+}
+
+void TimingWheel::stop() {
+    if (m_running.exchange(false)) {
+        {
+            std::lock_guard<std::mutex> lock(m_wait_mutex);
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+}
+
+uint64_t TimingWheel::ticksFor(std::chrono::milliseconds delay) const {
+    // Never sooner than asked, never in the slot being processed, never
+    // beyond what the top level can hold
+    const uint64_t max_ticks = (uint64_t(1) << (LEVEL_BITS * LEVELS)) - 1;
+    uint64_t ms = delay.count() > 0 ? static_cast<uint64_t>(delay.count()) : 0;
+    uint64_t ticks = (ms + m_tick.count() - 1) / m_tick.count();
+    return std::min(std::max<uint64_t>(ticks, 1), max_ticks);
+}
+
+bool TimingWheel::lookup(TimerId id, uint32_t& index) const {
+    if (id == INVALID_TIMER) {
+        return false;
+    }
+    index = static_cast<uint32_t>(id & 0xFFFFFFFF) - 1;
+    return index < m_timers.size() && m_timers[index].linked &&
+           m_timers[index].generation == static_cast<uint32_t>(id >> 32);
+}
+
+void TimingWheel::link(uint32_t index) {
+    Timer& timer = m_timers[index];
+    uint64_t delta = timer.expires - m_now;
+    
+    // The level whose span covers the remaining time; the slot is picked
+    // from the absolute expiry so it comes around exactly when due
+    unsigned level = 0;
+    while (level + 1 < LEVELS && delta >= (uint64_t(1) << (LEVEL_BITS * (level + 1)))) {
+        level++;
+    }
+    unsigned slot = level * SLOTS + ((timer.expires >> (LEVEL_BITS * level)) & (SLOTS - 1));
+    
+    timer.slot = static_cast<uint16_t>(slot);
+    timer.prev = NIL;
+    timer.next = m_slots[slot];
+    if (timer.next != NIL) {
+        m_timers[timer.next].prev = index;
+    }
+    m_slots[slot] = index;
+    timer.linked = true;
+}
+
+void TimingWheel::unlink(uint32_t index) {
+    Timer& timer = m_timers[index];
+    if (timer.prev != NIL) {
+        m_timers[timer.prev].next = timer.next;
+    } else {
+        m_slots[timer.slot] = timer.next;
+    }
+    if (timer.next != NIL) {
+        m_timers[timer.next].prev = timer.prev;
+    }
+    timer.linked = false;
+}
+
+void TimingWheel::release(uint32_t index) {
+    Timer& timer = m_timers[index];
+    timer.generation++;
+    timer.callback = nullptr;
+    m_free.push_back(index);
+    m_pending--;
+}
+
+TimingWheel::TimerId TimingWheel::schedule(std::chrono::milliseconds delay, Callback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t index;
+    if (!m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+    } else {
+        index = static_cast<uint32_t>(m_timers.size());
+        m_timers.push_back(Timer());
+        m_timers[index].generation = 1;
+    }
+    
+    Timer& timer = m_timers[index];
+    timer.expires = m_now + ticksFor(delay);
+    timer.callback = std::move(callback);
+    link(index);
+    m_pending++;
+    return (static_cast<TimerId>(timer.generation) << 32) | (index + 1);
+}
+
+bool TimingWheel::reschedule(TimerId id, std::chrono::milliseconds delay) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t index;
+    if (!lookup(id, index)) {
+        return false;
+    }
+    unlink(index);
+    m_timers[index].expires = m_now + ticksFor(delay);
+    link(index);
+    return true;
+}
+
+bool TimingWheel::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t index;
+    if (!lookup(id, index)) {
+        return false;
+    }
+    unlink(index);
+    release(index);
+    return true;
+}
+
+size_t TimingWheel::pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending;
+}
+
+void TimingWheel::advance(uint64_t ticks) {
+    std::vector<std::pair<TimerId, Callback>> expired;
+    
+    for (uint64_t i = 0; i < ticks; i++) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_now++;
+            
+            // Each time a level wraps, the next level's current slot is due
+            // within the span below it: move its timers down
+            for (unsigned level = 1; level < LEVELS; level++) {
+                if ((m_now & ((uint64_t(1) << (LEVEL_BITS * level)) - 1)) != 0) {
+                    break;
+                }
+                unsigned slot = level * SLOTS + ((m_now >> (LEVEL_BITS * level)) & (SLOTS - 1));
+                uint32_t index = m_slots[slot];
+                m_slots[slot] = NIL;
+                while (index != NIL) {
+                    uint32_t next = m_timers[index].next;
+                    link(index);
+                    index = next;
+                }
+            }
+            
+            unsigned slot = m_now & (SLOTS - 1);
+            uint32_t index = m_slots[slot];
+            m_slots[slot] = NIL;
+            while (index != NIL) {
+                Timer& timer = m_timers[index];
+                uint32_t next = timer.next;
+                timer.linked = false;
+                expired.emplace_back((static_cast<TimerId>(timer.generation) << 32) | (index + 1),
+                                     std::move(timer.callback));
+                release(index);
+                index = next;
+            }
+        }
+        
+        for (auto& timer : expired) {
+            timer.second(timer.first);
+        }
+        expired.clear();
+    }
+}
+
+void TimingWheel::run() {
+    auto next = std::chrono::steady_clock::now() + m_tick;
+    while (m_running) {
+        {
+            std::unique_lock<std::mutex> lock(m_wait_mutex);
+            m_wake.wait_until(lock, next, [this] { return !m_running; });
+        }
+        if (!m_running) break;
+        
+        // Catch up on ticks missed while callbacks ran long
+        auto now = std::chrono::steady_clock::now();
+        uint64_t ticks = 1 + (now - next) / m_tick;
+        next += ticks * m_tick;
+        advance(ticks);
+    }
+}
+
+} // namespace RelayServer
+} // namespace RemoteAccessSystem
@@ -0,0 +1,279 @@
+#include "tls_terminator.h"
+#include "async_log.h"
+#include <thread>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+namespace {
+
+const unsigned char TLS_HANDSHAKE_RECORD = 0x16;
+const int HANDSHAKE_TIMEOUT_SECONDS = 10;
+// Longest the pump waits for either side to take data before it gives
+// the connection up; idle connections are not affected
+const int STALL_TIMEOUT_MS = 30000;
+
+std::string lastSslError() {
+    char text[256];
+    unsigned long code = ERR_get_error();
+    if (code == 0) return "unknown error";
+    ERR_error_string_n(code, text, sizeof(text));
+    ERR_clear_error();
+    return text;
+}
+
+void setReceiveTimeout(int fd, int seconds) {
+    struct timeval tv;
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// Waits up to STALL_TIMEOUT_MS for fd to become ready for `events`;
+// false on timeout or error
+bool waitReady(int fd, short events) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    int ready;
+    do {
+        ready = poll(&pfd, 1, STALL_TIMEOUT_MS);
+    } while (ready < 0 && errno == EINTR);
+    if (ready == 0) {
+        LOG_INFO("RelayServer", "TLS connection stalled, closing", {"fd", fd}, {"timeout_ms", STALL_TIMEOUT_MS});
+    }
+    return ready > 0;
+}
+
+// Waits until fd is ready for the event OpenSSL asked for
+bool waitFor(int fd, int ssl_error) {
+    return waitReady(fd, ssl_error == SSL_ERROR_WANT_WRITE ? POLLOUT : POLLIN);
+}
+
+// fd is non-blocking; a side that takes nothing for STALL_TIMEOUT_MS fails
+bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!waitReady(fd, POLLOUT)) return false;
+            continue;
+        }
+        if (sent <= 0) return false;
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+bool sslWriteAll(SSL* ssl, int net_fd, const char* data, size_t length) {
+    while (length > 0) {
+        size_t written = 0;
+        if (SSL_write_ex(ssl, data, length, &written) == 1) {
+            data += written;
+            length -= written;
+            continue;
+        }
+        int error = SSL_get_error(ssl, 0);
+        if ((error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) || !waitFor(net_fd, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TlsTerminator::TlsTerminator()
+    : m_ctx(nullptr), m_handshakes(0), m_resumed(0), m_ktls(0), m_proxied(0), m_failures(0) {
+}
+
+TlsTerminator::~TlsTerminator() {
+    SSL_CTX_free(m_ctx);
+}
+
+bool TlsTerminator::init(const std::string& cert_file, const std::string& key_file) {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        LOG_ERROR("RelayServer", "TLS context failed", {"error", lastSslError()});
+        return false;
+    }
+    
+    SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+    
+    if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        LOG_ERROR("RelayServer", "TLS certificate unusable", {"certificate", cert_file}, {"key", key_file},
+                  {"error", lastSslError()});
+        SSL_CTX_free(ctx);
+        return false;
+    }
+    
+    // Stateless tickets: no server-side cache to share between threads,
+    // one ticket per handshake is enough for a client that reconnects
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_num_tickets(ctx, 1);
+    SSL_CTX_set_timeout(ctx, 24 * 60 * 60);
+    
+    // Partial writes let the pump forward as soon as a record is out;
+    // no read-ahead so nothing is buffered past the handshake, which is
+    // what allows the kernel to take over the receive side
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    SSL_CTX_set_read_ahead(ctx, 0);
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
+    m_ctx = ctx;
+    return true;
+}
+
+bool TlsTerminator::startsWithTls(int fd) {
+    unsigned char first = 0;
+    ssize_t bytes;
+    do {
+        bytes = recv(fd, &first, 1, MSG_PEEK);
+    } while (bytes < 0 && errno == EINTR);
+    return bytes == 1 && first == TLS_HANDSHAKE_RECORD;
+}
+
+int TlsTerminator::accept(int fd) {
+    SSL* ssl = SSL_new(m_ctx);
+    if (!ssl || SSL_set_fd(ssl, fd) != 1) {
+        LOG_WARN("RelayServer", "TLS session setup failed", {"error", lastSslError()});
+        SSL_free(ssl);
+        close(fd);
+        m_failures++;
+        return -1;
+    }
+    
+    // A client that stalls mid-handshake must not pin the thread
+    setReceiveTimeout(fd, HANDSHAKE_TIMEOUT_SECONDS);
+    if (SSL_accept(ssl) != 1) {
+        LOG_WARN("RelayServer", "TLS handshake failed", {"error", lastSslError()});
+        SSL_free(ssl);
+        close(fd);
+        m_failures++;
+        return -1;
+    }
+    setReceiveTimeout(fd, 0);
+    
+    m_handshakes++;
+    if (SSL_session_reused(ssl)) {
+        m_resumed++;
+    }
+    
+    // Both directions in the kernel and nothing left in OpenSSL's buffers:
+    // the socket can be used directly. The BIO does not own the fd, so
+    // freeing the SSL leaves the connection open.
+    bool ktls = false;
+#ifdef SSL_OP_ENABLE_KTLS
+    ktls = BIO_get_ktls_send(SSL_get_wbio(ssl)) && BIO_get_ktls_recv(SSL_get_rbio(ssl)) &&
+           !SSL_has_pending(ssl);
+#endif
+    if (ktls) {
+        SSL_free(ssl);
+        m_ktls++;
+        return fd;
+    }
+    
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        LOG_WARN("RelayServer", "TLS socketpair failed", {"error", strerror(errno)});
+        SSL_free(ssl);
+        close(fd);
+        m_failures++;
+        return -1;
+    }
+    
+    // The pump writes every record as soon as it has it; Nagle on the real
+    // socket would only add latency to the interactive channels
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    
+    m_proxied++;
+    std::thread(&TlsTerminator::pump, ssl, fd, pair[1]).detach();
+    return pair[0];
+}
+
+// Both descriptors are non-blocking, so a side that stops taking data
+// costs at most STALL_TIMEOUT_MS before the connection is torn down
+void TlsTerminator::pump(SSL* ssl, int net_fd, int app_fd) {
+    fcntl(net_fd, F_SETFL, fcntl(net_fd, F_GETFL) | O_NONBLOCK);
+    fcntl(app_fd, F_SETFL, fcntl(app_fd, F_GETFL) | O_NONBLOCK);
+    
+    char buffer[16384];
+    bool open = true;
+    bool peer_closed = false;
+    while (open) {
+        // Everything OpenSSL can decrypt now, before waiting again
+        while (true) {
+            size_t bytes = 0;
+            if (SSL_read_ex(ssl, buffer, sizeof(buffer), &bytes) == 1) {
+                if (!writeAll(app_fd, buffer, bytes)) {
+                    open = false;
+                    break;
+                }
+                continue;
+            }
+            int error = SSL_get_error(ssl, 0);
+            if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+                peer_closed = true;
+                open = false;
+            }
+            break;
+        }
+        if (!open) break;
+        
+        struct pollfd fds[2];
+        fds[0].fd = net_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = app_fd;
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t bytes = recv(app_fd, buffer, sizeof(buffer), 0);
+            if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                continue;
+            }
+            if (bytes <= 0 || !sslWriteAll(ssl, net_fd, buffer, bytes)) {
+                break;
+            }
+        }
+        if (fds[0].revents & (POLLHUP | POLLERR) && !(fds[0].revents & POLLIN)) {
+            peer_closed = true;
+            break;
+        }
+    }
+    
+    if (!peer_closed) {
+        SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+    close(net_fd);
+    shutdown(app_fd, SHUT_RDWR);
+    close(app_fd);
+}
+
+TlsTerminator::Stats TlsTerminator::stats() const {
+    Stats stats;
+    stats.handshakes = m_handshakes.load();
+    stats.resumed = m_resumed.load();
+    stats.ktls = m_ktls.load();
+    stats.proxied = m_proxied.load();
+    stats.failures = m_failures.load();
+    return stats;
+}
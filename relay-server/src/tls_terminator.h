@@ -0,0 +1,66 @@
+#ifndef TLS_TERMINATOR_H
+#define TLS_TERMINATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+
+// TLS 1.3 termination for relay connections.
+//
+// TLS clients share the relay port with plaintext ones: a TLS handshake
+// record starts with 0x16, which no text command and no Wire frame (0xFA)
+// does, so the first byte tells them apart and older clients keep working.
+//
+// After the handshake the connection is handed back as a plain fd, so the
+// relay's send/recv/splice code does not change:
+//  - with kernel TLS the socket itself, the kernel doing record crypto
+//    (zero-copy transfers keep working on it);
+//  - otherwise one end of a socketpair, with a pump thread running
+//    SSL_read/SSL_write against the real socket.
+//
+// Resumption uses stateless TLS 1.3 session tickets keyed per process, so
+// a reconnecting mobile skips the certificate and signature exchange.
+class TlsTerminator {
+public:
+    struct Stats {
+        uint64_t handshakes;
+        uint64_t resumed;
+        uint64_t ktls;          // handed back with kernel TLS both ways
+        uint64_t proxied;       // handed back through a pump thread
+        uint64_t failures;
+    };
+
+    TlsTerminator();
+    ~TlsTerminator();
+
+    // Loads a PEM certificate chain and key; false (logged) if unusable
+    bool init(const std::string& cert_file, const std::string& key_file);
+    bool enabled() const { return m_ctx != nullptr; }
+
+    // Waits for the peer's first byte without consuming it
+    static bool startsWithTls(int fd);
+
+    // Runs the server handshake on fd. Returns the descriptor the relay
+    // should use from now on, or -1 (fd closed) if the handshake failed.
+    int accept(int fd);
+
+    Stats stats() const;
+
+private:
+    static void pump(SSL* ssl, int net_fd, int app_fd);
+
+    TlsTerminator(const TlsTerminator&) = delete;
+    TlsTerminator& operator=(const TlsTerminator&) = delete;
+
+    SSL_CTX* m_ctx;
+    std::atomic<uint64_t> m_handshakes;
+    std::atomic<uint64_t> m_resumed;
+    std::atomic<uint64_t> m_ktls;
+    std::atomic<uint64_t> m_proxied;
+    std::atomic<uint64_t> m_failures;
+};
+
+#endif // TLS_TERMINATOR_H